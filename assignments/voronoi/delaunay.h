@@ -0,0 +1,638 @@
+#ifndef DELAUNAY_H
+#define DELAUNAY_H
+
+// Delaunay triangulation of the Voronoi sites, built incrementally as the sites are added, and the Voronoi diagram
+// that is its dual.
+//
+// The sites are inserted with the Bowyer-Watson algorithm: the triangle that contains the new site is found by
+// walking across the triangulation, every triangle whose circumcircle contains the site is removed (the cavity),
+// and the cavity is filled with a fan of triangles around the site.
+// A coarse grid keeps, for every cell, the last site added in it. The walks start from the site of the grid cell of
+// the point (or of the closest cell that has one), so they cross a few triangles on average and the expected cost of
+// an insertion or a query does not grow with the number of sites (for sites spread over the bounds, the grid doubles
+// its resolution as they are added).
+//
+// The sites must be inside the bounds given to the constructor. Three extra vertices (a triangle much larger than
+// the bounds) enclose them, so every point of the bounds is in a triangle. The triangles that use these vertices are
+// not part of the diagram, the cells of the sites on the convex hull are cut at the bounds.
+//
+// The nearest site of a point is found by walking the Delaunay graph: from any site, a neighbour closer to the point
+// exists unless the site is already the nearest one.
+//
+// The cell of a site is the polygon of the circumcenters of the triangles around it, see cellPolygon.
+//
+// The orientation and in-circle tests are exact (see the exact namespace): they are computed in doubles first, and
+// again with exact expansion arithmetic when the result is too close to 0 to trust its sign. A wrong sign would walk
+// in circles or leave overlapping triangles. Being exact, the tests don't lose precision on the large triangles of the
+// enclosing vertices either. A point exactly on a circumcircle counts as outside, so four or more sites on one circle
+// get one of their valid triangulations.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Shewchuk's exact arithmetic ("Adaptive Precision Floating-Point Arithmetic and Fast Robust Geometric Predicates"):
+// an expansion is a sum of doubles of increasing magnitude that don't overlap, it holds the exact result of sums and
+// products of doubles. Its sign is the sign of its last (largest) component.
+// This needs IEEE doubles rounded to nearest, it breaks with -ffast-math or with the x87 extended registers.
+namespace exact {
+    typedef std::vector<double> Expansion;
+
+    // a + b = sum + error exactly
+    inline void twoSum(double a, double b, double &sum, double &error)
+    {
+        sum = a + b;
+        double bVirtual = sum - a, aVirtual = sum - bVirtual;
+        error = (a - aVirtual) + (b - bVirtual);
+    }
+
+    // a = high + low, each with half of the bits of the mantissa
+    inline void split(double a, double &high, double &low)
+    {
+        double c = 134217729.0 * a; // 2^27 + 1
+        high = c - (c - a);
+        low = a - high;
+    }
+
+    // a * b = product + error exactly
+    inline void twoProduct(double a, double b, double &product, double &error)
+    {
+        product = a * b;
+        double aHigh, aLow, bHigh, bLow;
+        split(a, aHigh, aLow);
+        split(b, bHigh, bLow);
+        error = aLow * bLow - (((product - aHigh * bHigh) - aLow * bHigh) - aHigh * bLow);
+    }
+
+    // appends the component to h unless it is 0, an empty expansion is 0
+    inline void append(Expansion &h, double component)
+    {
+        if (component != 0.0)
+            h.push_back(component);
+    }
+
+    inline Expansion difference(double a, double b)
+    {
+        double sum, error;
+        twoSum(a, -b, sum, error);
+        Expansion h;
+        append(h, error);
+        append(h, sum);
+        return h;
+    }
+
+    inline Expansion sum(const Expansion &e, const Expansion &f)
+    {
+        // the components of both, by increasing magnitude, added one at a time
+        Expansion merged(e.size() + f.size());
+        std::merge(e.begin(), e.end(), f.begin(), f.end(), merged.begin(),
+                   [](double a, double b) { return std::abs(a) < std::abs(b); });
+        Expansion h;
+        double q = 0.0;
+        for (double component : merged)
+        {
+            double error;
+            twoSum(q, component, q, error);
+            append(h, error);
+        }
+        append(h, q);
+        return h;
+    }
+
+    inline Expansion negate(Expansion e)
+    {
+        for (double &component : e)
+            component = -component;
+        return e;
+    }
+
+    inline Expansion scale(const Expansion &e, double b)
+    {
+        Expansion h;
+        if (e.empty() || b == 0.0)
+            return h;
+        double q, error;
+        twoProduct(e[0], b, q, error);
+        append(h, error);
+        for (size_t i = 1; i < e.size(); i++)
+        {
+            double product, productError, sum;
+            twoProduct(e[i], b, product, productError);
+            twoSum(q, productError, sum, error);
+            append(h, error);
+            twoSum(product, sum, q, error);
+            append(h, error);
+        }
+        append(h, q);
+        return h;
+    }
+
+    inline Expansion product(const Expansion &e, const Expansion &f)
+    {
+        Expansion h;
+        for (double component : f)
+            h = sum(h, scale(e, component));
+        return h;
+    }
+
+    inline int sign(const Expansion &e)
+    {
+        return e.empty() ? 0 : e.back() > 0.0 ? 1 : -1;
+    }
+
+    // bounds of the rounding errors of the double versions of the tests, from Shewchuk
+    const double epsilon = 1.1102230246251565e-16; // 2^-53
+    const double orientBound = (3.0 + 16.0 * epsilon) * epsilon;
+    const double inCircleBound = (10.0 + 96.0 * epsilon) * epsilon;
+
+    // the signs of the determinants of orient and inCircle below, computed exactly
+    inline int orientSign(double ax, double ay, double bx, double by, double cx, double cy)
+    {
+        return sign(sum(product(difference(ax, cx), difference(by, cy)),
+                        negate(product(difference(ay, cy), difference(bx, cx)))));
+    }
+
+    inline int inCircleSign(double ax, double ay, double bx, double by, double cx, double cy, double dx, double dy)
+    {
+        Expansion adx = difference(ax, dx), ady = difference(ay, dy), bdx = difference(bx, dx),
+                  bdy = difference(by, dy), cdx = difference(cx, dx), cdy = difference(cy, dy);
+        // the lifted length of each vertex times the 2x2 minor of the two others
+        auto lift = [](const Expansion &x, const Expansion &y) { return sum(product(x, x), product(y, y)); };
+        auto minor = [](const Expansion &x1, const Expansion &y1, const Expansion &x2, const Expansion &y2) {
+            return sum(product(x1, y2), negate(product(x2, y1)));
+        };
+        Expansion a = product(lift(adx, ady), minor(bdx, bdy, cdx, cdy));
+        Expansion b = product(lift(bdx, bdy), minor(cdx, cdy, adx, ady));
+        Expansion c = product(lift(cdx, cdy), minor(adx, ady, bdx, bdy));
+        return sign(sum(sum(a, b), c));
+    }
+
+    // 1 if a, b, c are in counter clockwise order, -1 if clockwise, 0 if they are on a line
+    inline int orient(double ax, double ay, double bx, double by, double cx, double cy)
+    {
+        double left = (ax - cx) * (by - cy), right = (ay - cy) * (bx - cx);
+        double determinant = left - right;
+        if (std::abs(determinant) > orientBound * (std::abs(left) + std::abs(right)))
+            return determinant > 0.0 ? 1 : -1;
+        return orientSign(ax, ay, bx, by, cx, cy);
+    }
+
+    // 1 if d is inside the circle through the counter clockwise a, b, c, -1 if it is outside, 0 if it is on it
+    inline int inCircle(double ax, double ay, double bx, double by, double cx, double cy, double dx, double dy)
+    {
+        double adx = ax - dx, ady = ay - dy, bdx = bx - dx, bdy = by - dy, cdx = cx - dx, cdy = cy - dy;
+        double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy, cdxady = cdx * ady, adxcdy = adx * cdy;
+        double adxbdy = adx * bdy, bdxady = bdx * ady;
+        double aLift = adx * adx + ady * ady, bLift = bdx * bdx + bdy * bdy, cLift = cdx * cdx + cdy * cdy;
+        double determinant = aLift * (bdxcdy - cdxbdy) + bLift * (cdxady - adxcdy) + cLift * (adxbdy - bdxady);
+        double permanent = (std::abs(bdxcdy) + std::abs(cdxbdy)) * aLift + (std::abs(cdxady) + std::abs(adxcdy)) * bLift +
+                           (std::abs(adxbdy) + std::abs(bdxady)) * cLift;
+        if (std::abs(determinant) > inCircleBound * permanent)
+            return determinant > 0.0 ? 1 : -1;
+        return inCircleSign(ax, ay, bx, by, cx, cy, dx, dy);
+    }
+}
+
+class Delaunay {
+public:
+    enum { NO_SITE = -1, NO_TRIANGLE = -1 };
+
+    // vertices in counter clockwise order, neighbour[i] shares the edge opposite to vertex[i]
+    struct Triangle {
+        int vertex[3];
+        int neighbour[3];
+    };
+
+    Delaunay(float minX = -1.0f, float minY = -1.0f, float maxX = 1.0f, float maxY = 1.0f)
+        : minX(minX), minY(minY), maxX(maxX), maxY(maxY)
+    {
+        clear();
+    }
+
+    // removes all the sites
+    void clear()
+    {
+        x.clear(); y.clear();
+        vertexTriangle.clear();
+        triangles.clear();
+        freeTriangles.clear();
+        stamps.clear();
+
+        // the enclosing triangle, far enough that its vertices don't change the diagram inside the bounds
+        double centerX = (minX + maxX) * 0.5, centerY = (minY + maxY) * 0.5;
+        double size = std::max(maxX - minX, maxY - minY) * 1.0e4;
+        addVertex(centerX - size, centerY - size);
+        addVertex(centerX + size, centerY - size);
+        addVertex(centerX, centerY + size);
+        triangles.push_back(Triangle{{0, 1, 2}, {NO_TRIANGLE, NO_TRIANGLE, NO_TRIANGLE}});
+        stamps.push_back(0);
+        vertexTriangle[0] = vertexTriangle[1] = vertexTriangle[2] = 0;
+        lastTriangle = 0;
+
+        gridSize = 1;
+        grid.assign(1, NO_SITE);
+    }
+
+    size_t siteCount() const { return x.size() - FIRST_SITE; }
+
+    glm::vec2 site(int s) const { return glm::vec2(x[s + FIRST_SITE], y[s + FIRST_SITE]); }
+
+    // adds a site, returns its index, or NO_SITE if it is out of the bounds or there is a site at the same position
+    int insert(float px, float py)
+    {
+        if (!(px >= minX && px <= maxX && py >= minY && py <= maxY))
+            return NO_SITE;
+        int t = locate(px, py, startTriangle(px, py));
+        for (int v : triangles[t].vertex)
+            if (x[v] == px && y[v] == py)
+                return NO_SITE;
+
+        int p = addVertex(px, py);
+        fillCavity(p, t);
+
+        int s = p - FIRST_SITE;
+        if (siteCount() > (size_t) gridSize * gridSize * 2)
+            resizeGrid(gridSize * 2);
+        else
+            grid[gridCell(px, py)] = s;
+        return s;
+    }
+
+    // the site closest to the point, NO_SITE if there are no sites
+    int nearest(float px, float py) const
+    {
+        if (siteCount() == 0)
+            return NO_SITE;
+        int v = startVertex(px, py);
+        double best = squaredDistance(v, px, py);
+        std::vector<int> around;
+        for (bool moved = true; moved; )
+        {
+            moved = false;
+            neighbourVertices(v, around);
+            for (int u : around)
+            {
+                double d = u >= FIRST_SITE ? squaredDistance(u, px, py) : INFINITY;
+                if (d < best)
+                {
+                    best = d;
+                    v = u;
+                    moved = true;
+                }
+            }
+        }
+        return v - FIRST_SITE;
+    }
+
+    // the sites whose cells share an edge with the cell of site s
+    void neighbours(int s, std::vector<int> &sites) const
+    {
+        std::vector<int> around;
+        neighbourVertices(s + FIRST_SITE, around);
+        sites.clear();
+        for (int v : around)
+            if (v >= FIRST_SITE)
+                sites.push_back(v - FIRST_SITE);
+    }
+
+    // the Voronoi cell of site s, in counter clockwise order and cut at the bounds
+    void cellPolygon(int s, std::vector<glm::vec2> &polygon) const
+    {
+        polygon.clear();
+        int v = s + FIRST_SITE;
+        int first = vertexTriangle[v], t = first;
+        do
+        {
+            polygon.push_back(circumcenter(triangles[t]));
+            t = nextAround(t, v);
+        } while (t != first && t != NO_TRIANGLE);
+        clip(polygon);
+    }
+
+    // triangles between sites only (without the enclosing vertices), three site indices per triangle
+    void siteTriangles(std::vector<int> &indices) const
+    {
+        indices.clear();
+        for (size_t t = 0; t < triangles.size(); t++)
+        {
+            const Triangle &triangle = triangles[t];
+            if (isFree(t) || triangle.vertex[0] < FIRST_SITE || triangle.vertex[1] < FIRST_SITE ||
+                triangle.vertex[2] < FIRST_SITE)
+                continue;
+            for (int v : triangle.vertex)
+                indices.push_back(v - FIRST_SITE);
+        }
+    }
+
+    // number of triangles that are not counter clockwise, plus the number of triangle edges between sites that are not
+    // locally Delaunay (the vertex across the edge is strictly inside the circumcircle), 0 for a valid triangulation.
+    // The tests are exact, there is no tolerance
+    size_t countViolations() const
+    {
+        size_t violations = 0;
+        for (size_t t = 0; t < triangles.size(); t++)
+        {
+            const Triangle &triangle = triangles[t];
+            if (isFree(t))
+                continue;
+            violations += orient(triangle.vertex[0], triangle.vertex[1], x[triangle.vertex[2]], y[triangle.vertex[2]]) <= 0;
+            for (int i = 0; i < 3; i++)
+            {
+                int n = triangle.neighbour[i];
+                if (n == NO_TRIANGLE)
+                    continue;
+                int opposite = oppositeVertex(triangles[n], (int) t);
+                if (opposite < FIRST_SITE || triangle.vertex[0] < FIRST_SITE || triangle.vertex[1] < FIRST_SITE ||
+                    triangle.vertex[2] < FIRST_SITE)
+                    continue;
+                violations += inCircle(triangle, opposite) > 0;
+            }
+        }
+        return violations;
+    }
+
+private:
+    // the vertices of the enclosing triangle come first
+    enum { FIRST_SITE = 3 };
+
+    double minX, minY, maxX, maxY;
+
+    std::vector<double> x, y;
+    std::vector<int> vertexTriangle; // a triangle that uses the vertex
+    std::vector<Triangle> triangles;
+    std::vector<int> freeTriangles;  // removed triangles, their slots are used again
+    std::vector<unsigned int> stamps; // marks the triangles of the current cavity
+    unsigned int stamp = 0;
+    int lastTriangle = 0;
+    mutable unsigned int walkRotation = 0;
+
+    // the last site added in each cell of a gridSize x gridSize grid over the bounds
+    int gridSize = 1;
+    std::vector<int> grid;
+
+    // scratch memory of the insertions
+    std::vector<int> cavity, stack;
+    struct BoundaryEdge { int from, to, outside, triangle; };
+    std::vector<BoundaryEdge> boundary;
+
+    int addVertex(double px, double py)
+    {
+        x.push_back(px);
+        y.push_back(py);
+        vertexTriangle.push_back(NO_TRIANGLE);
+        return (int) x.size() - 1;
+    }
+
+    bool isFree(size_t t) const { return triangles[t].vertex[0] == NO_SITE; }
+
+    double squaredDistance(int v, double px, double py) const
+    {
+        double dx = x[v] - px, dy = y[v] - py;
+        return dx * dx + dy * dy;
+    }
+
+    // 1 if a, b and the point are in counter clockwise order, -1 if clockwise, 0 if they are on a line
+    int orient(int a, int b, double px, double py) const
+    {
+        return exact::orient(x[a], y[a], x[b], y[b], px, py);
+    }
+
+    // 1 if vertex v is inside the circumcircle of the (counter clockwise) triangle, -1 if outside, 0 if on it
+    int inCircle(const Triangle &triangle, int v) const
+    {
+        int a = triangle.vertex[0], b = triangle.vertex[1], c = triangle.vertex[2];
+        return exact::inCircle(x[a], y[a], x[b], y[b], x[c], y[c], x[v], y[v]);
+    }
+
+    glm::vec2 circumcenter(const Triangle &triangle) const
+    {
+        int a = triangle.vertex[0], b = triangle.vertex[1], c = triangle.vertex[2];
+        double bx = x[b] - x[a], by = y[b] - y[a], cx = x[c] - x[a], cy = y[c] - y[a];
+        double d = 2.0 * (bx * cy - by * cx);
+        double b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+        return glm::vec2((float) (x[a] + (cy * b2 - by * c2) / d), (float) (y[a] + (bx * c2 - cx * b2) / d));
+    }
+
+    static int indexOf(const Triangle &triangle, int v)
+    {
+        return triangle.vertex[0] == v ? 0 : triangle.vertex[1] == v ? 1 : 2;
+    }
+
+    // the vertex of triangle that is not on the edge it shares with neighbour
+    static int oppositeVertex(const Triangle &triangle, int neighbour)
+    {
+        for (int i = 0; i < 3; i++)
+            if (triangle.neighbour[i] == neighbour)
+                return triangle.vertex[i];
+        return NO_SITE;
+    }
+
+    // the next triangle around vertex v in counter clockwise order
+    int nextAround(int t, int v) const
+    {
+        const Triangle &triangle = triangles[t];
+        // the edge from v to the vertex before it is opposite to the vertex after it
+        return triangle.neighbour[(indexOf(triangle, v) + 1) % 3];
+    }
+
+    // the vertices connected to v by an edge
+    void neighbourVertices(int v, std::vector<int> &vertices) const
+    {
+        vertices.clear();
+        int first = vertexTriangle[v], t = first;
+        do
+        {
+            const Triangle &triangle = triangles[t];
+            vertices.push_back(triangle.vertex[(indexOf(triangle, v) + 1) % 3]);
+            t = nextAround(t, v);
+        } while (t != first && t != NO_TRIANGLE);
+    }
+
+    int gridCell(double px, double py) const
+    {
+        int cx = std::min(gridSize - 1, std::max(0, (int) ((px - minX) / (maxX - minX) * gridSize)));
+        int cy = std::min(gridSize - 1, std::max(0, (int) ((py - minY) / (maxY - minY) * gridSize)));
+        return cy * gridSize + cx;
+    }
+
+    void resizeGrid(int size)
+    {
+        gridSize = size;
+        grid.assign((size_t) size * size, NO_SITE);
+        for (size_t v = FIRST_SITE; v < x.size(); v++)
+            grid[gridCell(x[v], y[v])] = (int) v - FIRST_SITE;
+    }
+
+    // a site close to the point: the last site added to its grid cell, or to the closest ring of cells around it
+    // that has one, NO_SITE if there are no sites
+    int gridSite(double px, double py) const
+    {
+        int cell = gridCell(px, py), cx = cell % gridSize, cy = cell / gridSize;
+        for (int ring = 0; ring < gridSize; ring++)
+            for (int j = std::max(0, cy - ring); j <= std::min(gridSize - 1, cy + ring); j++)
+                for (int i = std::max(0, cx - ring); i <= std::min(gridSize - 1, cx + ring); i++)
+                    if ((std::abs(i - cx) == ring || std::abs(j - cy) == ring) && grid[j * gridSize + i] != NO_SITE)
+                        return grid[j * gridSize + i];
+        return NO_SITE;
+    }
+
+    int startVertex(double px, double py) const
+    {
+        return gridSite(px, py) + FIRST_SITE;
+    }
+
+    int startTriangle(double px, double py) const
+    {
+        int s = gridSite(px, py);
+        return s != NO_SITE ? vertexTriangle[s + FIRST_SITE] : lastTriangle;
+    }
+
+    // walks from triangle t towards the point, crossing the edges the point is on the other side of, until the
+    // triangle contains the point. The first edge tested changes at every step, so the walk can't loop
+    int locate(double px, double py, int t) const
+    {
+        for (;;)
+        {
+            const Triangle &triangle = triangles[t];
+            int next = NO_TRIANGLE;
+            unsigned int rotation = walkRotation++;
+            for (int k = 0; k < 3 && next == NO_TRIANGLE; k++)
+            {
+                int i = (int) ((rotation + k) % 3);
+                int a = triangle.vertex[(i + 1) % 3], b = triangle.vertex[(i + 2) % 3];
+                if (orient(a, b, px, py) < 0 && triangle.neighbour[i] != NO_TRIANGLE)
+                    next = triangle.neighbour[i];
+            }
+            if (next == NO_TRIANGLE)
+                return t;
+            t = next;
+        }
+    }
+
+    int newTriangle()
+    {
+        if (!freeTriangles.empty())
+        {
+            int t = freeTriangles.back();
+            freeTriangles.pop_back();
+            return t;
+        }
+        triangles.push_back(Triangle());
+        stamps.push_back(0);
+        return (int) triangles.size() - 1;
+    }
+
+    // removes the triangles whose circumcircle strictly contains vertex p (starting with t, which contains it) and
+    // connects p to the edges of the hole
+    void fillCavity(int p, int t)
+    {
+        stamp++;
+        cavity.clear();
+        stack.assign(1, t);
+        stamps[t] = stamp;
+        while (!stack.empty())
+        {
+            int c = stack.back();
+            stack.pop_back();
+            cavity.push_back(c);
+            for (int n : triangles[c].neighbour)
+                if (n != NO_TRIANGLE && stamps[n] != stamp && inCircle(triangles[n], p) > 0)
+                {
+                    stamps[n] = stamp;
+                    stack.push_back(n);
+                }
+        }
+
+        // the fan around p is only valid if the cavity is star-shaped around p: p must be strictly on the left of every
+        // edge of its boundary. The exact tests guarantee it, a triangle (other than t) with an edge that fails is
+        // still left out of the cavity and the boundary collected again
+        for (bool shrunk = true; shrunk; )
+        {
+            shrunk = false;
+            boundary.clear();
+            for (int c : cavity)
+            {
+                if (stamps[c] != stamp)
+                    continue;
+                const Triangle &triangle = triangles[c];
+                for (int i = 0; i < 3; i++)
+                {
+                    int n = triangle.neighbour[i];
+                    if (n != NO_TRIANGLE && stamps[n] == stamp)
+                        continue;
+                    int from = triangle.vertex[(i + 1) % 3], to = triangle.vertex[(i + 2) % 3];
+                    if (c != t && orient(from, to, x[p], y[p]) <= 0)
+                    {
+                        stamps[c] = 0;
+                        shrunk = true;
+                        break;
+                    }
+                    boundary.push_back(BoundaryEdge{from, to, n, 0});
+                }
+            }
+        }
+        cavity.erase(std::remove_if(cavity.begin(), cavity.end(), [&](int c) { return stamps[c] != stamp; }), cavity.end());
+
+        for (int c : cavity)
+        {
+            triangles[c].vertex[0] = NO_SITE;
+            freeTriangles.push_back(c);
+        }
+
+        // a triangle (p, from, to) for every edge of the hole, linked to the triangle outside the edge
+        for (BoundaryEdge &edge : boundary)
+        {
+            int n = newTriangle();
+            edge.triangle = n;
+            triangles[n] = Triangle{{p, edge.from, edge.to}, {edge.outside, NO_TRIANGLE, NO_TRIANGLE}};
+            if (edge.outside != NO_TRIANGLE)
+            {
+                // the outside triangle can touch the cavity on several edges, this is the one that goes from 'to' to
+                // 'from' (the slots of the cavity are being reused, so the edge is found by its vertices)
+                Triangle &outside = triangles[edge.outside];
+                for (int i = 0; i < 3; i++)
+                    if (outside.vertex[(i + 1) % 3] == edge.to && outside.vertex[(i + 2) % 3] == edge.from)
+                        outside.neighbour[i] = n;
+            }
+            vertexTriangle[edge.from] = n;
+        }
+        // the new triangles around p: the one starting at 'to' is across the edge (p, to)
+        for (const BoundaryEdge &edge : boundary)
+            for (const BoundaryEdge &other : boundary)
+                if (other.from == edge.to)
+                {
+                    triangles[edge.triangle].neighbour[1] = other.triangle;
+                    triangles[other.triangle].neighbour[2] = edge.triangle;
+                    break;
+                }
+        vertexTriangle[p] = boundary[0].triangle;
+        lastTriangle = boundary[0].triangle;
+    }
+
+    // cuts a convex polygon at the bounds (Sutherland-Hodgman)
+    void clip(std::vector<glm::vec2> &polygon) const
+    {
+        std::vector<glm::vec2> input;
+        const float bounds[4] = {(float) minX, (float) maxX, (float) minY, (float) maxY};
+        for (int side = 0; side < 4 && !polygon.empty(); side++)
+        {
+            int axis = side / 2;
+            float limit = bounds[side], sign = side % 2 == 0 ? 1.0f : -1.0f;
+            input.swap(polygon);
+            polygon.clear();
+            for (size_t i = 0; i < input.size(); i++)
+            {
+                const glm::vec2 &a = input[i], &b = input[(i + 1) % input.size()];
+                float da = (a[axis] - limit) * sign, db = (b[axis] - limit) * sign;
+                if (da >= 0.0f)
+                    polygon.push_back(a);
+                if ((da >= 0.0f) != (db >= 0.0f))
+                    polygon.push_back(a + (b - a) * (da / (da - db)));
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef JUMP_FLOOD_H
+#define JUMP_FLOOD_H
+
+// Voronoi diagram computed on the CPU with the jump flooding algorithm (JFA), as an alternative to drawing a cone
+// per site.
+//
+// Every pixel of the grid stores the index of the closest site found so far. The sites are first written to the
+// pixel they fall in, then log2(resolution) passes with steps N/2, N/4, ..., 1 let each pixel look at the 8 pixels at
+// distance 'step' (and itself) and keep the closest of their sites. One more pass with step 1 fixes most of the
+// pixels the halving steps got wrong. The cost is O(pixels * log(resolution)) whatever the number of sites.
+//
+// The distances are measured in normalized device coordinates, like the cones, and the images are shaded with the
+// same formulas as color.frag, distance.frag and distance_color.frag, so they can replace the rendered cones.
+// The rows are split in one band per thread, the threads run all the passes and wait for each other in between.
+// Next to the site index, the grid keeps the x and y of the site in separate arrays, so a pass reads contiguous rows
+// of floats instead of looking the sites up, and the inner loop has no branches: the compiler can vectorize it. Pixels without a site hold a position far away from the grid.
+//
+// Row 0 is the bottom row of the image, as in OpenGL textures.
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JumpFlood {
+public:
+    // the fragment shader the image reproduces
+    enum Mode { MODE_COLOR = 0, MODE_DISTANCE = 1, MODE_DISTANCE_COLOR = 2 };
+
+    // pixels that have no site yet
+    enum { NO_SITE = -1 };
+
+    JumpFlood(int width, int height, unsigned int threadCount = std::max(std::thread::hardware_concurrency(), 1u))
+        : threadCount(std::max(threadCount, 1u))
+    {
+        resize(width, height);
+    }
+
+    void resize(int width, int height)
+    {
+        this->width = std::max(width, 1);
+        this->height = std::max(height, 1);
+        nearest.assign((size_t) this->width * this->height, NO_SITE);
+        nearestX.assign(nearest.size(), (float) FAR_AWAY);
+        nearestY.assign(nearest.size(), (float) FAR_AWAY);
+        buffer.assign(nearest.size(), NO_SITE);
+        bufferX.assign(nearest.size(), (float) FAR_AWAY);
+        bufferY.assign(nearest.size(), (float) FAR_AWAY);
+        // the x and y of the pixel centers in normalized device coordinates
+        pixelX.resize(this->width);
+        pixelY.resize(this->height);
+        for (int x = 0; x < this->width; x++)
+            pixelX[x] = ((float) x + 0.5f) / (float) this->width * 2.0f - 1.0f;
+        for (int y = 0; y < this->height; y++)
+            pixelY[y] = ((float) y + 0.5f) / (float) this->height * 2.0f - 1.0f;
+    }
+
+    void clearSites()
+    {
+        siteX.clear(); siteY.clear();
+        siteR.clear(); siteG.clear(); siteB.clear();
+    }
+
+    // x and y in normalized device coordinates, the color in [0, 1]
+    void addSite(float x, float y, float r, float g, float b)
+    {
+        siteX.push_back(x); siteY.push_back(y);
+        siteR.push_back(r); siteG.push_back(g); siteB.push_back(b);
+    }
+
+    size_t siteCount() const { return siteX.size(); }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // fills the grid with the index of the closest site of every pixel
+    void compute()
+    {
+        std::fill(nearest.begin(), nearest.end(), (int32_t) NO_SITE);
+        std::fill(nearestX.begin(), nearestX.end(), (float) FAR_AWAY);
+        std::fill(nearestY.begin(), nearestY.end(), (float) FAR_AWAY);
+        seed();
+        std::vector<int> steps;
+        int step = 1;
+        while (step * 2 < std::max(width, height))
+            step *= 2;
+        for (; step >= 1; step /= 2)
+            steps.push_back(step);
+        steps.push_back(1);
+
+        // the threads are started once for all the passes, each keeps its band of rows and its row of distances and
+        // waits for the others before the next pass. The passes read and write the two grids in turn
+        int threads = (int) std::min<unsigned int>(threadCount, (unsigned int) height);
+        Barrier barrier(threads);
+        parallelBands(threads, [&](int begin, int end) {
+            std::vector<float> best(width);
+            for (size_t pass = 0; pass < steps.size(); pass++)
+            {
+                if (pass % 2 == 0)
+                    for (int y = begin; y < end; y++)
+                        floodRow(y, steps[pass], nearest, nearestX, nearestY, buffer, bufferX, bufferY, best.data());
+                else
+                    for (int y = begin; y < end; y++)
+                        floodRow(y, steps[pass], buffer, bufferX, bufferY, nearest, nearestX, nearestY, best.data());
+                barrier.wait();
+            }
+        });
+        if (steps.size() % 2 == 1)
+        {
+            nearest.swap(buffer);
+            nearestX.swap(bufferX);
+            nearestY.swap(bufferY);
+        }
+    }
+
+    // the site closest to pixel (x, y), or NO_SITE if there are no sites
+    int32_t site(int x, int y) const { return nearest[(size_t) y * width + x]; }
+
+    // distance, in normalized device coordinates, from pixel (x, y) to its site
+    float distance(int x, int y) const
+    {
+        if (site(x, y) == NO_SITE)
+            return INFINITY;
+        size_t i = (size_t) y * width + x;
+        float dx = pixelX[x] - nearestX[i], dy = pixelY[y] - nearestY[i];
+        return std::sqrt(dx * dx + dy * dy);
+    }
+
+    // RGB8 image of the diagram, shaded like the fragment shader of the mode for cones of the given radius and
+    // height (see createCone in main.cpp), pixels out of every cone are black like the clear color
+    void shade(Mode mode, std::vector<uint8_t> &rgb, float coneRadius, float coneHeight) const
+    {
+        rgb.resize(nearest.size() * 3);
+        parallelRows([&](int y) {
+            for (int x = 0; x < width; x++)
+            {
+                size_t i = (size_t) y * width + x;
+                int32_t s = nearest[i];
+                float color[3] = {0.0f, 0.0f, 0.0f};
+                if (s != NO_SITE)
+                {
+                    // z of the cone at this distance from its center, and the gl_FragCoord.z it gets with
+                    // glDepthRange(1, -1)
+                    float z = 1.0f + (coneHeight - 1.0f) * distance(x, y) / coneRadius;
+                    if (z >= coneHeight)
+                    {
+                        float fragZ = (1.0f - z) * 0.5f;
+                        float siteColor[3] = {siteR[s], siteG[s], siteB[s]};
+                        if (mode == MODE_COLOR)
+                            std::copy(siteColor, siteColor + 3, color);
+                        else if (mode == MODE_DISTANCE)
+                            color[0] = color[1] = color[2] = std::pow(std::sqrt(std::abs(fragZ - z)), 5.0f);
+                        else
+                        {
+                            float ratio = std::pow(std::sqrt(std::abs(fragZ - z)), 3.0f);
+                            for (int c = 0; c < 3; c++)
+                                color[c] = siteColor[c] * ratio;
+                        }
+                    }
+                }
+                for (int c = 0; c < 3; c++)
+                    rgb[i * 3 + c] = (uint8_t) (std::max(0.0f, std::min(color[c], 1.0f)) * 255.0f + 0.5f);
+            }
+        });
+    }
+
+private:
+    // x and y of the pixels without a site, its squared distance to the grid is still finite in floats
+    enum { FAR_AWAY = 1000000 };
+
+    int width = 1, height = 1;
+    unsigned int threadCount;
+    // the site of every pixel, and its position
+    std::vector<int32_t> nearest, buffer;
+    std::vector<float> nearestX, nearestY, bufferX, bufferY;
+    std::vector<float> pixelX, pixelY;
+    std::vector<float> siteX, siteY, siteR, siteG, siteB;
+
+    float squaredDistance(int x, int y, int32_t s) const
+    {
+        float dx = pixelX[x] - siteX[s], dy = pixelY[y] - siteY[s];
+        return dx * dx + dy * dy;
+    }
+
+    // every site claims the pixel it falls in, the closest site to the pixel center wins when several share it
+    void seed()
+    {
+        for (int32_t s = 0; s < (int32_t) siteX.size(); s++)
+        {
+            int x = (int) std::floor((siteX[s] + 1.0f) * 0.5f * (float) width);
+            int y = (int) std::floor((siteY[s] + 1.0f) * 0.5f * (float) height);
+            if (x < 0 || y < 0 || x >= width || y >= height)
+                continue;
+            size_t i = (size_t) y * width + x;
+            if (nearest[i] == NO_SITE || squaredDistance(x, y, s) < squaredDistance(x, y, nearest[i]))
+            {
+                nearest[i] = s;
+                nearestX[i] = siteX[s];
+                nearestY[i] = siteY[s];
+            }
+        }
+    }
+
+    // lets threads wait for each other between the passes of compute
+    class Barrier {
+    public:
+        explicit Barrier(int count) : count(count) {}
+
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            unsigned int arrivedGeneration = generation;
+            if (++waiting == count)
+            {
+                waiting = 0;
+                generation++;
+                condition.notify_all();
+            }
+            else
+                condition.wait(lock, [&]() { return generation != arrivedGeneration; });
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable condition;
+        int count, waiting = 0;
+        unsigned int generation = 0;
+    };
+
+    // row y of one JFA pass with the given step, reads the 'in' grids and writes the 'out' grids. best holds the
+    // squared distances of the row, width floats
+    void floodRow(int y, int step, const std::vector<int32_t> &inSite, const std::vector<float> &inSiteX,
+                  const std::vector<float> &inSiteY, std::vector<int32_t> &outSite, std::vector<float> &outSiteX,
+                  std::vector<float> &outSiteY, float *best) const
+    {
+        size_t rowStart = (size_t) y * width;
+        int32_t *out = &outSite[rowStart];
+        float *outX = &outSiteX[rowStart], *outY = &outSiteY[rowStart];
+        std::copy(&inSite[rowStart], &inSite[rowStart] + width, out);
+        std::copy(&inSiteX[rowStart], &inSiteX[rowStart] + width, outX);
+        std::copy(&inSiteY[rowStart], &inSiteY[rowStart] + width, outY);
+        const float *px = pixelX.data(), py = pixelY[y];
+        for (int x = 0; x < width; x++)
+            best[x] = (px[x] - outX[x]) * (px[x] - outX[x]) + (py - outY[x]) * (py - outY[x]);
+
+        for (int dy = -step; dy <= step; dy += step)
+        {
+            int ny = y + dy;
+            if (ny < 0 || ny >= height)
+                continue;
+            size_t neighbourRow = (size_t) ny * width;
+            for (int dx = -step; dx <= step; dx += step)
+            {
+                if (dx == 0 && dy == 0)
+                    continue;
+                // the columns whose neighbour at dx is inside the grid (none when step is wider than the grid),
+                // so x + dx is always a column of the neighbour row
+                int first = std::max(0, -dx), last = std::min(width, width - dx);
+                const int32_t *in = inSite.data() + neighbourRow;
+                const float *inX = inSiteX.data() + neighbourRow, *inY = inSiteY.data() + neighbourRow;
+                for (int x = first; x < last; x++)
+                {
+                    float nx = inX[x + dx], ny = inY[x + dx];
+                    float d = (px[x] - nx) * (px[x] - nx) + (py - ny) * (py - ny);
+                    bool closer = d < best[x];
+                    best[x] = closer ? d : best[x];
+                    out[x] = closer ? in[x + dx] : out[x];
+                    outX[x] = closer ? nx : outX[x];
+                    outY[x] = closer ? ny : outY[x];
+                }
+            }
+        }
+    }
+
+    // calls bandFunction(begin, end) on 'threads' threads, the rows are split in one band per thread
+    template<class BandFunction>
+    void parallelBands(int threads, const BandFunction &bandFunction) const
+    {
+        if (threads <= 1)
+        {
+            bandFunction(0, height);
+            return;
+        }
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++)
+            workers.emplace_back(bandFunction, height * t / threads, height * (t + 1) / threads);
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    // calls rowFunction(y) for every row, the rows are split in one band per thread
+    template<class RowFunction>
+    void parallelRows(const RowFunction &rowFunction) const
+    {
+        parallelBands((int) std::min<unsigned int>(threadCount, (unsigned int) height), [&rowFunction](int begin, int end) {
+            for (int y = begin; y < end; y++)
+                rowFunction(y);
+        });
+    }
+};
+
+#endif
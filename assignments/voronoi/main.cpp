@@ -2,23 +2,50 @@
 #include <GLFW/glfw3.h>
 
 #include <shader.h>
+#include <jump_flood.h>
+#include <delaunay.h>
 
 #include <iostream>
 #include <vector>
+#include <chrono>
+#include <cstddef>
+#include <string>
 #include <math.h>
 #include <glm/gtc/type_ptr.hpp>
 
-// structure to hold the info necessary to render an object
-struct SceneObject {
-    unsigned int VAO;           // vertex array object handle
-    unsigned int vertexCount;   // number of vertices in the object
-    float r, g, b;              // for object color
+// per site data of a cone, stored in the instance buffer: the same cone mesh is drawn once for every site
+struct ConeInstance {
     float x, y;                 // for position offset
+    float r, g, b;              // for object color
+};
+
+// the cone mesh shared by all the sites, and the instance buffer that holds one ConeInstance per site
+struct ConeBatch {
+    unsigned int VAO;           // vertex array object handle
+    unsigned int vertexCount;   // number of indices of the cone
+    unsigned int instanceVBO;   // ConeInstance of every site
+    unsigned int capacity;      // sites that fit in the instance buffer
+    std::vector<ConeInstance> instances;
 };
 
 // declaration of the function you will implement in voronoi 1.1
-SceneObject instantiateCone(float r, float g, float b, float offsetX, float offsetY);
+ConeBatch createConeBatch();
+void instantiateCone(float r, float g, float b, float offsetX, float offsetY);
 std::pair<std::vector<float>, std::vector<GLint>> createCone();
+// draws all the cones with a single instanced draw call
+void drawCones();
+// creates the texture the diagram computed on the CPU is uploaded to, and a framebuffer to copy it to the screen
+void createJumpFloodTarget();
+// draws the diagram computed on the CPU, it is computed again only when the sites or the window size change
+void drawJumpFlood(GLFWwindow* window);
+// creates the VAO of the Voronoi cells, they are drawn as plain triangles
+void createCellMesh();
+// draws the cells of the Delaunay diagram, the mesh is built again only when the sites change
+void drawCells();
+// frame time of the cones and time of the CPU diagram, with 1k to 1M random sites
+int runConeBenchmark(GLFWwindow* window);
+// insertion and query times of the Delaunay diagram with 1M random sites, no window needed
+int runDelaunayBenchmark();
 // mouse, keyboard and screen reshape glfw callbacks
 void button_input_callback(GLFWwindow* window, int button, int action, int mods);
 void key_input_callback(GLFWwindow* window, int button, int other,int action, int mods);
@@ -35,13 +62,33 @@ const float height = 0.0f;
 
 
 // global variables we will use to store our objects, shaders, and active shader
-std::vector<SceneObject> sceneObjects;
+ConeBatch cones;
 std::vector<Shader> shaderPrograms;
 Shader* activeShader;
 
+// what is drawn: the cones, the diagram computed with jump flooding (key J) or the cells of the Delaunay diagram (key C)
+enum DrawMode { DRAW_CONES, DRAW_JUMP_FLOOD, DRAW_CELLS };
+DrawMode drawMode = DRAW_CONES;
 
-int main()
+// the same diagram computed on the CPU with jump flooding
+JumpFlood jumpFlood(SCR_WIDTH, SCR_HEIGHT);
+unsigned int jumpFloodTexture, jumpFloodFramebuffer;
+bool jumpFloodDirty = true; // the sites changed since the last compute
+int jumpFloodMode = -1;     // the mode of the image in the texture
+
+// the sites in a Delaunay triangulation, to query the diagram (right click) and to draw the cells as polygons
+Delaunay delaunay;
+std::vector<glm::vec3> cellColors; // the color of every site of the triangulation
+unsigned int cellVAO, cellVBO, cellVertexCount = 0;
+bool cellsDirty = true;
+
+
+int main(int argc, char* argv[])
 {
+    // usage: --delaunay-benchmark
+    if (argc >= 2 && std::string(argv[1]) == "--delaunay-benchmark")
+        return runDelaunayBenchmark();
+
     // glfw: initialize and configure
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -80,6 +127,9 @@ int main()
     shaderPrograms.push_back(Shader("shaders/shader.vert", "shaders/distance.frag"));
     shaderPrograms.push_back(Shader("shaders/shader.vert", "shaders/distance_color.frag"));
     activeShader = &shaderPrograms[0];
+    cones = createConeBatch();
+    createJumpFloodTarget();
+    createCellMesh();
 
     // NEW!
     // set up the z-buffer
@@ -87,6 +137,10 @@ int main()
     glEnable(GL_DEPTH_TEST); // turn on z-buffer depth test
     glDepthFunc(GL_LESS); // draws fragments that are closer to the screen in NDC
 
+    // usage: --cone-benchmark
+    if (argc >= 2 && std::string(argv[1]) == "--cone-benchmark")
+        return runConeBenchmark(window);
+
     // render loop
     while (!glfwWindowShouldClose(window)) {
         // background color
@@ -94,24 +148,13 @@ int main()
         // notice that now we are clearing two buffers, the color and the z-buffer
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // render the cones
-        glUseProgram(activeShader->ID);
-
-        // TODO voronoi 1.3
-        // Iterate through the scene objects, for each object:
-        // - bind the VAO; set the uniform variables; and draw.
-        int pos_off_location = glGetUniformLocation(activeShader -> ID, "positionOffset");
-        int coneColor_location = glGetUniformLocation(activeShader -> ID, "coneColor");
-
-        for(auto obj : sceneObjects)
-        {
-
-            glm::vec2 posOffset = glm::vec2(obj.x, obj.y);
-            glUniform2fv(pos_off_location, 1, glm::value_ptr(posOffset));
-            glUniform3fv(coneColor_location, 1, glm::value_ptr(glm::vec3(obj.r, obj.g, obj.b)));
-            glBindVertexArray(obj.VAO);
-            glDrawElements(GL_TRIANGLES, obj.vertexCount, GL_UNSIGNED_INT, 0);
-        }
+        // render the cones, or the diagram computed on the CPU
+        if (drawMode == DRAW_JUMP_FLOOD)
+            drawJumpFlood(window);
+        else if (drawMode == DRAW_CELLS)
+            drawCells();
+        else
+            drawCones();
 
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -160,64 +203,259 @@ std::pair<std::vector<float>, std::vector<GLint>> createCone()
 
     return std::make_pair(vertexData, vertexIndices);
 }
-// creates a cone triangle mesh, uploads it to openGL and returns the VAO associated to the mesh
-SceneObject instantiateCone(float r, float g, float b, float offsetX, float offsetY){
+// creates the cone triangle mesh, uploads it to openGL, and sets up the (empty) instance buffer, the VAO reads the
+// offset and color attributes once per instance
+ConeBatch createConeBatch(){
     // TODO voronoi 1.1
     // (exercises 1.7 and 1.8 can help you with implementing this function)
-
-    // Create an instance of a SceneObject,
-    SceneObject sceneObject{};
-
-    // you will need to store offsetX, offsetY, r, g and b in the object.
-
-    sceneObject.r = r;
-    sceneObject.g = g;
-    sceneObject.b = b;
-
-    sceneObject.x = offsetX;
-    sceneObject.y = offsetY;
-
+    ConeBatch batch{};
 
     // Build the geometry into an std::vector<float> or float array.
-
     auto cone = createCone();
     std::vector<float> vertexData = cone.first;
     std::vector<GLint> vertexIndices = cone.second;
 
-    // Store the number of vertices in the mesh in the scene object.
-    sceneObject.vertexCount = vertexIndices.size();
-
     // Declare and generate a VAO and VBO (and an EBO if you decide the work with indices).
     unsigned int vertexDataVBO, vertexIndicesEBO, VAO;
 
-    createArrayBuffer(vertexData, vertexIndices, vertexDataVBO, vertexIndicesEBO);
-
-
-    // tell how many vertices to draw,
-    // no need to divide by the number of floats per vertex since we now have a list of vertex indices
-    sceneObject.vertexCount = vertexIndices.size();
-
     // create a vertex array object (VAO) on OpenGL and save a handle to it
     glGenVertexArrays(1, &VAO);
 
     // bind vertex array object
     glBindVertexArray(VAO);
 
-    // set vertex shader attribute "aPos"
-    glBindBuffer(GL_ARRAY_BUFFER, vertexDataVBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vertexIndicesEBO);
-    // Set the position attribute pointers in the shader.
+    createArrayBuffer(vertexData, vertexIndices, vertexDataVBO, vertexIndicesEBO);
+
+    // tell how many vertices to draw,
+    // no need to divide by the number of floats per vertex since we now have a list of vertex indices
+    batch.vertexCount = vertexIndices.size();
+
+    // Set the position attribute pointers in the shader (location 0 in shader.vert).
     int posSize = 3;
-    int posAttributeLocation = glGetAttribLocation(activeShader -> ID, "pos");
-    glEnableVertexAttribArray(posAttributeLocation);
-    glVertexAttribPointer(posAttributeLocation, posSize, GL_FLOAT, GL_FALSE,
-                          (posSize) * (int) sizeof(float), 0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, posSize, GL_FLOAT, GL_FALSE, (posSize) * (int) sizeof(float), 0);
+
+    // the instance buffer, it grows when a site does not fit (see instantiateCone)
+    batch.capacity = 1024;
+    glGenBuffers(1, &batch.instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, batch.instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, batch.capacity * sizeof(ConeInstance), nullptr, GL_DYNAMIC_DRAW);
+
+    // position offset (location 1) and color (location 2), advanced once per cone instead of once per vertex
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ConeInstance), (void*) offsetof(ConeInstance, x));
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(ConeInstance), (void*) offsetof(ConeInstance, r));
+    glVertexAttribDivisor(2, 1);
+
+    glBindVertexArray(0);
+
+    // Store the VAO handle in the batch.
+    batch.VAO = VAO;
+    return batch;
+}
 
-    // Store the VAO handle in the scene object.
-    sceneObject.VAO = VAO;
+// adds a cone for a new site: only the new instance is uploaded, the buffer is reallocated (twice as large) when full
+void instantiateCone(float r, float g, float b, float offsetX, float offsetY){
+    cones.instances.push_back(ConeInstance{offsetX, offsetY, r, g, b});
+    jumpFlood.addSite(offsetX, offsetY, r, g, b);
+    jumpFloodDirty = true;
+    if (delaunay.insert(offsetX, offsetY) != Delaunay::NO_SITE)
+    {
+        cellColors.push_back(glm::vec3(r, g, b));
+        cellsDirty = true;
+    }
 
-    // 'return' the scene object for the cone instance you just created.
-    return sceneObject;
+    glBindBuffer(GL_ARRAY_BUFFER, cones.instanceVBO);
+    if (cones.instances.size() > cones.capacity)
+    {
+        while (cones.capacity < cones.instances.size())
+            cones.capacity *= 2;
+        glBufferData(GL_ARRAY_BUFFER, cones.capacity * sizeof(ConeInstance), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, cones.instances.size() * sizeof(ConeInstance), cones.instances.data());
+    }
+    else
+        glBufferSubData(GL_ARRAY_BUFFER, (cones.instances.size() - 1) * sizeof(ConeInstance), sizeof(ConeInstance),
+                        &cones.instances.back());
+}
+
+void drawCones(){
+    // TODO voronoi 1.3
+    // the offset and color of every cone come from the instance buffer, so all the cones are drawn with one call,
+    // whatever the number of sites
+    glUseProgram(activeShader->ID);
+    glBindVertexArray(cones.VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, cones.vertexCount, GL_UNSIGNED_INT, 0, (GLsizei) cones.instances.size());
+    glBindVertexArray(0);
+}
+
+void createJumpFloodTarget(){
+    glGenTextures(1, &jumpFloodTexture);
+    glBindTexture(GL_TEXTURE_2D, jumpFloodTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, jumpFlood.getWidth(), jumpFlood.getHeight(), 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+
+    glGenFramebuffers(1, &jumpFloodFramebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, jumpFloodFramebuffer);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, jumpFloodTexture, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+void drawJumpFlood(GLFWwindow* window){
+    int screenWidth, screenHeight;
+    glfwGetFramebufferSize(window, &screenWidth, &screenHeight);
+    if (screenWidth != jumpFlood.getWidth() || screenHeight != jumpFlood.getHeight())
+    {
+        jumpFlood.resize(screenWidth, screenHeight);
+        jumpFloodDirty = true;
+    }
+    // keys 1, 2 and 3 select the shading, as they select the fragment shader of the cones
+    int mode = (int) (activeShader - &shaderPrograms[0]);
+    if (jumpFloodDirty)
+        jumpFlood.compute();
+    if (jumpFloodDirty || mode != jumpFloodMode)
+    {
+        static std::vector<uint8_t> image;
+        jumpFlood.shade((JumpFlood::Mode) mode, image, radius / 2, height);
+        glBindTexture(GL_TEXTURE_2D, jumpFloodTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, screenWidth, screenHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, image.data());
+        jumpFloodDirty = false;
+        jumpFloodMode = mode;
+    }
+
+    // copy the image to the screen, it has the size of the frame buffer
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, jumpFloodFramebuffer);
+    glBlitFramebuffer(0, 0, screenWidth, screenHeight, 0, 0, screenWidth, screenHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+void createCellMesh(){
+    glGenVertexArrays(1, &cellVAO);
+    glGenBuffers(1, &cellVBO);
+    glBindVertexArray(cellVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, cellVBO);
+    // position (location 0) and color (location 2) of every vertex, the position offset (location 1) stays 0
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), 0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*) (3 * sizeof(float)));
+    glBindVertexArray(0);
+}
+
+void drawCells(){
+    if (cellsDirty)
+    {
+        // a fan of triangles from the site to the corners of its cell, with the z of the cone at each vertex
+        std::vector<float> vertices;
+        std::vector<glm::vec2> polygon;
+        for (size_t s = 0; s < delaunay.siteCount(); s++)
+        {
+            delaunay.cellPolygon(s, polygon);
+            glm::vec2 site = delaunay.site(s);
+            const glm::vec3 &color = cellColors[s];
+            for (size_t i = 0; i < polygon.size(); i++)
+            {
+                glm::vec2 corners[3] = {site, polygon[i], polygon[(i + 1) % polygon.size()]};
+                for (const glm::vec2 &corner : corners)
+                {
+                    float z = 1.0f + (height - 1.0f) * glm::length(corner - site) / (radius / 2);
+                    float vertex[6] = {corner.x, corner.y, z, color.r, color.g, color.b};
+                    vertices.insert(vertices.end(), vertex, vertex + 6);
+                }
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, cellVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_DYNAMIC_DRAW);
+        cellVertexCount = vertices.size() / 6;
+        cellsDirty = false;
+    }
+
+    glUseProgram(activeShader->ID);
+    glVertexAttrib2f(1, 0.0f, 0.0f);
+    glBindVertexArray(cellVAO);
+    glDrawArrays(GL_TRIANGLES, 0, cellVertexCount);
+    glBindVertexArray(0);
+}
+
+int runConeBenchmark(GLFWwindow* window){
+    glfwSwapInterval(0); // don't wait for the screen refresh
+    int screenWidth, screenHeight;
+    glfwGetFramebufferSize(window, &screenWidth, &screenHeight);
+    std::vector<uint8_t> coneImage(screenWidth * screenHeight * 3), floodImage;
+    for (unsigned int siteCount : {1000u, 10000u, 100000u, 1000000u})
+    {
+        while (cones.instances.size() < siteCount)
+        {
+            float x = (float)std::rand() / RAND_MAX * 2.0f - 1.0f;
+            float y = (float)std::rand() / RAND_MAX * 2.0f - 1.0f;
+            instantiateCone((float)std::rand() / RAND_MAX, (float)std::rand() / RAND_MAX, (float)std::rand() / RAND_MAX, x, y);
+        }
+
+        // every cone covers the whole screen, a frame with a million cones takes seconds
+        const int frames = std::max(1, std::min(50, (int) (100000 / siteCount)));
+        activeShader = &shaderPrograms[0];
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            drawCones();
+            glfwSwapBuffers(window);
+            glFinish(); // wait for the GPU, so the time is the time of the frame and not of the submission
+            glfwPollEvents();
+        }
+        std::chrono::duration<double, std::milli> coneTime = std::chrono::high_resolution_clock::now() - start;
+
+        // the image of the cones, from the front buffer after the last swap
+        glReadBuffer(GL_FRONT);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, screenWidth, screenHeight, GL_RGB, GL_UNSIGNED_BYTE, coneImage.data());
+
+        jumpFlood.resize(screenWidth, screenHeight);
+        start = std::chrono::high_resolution_clock::now();
+        jumpFlood.compute();
+        jumpFlood.shade(JumpFlood::MODE_COLOR, floodImage, radius / 2, height);
+        std::chrono::duration<double, std::milli> floodTime = std::chrono::high_resolution_clock::now() - start;
+
+        // pixels of a different color, along the cell borders the cones (polygons) and the grid can disagree
+        size_t different = 0;
+        for (size_t i = 0; i < coneImage.size(); i += 3)
+            different += std::abs(coneImage[i] - floodImage[i]) > 1 || std::abs(coneImage[i + 1] - floodImage[i + 1]) > 1 ||
+                         std::abs(coneImage[i + 2] - floodImage[i + 2]) > 1;
+
+        std::cout << siteCount << " sites: cones " << coneTime.count() / frames << " ms per frame (1 draw call, "
+                  << siteCount * (cones.vertexCount / 3) << " triangles), jump flooding " << floodTime.count()
+                  << " ms, " << 100.0 * different / (screenWidth * screenHeight) << "% of the pixels differ" << std::endl;
+    }
+    glfwTerminate();
+    return 0;
+}
+
+int runDelaunayBenchmark(){
+    const int siteCount = 1000000, queryCount = 1000000;
+    std::vector<glm::vec2> points(siteCount + queryCount);
+    for (glm::vec2 &point : points)
+        point = glm::vec2((float)std::rand() / RAND_MAX * 2.0f - 1.0f, (float)std::rand() / RAND_MAX * 2.0f - 1.0f);
+
+    Delaunay diagram;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < siteCount; i++)
+        diagram.insert(points[i].x, points[i].y);
+    std::chrono::duration<double, std::milli> insertTime = std::chrono::high_resolution_clock::now() - start;
+
+    start = std::chrono::high_resolution_clock::now();
+    size_t checksum = 0;
+    for (int i = siteCount; i < siteCount + queryCount; i++)
+        checksum += diagram.nearest(points[i].x, points[i].y);
+    std::chrono::duration<double, std::milli> queryTime = std::chrono::high_resolution_clock::now() - start;
+
+    std::cout << diagram.siteCount() << " sites inserted in " << insertTime.count() << " ms ("
+              << insertTime.count() * 1.0e6 / siteCount << " ns per site), " << queryCount << " nearest site queries in "
+              << queryTime.count() << " ms (" << queryTime.count() * 1.0e6 / queryCount << " ns per query)" << std::endl;
+    std::cout << "edges that are not Delaunay: " << diagram.countViolations() << " (checksum " << checksum << ")" << std::endl;
+    return 0;
 }
 
 // glfw: called whenever a mouse button is pressed
@@ -231,8 +469,7 @@ void button_input_callback(GLFWwindow* window, int button, int action, int mods)
 
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
     {
-        // If a left mouse button press was detected, call instantiateCone:
-        // - Push the return value to the back of the global 'vector<SceneObject> sceneObjects'.
+        // If a left mouse button press was detected, call instantiateCone, it adds the cone to the global 'cones':
         // - The click position should be transformed from screen coordinates to normalized device coordinates,
         //   to obtain the offset values that describe the position of the object in the screen plane.
         // - A random value in the range [0, 1] should be used for the r, g and b variables.
@@ -250,8 +487,30 @@ void button_input_callback(GLFWwindow* window, int button, int action, int mods)
         float red = (float)std::rand() / RAND_MAX;
         float green = (float)std::rand() / RAND_MAX;
         float blue = (float)std::rand() / RAND_MAX;
-        SceneObject cone = instantiateCone(red, green, blue, xNdc, yNdc);
-        sceneObjects.push_back(cone);
+        instantiateCone(red, green, blue, xNdc, yNdc);
+    }
+
+    // the right button picks the cell under the cursor
+    if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
+    {
+        double xPos, yPos;
+        int xScreen, yScreen;
+        glfwGetCursorPos(window, &xPos, &yPos);
+        glfwGetWindowSize(window, &xScreen, &yScreen);
+        float xNdc = (float) xPos/(float) xScreen * 2.0f -1.0f;
+        float yNdc = -((float) yPos/(float) yScreen * 2.0f -1.0f);
+
+        int site = delaunay.nearest(xNdc, yNdc);
+        if (site != Delaunay::NO_SITE)
+        {
+            std::vector<int> neighbours;
+            delaunay.neighbours(site, neighbours);
+            glm::vec2 position = delaunay.site(site);
+            std::cout << "site " << site << " at (" << position.x << ", " << position.y << "), neighbours:";
+            for (int neighbour : neighbours)
+                std::cout << " " << neighbour;
+            std::cout << std::endl;
+        }
     }
 
 
@@ -277,6 +536,16 @@ void key_input_callback(GLFWwindow* window, int button, int other,int action, in
     {
         activeShader = &shaderPrograms[2];
     }
+    // Key J switches between the cones and the diagram computed on the CPU, key C between the cones and the cells of
+    // the Delaunay diagram.
+    else if (button == GLFW_KEY_J && action == GLFW_PRESS)
+    {
+        drawMode = drawMode == DRAW_JUMP_FLOOD ? DRAW_CONES : DRAW_JUMP_FLOOD;
+    }
+    else if (button == GLFW_KEY_C && action == GLFW_PRESS)
+    {
+        drawMode = drawMode == DRAW_CELLS ? DRAW_CONES : DRAW_CELLS;
+    }
 }
 
 
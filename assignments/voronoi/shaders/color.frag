@@ -4,12 +4,12 @@
 // TODO voronoi 1.3
 // fragColor is the output color that OpenGL will try to draw in the screen, if it's not occluded.
 out vec4 fragColor;
-// Create a 'uniform vec3' to receive the cone color from your application.
-uniform vec3 coneColor;
+// The cone color comes from the vertex shader, which reads it from the instance buffer.
+in vec3 coneColor;
 
 void main()
 {
-    // set the fragColor using the 'uniform vec3' color that you set for the current object
+    // set the fragColor using the cone color that you set for the current object
     // notice that fragColor is a vec4, the last value is used to set opacity and should be set to 1
     fragColor = vec4(coneColor.x, coneColor.y, coneColor.z, 1.0); // CODE HERE
 }
\ No newline at end of file
@@ -7,8 +7,8 @@
 // the variable must have the same name as the 'out variable' in the vertex shader.
 out vec4 fragColor;
 in float zCoordinate;
-// Create a 'uniform vec3' to receive the cone color from your application.
-uniform vec3 coneColor;
+// The cone color comes from the vertex shader, which reads it from the instance buffer.
+in vec3 coneColor;
 
 void main()
 {
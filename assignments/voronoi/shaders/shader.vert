@@ -7,17 +7,20 @@ layout (location = 0) in vec3 pos;
 // You have to declare an 'out float' to send the z-coordinate of the position
 // to the fragment shader (voronoi 1.4 and 1.5)
 out float zCoordinate;
-// You have to set an 'uniform vec2' to receive the position offset of the object
-
-uniform vec2 positionOffset;
+// The position offset and the color of the cone are per instance attributes (one value per cone, see createConeBatch)
+layout (location = 1) in vec2 positionOffset;
+layout (location = 2) in vec3 instanceColor;
+// the color of the cone, for the fragment shaders that need it
+out vec3 coneColor;
 
 void main()
 {
     // TODO voronoi 1.3
     // Set the vertex->fragment shader 'out' variable
     zCoordinate = pos.z;
+    coneColor = instanceColor;
     // Set the 'gl_Position' built-in variable using a 'vec4(vec3 position you compute, 1.0)',
-    // Remeber to use the 'uniform vec2' to move the vertex before you set 'gl_Position'.
+    // Remember to add the per instance 'positionOffset' to move the vertex before you set 'gl_Position'.
 
     gl_Position = vec4(pos.x+positionOffset.x, pos.y+positionOffset.y, pos.z, 1);
 }
\ No newline at end of file
@@ -4,11 +4,15 @@
 
 #include <vector>
 #include <chrono>
+#include <string>
+#include <algorithm>
 
 #include "shader.h"
 #include "glmutils.h"
 
 #include "primitives.h"
+#include "particle_buffer.h"
+#include "particle_system.h"
 
 // structure to hold render info
 // -----------------------------
@@ -48,7 +52,14 @@ void emitParticle(float posX, float posY, float posZ, float velX, float velY, fl
 
 void renderParticles();
 void renderLines();
+void renderSimulatedParticles();
+void createSimulatedVertexBuffer();
+void initSimulatedParticles();
+void buildSceneCollider(SpatialHash &collider);
 void initPrevModel();
+int runRainBenchmark(GLFWwindow* window);
+int runParticleBenchmark();
+int runCollisionBenchmark();
 // screen settings
 // ---------------
 const unsigned int SCR_WIDTH = 600;
@@ -63,9 +74,13 @@ float lastX = 300, lastY = 300;
 // -----------------------------------
 SceneObject cube;
 SceneObject floorObj;
+// where the 2 cubes are in the scene, they are drawn and collided with there
+const glm::mat4 cubeModels[] = {glm::translate(2.0f, 1.f, 2.0f) * glm::rotateY(glm::half_pi<float>()),
+                                glm::translate(-2.0f, 1.f, -2.0f) * glm::rotateY(glm::quarter_pi<float>())};
 Shader* shaderProgramWorld;
 Shader* shaderProgramSnow;
 Shader* shaderProgramRain;
+Shader* shaderProgramSimulated;
 
 
 // global variables used for control
@@ -79,21 +94,41 @@ float linearSpeed = 0.15f, rotationGain = 30.0f;
 const unsigned int particleSize = 13;
 const unsigned int lineSize = 3;
 const unsigned int numberOfParticles = 10000;
-unsigned int ParticleVAO, ParticleVBO, LineVAO, LineVBO;
+unsigned int ParticleVAO, LineVAO, LineVBO, LineInstanceVBO;
 const unsigned int sizeOfFloat = 4;
-unsigned int particleId = 0;
+// snow particles, emitted in a ring and uploaded once per frame
+ParticleBuffer snowParticles(numberOfParticles, particleSize);
 const float boxSize = 5.0;
-bool isRaining = false;
+// 1 rain, 2 snow, 3 snow simulated on the CPU
+enum WeatherMode { WEATHER_RAIN, WEATHER_SNOW, WEATHER_SIMULATED };
+WeatherMode weatherMode = WEATHER_SNOW;
 unsigned int lineId = 0;
 
-glm::vec3 velocities[numberOfParticles/2];
-glm::vec3 randoms[numberOfParticles/2];
+// rain streaks, a line drawn once per streak with the velocity and random offset of the streak (the instance buffer)
+const unsigned int numberOfRainStreaks = numberOfParticles / 2;
+const unsigned int lineInstanceSize = 6;
+
+// snow simulated on the CPU, its positions are streamed into SimulatedVBO every frame
+const unsigned int numberOfSimulatedParticles = 1000000;
+ParticleSystem simulation(numberOfSimulatedParticles);
+// the floor and the cubes, the simulated snow sticks to them
+SpatialHash sceneCollider;
+unsigned int SimulatedVAO, SimulatedVBO;
+float lastSimulationTime = 0.0f;
 
 glm::mat4 prevModel;
 
-int main()
+int main(int argc, char* argv[])
 {
     srand (static_cast <unsigned> (time(0)));
+
+    // usage: --particle-benchmark, runs without a window
+    if (argc >= 2 && std::string(argv[1]) == "--particle-benchmark")
+        return runParticleBenchmark();
+    // usage: --collision-benchmark, runs without a window
+    if (argc >= 2 && std::string(argv[1]) == "--collision-benchmark")
+        return runCollisionBenchmark();
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -151,11 +186,19 @@ int main()
 
     createSnowVertexBuffer();
     createRainVertexBuffer();
+    createSimulatedVertexBuffer();
     initSnowParticles();
+    buildSceneCollider(sceneCollider);
+    simulation.setCollider(&sceneCollider, SpatialHash::RESPONSE_STICK);
+    initSimulatedParticles();
     initPrevModel();
 
     initVelocitiesAndRandoms();
 
+    // usage: --rain-benchmark
+    if (argc >= 2 && std::string(argv[1]) == "--rain-benchmark")
+        return runRainBenchmark(window);
+
     // render loop
     // -----------
     // render every loopInterval seconds
@@ -184,17 +227,21 @@ int main()
         shaderProgramWorld->use();
         drawObjects();
 
-        if(isRaining)
+        if(weatherMode == WEATHER_RAIN)
         {
 
             renderLines();
 
         }
-        else
+        else if(weatherMode == WEATHER_SNOW)
         {
 
             renderParticles();
         }
+        else
+        {
+            renderSimulatedParticles();
+        }
 
 
         glfwSwapBuffers(window);
@@ -207,8 +254,11 @@ int main()
         }
     }
 
+    snowParticles.destroy();
     delete shaderProgramWorld;
     delete shaderProgramSnow;
+    delete shaderProgramRain;
+    delete shaderProgramSimulated;
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -236,11 +286,161 @@ void renderParticles() {
     shaderProgramSnow->setVec3("forwardOffset", forwardOffset);
 
 
+    // upload the particles emitted since the last frame
+    snowParticles.flush();
+
     glBindVertexArray(ParticleVAO);
-    glDrawArrays(GL_POINTS, 0, numberOfParticles);
+    glDrawArrays(GL_POINTS, snowParticles.firstVertex(), numberOfParticles);
+    snowParticles.fence();
     glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
 }
 
+void renderSimulatedParticles() {
+    // the simulation steps by the real time between frames, at most 0.1 s so it doesn't jump after a stall
+    float dt = std::min(currentTime - lastSimulationTime, 0.1f);
+    lastSimulationTime = currentTime;
+
+    // the particles that died are replaced by new ones above the camera
+    simulation.update(dt, currentTime);
+    simulation.spawn(simulation.getCapacity() - simulation.count(), glm::vec3(camPosition.x, 0.0f, camPosition.z));
+
+    // orphan the buffer so the driver doesn't wait for the previous frame to be drawn, and write the particles
+    // straight into the new storage
+    GLsizeiptr size = (GLsizeiptr) (simulation.getCapacity() * ParticleSystem::VERTEX_SIZE * sizeOfFloat);
+    glBindBuffer(GL_ARRAY_BUFFER, SimulatedVBO);
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    float *vertices = (float*) glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (vertices)
+    {
+        simulation.writeVertices(vertices);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    shaderProgramSimulated -> use();
+
+    glm::mat4 projection = glm::perspectiveFov(70.0f, (float)SCR_WIDTH, (float)SCR_HEIGHT, .01f, 100.0f);
+    glm::mat4 view = glm::lookAt(camPosition, camPosition + camForward, glm::vec3(0,1,0));
+    shaderProgramSimulated->setMat4("model", projection * view);
+    shaderProgramSimulated->setVec3("camPosition", camPosition);
+
+    glBindVertexArray(SimulatedVAO);
+    glDrawArrays(GL_POINTS, 0, (GLsizei) simulation.count());
+    glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+}
+
+// time of ParticleSystem::update and writeVertices for a full system, without OpenGL
+int runParticleBenchmark() {
+    const size_t particles = 1 << 20;
+    const int frames = 100;
+    const float dt = 1.0f / 60.0f;
+    ParticleSystem system(particles);
+    system.settings.emitterMin.y = system.settings.groundHeight;
+    system.spawn(particles);
+    system.settings.emitterMin.y = ParticleSystem::Settings().emitterMin.y;
+    std::vector<float> vertices(particles * ParticleSystem::VERTEX_SIZE);
+
+    std::chrono::duration<double, std::milli> updateTime(0), writeTime(0);
+    size_t died = 0;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        system.update(dt, (float) frame * dt);
+        updateTime += std::chrono::high_resolution_clock::now() - start;
+        died += particles - system.count();
+        system.spawn(particles - system.count());
+
+        start = std::chrono::high_resolution_clock::now();
+        system.writeVertices(&vertices[0]);
+        writeTime += std::chrono::high_resolution_clock::now() - start;
+    }
+
+    // every live particle is above the ground and younger than its lifetime
+    size_t wrong = 0;
+    for (size_t i = 0; i < system.count(); i++)
+        if (system.position(i).y <= system.settings.groundHeight || system.age(i) >= system.settings.lifetime)
+            wrong++;
+
+    std::cout << particles << " particles, " << system.getThreadCount() << " threads: "
+              << updateTime.count() / frames << " ms per update, "
+              << writeTime.count() / frames << " ms per writeVertices, "
+              << died / frames << " particles replaced per frame, "
+              << wrong << " dead particles left" << std::endl;
+    return wrong == 0 ? 0 : 1;
+}
+
+// time of ParticleSystem::update with the particles colliding with the floor and the cubes, and of the spatial hash
+// queries against testing every triangle
+int runCollisionBenchmark() {
+    const size_t particles = 1 << 20;
+    const int frames = 100;
+    const float dt = 1.0f / 60.0f;
+    SpatialHash collider;
+    buildSceneCollider(collider);
+
+    const char *names[] = {"no collision", "snow sticks", "rain dies"};
+    for (int test = 0; test < 3; test++)
+    {
+        ParticleSystem system(particles);
+        if (test > 0)
+            system.setCollider(&collider, test == 1 ? SpatialHash::RESPONSE_STICK : SpatialHash::RESPONSE_DIE);
+        system.settings.emitterMin.y = system.settings.groundHeight;
+        system.spawn(particles);
+        system.settings.emitterMin.y = ParticleSystem::Settings().emitterMin.y;
+
+        std::chrono::duration<double, std::milli> updateTime(0);
+        for (int frame = 0; frame < frames; frame++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            system.update(dt, (float) frame * dt);
+            updateTime += std::chrono::high_resolution_clock::now() - start;
+            system.spawn(particles - system.count());
+        }
+        size_t stuck = 0;
+        for (size_t i = 0; i < system.count(); i++)
+            stuck += !system.isMoving(i);
+        std::cout << names[test] << ": " << updateTime.count() / frames << " ms per update of " << particles
+                  << " particles, " << stuck << " stuck" << std::endl;
+    }
+
+    // the segments of one frame of falling particles, spread over the height of the cubes so many of them are near
+    // a triangle
+    ParticleSystem system(particles);
+    system.settings.emitterMin.y = -0.5f;
+    system.settings.emitterMax.y = 2.5f;
+    system.settings.emitterMin.x = system.settings.emitterMin.z = -4.0f;
+    system.settings.emitterMax.x = system.settings.emitterMax.z = 4.0f;
+    system.spawn(particles);
+    std::vector<float> hashT(particles), allT(particles);
+    glm::vec3 normal;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < particles; i++)
+        if (!collider.intersect(system.position(i), system.position(i) + system.velocity(i) * 0.1f, hashT[i], normal))
+            hashT[i] = -1.0f;
+    auto middle = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < particles; i++)
+        if (!collider.intersectAll(system.position(i), system.position(i) + system.velocity(i) * 0.1f, allT[i], normal))
+            allT[i] = -1.0f;
+    std::chrono::duration<double, std::milli> hashTime = middle - start, allTime = std::chrono::high_resolution_clock::now() - middle;
+    size_t hits = 0, mismatches = 0;
+    for (size_t i = 0; i < particles; i++)
+    {
+        hits += hashT[i] >= 0.0f;
+        mismatches += hashT[i] != allT[i];
+    }
+    std::cout << particles << " segments against " << collider.triangleCount() << " triangles, " << hits
+              << " hits: spatial hash " << hashTime.count() << " ms, every triangle " << allTime.count()
+              << " ms, " << mismatches << " different results" << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+void buildSceneCollider(SpatialHash &collider) {
+    collider.addMesh(floorVertices, floorIndices, glm::mat4(1.0f));
+    for (const glm::mat4 &cubeModel : cubeModels)
+        collider.addMesh(cubeVertices, cubeIndices, cubeModel);
+    collider.build();
+}
+
 void initPrevModel()
 {
     glm::mat4 scale = glm::scale(1.f, 1.f, 1.f);
@@ -269,25 +469,35 @@ void renderLines() {
 
     shaderProgramRain->setVec3("camPosition", camPosition);
     shaderProgramRain->setVec3("forwardOffset", forwardOffset);
-    glBindVertexArray(LineVAO);
-
-    for(int i = 0; i < numberOfParticles / 2; i++)
-    {
-        glm::vec3 velocity = velocities[i];
-        glm::vec3 random = randoms[i];
+    shaderProgramRain->setFloat("currentTime", currentTime);
 
-        glm::vec3 offset = velocity * currentTime + random;
-        offset -= camPosition + camForward + boxSize / 2;
-
-        offset = glm::mod(offset, boxSize);
+    // one line per streak, the offset of each streak is computed in rain.vert from its velocity and random offset
+    glBindVertexArray(LineVAO);
+    glDrawArraysInstanced(GL_LINES, 0, 2, numberOfRainStreaks);
 
-        shaderProgramRain->setVec3("offset", offset);
-        shaderProgramRain->setVec3("velocity", velocity);
+    glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+}
 
-        glDrawArrays(GL_LINES, 0, numberOfParticles);
+// CPU time spent in renderLines, the time to record the draw (not the time the GPU takes to draw it)
+int runRainBenchmark(GLFWwindow* window) {
+    glfwSwapInterval(0); // don't wait for the screen refresh
+    const int frames = 200;
+    std::chrono::duration<double, std::milli> cpuTime(0);
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        currentTime = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - begin).count();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        auto start = std::chrono::high_resolution_clock::now();
+        renderLines();
+        cpuTime += std::chrono::high_resolution_clock::now() - start;
+        glfwSwapBuffers(window);
+        glfwPollEvents();
     }
-
-    glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    std::cout << numberOfRainStreaks << " rain streaks: " << cpuTime.count() / frames
+              << " ms of CPU time per frame in renderLines, 1 draw call" << std::endl;
+    glfwTerminate();
+    return 0;
 }
 
 void initSnowParticles() {
@@ -311,9 +521,18 @@ void initSnowParticles() {
     }
 }
 
+// fills the simulation at once, spread over the whole height of the emitter box down to the ground so the snow
+// doesn't start as a single layer
+void initSimulatedParticles() {
+    simulation.settings.emitterMin.y = simulation.settings.groundHeight;
+    simulation.spawn(simulation.getCapacity());
+    simulation.settings.emitterMin.y = ParticleSystem::Settings().emitterMin.y;
+}
+
 void initVelocitiesAndRandoms()
 {
-    for(int i = 0; i < numberOfParticles / 2; i++)
+    std::vector<float> data(numberOfRainStreaks * lineInstanceSize);
+    for(int i = 0; i < numberOfRainStreaks; i++)
     {
         float velX = RandomNumber(-1, -1);
         float velY = RandomNumber(-3, -5);
@@ -323,25 +542,21 @@ void initVelocitiesAndRandoms()
         float ranY = RandomNumber(-5, 5);
         float ranZ = RandomNumber(-5, 5);
 
-        velocities[i] = glm::vec3 (velX, velY, velZ);
-        randoms[i] = glm::vec3(ranX, ranY, ranZ);
+        float streak[lineInstanceSize] = {velX, velY, velZ, ranX, ranY, ranZ};
+        std::copy(streak, streak + lineInstanceSize, &data[i * lineInstanceSize]);
     }
+
+    // the streaks don't change, they are uploaded once
+    glBindBuffer(GL_ARRAY_BUFFER, LineInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeOfFloat, &data[0], GL_STATIC_DRAW);
 }
 
 void createSnowVertexBuffer(){
     glGenVertexArrays(1, &ParticleVAO);
-    glGenBuffers(1, &ParticleVBO);
-
     glBindVertexArray(ParticleVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, ParticleVBO);
-
-    // initialize particle buffer, set all values to 0
-    std::vector<float> data(numberOfParticles * particleSize);
-    for(float & i : data)
-        i = 0.0f;
 
-    // allocate at openGL controlled memory
-    glBufferData(GL_ARRAY_BUFFER, numberOfParticles * particleSize * sizeOfFloat, &data[0], GL_DYNAMIC_DRAW);
+    // allocate at openGL controlled memory, all values set to 0
+    snowParticles.create();
     bindAttributesParticle();
 }
 
@@ -352,34 +567,41 @@ void createRainVertexBuffer(){
     glBindVertexArray(LineVAO);
     glBindBuffer(GL_ARRAY_BUFFER, LineVBO);
 
-    // initialize particle buffer, set all values to 0
-    std::vector<float> data(numberOfParticles * lineSize);
-
-    for(int i = 0; i < data.size(); i = i + 6)
-    {
-//        float x = RandomNumber(boxSize, boxSize * 2);
-//        float y = RandomNumber(boxSize, boxSize * 2);
-//        float z = RandomNumber(boxSize, boxSize * 2);
-//
-        float x = 5.0;
-        float y = 5.0;
-        float z = 5.0;
-
-        data[i] = x;
-        data[i+1] = y;
-        data[i+2] = z;
-
-        data[i+3] = x;
-        data[i+4] = y;
-        data[i+5] = z;
-
-    }
+    // the two ends of the line shared by all the streaks, rain.vert stretches it along the velocity of the streak
+    std::vector<float> data(2 * lineSize);
+    for(float & i : data)
+        i = 5.0f;
 
     // allocate at openGL controlled memory
-    glBufferData(GL_ARRAY_BUFFER, numberOfParticles * lineSize * sizeOfFloat, &data[0], GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, 2 * lineSize * sizeOfFloat, &data[0], GL_STATIC_DRAW);
+
+    // velocity and random offset of every streak, filled in initVelocitiesAndRandoms
+    glGenBuffers(1, &LineInstanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, LineInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, numberOfRainStreaks * lineInstanceSize * sizeOfFloat, nullptr, GL_STATIC_DRAW);
     bindAttributesLine();
 }
 
+void createSimulatedVertexBuffer(){
+    glGenVertexArrays(1, &SimulatedVAO);
+    glGenBuffers(1, &SimulatedVBO);
+
+    glBindVertexArray(SimulatedVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, SimulatedVBO);
+    // the storage is replaced every frame in renderSimulatedParticles
+    glBufferData(GL_ARRAY_BUFFER, simulation.getCapacity() * ParticleSystem::VERTEX_SIZE * sizeOfFloat, nullptr, GL_STREAM_DRAW);
+
+    int posSize = 3; // each position has x,y & z
+    GLuint vertexLocation = glGetAttribLocation(shaderProgramSimulated->ID, "pos");
+    glEnableVertexAttribArray(vertexLocation);
+    glVertexAttribPointer(vertexLocation, posSize, GL_FLOAT, GL_FALSE, ParticleSystem::VERTEX_SIZE * sizeOfFloat, (void*)0);
+
+    int lifeSize = 1; // the age of the particle over its lifetime
+    GLuint lifeLocation = glGetAttribLocation(shaderProgramSimulated->ID, "life");
+    glEnableVertexAttribArray(lifeLocation);
+    glVertexAttribPointer(lifeLocation, lifeSize, GL_FLOAT, GL_FALSE, ParticleSystem::VERTEX_SIZE * sizeOfFloat, (void*)(posSize*sizeOfFloat));
+}
+
 void bindAttributesParticle(){
     int posSize = 3; // each position has x,y & z
     GLuint vertexLocation = glGetAttribLocation(shaderProgramSnow->ID, "pos");
@@ -408,10 +630,25 @@ void bindAttributesParticle(){
 }
 
 void bindAttributesLine(){
+    glBindBuffer(GL_ARRAY_BUFFER, LineVBO);
     int posSizeStart = 3; // each position has x,y & z
     GLuint vertexStartLocation = glGetAttribLocation(shaderProgramRain->ID, "pos");
     glEnableVertexAttribArray(vertexStartLocation);
-    glVertexAttribPointer(vertexStartLocation, posSizeStart, GL_FLOAT, GL_FALSE, particleSize * sizeOfFloat, (void*)0);
+    glVertexAttribPointer(vertexStartLocation, posSizeStart, GL_FLOAT, GL_FALSE, lineSize * sizeOfFloat, (void*)0);
+
+    // per streak attributes, they advance once per instance instead of once per vertex
+    glBindBuffer(GL_ARRAY_BUFFER, LineInstanceVBO);
+    int velocitySize = 3; // each velocity has x,y & z
+    GLuint velocityLocation = glGetAttribLocation(shaderProgramRain->ID, "velocity");
+    glEnableVertexAttribArray(velocityLocation);
+    glVertexAttribPointer(velocityLocation, velocitySize, GL_FLOAT, GL_FALSE, lineInstanceSize * sizeOfFloat, (void*)0);
+    glVertexAttribDivisor(velocityLocation, 1);
+
+    int randomOffsetSize = 3; // each offset has x,y & z
+    GLuint randomOffsetLocation = glGetAttribLocation(shaderProgramRain->ID, "randomOffset");
+    glEnableVertexAttribArray(randomOffsetLocation);
+    glVertexAttribPointer(randomOffsetLocation, randomOffsetSize, GL_FLOAT, GL_FALSE, lineInstanceSize * sizeOfFloat, (void*)(velocitySize*sizeOfFloat));
+    glVertexAttribDivisor(randomOffsetLocation, 1);
 }
 
 
@@ -434,8 +671,8 @@ void drawObjects(){
     floorObj.drawSceneObject();
 
     // draw 2 cubes and 2 planes in different locations and with different orientations
-    drawCube(viewProjection * glm::translate(2.0f, 1.f, 2.0f) * glm::rotateY(glm::half_pi<float>()) * scale);
-    drawCube(viewProjection * glm::translate(-2.0f, 1.f, -2.0f) * glm::rotateY(glm::quarter_pi<float>()) * scale);
+    for (const glm::mat4 &cubeModel : cubeModels)
+        drawCube(viewProjection * cubeModel * scale);
 
 
 }
@@ -452,6 +689,7 @@ void setup(){
     shaderProgramWorld = new Shader("shaders/shader.vert", "shaders/shader.frag");
     shaderProgramSnow = new Shader("shaders/snow.vert", "shaders/snow.frag");
     shaderProgramRain = new Shader("shaders/rain.vert", "shaders/rain.frag");
+    shaderProgramSimulated = new Shader("shaders/particle.vert", "shaders/snow.frag");
     // load floor mesh into openGL
     floorObj.VAO = createVertexArray(floorVertices, floorColors, floorIndices);
     floorObj.vertexCount = floorIndices.size();
@@ -462,9 +700,8 @@ void setup(){
 }
 
 void emitParticle(float posX, float posY, float posZ, float velX, float velY, float velZ, float ranX, float ranY, float ranZ, glm::vec3 color){
-    glBindVertexArray(ParticleVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, ParticleVBO);
-    float data[particleSize];
+    // the particle is uploaded with the others emitted in this frame, see renderParticles
+    float *data = snowParticles.emit();
     data[0] = posX;
     data[1] = posY;
     data[2] = posZ;
@@ -478,10 +715,6 @@ void emitParticle(float posX, float posY, float posZ, float velX, float velY, fl
     data[10] = color.y;
     data[11] = color.z;
     data[12] = currentTime;
-
-    // upload only parts of the buffer
-    glBufferSubData(GL_ARRAY_BUFFER, particleId * particleSize * sizeOfFloat, particleSize * sizeOfFloat, data);
-    particleId = (particleId + 1) % numberOfParticles;
 }
 
 float RandomNumber(float Min, float Max)
@@ -608,12 +841,20 @@ void processInput(GLFWwindow *window) {
 
     if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
     {
-        isRaining = true;
+        weatherMode = WEATHER_RAIN;
     }
 
     if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
     {
-        isRaining = false;
+        weatherMode = WEATHER_SNOW;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
+    {
+        // the simulation didn't run while another mode was shown, it restarts from now
+        if (weatherMode != WEATHER_SIMULATED)
+            lastSimulationTime = currentTime;
+        weatherMode = WEATHER_SIMULATED;
     }
 }
 
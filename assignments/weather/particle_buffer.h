@@ -0,0 +1,210 @@
+#ifndef PARTICLE_BUFFER_H
+#define PARTICLE_BUFFER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// not in the headers of an OpenGL 3.3 loader
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+// Vertex buffer of particles used as a ring: a new particle replaces the oldest one.
+//
+// The particles are emitted into a copy of the ring in CPU memory, and flush uploads the ones emitted since the last
+// flush. They are contiguous in the ring, so a flush is at most two uploads (when they wrap around the end), however
+// many particles were emitted. Call flush once per frame, before drawing from firstVertex.
+//
+// With OpenGL 4.4 or GL_ARB_buffer_storage the buffer is mapped once, persistently, and flush copies the particles into
+// it. The buffer then holds REGIONS copies of the ring: each flush writes the next region and the frame draws from it
+// (see firstVertex), while the GPU may still be drawing the previous frames from the other regions. A fence placed
+// after the draw (see fence) marks when the GPU is done with a region, flush only waits for the fence of the region it
+// is about to write, which was last drawn REGIONS frames earlier. A region gets the particles emitted since it was last
+// written. Otherwise each upload maps its range with GL_MAP_INVALIDATE_RANGE_BIT (the driver can give it new memory
+// instead of waiting for the GPU), and a flush that replaces every particle orphans the whole buffer with glBufferData.
+class ParticleBuffer {
+public:
+    struct Stats {
+        unsigned int uploads = 0;   // uploads (copies to the mapped buffer or buffer updates) in the last flush
+        unsigned int particles = 0; // particles uploaded in the last flush
+        bool waited = false;        // the last flush had to wait for the GPU to finish drawing its region
+    };
+
+    // copies of the ring in the persistently mapped buffer
+    static const unsigned int REGIONS = 3;
+
+    // capacity particles of particleSize floats
+    ParticleBuffer(unsigned int capacity, unsigned int particleSize)
+        : capacity(capacity), particleSize(particleSize), particles((size_t) capacity * particleSize, 0.0f)
+    {
+    }
+
+    ParticleBuffer(ParticleBuffer const&) = delete;
+    void operator=(ParticleBuffer const&) = delete;
+
+    // creates the vertex buffer, with all the particles set to 0, and leaves it bound to GL_ARRAY_BUFFER to set the
+    // attributes. usePersistentMapping false always uploads with glMapBufferRange, to compare
+    void create(bool usePersistentMapping = true)
+    {
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        GLsizeiptr regionSize = (GLsizeiptr) (particles.size() * sizeof(float));
+
+        typedef void (APIENTRY *BufferStorage)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+        BufferStorage bufferStorage = nullptr;
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (usePersistentMapping && (major > 4 || (major == 4 && minor >= 4) || glfwExtensionSupported("GL_ARB_buffer_storage")))
+            bufferStorage = (BufferStorage) glfwGetProcAddress("glBufferStorage");
+
+        if (bufferStorage)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            bufferStorage(GL_ARRAY_BUFFER, regionSize * REGIONS, nullptr, flags);
+            mapped = (float*) glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * REGIONS, flags);
+            for (unsigned int r = 0; mapped && r < REGIONS; r++)
+                std::memcpy(mapped + r * particles.size(), &particles[0], (size_t) regionSize);
+        }
+        else
+            glBufferData(GL_ARRAY_BUFFER, regionSize, &particles[0], GL_DYNAMIC_DRAW);
+    }
+
+    void destroy()
+    {
+        for (GLsync &sync : syncs)
+        {
+            if (sync)
+                glDeleteSync(sync);
+            sync = 0;
+        }
+        if (mapped)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        mapped = nullptr;
+        glDeleteBuffers(1, &VBO);
+    }
+
+    // the floats of a new particle, to fill before the next flush
+    float* emit()
+    {
+        float *particle = &particles[(size_t) next * particleSize];
+        next = (next + 1) % capacity;
+        pending = std::min(pending + 1, capacity);
+        emitted++;
+        return particle;
+    }
+
+    // uploads the particles emitted since the last flush
+    void flush()
+    {
+        stats = Stats();
+        if (mapped)
+        {
+            // the next region, last drawn REGIONS frames ago: the GPU is usually done with it already
+            unsigned int r = (region + 1) % REGIONS;
+            if (syncs[r])
+            {
+                stats.waited = glClientWaitSync(syncs[r], GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED;
+                if (stats.waited)
+                    glClientWaitSync(syncs[r], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                glDeleteSync(syncs[r]);
+                syncs[r] = 0;
+            }
+            region = r;
+            // the particles emitted since this region was written, they end at next
+            unsigned int count = (unsigned int) std::min<uint64_t>(emitted - regionEmitted[r], capacity);
+            regionEmitted[r] = emitted;
+            pending = 0;
+            if (count == 0)
+                return;
+            unsigned int first = (next + capacity - count) % capacity;
+            stats.particles = count;
+            upload(first, std::min(count, capacity - first));
+            if (first + count > capacity)
+                upload(0, first + count - capacity);
+            return;
+        }
+
+        if (pending == 0)
+            return;
+        unsigned int first = (next + capacity - pending) % capacity;
+        stats.particles = pending;
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (pending == capacity)
+        {
+            // every particle is new, orphan the buffer and fill the new storage in one call
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) (particles.size() * sizeof(float)), &particles[0], GL_DYNAMIC_DRAW);
+            stats.uploads = 1;
+        }
+        else
+        {
+            upload(first, std::min(pending, capacity - first));
+            if (first + pending > capacity)
+                upload(0, first + pending - capacity);
+        }
+        pending = 0;
+    }
+
+    // call after the draw that reads the buffer, so the flushes don't overwrite particles the GPU is drawing
+    void fence()
+    {
+        if (!mapped)
+            return;
+        if (syncs[region])
+            glDeleteSync(syncs[region]);
+        syncs[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // the first vertex to draw, the particles are the capacity vertices that start there
+    GLint firstVertex() const { return (GLint) (region * capacity); }
+
+    unsigned int getVBO() const { return VBO; }
+    bool isPersistentlyMapped() const { return mapped != nullptr; }
+    const Stats &lastFlush() const { return stats; }
+
+private:
+    unsigned int capacity, particleSize;
+    std::vector<float> particles; // copy of the ring in CPU memory, where the particles are emitted
+    unsigned int next = 0;        // the slot of the next particle
+    unsigned int pending = 0;     // particles emitted since the last flush, they end at next
+    unsigned int VBO = 0;
+    float *mapped = nullptr;
+    uint64_t emitted = 0;                 // particles emitted since the start
+    unsigned int region = 0;              // the region written by the last flush, drawn this frame
+    uint64_t regionEmitted[REGIONS] = {}; // the value of emitted when each region was last written
+    GLsync syncs[REGIONS] = {};           // the fences placed after the draws of each region
+    Stats stats;
+
+    // copies count particles from slot first to the buffer
+    void upload(unsigned int first, unsigned int count)
+    {
+        size_t offset = (size_t) first * particleSize;
+        size_t size = (size_t) count * particleSize * sizeof(float);
+        if (mapped)
+            std::memcpy(mapped + region * particles.size() + offset, &particles[offset], size);
+        else
+        {
+            void *range = glMapBufferRange(GL_ARRAY_BUFFER, (GLintptr) (offset * sizeof(float)), (GLsizeiptr) size,
+                                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+            if (range)
+            {
+                std::memcpy(range, &particles[offset], size);
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+            }
+        }
+        stats.uploads++;
+    }
+};
+
+#endif
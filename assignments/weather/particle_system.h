@@ -0,0 +1,256 @@
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+#include <glm/glm.hpp>
+
+#include "spatial_hash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Particles simulated on the CPU: they fall with gravity, are pushed by a wind field, die when they reach the ground
+// or get too old, and new ones are spawned in an emitter box.
+//
+// The particles are stored as structure of arrays (one array per coordinate of the positions and velocities, and
+// one for the ages), so the update is a loop over contiguous floats without branches that the compiler vectorizes.
+// The particles are split in one chunk per thread:
+// - each thread integrates its chunk and moves the particles that are still alive to the front of the chunk,
+// - then the holes left before the end of the live particles are filled with the last live particles, which moves
+//   at most as many particles as died (not all of them), so the live particles are always the first count() ones.
+// The order of the particles changes when some die.
+//
+// With a collider (see setCollider), each block is collided with the scene after it is integrated. A particle that
+// sticks to the scene stops moving until it dies of old age.
+//
+// Nothing here needs OpenGL, writeVertices fills a vertex buffer with the particles.
+class ParticleSystem {
+public:
+    struct Settings {
+        glm::vec3 gravity = glm::vec3(0.0f, -1.0f, 0.0f);
+        glm::vec3 wind = glm::vec3(-0.5f, 0.0f, -0.5f);   // the wind everywhere
+        float turbulence = 1.0f;         // strength of the wind that changes with the position and time
+        float drag = 1.0f;               // how fast the particles take the velocity of the wind (per second)
+        float groundHeight = 0.0f;       // the particles die below it
+        float lifetime = 15.0f;          // seconds
+        glm::vec3 emitterMin = glm::vec3(-20.0f, 10.0f, -20.0f), emitterMax = glm::vec3(20.0f, 12.0f, 20.0f);
+        glm::vec3 velocityMin = glm::vec3(-0.2f, -2.0f, -0.2f), velocityMax = glm::vec3(0.2f, -1.0f, 0.2f);
+    };
+
+    // floats per particle written by writeVertices: x, y, z and the age divided by the lifetime
+    enum { VERTEX_SIZE = 4 };
+
+    Settings settings;
+
+    explicit ParticleSystem(size_t capacity, unsigned int threadCount = std::max(std::thread::hardware_concurrency(), 1u))
+        : capacity(capacity), threadCount(std::max(threadCount, 1u))
+    {
+        for (std::vector<float> *array : arrays())
+            array->resize(capacity);
+    }
+
+    size_t count() const { return alive; }
+    size_t getCapacity() const { return capacity; }
+    unsigned int getThreadCount() const { return threadCount; }
+
+    glm::vec3 position(size_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+    glm::vec3 velocity(size_t i) const { return glm::vec3(vx[i], vy[i], vz[i]); }
+    float age(size_t i) const { return ages[i]; }
+    bool isMoving(size_t i) const { return moving[i] != 0.0f; }
+
+    // the particles collide with the triangles of collider (which must outlive the system), nullptr for none
+    void setCollider(const SpatialHash *collider, SpatialHash::Response response = SpatialHash::RESPONSE_STICK)
+    {
+        this->collider = collider;
+        this->response = response;
+    }
+
+    // adds up to n particles in the emitter box moved by offset, as many as there is room for
+    void spawn(size_t n, const glm::vec3 &offset = glm::vec3(0.0f))
+    {
+        n = std::min(n, capacity - alive);
+        const Settings &s = settings;
+        for (size_t i = alive; i < alive + n; i++)
+        {
+            x[i] = offset.x + random(s.emitterMin.x, s.emitterMax.x);
+            y[i] = offset.y + random(s.emitterMin.y, s.emitterMax.y);
+            z[i] = offset.z + random(s.emitterMin.z, s.emitterMax.z);
+            vx[i] = random(s.velocityMin.x, s.velocityMax.x);
+            vy[i] = random(s.velocityMin.y, s.velocityMax.y);
+            vz[i] = random(s.velocityMin.z, s.velocityMax.z);
+            ages[i] = 0.0f;
+            moving[i] = 1.0f;
+        }
+        alive += n;
+    }
+
+    // moves the particles dt seconds forward, time is the time of the simulation (it animates the wind), and removes
+    // the particles that died
+    void update(float dt, float time)
+    {
+        size_t chunks = std::min<size_t>(threadCount, std::max<size_t>(alive / MIN_CHUNK, 1));
+        std::vector<size_t> begin(chunks + 1), survivors(chunks);
+        for (size_t c = 0; c <= chunks; c++)
+            begin[c] = alive * c / chunks;
+
+        // the chunks are updated in blocks that fit in the L1 cache: the block is integrated, then its survivors are
+        // moved while it is still in the cache
+        parallelFor(chunks, [&](size_t c) {
+            size_t out = begin[c];
+            for (size_t block = begin[c]; block < begin[c + 1]; block += BLOCK)
+            {
+                size_t blockEnd = std::min<size_t>(block + BLOCK, begin[c + 1]);
+                integrate(block, blockEnd, dt, time);
+                if (collider)
+                    collider->collide(&x[block], &y[block], &z[block], &vx[block], &vy[block], &vz[block],
+                                      &moving[block], &ages[block], blockEnd - block, dt, response, settings.lifetime);
+                out = compact(block, blockEnd, out);
+            }
+            survivors[c] = out - begin[c];
+        });
+
+        // the survivors of each chunk are at its front. The holes below the new count are filled with the survivors
+        // that are above it, there are as many of one as of the other
+        size_t total = 0;
+        for (size_t survivorCount : survivors)
+            total += survivorCount;
+        std::vector<std::pair<size_t, size_t>> holes, sources;
+        for (size_t c = 0; c < chunks; c++)
+        {
+            size_t liveEnd = begin[c] + survivors[c];
+            if (liveEnd < std::min(begin[c + 1], total))
+                holes.push_back(std::make_pair(liveEnd, std::min(begin[c + 1], total)));
+            if (std::max(begin[c], total) < liveEnd)
+                sources.push_back(std::make_pair(std::max(begin[c], total), liveEnd));
+        }
+        size_t source = 0, from = sources.empty() ? 0 : sources[0].first;
+        for (const std::pair<size_t, size_t> &hole : holes)
+            for (size_t to = hole.first; to < hole.second; to++)
+            {
+                while (from == sources[source].second)
+                    from = sources[++source].first;
+                move(from++, to);
+            }
+        alive = total;
+    }
+
+    // writes VERTEX_SIZE floats per particle, count() particles
+    void writeVertices(float *vertices) const
+    {
+        size_t chunks = std::min<size_t>(threadCount, std::max<size_t>(alive / MIN_CHUNK, 1));
+        float inverseLifetime = 1.0f / settings.lifetime;
+        parallelFor(chunks, [&](size_t c) {
+            for (size_t i = alive * c / chunks; i < alive * (c + 1) / chunks; i++)
+            {
+                float *vertex = vertices + i * VERTEX_SIZE;
+                vertex[0] = x[i];
+                vertex[1] = y[i];
+                vertex[2] = z[i];
+                vertex[3] = ages[i] * inverseLifetime;
+            }
+        });
+    }
+
+private:
+    // below this many particles per thread, starting the threads costs more than it saves
+    enum { MIN_CHUNK = 16384, BLOCK = 512 };
+
+    size_t capacity, alive = 0;
+    unsigned int threadCount;
+    std::vector<float> x, y, z, vx, vy, vz, ages;
+    std::vector<float> moving; // 1 for the particles that move, 0 for those stuck to the scene
+    uint32_t randomState = 0x9E3779B9u;
+    const SpatialHash *collider = nullptr;
+    SpatialHash::Response response = SpatialHash::RESPONSE_STICK;
+
+    std::vector<std::vector<float>*> arrays() { return {&x, &y, &z, &vx, &vy, &vz, &ages, &moving}; }
+
+    // xorshift, rand() is slow and shared with the rest of the application
+    float random(float min, float max)
+    {
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        return min + (max - min) * (float) (randomState >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // close to sin(t), std::sin would take most of the update and keeps the loop from being vectorized
+    static float wave(float t)
+    {
+        // f in [-0.5, 0.5] (the period of sin is 1 in f), shifted by whole periods so it can be truncated to an int
+        // instead of calling floor
+        float shifted = t * (0.5f / 3.14159265f) + 0.5f + 1024.0f;
+        float f = shifted - (float) (int) shifted - 0.5f;
+        float g = 2.0f * f;
+        return 4.0f * g * (1.0f - std::abs(g));
+    }
+
+    void integrate(size_t begin, size_t end, float dt, float time)
+    {
+        const Settings &s = settings;
+        integrate(&x[begin], &y[begin], &z[begin], &vx[begin], &vy[begin], &vz[begin], &ages[begin], &moving[begin],
+                  end - begin, dt, time, s.gravity * dt, s.wind, s.turbulence, std::min(s.drag * dt, 1.0f));
+    }
+
+    // the kernel, restrict on the parameters tells the compiler the arrays don't overlap so it can vectorize the loop
+    static void integrate(float *__restrict x, float *__restrict y, float *__restrict z, float *__restrict vx,
+                          float *__restrict vy, float *__restrict vz, float *__restrict ages,
+                          const float *__restrict moving, size_t n, float dt, float time, glm::vec3 gravity,
+                          glm::vec3 wind, float turbulence, float drag)
+    {
+        const float gravityX = gravity.x, gravityY = gravity.y, gravityZ = gravity.z;
+        const float windX = wind.x, windY = wind.y, windZ = wind.z;
+        for (size_t i = 0; i < n; i++)
+        {
+            // the wind blows in gusts that move across the scene
+            float gustX = windX + turbulence * wave(z[i] * 0.5f + time);
+            float gustZ = windZ + turbulence * wave(x[i] * 0.5f + time * 1.3f);
+            // a stuck particle (moving is 0) keeps a velocity of 0
+            vx[i] = (vx[i] + gravityX + (gustX - vx[i]) * drag) * moving[i];
+            vy[i] = (vy[i] + gravityY + (windY - vy[i]) * drag) * moving[i];
+            vz[i] = (vz[i] + gravityZ + (gustZ - vz[i]) * drag) * moving[i];
+            x[i] += vx[i] * dt;
+            y[i] += vy[i] * dt;
+            z[i] += vz[i] * dt;
+            ages[i] += dt;
+        }
+    }
+
+    // moves the live particles of [begin, end) to out and after, keeping their order (out <= begin), returns the end
+    // of the moved particles. Every particle is copied, a dead one is overwritten by the next one
+    size_t compact(size_t begin, size_t end, size_t out)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            bool isAlive = ages[i] < settings.lifetime && y[i] > settings.groundHeight;
+            move(i, out);
+            out += isAlive;
+        }
+        return out;
+    }
+
+    void move(size_t from, size_t to)
+    {
+        x[to] = x[from]; y[to] = y[from]; z[to] = z[from];
+        vx[to] = vx[from]; vy[to] = vy[from]; vz[to] = vz[from];
+        ages[to] = ages[from]; moving[to] = moving[from];
+    }
+
+    // calls function(i) for i in [0, n), each in its own thread (the calling thread runs the last one)
+    template<class Function>
+    void parallelFor(size_t n, const Function &function) const
+    {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i + 1 < n; i++)
+            workers.emplace_back([&function, i]() { function(i); });
+        if (n > 0)
+            function(n - 1);
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+};
+
+#endif
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 pos;
+layout (location = 1) in float life;
+
+uniform mat4 model;
+uniform vec3 camPosition;
+
+out vec3 particleColor;
+out float distanceFrag;
+
+// the particles are simulated on the CPU (see particle_system.h), pos is already their position in the world
+void main()
+{
+   gl_Position = model * vec4(pos, 1.0);
+
+   float distance = distance(pos, camPosition);
+   distanceFrag = distance;
+
+   gl_PointSize = 5.0/distance;
+
+   // the snow fades into the clear color at the end of its life instead of disappearing at once
+   particleColor = mix(vec3(1.0), vec3(0.3), smoothstep(0.9, 1.0, life));
+}
\ No newline at end of file
@@ -1,18 +1,26 @@
 #version 330 core
 layout (location = 0) in vec3 pos;
+// one instance per streak, these two advance once per streak
+layout (location = 1) in vec3 velocity;
+layout (location = 2) in vec3 randomOffset;
 uniform mat4 model;
 uniform mat4 prevModel;
 
-uniform vec3 offset;
+uniform float currentTime;
 uniform vec3 camPosition;
 uniform vec3 forwardOffset;
-uniform vec3 velocity;
 
 uniform float boxSize;
 const float heightScale = 0.05;
 out float lenColorScale;
 void main()
 {
+    // offset of the streak, it falls with its velocity and wraps around the box in front of the camera
+    // (forwardOffset is twice the camera forward vector)
+    vec3 offset = velocity * currentTime + randomOffset;
+    offset -= camPosition + forwardOffset * 0.5 + boxSize / 2;
+    offset = mod(offset, boxSize);
+
     vec3 position = mod(pos + offset, boxSize);
     position += camPosition + forwardOffset - boxSize / 2;
 
@@ -33,4 +41,4 @@ void main()
     float len = length(dir);
     float lenPrev = length(dirPrev);
     lenColorScale = clamp(len/lenPrev, 0.0, 1.0);
-}
\ No newline at end of file
+}
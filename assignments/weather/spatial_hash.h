@@ -0,0 +1,282 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Triangles of the scene in a uniform grid of cubic cells, to find the triangles a short segment may cross without
+// testing all of them.
+//
+// The grid is not stored: a cell (ix, iy, iz) is hashed to a bucket of a table, and each bucket lists the triangles
+// whose bounding box overlaps one of the cells hashed to it. Different cells can share a bucket, which only adds
+// triangles to test. A segment looks at the buckets of the cells its bounding box overlaps (one cell when it is much
+// shorter than a cell, which is the case for a particle moving during one frame), so the cost of a query depends on
+// the number of triangles near the segment, not on the number of triangles of the scene.
+//
+// collide does it for a batch of particles stored as structure of arrays (see particle_system.h).
+class SpatialHash {
+public:
+    // what happens to a particle that hits a triangle
+    enum Response {
+        RESPONSE_STICK, // it stays where it hit, like snow
+        RESPONSE_DIE    // it is removed, like a rain drop that splashes
+    };
+
+    explicit SpatialHash(float cellSize = 1.0f) : cellSize(cellSize), inverseCellSize(1.0f / cellSize) {}
+
+    // adds the triangles of an indexed mesh with 3 floats per vertex (like the meshes of primitives.h) placed in the
+    // scene by model, call build after adding the meshes
+    void addMesh(const std::vector<float> &vertices, const std::vector<unsigned int> &indices, const glm::mat4 &model)
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            glm::vec3 corners[3];
+            for (int c = 0; c < 3; c++)
+            {
+                const float *vertex = &vertices[indices[i + c] * 3];
+                corners[c] = glm::vec3(model * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f));
+            }
+            addTriangle(corners[0], corners[1], corners[2]);
+        }
+    }
+
+    void addTriangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+    {
+        Triangle triangle;
+        triangle.a = a;
+        triangle.edge1 = b - a;
+        triangle.edge2 = c - a;
+        triangle.normal = glm::normalize(glm::cross(triangle.edge1, triangle.edge2));
+        triangles.push_back(triangle);
+    }
+
+    // fills the table with the triangles added so far
+    void build()
+    {
+        // (bucket, triangle) for every cell overlapped by every triangle
+        std::vector<std::pair<uint32_t, uint32_t>> entries;
+        size_t cellCount = 0;
+        for (const Triangle &triangle : triangles)
+        {
+            int low[3], high[3];
+            triangleCells(triangle, low, high);
+            cellCount += (size_t) (high[0] - low[0] + 1) * (high[1] - low[1] + 1) * (high[2] - low[2] + 1);
+        }
+        // most of the buckets are empty, so most segments far from the triangles are rejected by their bucket
+        tableSize = 1;
+        while (tableSize < cellCount * 8)
+            tableSize *= 2;
+
+        boundsMin = glm::vec3(INFINITY);
+        boundsMax = glm::vec3(-INFINITY);
+        for (const Triangle &triangle : triangles)
+            for (const glm::vec3 &corner : {triangle.a, triangle.a + triangle.edge1, triangle.a + triangle.edge2})
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    boundsMin[axis] = std::min(boundsMin[axis], corner[axis]);
+                    boundsMax[axis] = std::max(boundsMax[axis], corner[axis]);
+                }
+
+        entries.reserve(cellCount);
+        for (uint32_t t = 0; t < (uint32_t) triangles.size(); t++)
+        {
+            int low[3], high[3];
+            triangleCells(triangles[t], low, high);
+            for (int ix = low[0]; ix <= high[0]; ix++)
+                for (int iy = low[1]; iy <= high[1]; iy++)
+                    for (int iz = low[2]; iz <= high[2]; iz++)
+                        entries.push_back(std::make_pair(bucket(ix, iy, iz), t));
+        }
+        // a triangle is listed once per bucket even if several of its cells share the bucket
+        std::sort(entries.begin(), entries.end());
+        entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+        bucketStart.assign(tableSize + 1, 0);
+        bucketTriangles.resize(entries.size());
+        for (const std::pair<uint32_t, uint32_t> &entry : entries)
+            bucketStart[entry.first + 1]++;
+        for (size_t b = 0; b < tableSize; b++)
+            bucketStart[b + 1] += bucketStart[b];
+        for (size_t e = 0; e < entries.size(); e++)
+            bucketTriangles[e] = entries[e].second;
+    }
+
+    size_t triangleCount() const { return triangles.size(); }
+    float getCellSize() const { return cellSize; }
+
+    // the first triangle crossed by the segment from 'from' to 'to': t in [0, 1] is where along the segment, normal
+    // is the normal of the triangle on the side of 'from'. Returns false if the segment crosses nothing
+    bool intersect(const glm::vec3 &from, const glm::vec3 &to, float &t, glm::vec3 &normal) const
+    {
+        int low[3], high[3];
+        segmentCells(from, to, low, high);
+        t = 2.0f;
+        for (int ix = low[0]; ix <= high[0]; ix++)
+            for (int iy = low[1]; iy <= high[1]; iy++)
+                for (int iz = low[2]; iz <= high[2]; iz++)
+                {
+                    uint32_t b = bucket(ix, iy, iz);
+                    for (uint32_t i = bucketStart[b]; i < bucketStart[b + 1]; i++)
+                        intersectTriangle(triangles[bucketTriangles[i]], from, to, t, normal);
+                }
+        return t <= 1.0f;
+    }
+
+    // the same as intersect, testing every triangle of the scene
+    bool intersectAll(const glm::vec3 &from, const glm::vec3 &to, float &t, glm::vec3 &normal) const
+    {
+        t = 2.0f;
+        for (const Triangle &triangle : triangles)
+            intersectTriangle(triangle, from, to, t, normal);
+        return t <= 1.0f;
+    }
+
+    // the n particles moved from position - velocity * dt to position during the last step. Those that crossed a
+    // triangle are moved back to where they hit it, then either stick (their velocity and moving become 0) or die
+    // (their age becomes deadAge). Particles that don't move (moving is 0) are skipped.
+    //
+    // The particles are handled in batches, in two passes: the first one keeps the particles that are in the bounding
+    // box of the scene and whose buckets are not empty, the second one tests those against the triangles. Most
+    // particles are above the scene or fall through empty cells and never reach the second pass.
+    void collide(float *x, float *y, float *z, float *vx, float *vy, float *vz, float *moving, float *ages, size_t n,
+                 float dt, Response response, float deadAge) const
+    {
+        if (triangles.empty())
+            return;
+        uint32_t candidates[BATCH];
+        for (size_t batch = 0; batch < n; batch += BATCH)
+        {
+            size_t batchEnd = std::min<size_t>(batch + BATCH, n);
+            size_t candidateCount = 0;
+            for (size_t i = batch; i < batchEnd; i++)
+            {
+                if (moving[i] == 0.0f)
+                    continue;
+                glm::vec3 to(x[i], y[i], z[i]);
+                glm::vec3 from = to - glm::vec3(vx[i], vy[i], vz[i]) * dt;
+                if (!overlapsBounds(from, to))
+                    continue;
+                int low[3], high[3];
+                segmentCells(from, to, low, high);
+                bool nearTriangles = false;
+                for (int ix = low[0]; ix <= high[0]; ix++)
+                    for (int iy = low[1]; iy <= high[1]; iy++)
+                        for (int iz = low[2]; iz <= high[2]; iz++)
+                        {
+                            uint32_t b = bucket(ix, iy, iz);
+                            nearTriangles |= bucketStart[b] != bucketStart[b + 1];
+                        }
+                candidates[candidateCount] = (uint32_t) i;
+                candidateCount += nearTriangles;
+            }
+
+            for (size_t c = 0; c < candidateCount; c++)
+            {
+                uint32_t i = candidates[c];
+                glm::vec3 to(x[i], y[i], z[i]);
+                glm::vec3 from = to - glm::vec3(vx[i], vy[i], vz[i]) * dt;
+                float t;
+                glm::vec3 normal;
+                if (!intersect(from, to, t, normal))
+                    continue;
+                // a millimeter in front of the triangle, so the particle is not behind it because of rounding
+                glm::vec3 hit = from + (to - from) * t + normal * 0.001f;
+                x[i] = hit.x;
+                y[i] = hit.y;
+                z[i] = hit.z;
+                if (response == RESPONSE_STICK)
+                {
+                    vx[i] = vy[i] = vz[i] = 0.0f;
+                    moving[i] = 0.0f;
+                }
+                else
+                    ages[i] = deadAge;
+            }
+        }
+    }
+
+private:
+    // particles per batch of collide
+    enum { BATCH = 512 };
+
+    struct Triangle {
+        glm::vec3 a, edge1, edge2, normal;
+    };
+
+    float cellSize, inverseCellSize;
+    std::vector<Triangle> triangles;
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f); // the bounding box of the triangles
+    // the triangles of bucket b are bucketTriangles[bucketStart[b]] to bucketTriangles[bucketStart[b + 1] - 1], an
+    // empty table has a single empty bucket
+    size_t tableSize = 1;
+    std::vector<uint32_t> bucketStart = std::vector<uint32_t>(2, 0);
+    std::vector<uint32_t> bucketTriangles;
+
+    int cell(float coordinate) const { return (int) std::floor(coordinate * inverseCellSize); }
+
+    // the hash of Teschner et al. (Optimized Spatial Hashing for Collision Detection of Deformable Objects)
+    uint32_t bucket(int ix, int iy, int iz) const
+    {
+        return (((uint32_t) ix * 73856093u) ^ ((uint32_t) iy * 19349663u) ^ ((uint32_t) iz * 83492791u)) & (uint32_t) (tableSize - 1);
+    }
+
+    // the range of cells overlapped by the bounding box of the triangle
+    void triangleCells(const Triangle &triangle, int low[3], int high[3]) const
+    {
+        glm::vec3 b = triangle.a + triangle.edge1, c = triangle.a + triangle.edge2;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            low[axis] = cell(std::min(triangle.a[axis], std::min(b[axis], c[axis])));
+            high[axis] = cell(std::max(triangle.a[axis], std::max(b[axis], c[axis])));
+        }
+    }
+
+    bool overlapsBounds(const glm::vec3 &from, const glm::vec3 &to) const
+    {
+        bool overlaps = true;
+        for (int axis = 0; axis < 3; axis++)
+            overlaps &= std::max(from[axis], to[axis]) >= boundsMin[axis] && std::min(from[axis], to[axis]) <= boundsMax[axis];
+        return overlaps;
+    }
+
+    void segmentCells(const glm::vec3 &from, const glm::vec3 &to, int low[3], int high[3]) const
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            low[axis] = cell(std::min(from[axis], to[axis]));
+            high[axis] = cell(std::max(from[axis], to[axis]));
+        }
+    }
+
+    // Moller-Trumbore, keeps the hit if it is closer than t
+    static void intersectTriangle(const Triangle &triangle, const glm::vec3 &from, const glm::vec3 &to, float &t,
+                                  glm::vec3 &normal)
+    {
+        glm::vec3 direction = to - from;
+        glm::vec3 p = glm::cross(direction, triangle.edge2);
+        float determinant = glm::dot(triangle.edge1, p);
+        if (std::abs(determinant) < 1e-12f)
+            return;   // parallel to the triangle
+        float inverse = 1.0f / determinant;
+        glm::vec3 s = from - triangle.a;
+        float u = glm::dot(s, p) * inverse;
+        if (u < 0.0f || u > 1.0f)
+            return;
+        glm::vec3 q = glm::cross(s, triangle.edge1);
+        float v = glm::dot(direction, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f)
+            return;
+        float hit = glm::dot(triangle.edge2, q) * inverse;
+        if (hit < 0.0f || hit > 1.0f || hit >= t)
+            return;
+        t = hit;
+        normal = glm::dot(triangle.normal, direction) < 0.0f ? triangle.normal : -triangle.normal;
+    }
+};
+
+#endif
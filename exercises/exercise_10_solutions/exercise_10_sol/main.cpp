@@ -4,9 +4,13 @@
 
 #include <vector>
 #include <chrono>
+#include <cmath>
+#include <thread>
 #include <string>
 #include <glm/gtx/transform.hpp>
 #include "rt_renderer.h"
+#include "rt_streaming.h"
+#include "rt_distributed.h"
 #include "primitives.h"
 
 #include "camera.h"
@@ -17,6 +21,17 @@ void button_input_callback(GLFWwindow* window, int button, int action, int mods)
 void cursor_input_callback(GLFWwindow* window, double posX, double posY);
 void processInput(GLFWwindow* window);
 
+// builds the scene, a small colored cube inside a bigger grey cube
+std::vector<rt::vertex> buildScene();
+// renders an offline still in this process and with local worker processes, and reports the speedup
+int runDistributedBenchmark(const char* executable, unsigned int width, unsigned int height, unsigned int maxWorkers);
+// renders an offline still straight to a PPM file, tile by tile, without a frame buffer for the whole image
+int renderStillToFile(unsigned int width, unsigned int height, const char* path);
+// many small colored point lights below the ceiling and an area light on it, with the same total power for any count
+std::vector<rt::Light> buildLights(unsigned int pointLightCount);
+// renders with an increasing number of lights and reports the time of each render
+int runLightsBenchmark(unsigned int width, unsigned int height, unsigned int samplesPerPixel);
+
 // rasterization grid resolution
 const int max_W = 64, max_H = 64;
 
@@ -30,10 +45,52 @@ rt::Renderer renderer;
 float deltaTime = 0;
 unsigned int rtDepth = 2;
 
-int main()
+// out-of-core rendering, the scene is written to a cluster file and paged in from there
+bool useStreamedModel = false;
+const char* clusterFilePath = "rt_clusters.bin";
+const unsigned int trianglesPerCluster = 4;
+// caps the memory used by resident clusters, small enough that our test scene does not fit
+const size_t clusterCacheBudget = 4 * 1024;
+
+// many lights, sampled through a light BVH instead of the single light of the renderer
+bool useManyLights = false;
+const unsigned int manyLightsCount = 1024;
+const unsigned int sampleCounts[] = {1, 4, 16};
+unsigned int sampleCountIndex = 0;
+
+#ifdef RT_INSTRUMENTATION
+// show the per pixel cost instead of the rendered image, and request a dump of the statistics
+bool showHeatmap = false;
+bool dumpStatistics = false;
+const char* statisticsPath = "rt_stats.json";
+#endif
+
+int main(int argc, char* argv[])
 {
     using namespace std;
 
+    // usage: --rt-lights-benchmark [width] [height] [samples per pixel]
+    if (argc >= 2 && string(argv[1]) == "--rt-lights-benchmark")
+        return runLightsBenchmark(argc > 2 ? atoi(argv[2]) : 256,
+                                  argc > 3 ? atoi(argv[3]) : 256,
+                                  argc > 4 ? atoi(argv[4]) : 4);
+    // usage: --rt-still [width] [height] [file.ppm]
+    if (argc >= 2 && string(argv[1]) == "--rt-still")
+        return renderStillToFile(argc > 2 ? atoi(argv[2]) : 8192,
+                                 argc > 3 ? atoi(argv[3]) : 8192,
+                                 argc > 4 ? argv[4] : "rt_still.ppm");
+#ifndef _WIN32
+    // worker process of the distributed renderer (see renderer/rt_distributed.h)
+    if (argc >= 3 && string(argv[1]) == "--rt-worker")
+        return rt::runWorker(argv[2]);
+    // usage: --rt-benchmark [width] [height] [max workers]
+    if (argc >= 2 && string(argv[1]) == "--rt-benchmark")
+        return runDistributedBenchmark(argv[0],
+                                       argc > 2 ? atoi(argv[2]) : 1024,
+                                       argc > 3 ? atoi(argv[3]) : 1024,
+                                       argc > 4 ? atoi(argv[4]) : std::max(std::thread::hardware_concurrency(), 1u));
+#endif
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -72,40 +129,25 @@ int main()
 
     // load the 3D models
     // -----------------
-    std::vector<glm::vec3> points;
-    std::vector<glm::vec4> colors;
-    std::vector<glm::vec3> normals;
-    std::vector<glm::vec2> uvs;
-    Primitives::makeCube(2.f, points, normals, uvs, colors);
+    vector<rt::vertex> vts = buildScene();
 
 
-    vector<rt::vertex> vts;
-    glm::mat4 scale = glm::scale(glm::vec3(.25f,.25f,.25f));
-    for (unsigned int i = 0; i < points.size(); i++){
-        rt::vertex v{scale * glm::vec4(points[i], 1.0f),
-                    glm::vec4(normals[i], 0),
-                    colors[i],
-                    uvs[i]
-        };
-        vts.push_back(v);
-    }
-
-    glm::mat4 outsideout = glm::scale(glm::vec3(-2.f,-2.f,-2.f));
-    for (unsigned int i = 0; i < points.size(); i++){
-        rt::vertex v{outsideout * glm::vec4(points[i], 1.0f),
-                     glm::vec4(normals[i], 0),
-                     rt::grey,
-                     uvs[i]
-        };
-        vts.push_back(v);
-    }
-
+    // partition the scene into clusters, this would usually be done offline
+    rt::StreamedModel streamedModel;
+    if (!rt::writeClusterFile(vts, clusterFilePath, trianglesPerCluster) ||
+        !streamedModel.open(clusterFilePath, clusterCacheBudget))
+        std::cout << "Failed to write/open the cluster file " << clusterFilePath << std::endl;
+    else
+        std::cout << "Cluster file with " << streamedModel.clusterCount() << " clusters" << std::endl;
 
 
     // initialize our custom frame buffer
     // ----------------------------------
     // every frame we will: draw to it, upload it to a texture, and copy the texture to the window frame buffer.
     FrameBuffer<uint32_t> customBuffer(max_W, max_H);
+#ifdef RT_INSTRUMENTATION
+    FrameBuffer<uint32_t> heatmapBuffer(max_W, max_H);
+#endif
 
 
     // initialize texture we will use to upload our buffer to GPU
@@ -139,6 +181,16 @@ int main()
     std::cout << "3 - two reflections" << std::endl;
     std::cout << "4 - three reflections" << std::endl;
     std::cout << "5 - four reflections" << std::endl;
+    std::cout << "C - toggle streamed (out-of-core) geometry" << std::endl;
+    std::cout << "L - toggle " << manyLightsCount << " point lights and an area light" << std::endl;
+    std::cout << "P - cycle samples per pixel (1, 4, 16) used with many lights" << std::endl;
+#ifdef RT_INSTRUMENTATION
+    std::cout << "H - toggle per pixel cost heatmap (in-core geometry only)" << std::endl;
+    std::cout << "J - write ray statistics to " << statisticsPath << std::endl;
+#endif
+
+    std::vector<rt::Light> manyLights = buildLights(manyLightsCount);
+    bool usingManyLights = false;
 
     while (!glfwWindowShouldClose(window))
     {
@@ -154,14 +206,41 @@ int main()
 
         glm::mat4 scale = glm::scale(glm::vec3(.5f,.5f,.5f));
 
-        renderer.render(vts, glm::mat4(1), camera.GetViewMatrix(), 70.0f, rtDepth, customBuffer);
+        if (useManyLights != usingManyLights) {
+            renderer.setLights(useManyLights ? manyLights : std::vector<rt::Light>());
+            usingManyLights = useManyLights;
+        }
+        renderer.setSamplesPerPixel(sampleCounts[sampleCountIndex]);
+
+#ifdef RT_INSTRUMENTATION
+        rt::stats::Statistics::getInstance().reset(max_W, max_H);
+#endif
+        if (useStreamedModel && streamedModel.isOpen()) {
+            streamedModel.resetStats();
+            renderer.render(streamedModel, glm::mat4(1), camera.GetViewMatrix(), 70.0f, rtDepth, customBuffer);
+        }
+        else
+            renderer.render(vts, glm::mat4(1), camera.GetViewMatrix(), 70.0f, rtDepth, customBuffer);
+
+        uint32_t* displayBuffer = customBuffer.buffer;
+#ifdef RT_INSTRUMENTATION
+        if (showHeatmap) {
+            rt::stats::Statistics::getInstance().paintHeatmap(heatmapBuffer);
+            displayBuffer = heatmapBuffer.buffer;
+        }
+        if (dumpStatistics) {
+            if (rt::stats::Statistics::getInstance().writeJSON(statisticsPath))
+                std::cout << "Ray statistics written to " << statisticsPath << std::endl;
+            dumpStatistics = false;
+        }
+#endif
 
         // show our rendered image
         // -----------------------
         // upload the custom color buffer to the GPU using the texture
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, bufferTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, max_W, max_H, 0, GL_RGBA, GL_UNSIGNED_BYTE, customBuffer.buffer);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, max_W, max_H, 0, GL_RGBA, GL_UNSIGNED_BYTE, displayBuffer);
 
         // set opengl frame buffer object to read from our texture, we will copy from it
         glBindFramebuffer(GL_READ_FRAMEBUFFER, oglFrameBuffer);
@@ -185,7 +264,15 @@ int main()
             elapsed = std::chrono::high_resolution_clock::now() - frameStart;
         }
         deltaTime = elapsed.count();
-        glfwSetWindowTitle(window, ("Exercise 10 - FPS: " + std::to_string(int(1.0f/deltaTime + .5f))).c_str());
+        std::string title = "Exercise 10 - FPS: " + std::to_string(int(1.0f/deltaTime + .5f));
+        if (useStreamedModel && streamedModel.isOpen())
+            title += " - page-ins: " + std::to_string(streamedModel.stats().page_ins) +
+                     ", cache hits: " + std::to_string(streamedModel.stats().cache_hits) +
+                     ", peak cluster memory: " + std::to_string(streamedModel.stats().peak_resident_bytes) + " bytes";
+        if (useManyLights)
+            title += " - " + std::to_string(renderer.lights().size()) + " lights, " +
+                     std::to_string(renderer.samplesPerPixel()) + " samples per pixel";
+        glfwSetWindowTitle(window, title.c_str());
     }
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
@@ -236,6 +323,30 @@ void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS) rtDepth = 4;
     if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS) rtDepth = 5;
 
+    // toggle on key press, not while the key is held
+    static bool cWasPressed = false;
+    bool cPressed = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (cPressed && !cWasPressed) useStreamedModel = !useStreamedModel;
+    cWasPressed = cPressed;
+
+    static bool lWasPressed = false, pWasPressed = false;
+    bool lPressed = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+    bool pPressed = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (lPressed && !lWasPressed) useManyLights = !useManyLights;
+    if (pPressed && !pWasPressed) sampleCountIndex = (sampleCountIndex + 1) % 3;
+    lWasPressed = lPressed;
+    pWasPressed = pPressed;
+
+#ifdef RT_INSTRUMENTATION
+    static bool hWasPressed = false, jWasPressed = false;
+    bool hPressed = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+    bool jPressed = glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS;
+    if (hPressed && !hWasPressed) showHeatmap = !showHeatmap;
+    if (jPressed && !jWasPressed) dumpStatistics = true;
+    hWasPressed = hPressed;
+    jWasPressed = jPressed;
+#endif
+
     // movement commands
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(FORWARD, deltaTime);
@@ -255,4 +366,137 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
-}
\ No newline at end of file
+}
+
+
+std::vector<rt::vertex> buildScene(){
+    std::vector<glm::vec3> points;
+    std::vector<glm::vec4> colors;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    Primitives::makeCube(2.f, points, normals, uvs, colors);
+
+
+    std::vector<rt::vertex> vts;
+    glm::mat4 scale = glm::scale(glm::vec3(.25f,.25f,.25f));
+    for (unsigned int i = 0; i < points.size(); i++){
+        rt::vertex v{scale * glm::vec4(points[i], 1.0f),
+                    glm::vec4(normals[i], 0),
+                    colors[i],
+                    uvs[i]
+        };
+        vts.push_back(v);
+    }
+
+    glm::mat4 outsideout = glm::scale(glm::vec3(-2.f,-2.f,-2.f));
+    for (unsigned int i = 0; i < points.size(); i++){
+        rt::vertex v{outsideout * glm::vec4(points[i], 1.0f),
+                     glm::vec4(normals[i], 0),
+                     rt::grey,
+                     uvs[i]
+        };
+        vts.push_back(v);
+    }
+
+    return vts;
+}
+
+std::vector<rt::Light> buildLights(unsigned int pointLightCount){
+    std::vector<rt::Light> lights;
+    // a grid of point lights just below the ceiling (the room spans [-2, 2] on every axis)
+    unsigned int side = (unsigned int) std::ceil(std::sqrt(float(pointLightCount)));
+    for (unsigned int i = 0; i < pointLightCount; i++){
+        float u = (i % side + .5f) / side, v = (i / side + .5f) / side;
+        glm::vec3 position(-1.8f + 3.6f * u, 1.6f + .2f * float(i % 3) / 2.f, -1.8f + 3.6f * v);
+        glm::vec3 tint(.5f + .5f * u, .75f, 1.f - .5f * v);
+        lights.push_back(rt::Light::point(position, tint * (3.0f / float(pointLightCount))));
+    }
+    // a small panel in the ceiling, facing down
+    lights.push_back(rt::Light::area(glm::vec3(-.25f, 1.95f, -.25f), glm::vec3(.5f, 0, 0), glm::vec3(0, 0, .5f),
+                                     glm::vec3(4.f)));
+    return lights;
+}
+
+int runLightsBenchmark(unsigned int width, unsigned int height, unsigned int samplesPerPixel){
+    using namespace std;
+    vector<rt::vertex> vts = buildScene();
+    glm::mat4 view = camera.GetViewMatrix();
+    const unsigned int depth = 2;
+    FrameBuffer<uint32_t> fb(width, height);
+
+    cout << width << "x" << height << ", depth " << depth << ", " << samplesPerPixel << " samples per pixel" << endl;
+    rt::Renderer lightsRenderer;
+    lightsRenderer.setSamplesPerPixel(samplesPerPixel);
+    // the time should stay about the same for any number of lights, each sample traces one shadow ray
+    for (unsigned int count = 1; count <= 4096; count *= 4){
+        lightsRenderer.setLights(buildLights(count));
+        auto start = chrono::high_resolution_clock::now();
+        lightsRenderer.render(vts, glm::mat4(1), view, 70.0f, depth, fb);
+        float time = chrono::duration<float>(chrono::high_resolution_clock::now() - start).count();
+        cout << lightsRenderer.lights().size() << " lights: " << time << " s" << endl;
+    }
+    return 0;
+}
+
+int renderStillToFile(unsigned int width, unsigned int height, const char* path){
+    using namespace std;
+    vector<rt::vertex> vts = buildScene();
+    const unsigned int depth = 3, tileSize = 64;
+
+    TiledImageWriter writer;
+    if (!writer.open(path, width, height)) {
+        cout << "Failed to open " << path << endl;
+        return 1;
+    }
+    auto start = chrono::high_resolution_clock::now();
+    renderer.renderTiled(vts, glm::mat4(1), camera.GetViewMatrix(), 70.0f, depth, width, height, tileSize, writer);
+    bool ok = writer.close();
+    float total = chrono::duration<float>(chrono::high_resolution_clock::now() - start).count();
+
+    // time spent waiting for the disk is the overhead of writing, the rest of the writing overlapped with rendering
+    cout << width << "x" << height << " written to " << path << (ok ? "" : " (FAILED)") << endl;
+    cout << "total: " << total << " s, waiting for the writer: " << writer.stats().blocked_seconds
+         << " s, writing (in the background): " << writer.stats().write_seconds << " s" << endl;
+    return ok ? 0 : 1;
+}
+
+#ifndef _WIN32
+int runDistributedBenchmark(const char* executable, unsigned int width, unsigned int height, unsigned int maxWorkers){
+    using namespace std;
+    vector<rt::vertex> vts = buildScene();
+    glm::mat4 view = camera.GetViewMatrix();
+    const unsigned int depth = 3;
+
+    FrameBuffer<uint32_t> reference(width, height), distributed(width, height);
+    auto start = chrono::high_resolution_clock::now();
+    renderer.render(vts, glm::mat4(1), view, 70.0f, depth, reference);
+    float inProcessTime = chrono::duration<float>(chrono::high_resolution_clock::now() - start).count();
+    cout << width << "x" << height << ", depth " << depth << endl;
+    cout << "in process: " << inProcessTime << " s" << endl;
+
+    // 1, 2, 4, ... workers, and maxWorkers
+    for (unsigned int workers = 1; ; workers = std::min(workers * 2, maxWorkers)){
+        rt::DistributedRenderer coordinator;
+        string endpoint = "unix:/tmp/rt_coordinator_" + to_string(getpid()) + ".sock";
+        if (!coordinator.listen(endpoint) || !coordinator.launchLocalWorkers(executable, workers) ||
+            coordinator.acceptWorkers(workers) != workers){
+            cout << "Failed to start " << workers << " workers" << endl;
+            return 1;
+        }
+        coordinator.setScene(vts);
+
+        distributed.clearBuffer(0);
+        start = chrono::high_resolution_clock::now();
+        coordinator.render(glm::mat4(1), view, 70.0f, depth, distributed);
+        float time = chrono::duration<float>(chrono::high_resolution_clock::now() - start).count();
+
+        unsigned int mismatches = 0;
+        for (unsigned int i = 0; i < width * height; i++)
+            mismatches += reference.buffer[i] != distributed.buffer[i];
+        cout << workers << " workers: " << time << " s, speedup " << inProcessTime / time
+             << ", pixels different from in process: " << mismatches << endl;
+        if (workers == maxWorkers) break;
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,165 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_BVH_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_BVH_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "rt_types.h"
+#include "rt_stats.h"
+
+namespace rt{
+    using namespace glm;
+
+    // axis aligned bounding box
+    struct AABB{
+        vec3 min = vec3(FLT_MAX);
+        vec3 max = vec3(-FLT_MAX);
+
+        void grow(const vec3 &p) { min = glm::min(min, p); max = glm::max(max, p); }
+        void grow(const AABB &b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+        vec3 center() const { return (min + max) * .5f; }
+
+        // slab test, returns false if the ray misses the box or if the box starts after t_max
+        // the distance at which the ray enters the box is returned in t_entry
+        bool intersect(const Ray &ray, const vec3 &inv_dir, float t_max, float &t_entry) const {
+            vec3 t0 = (min - ray.origin) * inv_dir;
+            vec3 t1 = (max - ray.origin) * inv_dir;
+            vec3 t_small = glm::min(t0, t1);
+            vec3 t_big = glm::max(t0, t1);
+            float t_near = std::max(std::max(t_small.x, t_small.y), std::max(t_small.z, 0.0f));
+            float t_far = std::min(std::min(t_big.x, t_big.y), std::min(t_big.z, t_max));
+            t_entry = t_near;
+            return t_near <= t_far;
+        }
+    };
+
+    // a node is a leaf if count > 0, then [first, first + count) is a range of primitives,
+    // otherwise the children are stored at nodes[first] and nodes[first + 1]
+    struct BVHNode{
+        AABB bounds;
+        uint32_t first = 0;
+        uint32_t count = 0;
+
+        bool isLeaf() const { return count > 0; }
+    };
+
+    class BVH{
+    public:
+        std::vector<BVHNode> nodes;
+
+        // builds the hierarchy over a list of primitive bounds, splitting at the median centroid of the longest axis
+        // until there are at most max_leaf_size primitives in a node.
+        // "order" returns the primitive permutation, leaf ranges index into the reordered primitives
+        void build(const std::vector<AABB> &prim_bounds, unsigned int max_leaf_size, std::vector<uint32_t> &order){
+            nodes.clear();
+            order.resize(prim_bounds.size());
+            for (uint32_t i = 0; i < order.size(); i++)
+                order[i] = i;
+            if (prim_bounds.empty())
+                return;
+
+            nodes.reserve(2 * prim_bounds.size() / std::max(max_leaf_size, 1u) + 1);
+            nodes.emplace_back();
+            subdivide(0, 0, (uint32_t) order.size(), prim_bounds, std::max(max_leaf_size, 1u), order);
+        }
+
+        // builds the hierarchy over a triangle soup, the triangles in vts are reordered so that leaves
+        // reference contiguous vertex ranges (leaf.first and leaf.count are given in triangles)
+        void build(std::vector<vertex> &vts, unsigned int max_leaf_size = 4){
+            std::vector<AABB> tri_bounds(vts.size() / 3);
+            for (size_t t = 0; t < tri_bounds.size(); t++){
+                tri_bounds[t].grow(vec3(vts[t * 3].pos));
+                tri_bounds[t].grow(vec3(vts[t * 3 + 1].pos));
+                tri_bounds[t].grow(vec3(vts[t * 3 + 2].pos));
+            }
+            std::vector<uint32_t> order;
+            build(tri_bounds, max_leaf_size, order);
+
+            std::vector<vertex> sorted(order.size() * 3);
+            for (size_t t = 0; t < order.size(); t++)
+                for (int k = 0; k < 3; k++)
+                    sorted[t * 3 + k] = vts[order[t] * 3 + k];
+            vts.swap(sorted);
+        }
+
+        // visits, front to back, every leaf whose bounds are intersected by the ray before t_max.
+        // leaf_test(first, count) is called for each of those leaves and may shrink t_max (it is taken by reference
+        // so that the closest hit found so far culls the remaining nodes)
+        template<class LeafTest>
+        void traverse(const Ray &ray, const float &t_max, LeafTest leaf_test) const {
+            if (nodes.empty())
+                return;
+
+            vec3 inv_dir = 1.0f / ray.direction;
+            float t_entry;
+            if (!nodes[0].bounds.intersect(ray, inv_dir, t_max, t_entry))
+                return;
+
+            uint32_t stack[64];
+            int stack_size = 0;
+            stack[stack_size++] = 0;
+
+            while (stack_size > 0){
+                const BVHNode &node = nodes[stack[--stack_size]];
+                RT_STATS_NODE_VISITED();
+
+                if (node.isLeaf()){
+                    leaf_test(node.first, node.count);
+                    continue;
+                }
+
+                // visit the closest child first, so that t_max shrinks early and more boxes are culled
+                float t_left, t_right;
+                bool hit_left = nodes[node.first].bounds.intersect(ray, inv_dir, t_max, t_left);
+                bool hit_right = nodes[node.first + 1].bounds.intersect(ray, inv_dir, t_max, t_right);
+                if (hit_left && hit_right){
+                    bool left_first = t_left <= t_right;
+                    stack[stack_size++] = left_first ? node.first + 1 : node.first;
+                    stack[stack_size++] = left_first ? node.first : node.first + 1;
+                }
+                else if (hit_left)
+                    stack[stack_size++] = node.first;
+                else if (hit_right)
+                    stack[stack_size++] = node.first + 1;
+            }
+        }
+
+    private:
+        void subdivide(uint32_t node_id, uint32_t first, uint32_t count,
+                       const std::vector<AABB> &prim_bounds, unsigned int max_leaf_size,
+                       std::vector<uint32_t> &order){
+            AABB bounds, centroid_bounds;
+            for (uint32_t i = first; i < first + count; i++){
+                bounds.grow(prim_bounds[order[i]]);
+                centroid_bounds.grow(prim_bounds[order[i]].center());
+            }
+            nodes[node_id].bounds = bounds;
+
+            if (count <= max_leaf_size){
+                nodes[node_id].first = first;
+                nodes[node_id].count = count;
+                return;
+            }
+
+            vec3 extent = centroid_bounds.max - centroid_bounds.min;
+            int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+            uint32_t half = count / 2;
+            std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+                             [&](uint32_t a, uint32_t b){
+                                 return prim_bounds[a].center()[axis] < prim_bounds[b].center()[axis];
+                             });
+
+            uint32_t left = (uint32_t) nodes.size();
+            nodes.emplace_back();
+            nodes.emplace_back();
+            nodes[node_id].first = left;
+            nodes[node_id].count = 0;
+            subdivide(left, first, half, prim_bounds, max_leaf_size, order);
+            subdivide(left + 1, first + half, count - half, prim_bounds, max_leaf_size, order);
+        }
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_BVH_H
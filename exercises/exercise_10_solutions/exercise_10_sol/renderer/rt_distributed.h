@@ -0,0 +1,467 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_DISTRIBUTED_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_DISTRIBUTED_H
+
+// Distributed tile rendering for the ray tracer (POSIX only).
+//
+// A coordinator (DistributedRenderer) listens on an endpoint, worker processes (runWorker) connect to it.
+// The coordinator sends the scene (and the light list) once and the camera once per frame, then splits the image into tiles and hands them
+// out dynamically: every worker has a couple of tiles in flight and gets a new one as soon as it returns a result, so
+// fast workers (or cheap parts of the image) are not held back by slow ones.
+//
+// Endpoints are either "unix:<path>" (Unix domain socket, same machine) or "tcp:<ipv4 address>:<port>".
+// Workers running on the same machine can be started with launchLocalWorkers, which executes this same program with
+// the arguments "--rt-worker <endpoint>" (see main.cpp).
+
+#ifndef _WIN32
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "rt_types.h"
+#include "rt_renderer.h"
+#include "frame_buffer.h"
+
+namespace rt{
+    namespace net{
+
+        enum MessageType : uint32_t { MSG_SCENE = 1, MSG_CAMERA, MSG_TILE, MSG_RESULT, MSG_QUIT, MSG_LIGHTS };
+
+        struct MessageHeader{
+            uint32_t type;
+            uint32_t reserved;
+            uint64_t size; // payload size in bytes
+        };
+
+        struct CameraMessage{
+            glm::mat4 m, v;
+            float fov_degrees;
+            uint32_t depth, W, H;
+            uint32_t samples_per_pixel;
+        };
+
+        // the largest scene or light list a worker accepts
+        const uint64_t max_payload_size = uint64_t(1) << 32;
+
+        // whether a message sent to a worker may have this payload size, checked before anything is allocated for it
+        inline bool validWorkerPayload(const MessageHeader &header){
+            switch (header.type){
+                case MSG_SCENE: return header.size <= max_payload_size && header.size % sizeof(vertex) == 0;
+                case MSG_LIGHTS: return header.size <= max_payload_size && header.size % sizeof(Light) == 0;
+                case MSG_CAMERA: return header.size == sizeof(CameraMessage);
+                case MSG_TILE: return header.size == sizeof(Tile);
+                default: return false;
+            }
+        }
+
+        inline bool sendAll(int fd, const void *data, size_t size){
+            const char *bytes = (const char *) data;
+            while (size > 0){
+#ifdef MSG_NOSIGNAL
+                ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+#else
+                ssize_t sent = send(fd, bytes, size, 0);
+#endif
+                if (sent < 0 && errno == EINTR) continue;
+                if (sent <= 0) return false;
+                bytes += sent;
+                size -= (size_t) sent;
+            }
+            return true;
+        }
+
+        inline bool recvAll(int fd, void *data, size_t size){
+            char *bytes = (char *) data;
+            while (size > 0){
+                ssize_t received = recv(fd, bytes, size, 0);
+                if (received < 0 && errno == EINTR) continue;
+                if (received <= 0) return false;
+                bytes += received;
+                size -= (size_t) received;
+            }
+            return true;
+        }
+
+        inline bool sendMessage(int fd, MessageType type, const void *payload, size_t size,
+                                const void *payload2 = nullptr, size_t size2 = 0){
+            MessageHeader header{type, 0, size + size2};
+            return sendAll(fd, &header, sizeof(header)) &&
+                   (size == 0 || sendAll(fd, payload, size)) &&
+                   (size2 == 0 || sendAll(fd, payload2, size2));
+        }
+
+        // fills a sockaddr for the endpoint, returns the socket family or -1 if the endpoint is not valid
+        inline int parseEndpoint(const std::string &endpoint, sockaddr_storage &address, socklen_t &length){
+            memset(&address, 0, sizeof(address));
+            if (endpoint.compare(0, 5, "unix:") == 0){
+                sockaddr_un *addr = (sockaddr_un *) &address;
+                std::string path = endpoint.substr(5);
+                if (path.empty() || path.size() >= sizeof(addr->sun_path)) return -1;
+                addr->sun_family = AF_UNIX;
+                strncpy(addr->sun_path, path.c_str(), sizeof(addr->sun_path) - 1);
+                length = sizeof(sockaddr_un);
+                return AF_UNIX;
+            }
+            if (endpoint.compare(0, 4, "tcp:") == 0){
+                size_t colon = endpoint.rfind(':');
+                if (colon <= 4) return -1;
+                sockaddr_in *addr = (sockaddr_in *) &address;
+                addr->sin_family = AF_INET;
+                addr->sin_port = htons((uint16_t) atoi(endpoint.c_str() + colon + 1));
+                if (inet_pton(AF_INET, endpoint.substr(4, colon - 4).c_str(), &addr->sin_addr) != 1) return -1;
+                length = sizeof(sockaddr_in);
+                return AF_INET;
+            }
+            return -1;
+        }
+
+        inline void setNoDelay(int fd, int family){
+            if (family != AF_INET) return;
+            int flag = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+        }
+
+        // writing to a peer that crashed should fail with an error instead of killing the process with SIGPIPE.
+        // sendAll passes MSG_NOSIGNAL for that, where it does not exist (macOS) the socket is set up not to raise it
+        inline void setNoSigPipe(int fd){
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+            int flag = 1;
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &flag, sizeof(flag));
+#else
+            (void) fd;
+#endif
+        }
+
+        // connects to the coordinator, retrying for a few seconds in case it is not listening yet
+        inline int connectTo(const std::string &endpoint){
+            sockaddr_storage address;
+            socklen_t length;
+            int family = parseEndpoint(endpoint, address, length);
+            if (family < 0) return -1;
+
+            for (int attempt = 0; attempt < 50; attempt++){
+                int fd = socket(family, SOCK_STREAM, 0);
+                if (fd < 0) return -1;
+                if (connect(fd, (sockaddr *) &address, length) == 0){
+                    setNoDelay(fd, family);
+                    setNoSigPipe(fd);
+                    return fd;
+                }
+                close(fd);
+                usleep(100 * 1000);
+            }
+            return -1;
+        }
+    }
+
+
+    // worker side: connects to the coordinator and renders the tiles it receives until it is told to quit
+    // returns the process exit code
+    inline int runWorker(const std::string &endpoint){
+        using namespace net;
+        int fd = connectTo(endpoint);
+        if (fd < 0)
+            return 1;
+
+        Renderer renderer;
+        std::vector<vertex> vts;
+        CameraMessage camera_message{};
+        std::vector<uint32_t> pixels;
+        std::vector<char> payload;
+
+        MessageHeader header;
+        while (recvAll(fd, &header, sizeof(header))){
+            if (header.type == MSG_QUIT || !validWorkerPayload(header))
+                break;
+
+            payload.resize(header.size);
+            if (header.size > 0 && !recvAll(fd, payload.data(), header.size))
+                break;
+
+            if (header.type == MSG_SCENE){
+                vts.resize(header.size / sizeof(vertex));
+                memcpy(vts.data(), payload.data(), vts.size() * sizeof(vertex));
+            }
+            else if (header.type == MSG_LIGHTS){
+                std::vector<Light> lights(header.size / sizeof(Light));
+                memcpy(lights.data(), payload.data(), lights.size() * sizeof(Light));
+                renderer.setLights(lights);
+            }
+            else if (header.type == MSG_CAMERA){
+                memcpy(&camera_message, payload.data(), sizeof(CameraMessage));
+                renderer.setSamplesPerPixel(camera_message.samples_per_pixel);
+            }
+            else if (header.type == MSG_TILE){
+                Tile tile;
+                memcpy(&tile, payload.data(), sizeof(Tile));
+                // the pixels are only allocated for a tile of the frame of the last camera
+                if (tile.x0 >= tile.x1 || tile.y0 >= tile.y1 || tile.x1 > camera_message.W || tile.y1 > camera_message.H)
+                    break;
+                CameraRays camera(camera_message.m, camera_message.v, camera_message.fov_degrees,
+                                  camera_message.W, camera_message.H);
+                pixels.resize(tile.width() * tile.height());
+                renderer.renderTile(vts, camera, camera_message.depth, tile, pixels.data());
+                if (!sendMessage(fd, MSG_RESULT, &tile, sizeof(tile), pixels.data(), pixels.size() * sizeof(uint32_t)))
+                    break;
+            }
+        }
+        close(fd);
+        return 0;
+    }
+
+
+    // coordinator side
+    class DistributedRenderer{
+    public:
+        // edge length of the square tiles handed out to the workers
+        unsigned int tile_size = 32;
+        // tiles sent to a worker before it has returned any, hides the latency of the round trip
+        unsigned int tiles_in_flight = 2;
+        // light samples per pixel, only used if a light list was given (see Renderer::setSamplesPerPixel)
+        unsigned int samples_per_pixel = 1;
+
+        DistributedRenderer() = default;
+        DistributedRenderer(DistributedRenderer const&) = delete;
+        void operator=(DistributedRenderer const&) = delete;
+        ~DistributedRenderer() { shutdown(); }
+
+        // starts listening for workers on endpoint ("unix:<path>" or "tcp:<address>:<port>")
+        bool listen(const std::string &endpoint){
+            sockaddr_storage address;
+            socklen_t length;
+            family = net::parseEndpoint(endpoint, address, length);
+            if (family < 0) return false;
+
+            listen_fd = socket(family, SOCK_STREAM, 0);
+            if (listen_fd < 0) return false;
+            if (family == AF_UNIX){
+                unix_path = ((sockaddr_un *) &address)->sun_path;
+                unlink(unix_path.c_str());
+            }
+            else {
+                int reuse = 1;
+                setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            }
+            if (bind(listen_fd, (sockaddr *) &address, length) != 0 || ::listen(listen_fd, 64) != 0){
+                close(listen_fd);
+                listen_fd = -1;
+                return false;
+            }
+            this->endpoint = endpoint;
+            return true;
+        }
+
+        // starts count worker processes on this machine running this program. executable (argv[0]) is only used where
+        // /proc/self/exe does not exist, made absolute so that it does not depend on the working directory
+        bool launchLocalWorkers(const std::string &executable, unsigned int count){
+            std::string path = "/proc/self/exe";
+            if (access(path.c_str(), X_OK) != 0){
+                char resolved[PATH_MAX];
+                if (!realpath(executable.c_str(), resolved)) return false;
+                path = resolved;
+            }
+            for (unsigned int i = 0; i < count; i++){
+                pid_t pid = fork();
+                if (pid < 0) return false;
+                if (pid == 0){
+                    execl(path.c_str(), executable.c_str(), "--rt-worker", endpoint.c_str(), (char *) nullptr);
+                    _exit(127);
+                }
+                children.push_back(pid);
+            }
+            return true;
+        }
+
+        // waits until count workers have connected or timeout_ms has passed, returns the number of connected workers
+        unsigned int acceptWorkers(unsigned int count, int timeout_ms = 5000){
+            while (workers.size() < count){
+                pollfd pfd{listen_fd, POLLIN, 0};
+                if (poll(&pfd, 1, timeout_ms) <= 0) break;
+                int fd = accept(listen_fd, nullptr, nullptr);
+                if (fd < 0) break;
+                net::setNoDelay(fd, family);
+                net::setNoSigPipe(fd);
+                Worker worker;
+                worker.fd = fd;
+                workers.push_back(worker);
+            }
+            return (unsigned int) workers.size();
+        }
+
+        unsigned int workerCount() const { return (unsigned int) workers.size(); }
+
+        // sends the geometry to all workers, it is kept by the workers for the following frames
+        void setScene(const std::vector<vertex> &vts){
+            for (Worker &worker : workers)
+                if (worker.fd >= 0 && !net::sendMessage(worker.fd, net::MSG_SCENE, vts.data(), vts.size() * sizeof(vertex)))
+                    disconnect(worker);
+            scene = &vts;
+        }
+
+        // sends the light list to all workers (see Renderer::setLights), it is also kept for the following frames
+        void setLights(const std::vector<Light> &lights){
+            for (Worker &worker : workers)
+                if (worker.fd >= 0 && !net::sendMessage(worker.fd, net::MSG_LIGHTS, lights.data(), lights.size() * sizeof(Light)))
+                    disconnect(worker);
+            light_list = lights;
+        }
+
+        // renders one frame, tiles that cannot be rendered by any worker (e.g. all of them disconnected)
+        // are rendered in this process with the scene given to setScene, which must still be alive
+        void render(const glm::mat4 &m,
+                    const glm::mat4 &v,
+                    const float fov_degrees,
+                    unsigned int depth,
+                    FrameBuffer <uint32_t> &fb){
+            net::CameraMessage camera_message{m, v, fov_degrees, depth, fb.W, fb.H, samples_per_pixel};
+
+            std::deque<Tile> queue;
+            for (unsigned int y = 0; y < fb.H; y += tile_size)
+                for (unsigned int x = 0; x < fb.W; x += tile_size)
+                    queue.push_back(Tile{x, y, std::min(x + tile_size, fb.W), std::min(y + tile_size, fb.H)});
+
+            for (Worker &worker : workers)
+                if (worker.fd >= 0 && !net::sendMessage(worker.fd, net::MSG_CAMERA, &camera_message, sizeof(camera_message)))
+                    disconnect(worker);
+
+            std::vector<pollfd> pfds;
+            std::vector<uint32_t> pixels;
+            while (true){
+                // keep every worker busy, this also hands out the tiles of workers that disconnected
+                for (Worker &worker : workers)
+                    while (worker.fd >= 0 && worker.in_flight.size() < std::max(tiles_in_flight, 1u) && !queue.empty())
+                        sendNextTile(worker, queue);
+
+                pfds.clear();
+                for (Worker &worker : workers)
+                    if (worker.fd >= 0 && !worker.in_flight.empty())
+                        pfds.push_back(pollfd{worker.fd, POLLIN, 0});
+                if (pfds.empty())
+                    break;
+                if (poll(pfds.data(), pfds.size(), -1) < 0){
+                    if (errno == EINTR) continue;
+                    break;
+                }
+
+                for (const pollfd &pfd : pfds){
+                    if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                    auto found = std::find_if(workers.begin(), workers.end(), [&](const Worker &w){ return w.fd == pfd.fd; });
+                    if (found == workers.end()) continue;
+                    Worker &worker = *found;
+                    Tile tile;
+                    if (!receiveResult(worker, tile, pixels)){
+                        // give the tiles of a dead worker to the others
+                        queue.insert(queue.end(), worker.in_flight.begin(), worker.in_flight.end());
+                        disconnect(worker);
+                        continue;
+                    }
+                    for (unsigned int r = 0; r < tile.height(); r++)
+                        memcpy(fb.buffer + tile.x0 + (tile.y0 + r) * fb.W, pixels.data() + r * tile.width(),
+                               tile.width() * sizeof(uint32_t));
+                    worker.in_flight.pop_front();
+                }
+            }
+
+            if (!queue.empty() && scene){
+                CameraRays camera(m, v, fov_degrees, fb.W, fb.H);
+                Renderer local;
+                local.setLights(light_list);
+                local.setSamplesPerPixel(samples_per_pixel);
+                for (const Tile &tile : queue){
+                    pixels.resize(tile.width() * tile.height());
+                    local.renderTile(*scene, camera, depth, tile, pixels.data());
+                    for (unsigned int r = 0; r < tile.height(); r++)
+                        memcpy(fb.buffer + tile.x0 + (tile.y0 + r) * fb.W, pixels.data() + r * tile.width(),
+                               tile.width() * sizeof(uint32_t));
+                }
+            }
+        }
+
+        // tells the workers to quit and waits for the local ones to exit
+        void shutdown(){
+            for (Worker &worker : workers){
+                if (worker.fd < 0) continue;
+                net::sendMessage(worker.fd, net::MSG_QUIT, nullptr, 0);
+                disconnect(worker);
+            }
+            workers.clear();
+            for (pid_t pid : children)
+                waitpid(pid, nullptr, 0);
+            children.clear();
+            if (listen_fd >= 0)
+                close(listen_fd);
+            listen_fd = -1;
+            if (!unix_path.empty())
+                unlink(unix_path.c_str());
+            unix_path.clear();
+        }
+
+    private:
+        struct Worker{
+            int fd = -1;
+            std::deque<Tile> in_flight; // tiles sent and not returned yet, in the order they were sent
+        };
+
+        int listen_fd = -1;
+        int family = -1;
+        std::string endpoint;
+        std::string unix_path;
+        std::vector<Worker> workers;
+        std::vector<pid_t> children;
+        const std::vector<vertex> *scene = nullptr;
+        std::vector<Light> light_list;
+
+        void sendNextTile(Worker &worker, std::deque<Tile> &queue){
+            if (queue.empty()) return;
+            Tile tile = queue.front();
+            queue.pop_front();
+            worker.in_flight.push_back(tile);
+            if (!net::sendMessage(worker.fd, net::MSG_TILE, &tile, sizeof(tile))){
+                queue.insert(queue.end(), worker.in_flight.begin(), worker.in_flight.end());
+                disconnect(worker);
+            }
+        }
+
+        // reads the next result of the worker, which must be the oldest tile it was sent (so it lies inside the frame
+        // buffer). Anything else is treated as a broken worker: nothing is allocated or written for it
+        bool receiveResult(Worker &worker, Tile &tile, std::vector<uint32_t> &pixels){
+            net::MessageHeader header;
+            if (worker.in_flight.empty() || !net::recvAll(worker.fd, &header, sizeof(header)) ||
+                header.type != net::MSG_RESULT || header.size < sizeof(Tile) || !net::recvAll(worker.fd, &tile, sizeof(Tile)))
+                return false;
+            const Tile &expected = worker.in_flight.front();
+            if (tile.x0 != expected.x0 || tile.y0 != expected.y0 || tile.x1 != expected.x1 || tile.y1 != expected.y1)
+                return false;
+            uint64_t pixel_count = uint64_t(tile.width()) * tile.height();
+            if (header.size != sizeof(Tile) + pixel_count * sizeof(uint32_t))
+                return false;
+            pixels.resize(pixel_count);
+            return net::recvAll(worker.fd, pixels.data(), pixels.size() * sizeof(uint32_t));
+        }
+
+        void disconnect(Worker &worker){
+            if (worker.fd >= 0)
+                close(worker.fd);
+            worker.fd = -1;
+            worker.in_flight.clear();
+        }
+    };
+}
+
+#endif //_WIN32
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_DISTRIBUTED_H
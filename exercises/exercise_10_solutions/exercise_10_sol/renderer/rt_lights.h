@@ -0,0 +1,184 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_LIGHTS_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_LIGHTS_H
+
+// Many lights for the ray tracer.
+//
+// Instead of shading every light (one shadow ray per light, so the cost grows with the number of lights), each shading
+// point picks ONE light at random and divides its contribution by the probability of picking it. On average this gives
+// the same result, and the cost per shading point does not depend on how many lights there are. The remaining noise is
+// reduced by taking several samples per pixel.
+//
+// The light is picked by walking down a BVH built over the lights (LightTree), at each node we go left or right with a
+// probability proportional to an estimate of how much light each child sends to the shading point: the power of the
+// lights in the child divided by the squared distance to its bounds, and zero if the bounds are behind the surface.
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include "rt_types.h"
+#include "rt_bvh.h"
+
+namespace rt{
+    using namespace glm;
+
+    // a point light emits "emission" (rgb intensity) in all directions from position.
+    // an area light is the parallelogram position + s * edge_u + t * edge_v (s and t in [0, 1]) emitting "emission"
+    // (rgb radiance) on the side its normal, cross(edge_u, edge_v), points to
+    struct Light{
+        enum Type : uint32_t { POINT = 0, AREA };
+
+        Type type = POINT;
+        vec3 position = vec3(0);
+        vec3 edge_u = vec3(0), edge_v = vec3(0);
+        vec3 emission = vec3(1);
+
+        static Light point(const vec3 &position, const vec3 &intensity){
+            Light light;
+            light.position = position;
+            light.emission = intensity;
+            return light;
+        }
+        static Light area(const vec3 &corner, const vec3 &edge_u, const vec3 &edge_v, const vec3 &radiance){
+            Light light;
+            light.type = AREA;
+            light.position = corner;
+            light.edge_u = edge_u;
+            light.edge_v = edge_v;
+            light.emission = radiance;
+            return light;
+        }
+
+        float area() const { return type == AREA ? length(cross(edge_u, edge_v)) : 0.0f; }
+        vec3 normal() const { return normalize(cross(edge_u, edge_v)); }
+
+        AABB bounds() const {
+            AABB b;
+            b.grow(position);
+            if (type == AREA){
+                b.grow(position + edge_u);
+                b.grow(position + edge_v);
+                b.grow(position + edge_u + edge_v);
+            }
+            return b;
+        }
+
+        // total emitted power (of the luminance), used to decide how often the light is picked
+        float power() const {
+            float luminance = dot(emission, vec3(.2126f, .7152f, .0722f));
+            return type == AREA ? luminance * area() * pi<float>() : luminance * 4.0f * pi<float>();
+        }
+    };
+
+    // small hash and random number generator (PCG), seeded from the pixel and sample index so that every pixel gets
+    // the same random numbers no matter in which order, tile or process it is rendered
+    inline uint32_t hashSeed(uint32_t value){
+        uint32_t state = value * 747796405u + 2891336453u;
+        uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+    inline uint32_t hashSeed(uint32_t seed, uint32_t value){ return hashSeed(seed ^ hashSeed(value)); }
+
+    struct Random{
+        uint32_t state;
+
+        explicit Random(uint32_t seed): state(seed){}
+
+        // uniform in [0, 1)
+        float next(){
+            state = hashSeed(state);
+            return (state >> 8) * (1.0f / 16777216.0f);
+        }
+    };
+
+    class LightTree{
+    public:
+        void build(const std::vector<Light> &lights){
+            std::vector<AABB> light_bounds(lights.size());
+            for (size_t i = 0; i < lights.size(); i++)
+                light_bounds[i] = lights[i].bounds();
+
+            // one light per leaf, so a walk down the tree ends at a single light
+            std::vector<uint32_t> order;
+            bvh.build(light_bounds, 1, order);
+            light_list.resize(lights.size());
+            for (size_t i = 0; i < order.size(); i++)
+                light_list[i] = lights[order[i]];
+
+            // children are always stored after their parent, so a backwards pass sums the power bottom up
+            node_power.assign(bvh.nodes.size(), 0.0f);
+            for (size_t n = bvh.nodes.size(); n-- > 0;){
+                const BVHNode &node = bvh.nodes[n];
+                if (node.isLeaf())
+                    for (uint32_t i = node.first; i < node.first + node.count; i++)
+                        node_power[n] += light_list[i].power();
+                else
+                    node_power[n] = node_power[node.first] + node_power[node.first + 1];
+            }
+        }
+
+        bool empty() const { return light_list.empty(); }
+        const std::vector<Light> &lights() const { return light_list; }
+
+        // picks a light for the shading point p with normal n using the random number u in [0, 1).
+        // returns false if no light can reach p, otherwise the light index and the probability it had of being picked
+        bool pick(const vec3 &p, const vec3 &n, float u, uint32_t &light, float &probability) const {
+            if (light_list.empty() || importance(0, p, n) <= 0)
+                return false;
+
+            probability = 1.0f;
+            uint32_t node_id = 0;
+            while (!bvh.nodes[node_id].isLeaf()){
+                uint32_t left = bvh.nodes[node_id].first;
+                float w_left = importance(left, p, n);
+                float w_right = importance(left + 1, p, n);
+                if (w_left + w_right <= 0)
+                    return false;
+
+                // choose a child and rescale u to [0, 1), so that the same number can be used at the next level
+                float p_left = w_left / (w_left + w_right);
+                if (u < p_left){
+                    node_id = left;
+                    u = u / p_left;
+                    probability *= p_left;
+                }
+                else{
+                    node_id = left + 1;
+                    u = (u - p_left) / (1.0f - p_left);
+                    probability *= 1.0f - p_left;
+                }
+                u = std::min(u, 0.99999994f);
+            }
+            light = bvh.nodes[node_id].first;
+            return probability > 0;
+        }
+
+    private:
+        BVH bvh;
+        std::vector<Light> light_list; // in the order of the BVH leaves
+        std::vector<float> node_power;
+
+        // estimate of the light a node sends to p, it only has to be zero when no light in the node can reach p
+        float importance(uint32_t node_id, const vec3 &p, const vec3 &n) const {
+            const AABB &b = bvh.nodes[node_id].bounds;
+
+            // the lights can only illuminate the surface if some part of the bounds is in front of it
+            bool in_front = false;
+            for (int k = 0; k < 8 && !in_front; k++){
+                vec3 corner(k & 1 ? b.max.x : b.min.x, k & 2 ? b.max.y : b.min.y, k & 4 ? b.max.z : b.min.z);
+                in_front = dot(corner - p, n) > 0;
+            }
+            if (!in_front)
+                return 0;
+
+            // distance to the center of the bounds, but never closer than the bounds radius (we could be inside)
+            vec3 extent = b.max - b.min;
+            vec3 to_center = b.center() - p;
+            float dist2 = std::max(std::max(dot(to_center, to_center), .25f * dot(extent, extent)), 1e-4f);
+            return node_power[node_id] / dist2;
+        }
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_LIGHTS_H
@@ -6,22 +6,87 @@
 #define ITU_GRAPHICS_PROGRAMMING_RT_RENDERER_H
 
 #include <vector>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include "rt_types.h"
 #include "frame_buffer.h"
+#include "rt_stats.h"
+#include "rt_lights.h"
+#include "tiled_image_writer.h"
 
 namespace rt{
     using namespace Colors;
     using namespace glm;
 
+    class StreamedModel;
+
+    // one light picked for a shading point: the shadow ray towards it, and what it adds to the color if it is visible
+    // (already divided by the probability of picking that light and point)
+    struct LightSample{
+        Ray shadow_ray = Ray(vec3(0), vec3(0));
+        float distance = 0;
+        color contribution = color(0);
+    };
+
+    // generates the primary rays of a pinhole camera, in the space of the model
+    struct CameraRays{
+        vec4 lower_left_corner;
+        vec4 cam_pos;
+        vec2 pixel_size;
+        mat4 view_to_model;
+
+        CameraRays(const glm::mat4 &m,
+                   const glm::mat4 &v,
+                   const float fov_degrees,
+                   unsigned int W, unsigned int H){
+            float aspect_ratio = H / W;
+            // we use the fov and the tangent function to compute where is the bottom of the projection plane,
+            // we assume that the projection place is 1 unit in front of the camera (z == -1)
+            float bottom = - tan(abs(radians(fov_degrees)) * 0.5f);
+
+            // find the transformation that move points from camera space to model space
+            view_to_model = inverse(v * m);
+            // the bottom left corner of the image plane/camera sensor
+            lower_left_corner = vec4(bottom * aspect_ratio, bottom, -1, 1);
+            // we transform the camera position (also the convergence point of light rays) from camera coordinates to MODEL coordinates
+            // notice that we implicitly assume that the camera position is at 0,0,0 in its one coordinate space
+            cam_pos = view_to_model * vec4(0,0,0,1);
+
+            // the distance from the center of one pixel to the next along the horizontal and vertical axes of the screen
+            // notice that * and / are applied component wise
+            pixel_size = abs(vec2(lower_left_corner)) * 2.0f / vec2(H, W);
+        }
+
+        // ray through the pixel at column c and row r
+        Ray rayAt(unsigned int c, unsigned int r) const {
+            vec4 pixel_pos = lower_left_corner + vec4 (vec2(c, r) * pixel_size,0, 0);
+            pixel_pos = view_to_model * pixel_pos;  // transform from camera coord space to model coord space
+            return Ray(cam_pos, normalize(pixel_pos - cam_pos));
+        }
+    };
+
     class Renderer{
         // limits the number of reflections, 1 == no reflection
         const unsigned int max_recursion = 5;
         // mixture parameter for combining local illumination and reflected color
         float p_rg = 0.4f;
+        // phong reflection model parameters
+        float ambient = 0.1f, diffuse = 0.5f, specular = 0.5f, shininess = 10;
+        vec3 light_pos = vec3(0,1.9f,0); // light position in model space
+        // when lights are given (setLights) they replace the light above, each shading point then samples one of them
+        LightTree light_tree;
+        unsigned int samples_per_pixel = 1;
+        uint32_t sample_seed = 0; // seed of the pixel sample being traced, see renderTile
 
     public:
+        // the light list (model space) used instead of the single light at light_pos, an empty list restores that light
+        void setLights(const std::vector<Light> &lights) { light_tree.build(lights); }
+        const std::vector<Light> &lights() const { return light_tree.lights(); }
+        // number of light samples per pixel, only used with a light list (the single light has no noise)
+        void setSamplesPerPixel(unsigned int spp) { samples_per_pixel = spp > 0 ? spp : 1; }
+        unsigned int samplesPerPixel() const { return light_tree.empty() ? 1 : samples_per_pixel; }
+
         void render(const std::vector<vertex> &vts,
                     const glm::mat4 &m,
                     const glm::mat4 &v,
@@ -29,23 +94,17 @@ namespace rt{
                     unsigned int depth,
                     FrameBuffer <uint32_t> &fb) {
 
-            float aspect_ratio = fb.H / fb.W;
-            // we use the fov and the tangent function to compute where is the bottom of the projection plane,
-            // we assume that the projection place is 1 unit in front of the camera (z == -1)
-            float bottom = - tan(abs(radians(fov_degrees)) * 0.5f);
-
-            // find the transformation that move points from camera space to model space
-            mat4 view_to_model = inverse(v * m);
-            // the bottom left corner of the image plane/camera sensor
-            vec4 lower_left_corner = vec4(bottom * aspect_ratio, bottom, -1, 1);
-            // we transform the camera position (also the convergence point of light rays) from camera coordinates to MODEL coordinates
-            // notice that we implicitly assume that the camera position is at 0,0,0 in its one coordinate space
-            vec4 cam_pos = view_to_model * vec4(0,0,0,1);
-
-            // the distance from the center of one pixel to the next along the horizontal and vertical axes of the screen
-            // notice that * and / are applied component wise
-            vec2 pixel_size = abs(vec2(lower_left_corner)) * 2.0f / vec2(fb.H, fb.W);
+            CameraRays camera(m, v, fov_degrees, fb.W, fb.H);
+            renderTile(vts, camera, depth, Tile{0, 0, fb.W, fb.H}, fb.buffer);
+        }
 
+        // renders the pixels of one tile of the image, the tile is stored row by row in "pixels"
+        // (tile.width() * tile.height() values), so that tiles can be rendered independently of each other
+        void renderTile(const std::vector<vertex> &vts,
+                        const CameraRays &camera,
+                        unsigned int depth,
+                        const Tile &tile,
+                        uint32_t *pixels) {
 
             // TODO ex 10.1 iterate through all pixels in the buffer (width: [0, fb.W), height:[0, fb.H])
             //  for each pixel,
@@ -56,18 +115,56 @@ namespace rt{
             //  all intersection computations should happen in the same space, no matter what that space is)
             //  - create a ray with the camera origin, and the vector from the camera origin to the pixel you have just found
             //  - call the TraceRay method using that ray, and store the resulting color in the frame buffer (fb)
-            for (int c = 0; c < fb.W; c++){
-                for(int r = 0; r < fb.H; r++){
-                    vec4 pixel_pos = lower_left_corner + vec4 (vec2(c, r) * pixel_size,0, 0);
-                    pixel_pos = view_to_model * pixel_pos;  // transform from camera coord space to model coord space
-                    Ray ray(cam_pos, normalize(pixel_pos - cam_pos));
-                    color col = traceRay(ray, depth, vts);  // trace te ray / compute the color
-                    fb.paintAt(c, r, toRGBA32(col));        // set the color on the frame buffer
+            for(unsigned int r = tile.y0; r < tile.y1; r++){
+                for (unsigned int c = tile.x0; c < tile.x1; c++){
+                    RT_STATS_BEGIN_PIXEL();
+                    Ray ray = camera.rayAt(c, r);
+                    // with many lights, every sample picks different lights, the average reduces the noise
+                    unsigned int spp = samplesPerPixel();
+                    color col(0);
+                    for (unsigned int s = 0; s < spp; s++){
+                        RT_STATS_BEGIN_RAY(stats::PRIMARY);
+                        sample_seed = pixelSeed(c, r, s);
+                        col += traceRay(ray, depth, vts);  // trace te ray / compute the color
+                        RT_STATS_END_SAMPLE();
+                    }
+                    col /= float(spp);
+                    // set the color on the tile
+                    pixels[(c - tile.x0) + (r - tile.y0) * tile.width()] = toRGBA32(col);
+                    RT_STATS_END_PIXEL(c, r);
                 }
             }
+        }
 
+        // renders a W x H image tile by tile and hands every finished tile to the writer, which stores it in the
+        // background while the next tile is rendered. Only the tiles in flight are in memory, never the whole image
+        void renderTiled(const std::vector<vertex> &vts,
+                         const glm::mat4 &m,
+                         const glm::mat4 &v,
+                         const float fov_degrees,
+                         unsigned int depth,
+                         unsigned int W, unsigned int H,
+                         unsigned int tile_size,
+                         TiledImageWriter &writer) {
+            CameraRays camera(m, v, fov_degrees, W, H);
+            for (unsigned int y = 0; y < H; y += tile_size){
+                for (unsigned int x = 0; x < W; x += tile_size){
+                    Tile tile{x, y, std::min(x + tile_size, W), std::min(y + tile_size, H)};
+                    std::vector<uint32_t> pixels = writer.acquireBuffer(tile.width(), tile.height());
+                    renderTile(vts, camera, depth, tile, pixels.data());
+                    writer.submit(tile.x0, tile.y0, tile.width(), tile.height(), std::move(pixels));
+                }
+            }
         }
 
+        // same image as the method above, but the geometry is paged in from disk (see rt_streaming.h).
+        // rays are traced in breadth-first waves so that each resident cluster is tested against a whole batch of rays
+        void render(StreamedModel &model,
+                    const glm::mat4 &m,
+                    const glm::mat4 &v,
+                    const float fov_degrees,
+                    unsigned int depth,
+                    FrameBuffer <uint32_t> &fb);
 
         color traceRay(const Ray & ray,
                        unsigned int depth,
@@ -78,6 +175,7 @@ namespace rt{
             color col = black; // used to output a color
             Hit hitInfo; // used to store the hit information
             if (!rayModelIntersection(ray, vts, hitInfo)) return col; // no hit, return black
+            RT_STATS_SURFACE_HIT();
 
 
             // TODO ex 10.2 replace the current i_normal and i_col computation with their interpolated versions
@@ -87,22 +185,26 @@ namespace rt{
 
             vec3 i_pos = ray.origin + ray.direction * hitInfo.dist;
 
-            // TODO ex 10.3 implement the phong reflection model for the point light below
-            float ambient = 0.1f, diffuse = 0.5f, specular = 0.5f, shininess = 10;
-            vec3 light_pos(0,1.9f,0); // light position in model space
-            vec3 light_dir = normalize(light_pos - i_pos);
-
-            col = ambient * i_col;
-
+            // TODO ex 10.3 implement the phong reflection model for the point light below (see localIllumination)
             // TODO ex 10.4 check if the light source is visible from i_pos, we only use the diffuse and specular components if that is the case
-            Ray shadow_ray(i_pos + i_normal * .001f, light_dir); // i_normal * .001f is handling numerical precision issues, it prevents self-intersection
-            float light_dist = length(light_pos - i_pos);
-            Hit shadow_hit;
-            // check if there is geometry in the direction of the light, and if the closest geometry is closer than the light source
-            if (rayModelIntersection(shadow_ray, vts, shadow_hit) && light_dist < shadow_hit.dist) {
-                // the light is visible from i_pos (there is no occlusion), so we compute direct lighting
-                col += diffuse * i_col * max(dot(light_dir, i_normal), .0f) +
-                       specular * pow(max(dot(light_dir, i_normal), .0f), shininess);
+            if (light_tree.empty()) {
+                RT_STATS_BEGIN_RAY(stats::SHADOW);
+                Ray shadow_ray = shadowRay(i_pos, i_normal);
+                Hit shadow_hit;
+                // check if there is geometry in the direction of the light, and if the closest geometry is closer than the light source
+                bool light_visible = rayModelIntersection(shadow_ray, vts, shadow_hit) && lightDistance(i_pos) < shadow_hit.dist;
+                col = localIllumination(i_pos, i_normal, i_col, light_visible);
+            }
+            else {
+                // a single shadow ray, towards one light picked from the list
+                col = ambient * i_col;
+                LightSample sample;
+                if (sampleLight(i_pos, i_normal, i_col, hashSeed(sample_seed, depth), sample)) {
+                    RT_STATS_BEGIN_RAY(stats::SHADOW);
+                    Hit shadow_hit;
+                    if (!rayModelIntersection(sample.shadow_ray, vts, shadow_hit) || sample.distance < shadow_hit.dist)
+                        col += sample.contribution;
+                }
             }
 
             // the recursion/reflection happens here!
@@ -110,12 +212,79 @@ namespace rt{
                 Ray reflected_ray(i_pos, reflect(ray.direction, i_normal));
                 reflected_ray.origin -= ray.direction * .001f; // this is a small offset to address numerical precision issues
                 // integrate the current color with the reflection color by a p_rg factor
+                RT_STATS_BEGIN_RAY(stats::REFLECTION);
                 col += p_rg * traceRay(reflected_ray, depth - 1, vts);
             }
 
             return col;
         }
 
+        // phong reflection at i_pos, the diffuse and specular components are only used if the light is visible
+        color localIllumination(const vec3 &i_pos, const vec3 &i_normal, const color &i_col, bool light_visible) const {
+            vec3 light_dir = normalize(light_pos - i_pos);
+            color col = ambient * i_col;
+            if (light_visible) {
+                // the light is visible from i_pos (there is no occlusion), so we compute direct lighting
+                col += diffuse * i_col * max(dot(light_dir, i_normal), .0f) +
+                       specular * pow(max(dot(light_dir, i_normal), .0f), shininess);
+            }
+            return col;
+        }
+
+        // picks a light from the light list (and a point on it, for area lights) with the random numbers of seed.
+        // returns false if no light can illuminate i_pos, the sample is otherwise the phong diffuse and specular
+        // components for that light divided by the probability of the choice, so that the average over many samples
+        // is the sum over all lights
+        bool sampleLight(const vec3 &i_pos, const vec3 &i_normal, const color &i_col, uint32_t seed,
+                         LightSample &sample) const {
+            Random rng(seed);
+            uint32_t light_id;
+            float probability;
+            if (!light_tree.pick(i_pos, i_normal, rng.next(), light_id, probability))
+                return false;
+            const Light &light = light_tree.lights()[light_id];
+
+            vec3 light_point = light.position;
+            if (light.type == Light::AREA) {
+                float s = rng.next(), t = rng.next();
+                light_point += s * light.edge_u + t * light.edge_v;
+            }
+            vec3 to_light = light_point - i_pos;
+            float dist = length(to_light);
+            if (dist <= 0) return false;
+            vec3 light_dir = to_light / dist;
+            float cos_surface = dot(light_dir, i_normal);
+            if (cos_surface <= 0) return false;
+
+            // light arriving at i_pos, point lights fall off with the squared distance. A point sampled uniformly on an
+            // area light has probability 1/area, and it is seen at an angle (cos_light) from i_pos
+            vec3 incoming = light.emission / (dist * dist);
+            if (light.type == Light::AREA) {
+                float cos_light = dot(-light_dir, light.normal());
+                if (cos_light <= 0) return false;
+                incoming *= cos_light * light.area();
+            }
+
+            color phong = diffuse * i_col * cos_surface + specular * pow(cos_surface, shininess);
+            sample.contribution = phong * vec4(incoming / probability, 0);
+            sample.shadow_ray = Ray(i_pos + i_normal * .001f, light_dir);
+            sample.distance = dist;
+            return true;
+        }
+
+        // seed of sample s of the pixel at column c and row r
+        static uint32_t pixelSeed(unsigned int c, unsigned int r, unsigned int s) {
+            return hashSeed(hashSeed(hashSeed(c), r), s);
+        }
+
+        // shadow rays start slightly above the surface to prevent self-intersection
+        Ray shadowRay(const vec3 &i_pos, const vec3 &i_normal) const {
+            return Ray(i_pos + i_normal * .001f, normalize(light_pos - i_pos));
+        }
+        float lightDistance(const vec3 &i_pos) const { return length(light_pos - i_pos); }
+        float reflectionWeight() const { return p_rg; }
+        unsigned int maxRecursion() const { return max_recursion; }
+
         // returns false if no intersection
         // intersection results are returned in the "hit" reference variable
         static bool rayModelIntersection(const Ray & ray,
@@ -127,6 +296,7 @@ namespace rt{
                 vec3 barycentric_temp;
                 // notice that we use the hit.dist to ensure that when new intersections happen, these are closer to the
                 // projection convergence point (camera position in our case) than the previously stored hit.
+                RT_STATS_TRIANGLE_TESTED();
                 if (rayTriangleIntersection(ray, vts[i], vts[i+1], vts[i+2], dist_temp, barycentric_temp) && dist_temp < hit.dist)
                 {
                     hit.hit_ID = i;
@@ -134,6 +304,7 @@ namespace rt{
                     hit.barycentric = barycentric_temp;
                 }
             }
+            if (hit.hit_ID >= 0) RT_STATS_HIT();
             return hit.hit_ID < 0 ? false : true;
         }
 
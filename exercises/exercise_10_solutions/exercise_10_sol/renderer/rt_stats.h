@@ -0,0 +1,193 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_STATS_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_STATS_H
+
+// Ray tracing instrumentation.
+//
+// Build with RT_INSTRUMENTATION defined (cmake -DRT_INSTRUMENTATION=ON) to count, per ray type, how many rays were
+// traced, how many triangles were tested, how many BVH nodes were visited and how many rays hit something.
+// The cost of each pixel (triangles tested + nodes visited by all the rays of the pixel) is also recorded, so it can be
+// shown as a heatmap, and histograms can be written to a JSON file.
+// Without RT_INSTRUMENTATION the RT_STATS_* macros expand to nothing, so there is no overhead at all.
+
+namespace rt{
+    namespace stats{
+        enum RayType { PRIMARY = 0, SHADOW, REFLECTION, RAY_TYPE_COUNT };
+    }
+}
+
+#ifdef RT_INSTRUMENTATION
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "rt_types.h"
+#include "frame_buffer.h"
+
+namespace rt{
+    namespace stats{
+
+        struct RayCounters{
+            uint64_t rays = 0;
+            uint64_t triangles_tested = 0;
+            uint64_t nodes_visited = 0;
+            uint64_t hits = 0;
+        };
+
+        class Statistics{
+        public:
+            // the number of log2 buckets of the pixel cost histogram, and the longest path in the bounce histogram
+            // (which counts one path per pixel sample)
+            static const unsigned int cost_buckets = 32;
+            static const unsigned int max_bounces = 16;
+
+            RayCounters per_type[RAY_TYPE_COUNT];
+            uint64_t cost_histogram[cost_buckets] = {};
+            uint64_t bounce_histogram[max_bounces + 1] = {};
+
+            // the getInstance and deleted functions below makes this a singleton
+            static Statistics& getInstance()
+            {
+                static Statistics instance;
+                return instance;
+            }
+            Statistics(Statistics const&)      = delete;
+            void operator=(Statistics const&)  = delete;
+
+            // clears all counters and sizes the per pixel cost buffer
+            void reset(unsigned int width, unsigned int height){
+                for (RayCounters &c : per_type)
+                    c = RayCounters();
+                std::fill(cost_histogram, cost_histogram + cost_buckets, 0);
+                std::fill(bounce_histogram, bounce_histogram + max_bounces + 1, 0);
+                W = width;
+                H = height;
+                cost.assign(W * H, 0);
+            }
+
+            void beginRays(RayType type, uint64_t count){
+                current = type;
+                per_type[type].rays += count;
+            }
+            void triangleTested() { per_type[current].triangles_tested++; pixel_cost++; }
+            void nodeVisited() { per_type[current].nodes_visited++; pixel_cost++; }
+            void hit() { per_type[current].hits++; }
+            void surfaceHit() { sample_bounces++; }
+
+            void beginPixel(){
+                pixel_cost = 0;
+                sample_bounces = 0;
+            }
+            // the surfaces hit by the path of one sample of the pixel
+            void endSample(){
+                recordSample(sample_bounces);
+                sample_bounces = 0;
+            }
+            void endPixel(unsigned int x, unsigned int y){
+                recordPixel(x, y, pixel_cost);
+            }
+
+            // streamed rendering (rt_streaming.h) traces the rays of many pixels together, so it cannot use
+            // beginPixel/endPixel: it reads costCounter before and after the work of each ray, adds the difference to
+            // the pixel of the ray, counts the bounces of each sample itself and records both with these
+            uint64_t costCounter() const { return pixel_cost; }
+            void recordSample(unsigned int bounces){
+                bounce_histogram[bounces < max_bounces ? bounces : max_bounces]++;
+            }
+            void recordPixel(unsigned int x, unsigned int y, uint64_t total){
+                if (x < W && y < H)
+                    cost[x + y * W] = total;
+                unsigned int bucket = 0;
+                while ((uint64_t(1) << (bucket + 1)) <= total && bucket + 1 < cost_buckets)
+                    bucket++;
+                cost_histogram[total == 0 ? 0 : bucket]++;
+            }
+
+            uint64_t costAt(unsigned int x, unsigned int y) const { return cost[x + y * W]; }
+
+            // maps the cost of each pixel to a color, from dark blue (cheapest) to red (most expensive)
+            void paintHeatmap(FrameBuffer<uint32_t> &fb) const {
+                const Colors::color cold(0, 0, .25f, 1);
+                uint64_t max_cost = 1;
+                for (uint64_t c : cost)
+                    max_cost = std::max(max_cost, c);
+                for (unsigned int y = 0; y < fb.H && y < H; y++){
+                    for (unsigned int x = 0; x < fb.W && x < W; x++){
+                        float t = float(costAt(x, y)) / float(max_cost);
+                        Colors::color col = t < .5f ? glm::mix(cold, Colors::green, t * 2.f)
+                                                    : glm::mix(Colors::green, Colors::red, (t - .5f) * 2.f);
+                        fb.paintAt(x, y, Colors::toRGBA32(col));
+                    }
+                }
+            }
+
+            // writes the counters and the histograms to a JSON file, returns false if the file could not be written
+            bool writeJSON(const std::string &path) const {
+                FILE *file = fopen(path.c_str(), "w");
+                if (!file)
+                    return false;
+                const char *names[RAY_TYPE_COUNT] = {"primary", "shadow", "reflection"};
+                fprintf(file, "{\n  \"width\": %u,\n  \"height\": %u,\n  \"rays\": {\n", W, H);
+                for (int t = 0; t < RAY_TYPE_COUNT; t++){
+                    const RayCounters &c = per_type[t];
+                    fprintf(file, "    \"%s\": {\"rays\": %llu, \"triangles_tested\": %llu, \"nodes_visited\": %llu, \"hits\": %llu}%s\n",
+                            names[t], (unsigned long long) c.rays, (unsigned long long) c.triangles_tested,
+                            (unsigned long long) c.nodes_visited, (unsigned long long) c.hits, t + 1 < RAY_TYPE_COUNT ? "," : "");
+                }
+                fprintf(file, "  },\n  \"pixel_cost_histogram\": {\"bucket_lower_bounds\": [0");
+                for (unsigned int b = 1; b < cost_buckets; b++)
+                    fprintf(file, ", %llu", (unsigned long long) (uint64_t(1) << b));
+                fprintf(file, "], \"pixels\": [");
+                for (unsigned int b = 0; b < cost_buckets; b++)
+                    fprintf(file, "%s%llu", b ? ", " : "", (unsigned long long) cost_histogram[b]);
+                fprintf(file, "]},\n  \"bounce_depth_histogram\": [");
+                for (unsigned int b = 0; b <= max_bounces; b++)
+                    fprintf(file, "%s%llu", b ? ", " : "", (unsigned long long) bounce_histogram[b]);
+                fprintf(file, "]\n}\n");
+                bool ok = !ferror(file);
+                fclose(file);
+                return ok;
+            }
+
+        private:
+            Statistics() = default;
+
+            unsigned int W = 0, H = 0;
+            std::vector<uint64_t> cost;
+            RayType current = PRIMARY;
+            uint64_t pixel_cost = 0;
+            unsigned int sample_bounces = 0;
+        };
+    }
+}
+
+#define RT_STATS_BEGIN_RAY(type) rt::stats::Statistics::getInstance().beginRays(type, 1)
+#define RT_STATS_BEGIN_RAYS(type, count) rt::stats::Statistics::getInstance().beginRays(type, count)
+#define RT_STATS_TRIANGLE_TESTED() rt::stats::Statistics::getInstance().triangleTested()
+#define RT_STATS_NODE_VISITED() rt::stats::Statistics::getInstance().nodeVisited()
+#define RT_STATS_HIT() rt::stats::Statistics::getInstance().hit()
+#define RT_STATS_SURFACE_HIT() rt::stats::Statistics::getInstance().surfaceHit()
+#define RT_STATS_BEGIN_PIXEL() rt::stats::Statistics::getInstance().beginPixel()
+#define RT_STATS_END_SAMPLE() rt::stats::Statistics::getInstance().endSample()
+#define RT_STATS_END_PIXEL(x, y) rt::stats::Statistics::getInstance().endPixel(x, y)
+#define RT_STATS_RECORD_SAMPLE(bounces) rt::stats::Statistics::getInstance().recordSample(bounces)
+#define RT_STATS_RECORD_PIXEL(x, y, cost) rt::stats::Statistics::getInstance().recordPixel(x, y, cost)
+
+#else
+
+#define RT_STATS_BEGIN_RAY(type) ((void) 0)
+#define RT_STATS_BEGIN_RAYS(type, count) ((void) 0)
+#define RT_STATS_TRIANGLE_TESTED() ((void) 0)
+#define RT_STATS_NODE_VISITED() ((void) 0)
+#define RT_STATS_HIT() ((void) 0)
+#define RT_STATS_SURFACE_HIT() ((void) 0)
+#define RT_STATS_BEGIN_PIXEL() ((void) 0)
+#define RT_STATS_END_SAMPLE() ((void) 0)
+#define RT_STATS_END_PIXEL(x, y) ((void) 0)
+#define RT_STATS_RECORD_SAMPLE(bounces) ((void) 0)
+#define RT_STATS_RECORD_PIXEL(x, y, cost) ((void) 0)
+
+#endif //RT_INSTRUMENTATION
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_STATS_H
@@ -0,0 +1,498 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_STREAMING_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_STREAMING_H
+
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "rt_types.h"
+#include "rt_bvh.h"
+#include "rt_renderer.h"
+
+// Out-of-core geometry for the ray tracer.
+//
+// A model is partitioned offline (writeClusterFile) into spatially coherent clusters of triangles, each cluster gets
+// its own small BVH and both are stored in a cluster file. At render time (StreamedModel) only a top level BVH over the
+// cluster bounds stays in memory, cluster data is read from the file when a ray reaches it and kept in a LRU cache
+// that never grows beyond a given number of bytes.
+//
+// File layout (native endianness):
+//   ClusterFileHeader
+//   BVHNode[top_node_count]          top level hierarchy, leaves have count == 1 and first == cluster index
+//   ClusterRecord[cluster_count]
+//   for each cluster: BVHNode[node_count] followed by vertex[3 * triangle_count]
+
+namespace rt{
+
+    struct ClusterFileHeader{
+        char magic[4] = {'R', 'T', 'C', 'L'};
+        uint32_t version = 1;
+        uint32_t cluster_count = 0;
+        uint32_t top_node_count = 0;
+    };
+
+    struct ClusterRecord{
+        AABB bounds;
+        uint64_t offset = 0; // position of the cluster data in the file
+        uint32_t node_count = 0;
+        uint32_t triangle_count = 0;
+
+        size_t bytes() const { return node_count * sizeof(BVHNode) + triangle_count * 3 * sizeof(vertex); }
+    };
+
+    // file positions in 64 bits, long is 32 bits on Windows and cluster files of large models go past 2 GB
+    inline bool seekClusterFile(FILE *file, uint64_t offset){
+#ifdef _WIN32
+        return _fseeki64(file, (__int64) offset, SEEK_SET) == 0;
+#else
+        return fseeko(file, (off_t) offset, SEEK_SET) == 0;
+#endif
+    }
+
+    inline uint64_t tellClusterFile(FILE *file){
+#ifdef _WIN32
+        return (uint64_t) _ftelli64(file);
+#else
+        return (uint64_t) ftello(file);
+#endif
+    }
+
+    // partitions the triangle soup vts into clusters of at most triangles_per_cluster triangles and writes them to path,
+    // returns false if the file could not be written.
+    // the partition is the top of a median split BVH, so triangles that are close in space end up in the same cluster
+    // and clusters that are close in space end up close in the file.
+    // notice that this step still needs the whole model in memory (but no copy of it), it is meant to run once, offline
+    inline bool writeClusterFile(const std::vector<vertex> &vts, const std::string &path, unsigned int triangles_per_cluster = 4096){
+        std::vector<AABB> tri_bounds(vts.size() / 3);
+        for (size_t t = 0; t < tri_bounds.size(); t++){
+            tri_bounds[t].grow(vec3(vts[t * 3].pos));
+            tri_bounds[t].grow(vec3(vts[t * 3 + 1].pos));
+            tri_bounds[t].grow(vec3(vts[t * 3 + 2].pos));
+        }
+
+        BVH top;
+        std::vector<uint32_t> order;
+        top.build(tri_bounds, triangles_per_cluster, order);
+
+        // every leaf of the top level hierarchy becomes a cluster
+        std::vector<ClusterRecord> clusters;
+        std::vector<std::pair<uint32_t, uint32_t>> cluster_ranges;
+        for (BVHNode &node : top.nodes){
+            if (!node.isLeaf())
+                continue;
+            ClusterRecord record;
+            record.bounds = node.bounds;
+            record.triangle_count = node.count;
+            cluster_ranges.emplace_back(node.first, node.count);
+            node.first = (uint32_t) clusters.size();
+            node.count = 1;
+            clusters.push_back(record);
+        }
+
+        FILE *file = fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+
+        ClusterFileHeader header;
+        header.cluster_count = (uint32_t) clusters.size();
+        header.top_node_count = (uint32_t) top.nodes.size();
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(top.nodes.data(), sizeof(BVHNode), top.nodes.size(), file);
+        // the records are written again once the cluster sizes are known
+        uint64_t records_offset = tellClusterFile(file);
+        fwrite(clusters.data(), sizeof(ClusterRecord), clusters.size(), file);
+
+        std::vector<vertex> cluster_vts;
+        for (size_t c = 0; c < clusters.size(); c++){
+            cluster_vts.clear();
+            for (uint32_t t = cluster_ranges[c].first; t < cluster_ranges[c].first + cluster_ranges[c].second; t++)
+                for (int k = 0; k < 3; k++)
+                    cluster_vts.push_back(vts[order[t] * 3 + k]);
+
+            BVH bvh;
+            bvh.build(cluster_vts);
+
+            clusters[c].offset = tellClusterFile(file);
+            clusters[c].node_count = (uint32_t) bvh.nodes.size();
+            fwrite(bvh.nodes.data(), sizeof(BVHNode), bvh.nodes.size(), file);
+            fwrite(cluster_vts.data(), sizeof(vertex), cluster_vts.size(), file);
+        }
+
+        bool ok = seekClusterFile(file, records_offset);
+        fwrite(clusters.data(), sizeof(ClusterRecord), clusters.size(), file);
+        ok = ok && !ferror(file);
+        fclose(file);
+        return ok;
+    }
+
+    // result of a query against a streamed model, the surface attributes are interpolated while the cluster is resident
+    struct SurfaceHit{
+        float dist = FLT_MAX;
+        vec3 normal;
+        Colors::color col;
+        bool found = false;
+    };
+
+    class StreamedModel{
+    public:
+        // number of cluster reads from disk, number of requests served from memory
+        // and the largest amount of cluster memory held at any time
+        struct Stats{
+            size_t page_ins = 0;
+            size_t cache_hits = 0;
+            size_t peak_resident_bytes = 0;
+        };
+
+        // rays are traced in batches of at most this many primary rays (pixels times samples per pixel),
+        // the memory used by the batch (rays, hits and shadow rays) adds to the cache budget
+        unsigned int ray_batch_size = 1 << 16;
+
+        StreamedModel() = default;
+        StreamedModel(StreamedModel const&) = delete;
+        void operator=(StreamedModel const&) = delete;
+        ~StreamedModel() { close(); }
+
+        // opens a file written by writeClusterFile, cache_budget_bytes caps the memory used by resident clusters.
+        // a budget smaller than the largest cluster still renders, with a single cluster resident at a time
+        bool open(const std::string &path, size_t cache_budget_bytes){
+            close();
+            file = fopen(path.c_str(), "rb");
+            if (!file)
+                return false;
+
+            ClusterFileHeader header;
+            if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, ClusterFileHeader().magic, 4) != 0
+                || header.version != ClusterFileHeader().version){
+                close();
+                return false;
+            }
+            top.nodes.resize(header.top_node_count);
+            clusters.resize(header.cluster_count);
+            if (fread(top.nodes.data(), sizeof(BVHNode), top.nodes.size(), file) != top.nodes.size() ||
+                fread(clusters.data(), sizeof(ClusterRecord), clusters.size(), file) != clusters.size()){
+                close();
+                return false;
+            }
+
+            resident.resize(clusters.size());
+            lru_position.resize(clusters.size());
+            budget = cache_budget_bytes;
+            return true;
+        }
+
+        void close(){
+            if (file)
+                fclose(file);
+            file = nullptr;
+            top.nodes.clear();
+            clusters.clear();
+            resident.clear();
+            lru_position.clear();
+            lru.clear();
+            resident_bytes = 0;
+        }
+
+        bool isOpen() const { return file != nullptr; }
+        size_t clusterCount() const { return clusters.size(); }
+        size_t residentBytes() const { return resident_bytes; }
+        const Stats &stats() const { return statistics; }
+        void resetStats() { statistics = Stats(); statistics.peak_resident_bytes = resident_bytes; }
+
+        void setCacheBudget(size_t cache_budget_bytes){
+            budget = cache_budget_bytes;
+            evict(0);
+        }
+
+        // closest hit query for a batch of rays, hits[i].dist is used as the maximum distance of rays[i].
+        // every ray is first tested against the resident top level hierarchy, the (cluster, ray) pairs are then sorted
+        // by cluster so that each cluster is paged in (at most) once per batch and tested against all its rays
+        void intersect(const std::vector<Ray> &rays, std::vector<SurfaceHit> &hits){
+#ifdef RT_INSTRUMENTATION
+            const stats::Statistics &counters = stats::Statistics::getInstance();
+            ray_costs.assign(rays.size(), 0);
+#endif
+            work.clear();
+            for (uint32_t i = 0; i < rays.size(); i++){
+#ifdef RT_INSTRUMENTATION
+                uint64_t cost_before = counters.costCounter();
+#endif
+                top.traverse(rays[i], hits[i].dist, [&](uint32_t first, uint32_t count){
+                    for (uint32_t c = first; c < first + count; c++)
+                        work.emplace_back(c, i);
+                });
+#ifdef RT_INSTRUMENTATION
+                ray_costs[i] += counters.costCounter() - cost_before;
+#endif
+            }
+            std::sort(work.begin(), work.end());
+
+            for (size_t w = 0; w < work.size();){
+                uint32_t cluster_id = work[w].first;
+                const Cluster &cluster = acquire(cluster_id);
+                for (; w < work.size() && work[w].first == cluster_id; w++){
+                    uint32_t i = work[w].second;
+#ifdef RT_INSTRUMENTATION
+                    uint64_t cost_before = counters.costCounter();
+#endif
+                    intersectCluster(cluster, rays[i], hits[i]);
+#ifdef RT_INSTRUMENTATION
+                    ray_costs[i] += counters.costCounter() - cost_before;
+#endif
+                }
+            }
+#ifdef RT_INSTRUMENTATION
+            for (const SurfaceHit &hit : hits)
+                if (hit.found) RT_STATS_HIT();
+#endif
+        }
+
+#ifdef RT_INSTRUMENTATION
+        // the triangles tested and nodes visited by each ray of the last call to intersect
+        const std::vector<uint64_t> &rayCosts() const { return ray_costs; }
+#endif
+
+    private:
+        struct Cluster{
+            BVH bvh;
+            std::vector<vertex> vts;
+        };
+
+        FILE *file = nullptr;
+        BVH top;
+        std::vector<ClusterRecord> clusters;
+
+        // LRU cache, the most recently used cluster is at the front of the list
+        std::vector<std::unique_ptr<Cluster>> resident;
+        std::vector<std::list<uint32_t>::iterator> lru_position;
+        std::list<uint32_t> lru;
+        size_t budget = 0;
+        size_t resident_bytes = 0;
+        Stats statistics;
+
+        std::vector<std::pair<uint32_t, uint32_t>> work;
+#ifdef RT_INSTRUMENTATION
+        std::vector<uint64_t> ray_costs;
+#endif
+
+        // the returned reference is valid until the next call to acquire
+        const Cluster &acquire(uint32_t id){
+            if (resident[id]){
+                statistics.cache_hits++;
+                lru.splice(lru.begin(), lru, lru_position[id]);
+                return *resident[id];
+            }
+
+            const ClusterRecord &record = clusters[id];
+            evict(record.bytes());
+
+            std::unique_ptr<Cluster> cluster(new Cluster());
+            cluster->bvh.nodes.resize(record.node_count);
+            cluster->vts.resize(record.triangle_count * 3);
+            bool seeked = seekClusterFile(file, record.offset);
+            size_t nodes_read = seeked ? fread(cluster->bvh.nodes.data(), sizeof(BVHNode), record.node_count, file) : 0;
+            size_t vts_read = seeked ? fread(cluster->vts.data(), sizeof(vertex), cluster->vts.size(), file) : 0;
+            if (nodes_read != record.node_count || vts_read != cluster->vts.size()){
+                // truncated file, keep the cluster empty so that rays go through it
+                cluster->bvh.nodes.clear();
+                cluster->vts.clear();
+            }
+
+            statistics.page_ins++;
+            resident_bytes += record.bytes();
+            statistics.peak_resident_bytes = std::max(statistics.peak_resident_bytes, resident_bytes);
+            resident[id] = std::move(cluster);
+            lru.push_front(id);
+            lru_position[id] = lru.begin();
+            return *resident[id];
+        }
+
+        // drops least recently used clusters until "incoming" more bytes fit in the budget
+        void evict(size_t incoming){
+            while (!lru.empty() && resident_bytes + incoming > budget){
+                uint32_t id = lru.back();
+                lru.pop_back();
+                resident[id].reset();
+                resident_bytes -= clusters[id].bytes();
+            }
+        }
+
+        static void intersectCluster(const Cluster &cluster, const Ray &ray, SurfaceHit &surface){
+            Hit hit;
+            hit.dist = surface.dist;
+            const vertex *vts = cluster.vts.data();
+            cluster.bvh.traverse(ray, hit.dist, [&](uint32_t first, uint32_t count){
+                for (uint32_t t = first; t < first + count; t++){
+                    float dist_temp;
+                    vec3 barycentric_temp;
+                    RT_STATS_TRIANGLE_TESTED();
+                    if (Renderer::rayTriangleIntersection(ray, vts[t * 3], vts[t * 3 + 1], vts[t * 3 + 2], dist_temp, barycentric_temp)
+                        && dist_temp < hit.dist){
+                        hit.hit_ID = (int) t * 3;
+                        hit.dist = dist_temp;
+                        hit.barycentric = barycentric_temp;
+                    }
+                }
+            });
+            if (hit.hit_ID < 0)
+                return;
+
+            const vertex &p1 = vts[hit.hit_ID], &p2 = vts[hit.hit_ID + 1], &p3 = vts[hit.hit_ID + 2];
+            surface.found = true;
+            surface.dist = hit.dist;
+            surface.normal = normalize(vec3(p1.norm * hit.barycentric.x + p2.norm * hit.barycentric.y + p3.norm * hit.barycentric.z));
+            surface.col = p1.col * hit.barycentric.x + p2.col * hit.barycentric.y + p3.col * hit.barycentric.z;
+        }
+    };
+
+
+    inline void Renderer::render(StreamedModel &model,
+                                 const glm::mat4 &m,
+                                 const glm::mat4 &v,
+                                 const float fov_degrees,
+                                 unsigned int depth,
+                                 FrameBuffer <uint32_t> &fb) {
+        depth = depth > max_recursion ? max_recursion : depth;
+        CameraRays camera(m, v, fov_degrees, fb.W, fb.H);
+
+        unsigned int pixel_count = fb.W * fb.H;
+        // with a light list, every pixel starts samplesPerPixel() rays, each one picks its own lights
+        unsigned int spp = samplesPerPixel();
+        unsigned int batch_size = std::max(model.ray_batch_size / spp, 1u);
+
+        std::vector<Ray> rays, next_rays, shadow_rays;
+        std::vector<uint32_t> pixels, next_pixels, seeds, next_seeds;
+        std::vector<float> weights, next_weights;
+        std::vector<SurfaceHit> hits, shadow_hits;
+        std::vector<LightSample> light_samples;
+        std::vector<int> shadow_slots; // index of the shadow ray of each hit, -1 if it has none
+        std::vector<color> accumulated;
+#ifdef RT_INSTRUMENTATION
+        // the stats of the pixels of the batch, and of their samples (the path of a ray is followed through the waves
+        // by the index of its sample in the batch)
+        std::vector<uint64_t> pixel_costs;
+        std::vector<unsigned int> sample_bounces;
+        std::vector<uint32_t> samples, next_samples;
+#endif
+
+        for (unsigned int batch_start = 0; batch_start < pixel_count; batch_start += batch_size){
+            unsigned int batch_end = std::min(batch_start + batch_size, pixel_count);
+
+            rays.clear(); pixels.clear(); weights.clear(); seeds.clear();
+            for (unsigned int p = batch_start; p < batch_end; p++){
+                for (unsigned int s = 0; s < spp; s++){
+                    rays.push_back(camera.rayAt(p % fb.W, p / fb.W));
+                    pixels.push_back(p - batch_start);
+                    weights.push_back(1.0f / float(spp));
+                    seeds.push_back(pixelSeed(p % fb.W, p / fb.W, s));
+                }
+            }
+            accumulated.assign(batch_end - batch_start, color(0));
+#ifdef RT_INSTRUMENTATION
+            pixel_costs.assign(batch_end - batch_start, 0);
+            sample_bounces.assign(rays.size(), 0);
+            samples.resize(rays.size());
+            for (uint32_t i = 0; i < rays.size(); i++)
+                samples[i] = i;
+#endif
+
+            // each wave traces one level of the recursion in traceRay, for all the rays of the batch
+            for (unsigned int level = depth; level >= 1 && !rays.empty(); level--){
+                hits.assign(rays.size(), SurfaceHit());
+                RT_STATS_BEGIN_RAYS(level == depth ? stats::PRIMARY : stats::REFLECTION, rays.size());
+                model.intersect(rays, hits);
+#ifdef RT_INSTRUMENTATION
+                for (unsigned int i = 0; i < rays.size(); i++){
+                    pixel_costs[pixels[i]] += model.rayCosts()[i];
+                    sample_bounces[samples[i]] += hits[i].found;
+                }
+#endif
+
+                // the random numbers of a light sample depend on its pixel sample and level (as in traceRay), so
+                // streamed and in-core rendering pick the same lights
+                shadow_rays.clear();
+                light_samples.clear();
+                shadow_slots.assign(rays.size(), -1);
+                for (unsigned int i = 0; i < rays.size(); i++){
+                    if (!hits[i].found) continue;
+                    vec3 i_pos = rays[i].origin + rays[i].direction * hits[i].dist;
+                    if (light_tree.empty())
+                        shadow_rays.push_back(shadowRay(i_pos, hits[i].normal));
+                    else {
+                        LightSample sample;
+                        if (!sampleLight(i_pos, hits[i].normal, hits[i].col, hashSeed(seeds[i], level), sample))
+                            continue;
+                        shadow_rays.push_back(sample.shadow_ray);
+                        light_samples.push_back(sample);
+                    }
+                    shadow_slots[i] = (int) shadow_rays.size() - 1;
+                }
+                shadow_hits.assign(shadow_rays.size(), SurfaceHit());
+                RT_STATS_BEGIN_RAYS(stats::SHADOW, shadow_rays.size());
+                model.intersect(shadow_rays, shadow_hits);
+#ifdef RT_INSTRUMENTATION
+                for (unsigned int i = 0; i < rays.size(); i++)
+                    if (shadow_slots[i] >= 0)
+                        pixel_costs[pixels[i]] += model.rayCosts()[shadow_slots[i]];
+#endif
+
+                next_rays.clear(); next_pixels.clear(); next_weights.clear(); next_seeds.clear();
+#ifdef RT_INSTRUMENTATION
+                next_samples.clear();
+#endif
+                for (unsigned int i = 0; i < rays.size(); i++){
+                    if (!hits[i].found) {
+                        accumulated[pixels[i]] += weights[i] * black; // no hit, black
+                        continue;
+                    }
+                    vec3 i_pos = rays[i].origin + rays[i].direction * hits[i].dist;
+                    int slot = shadow_slots[i];
+                    if (light_tree.empty()) {
+                        const SurfaceHit &shadow_hit = shadow_hits[slot];
+                        bool light_visible = shadow_hit.found && lightDistance(i_pos) < shadow_hit.dist;
+                        accumulated[pixels[i]] += weights[i] * localIllumination(i_pos, hits[i].normal, hits[i].col, light_visible);
+                    }
+                    else {
+                        color col = ambient * hits[i].col;
+                        if (slot >= 0 && (!shadow_hits[slot].found || light_samples[slot].distance < shadow_hits[slot].dist))
+                            col += light_samples[slot].contribution;
+                        accumulated[pixels[i]] += weights[i] * col;
+                    }
+
+                    if (level > 1) {
+                        Ray reflected_ray(i_pos, reflect(rays[i].direction, hits[i].normal));
+                        reflected_ray.origin -= rays[i].direction * .001f; // this is a small offset to address numerical precision issues
+                        next_rays.push_back(reflected_ray);
+                        next_pixels.push_back(pixels[i]);
+                        next_weights.push_back(weights[i] * p_rg);
+                        next_seeds.push_back(seeds[i]);
+#ifdef RT_INSTRUMENTATION
+                        next_samples.push_back(samples[i]);
+#endif
+                    }
+                }
+                rays.swap(next_rays);
+                pixels.swap(next_pixels);
+                weights.swap(next_weights);
+                seeds.swap(next_seeds);
+#ifdef RT_INSTRUMENTATION
+                samples.swap(next_samples);
+#endif
+            }
+
+            for (unsigned int p = batch_start; p < batch_end; p++)
+                fb.paintAt(p % fb.W, p / fb.W, toRGBA32(accumulated[p - batch_start]));
+#ifdef RT_INSTRUMENTATION
+            for (unsigned int bounces : sample_bounces)
+                RT_STATS_RECORD_SAMPLE(bounces);
+            for (unsigned int p = batch_start; p < batch_end; p++)
+                RT_STATS_RECORD_PIXEL(p % fb.W, p / fb.W, pixel_costs[p - batch_start]);
+#endif
+        }
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_STREAMING_H
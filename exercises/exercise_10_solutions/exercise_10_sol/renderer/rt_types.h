@@ -36,6 +36,14 @@ namespace rt{
         glm::vec3 direction;
     };
 
+    // a rectangular region of the image, [x0, x1) x [y0, y1)
+    struct Tile{
+        unsigned int x0, y0, x1, y1;
+
+        unsigned int width() const { return x1 - x0; }
+        unsigned int height() const { return y1 - y0; }
+    };
+
     struct Hit{
         int hit_ID = -1; // negative values for no hit, other values for the index of the first vertex in a triangle
         glm::vec3 barycentric; // the barycentric coordinates of the triangle that was hit (if any)
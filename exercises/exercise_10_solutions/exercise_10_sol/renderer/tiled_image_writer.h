@@ -0,0 +1,183 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_TILED_IMAGE_WRITER_H
+#define ITU_GRAPHICS_PROGRAMMING_TILED_IMAGE_WRITER_H
+
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes an image to a binary PPM file (P6) tile by tile, so that huge images never need a full frame buffer in memory.
+//
+// The file is sized when it is opened and every finished tile is written in place, at the offset of its rows, by a
+// background thread. The renderer keeps working on the next tile while the previous ones are being written.
+// At most max_tiles_in_flight tiles are kept in memory, submit blocks when the writer falls behind.
+//
+// Pixels are RGBA8 packed in 32 bits (as in our frame buffers), row 0 is the bottom row of the image.
+class TiledImageWriter {
+public:
+    // time the renderer waited for the writer, and time the writer thread spent writing
+    struct Stats {
+        double blocked_seconds = 0;
+        double write_seconds = 0;
+        size_t tiles_written = 0;
+    };
+
+    TiledImageWriter() = default;
+    TiledImageWriter(TiledImageWriter const&) = delete;
+    void operator=(TiledImageWriter const&) = delete;
+    ~TiledImageWriter() { close(); }
+
+    bool open(const std::string &path, unsigned int width, unsigned int height, unsigned int max_tiles_in_flight = 8) {
+        close();
+        file = fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+
+        W = width;
+        H = height;
+        max_in_flight = max_tiles_in_flight > 0 ? max_tiles_in_flight : 1;
+        failed = false;
+        statistics = Stats();
+
+        header_size = (uint64_t) fprintf(file, "P6\n%u %u\n255\n", W, H);
+        // write the last byte, so that the file has its final size (most file systems will not allocate the gap)
+        uint64_t file_size = header_size + (uint64_t) W * H * 3;
+        if ((uint64_t) W * H > 0 && (!seek(file_size - 1) || fputc(0, file) == EOF)) {
+            fclose(file);
+            file = nullptr;
+            return false;
+        }
+
+        stopping = false;
+        worker = std::thread(&TiledImageWriter::writeLoop, this);
+        return true;
+    }
+
+    // buffer of width * height pixels to render a tile into, reuses the memory of tiles that were already written
+    std::vector<uint32_t> acquireBuffer(unsigned int width, unsigned int height) {
+        std::vector<uint32_t> buffer;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!free_buffers.empty()) {
+                buffer.swap(free_buffers.back());
+                free_buffers.pop_back();
+            }
+        }
+        buffer.resize((size_t) width * height);
+        return buffer;
+    }
+
+    // queues a finished tile (width * height pixels, stored row by row) with its lower left corner at x0, y0.
+    // pixels outside the image are ignored
+    void submit(unsigned int x0, unsigned int y0, unsigned int width, unsigned int height, std::vector<uint32_t> &&pixels) {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::unique_lock<std::mutex> lock(mutex);
+        space_available.wait(lock, [this]{ return queue.size() + writing < max_in_flight; });
+        statistics.blocked_seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        queue.push_back(PendingTile{x0, y0, width, height, std::move(pixels)});
+        tile_available.notify_one();
+    }
+
+    // waits until all tiles are written and closes the file, returns false if anything failed
+    bool close() {
+        if (!file)
+            return !failed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        tile_available.notify_one();
+        if (worker.joinable())
+            worker.join();
+        if (fclose(file) != 0)
+            failed = true;
+        file = nullptr;
+        free_buffers.clear();
+        return !failed;
+    }
+
+    // only up to date once close has returned
+    const Stats &stats() const { return statistics; }
+
+private:
+    struct PendingTile {
+        unsigned int x0, y0, width, height;
+        std::vector<uint32_t> pixels;
+    };
+
+    FILE *file = nullptr;
+    unsigned int W = 0, H = 0;
+    uint64_t header_size = 0;
+    unsigned int max_in_flight = 1;
+    bool failed = false;
+    Stats statistics;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable tile_available, space_available;
+    std::deque<PendingTile> queue;
+    std::vector<std::vector<uint32_t>> free_buffers;
+    unsigned int writing = 0;
+    bool stopping = false;
+
+    bool seek(uint64_t offset) {
+#ifdef _WIN32
+        return _fseeki64(file, (__int64) offset, SEEK_SET) == 0;
+#else
+        return fseeko(file, (off_t) offset, SEEK_SET) == 0;
+#endif
+    }
+
+    void writeLoop() {
+        std::vector<unsigned char> row;
+        while (true) {
+            PendingTile tile;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                tile_available.wait(lock, [this]{ return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                tile = std::move(queue.front());
+                queue.pop_front();
+                writing++;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            bool ok = true;
+            unsigned int x_end = tile.x0 + tile.width < W ? tile.x0 + tile.width : W;
+            unsigned int y_end = tile.y0 + tile.height < H ? tile.y0 + tile.height : H;
+            if (tile.x0 < x_end) {
+                row.resize((x_end - tile.x0) * 3);
+                for (unsigned int y = tile.y0; y < y_end; y++) {
+                    const uint32_t *src = tile.pixels.data() + (size_t) (y - tile.y0) * tile.width;
+                    for (unsigned int x = 0; x < x_end - tile.x0; x++) {
+                        row[x * 3] = (unsigned char) (src[x] & 0xff);
+                        row[x * 3 + 1] = (unsigned char) ((src[x] >> 8) & 0xff);
+                        row[x * 3 + 2] = (unsigned char) ((src[x] >> 16) & 0xff);
+                    }
+                    // PPM stores the top row first
+                    uint64_t offset = header_size + ((uint64_t) (H - 1 - y) * W + tile.x0) * 3;
+                    ok = ok && seek(offset) && fwrite(row.data(), 1, row.size(), file) == row.size();
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                writing--;
+                failed = failed || !ok;
+                statistics.write_seconds += seconds;
+                statistics.tiles_written++;
+                free_buffers.push_back(std::move(tile.pixels));
+            }
+            space_available.notify_one();
+        }
+    }
+};
+
+#endif //ITU_GRAPHICS_PROGRAMMING_TILED_IMAGE_WRITER_H
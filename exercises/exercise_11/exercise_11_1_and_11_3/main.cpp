@@ -3,11 +3,16 @@
 #include <iostream>
 
 #include <vector>
+#include <chrono>
 #include <glm/gtc/matrix_access.hpp>
 
 #include "shader.h"
+#include "gl_state.h"
 #include "camera.h"
 #include "model.h"
+#include "model_loader.h"
+#include "scene_graph.h"
+#include "render_queue.h"
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -18,7 +23,9 @@
 unsigned int initSkyboxBuffers();
 unsigned int loadCubemap(vector<std::string> faces);
 void drawScene();
+void setupCarGraph();
 void drawGui();
+void printLoadStats(double loadSeconds);
 
 // glfw and input functions
 // ------------------------
@@ -45,7 +52,20 @@ Shader* skyboxShader;
 unsigned int skyboxVAO; // skybox handle
 unsigned int cubemapTexture; // skybox texture handle
 
+ModelLoader* modelLoader; // loads the models in the background (see model_loader.h)
+
+// transform hierarchy of the car (see scene_graph.h), the wheels and the rest of the car are children of the car node
+SceneGraph carGraph;
+int carNode, bodyNode;
+int wheelNodes[4];
+
 Camera camera(glm::vec3(0.0f, 1.6f, 5.0f));
+// upload the vertices of the models in the packed format (see packed_vertex.h), 20 instead of 56 bytes per vertex
+const bool usePackedVertices = true;
+meshlet::Stats cullStats; // meshlets culled in the last frame (see meshlet.h)
+Shader::CallCounts uniformCalls; // uniform GL calls of the last frame
+GLState::Counts stateCalls; // binds and state changes of the last frame (see gl_state.h)
+RenderQueue renderQueue; // the draws of the frame (see render_queue.h)
 
 // global variables used for control
 // ---------------------------------
@@ -59,6 +79,9 @@ bool isPaused = false; // used to stop camera movement when GUI is open
 struct Config {
     float reflectionFactor = 1.0f;
     float n2 = 1.5f;
+
+    // draw only the parts of the models inside the view and facing the camera
+    bool meshletCulling = true;
 } config;
 
 
@@ -104,11 +127,17 @@ int main()
 
     // init shaders and models
     shader = new Shader("shaders/shader.vert", "shaders/shader.frag");
-    carPaint = new Model("car/Paint_LOD0.obj");
-    carBody = new Model("car/Body_LOD0.obj");
-    carWindow = new Model("car/Windows_LOD0.obj");
-    carWheel = new Model("car/Wheel_LOD0.obj");
+    // the models are loaded by worker threads and uploaded by the render loop, they show up as soon as they are ready.
+    // the first launch imports the models with assimp and writes the mesh caches (cold), later launches load the
+    // caches (warm). delete the .meshcache files next to the models to measure a cold start again
+    auto loadStart = std::chrono::high_resolution_clock::now();
+    modelLoader = new ModelLoader();
+    carPaint = modelLoader->load("car/Paint_LOD0.obj", false, usePackedVertices);
+    carBody = modelLoader->load("car/Body_LOD0.obj", false, usePackedVertices);
+    carWindow = modelLoader->load("car/Windows_LOD0.obj", false, usePackedVertices);
+    carWheel = modelLoader->load("car/Wheel_LOD0.obj", false, usePackedVertices);
     skyboxShader = new Shader("shaders/skybox.vert", "shaders/skybox.frag");
+    setupCarGraph();
 
     // init skybox
     vector<std::string> faces
@@ -154,11 +183,25 @@ int main()
 
         processInput(window);
 
+        // create the GL objects of the models that finished loading, a few milliseconds per frame
+        if (!modelLoader->allDone())
+        {
+            modelLoader->processUploads();
+            if (modelLoader->allDone())
+                printLoadStats(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - loadStart).count());
+        }
+
         glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 
+        // the uploads and the GUI change the state behind the cache
+        GLState::instance().invalidate();
         drawScene();
+        uniformCalls = Shader::callCounts();
+        Shader::callCounts() = Shader::CallCounts();
+        stateCalls = GLState::instance().callCounts();
+        GLState::instance().resetCallCounts();
 
         if (isPaused) {
             drawGui();
@@ -174,6 +217,7 @@ int main()
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
+    delete modelLoader; // first, its workers may still be using the models
     delete carWindow;
     delete carPaint;
     delete carBody;
@@ -293,6 +337,44 @@ unsigned int loadCubemap(vector<std::string> faces)
 }
 
 
+// prints how long the models took to load, how many came from the mesh cache and the size of their vertex buffers
+void printLoadStats(double loadSeconds)
+{
+    int cachedModels = 0, failedModels = 0, totalModels = 0;
+    size_t vertexBytes = 0, unpackedVertexBytes = 0;
+    for (Model* model : {carPaint, carBody, carWindow, carWheel})
+    {
+        cachedModels += model->loadedFromCache;
+        failedModels += model->hasFailed();
+        for (const Mesh &mesh : model->meshes)
+        {
+            vertexBytes += mesh.vertexBufferSize();
+            unpackedVertexBytes += mesh.vertexCount * sizeof(Vertex);
+        }
+        totalModels++;
+    }
+    std::cout << "models loaded in " << loadSeconds * 1000.0 << " ms (" << cachedModels << "/" << totalModels
+              << " from the mesh cache, " << (cachedModels == totalModels ? "warm" : "cold") << " start)" << std::endl;
+    if (failedModels > 0)
+        std::cout << failedModels << "/" << totalModels << " models could not be loaded" << std::endl;
+    std::cout << "vertex buffers: " << vertexBytes / 1024.0 << " KB (" << unpackedVertexBytes / 1024.0 << " KB unpacked)" << std::endl;
+    TextureCache::Stats textureStats = TextureCache::instance().stats();
+    std::cout << "textures: " << textureStats.textures << " in the cache, " << textureStats.residentBytes / (1024.0 * 1024.0)
+              << " MB resident, " << textureStats.hits << " hits, " << textureStats.decodes << " files decoded" << std::endl;
+}
+
+void setupCarGraph()
+{
+    carNode = carGraph.addNode(SceneGraph::NO_PARENT, glm::mat4(1.0f), "car");
+    bodyNode = carGraph.addNode(carNode, glm::mat4(1.0f), "body");
+    // the wheels on the right side are the same model turned around
+    glm::mat4 turned = glm::rotate(glm::mat4(1.0f), glm::pi<float>(), glm::vec3(0.0, 1.0, 0.0));
+    wheelNodes[0] = carGraph.addNode(carNode, glm::translate(glm::mat4(1.0f), glm::vec3(-.7432, .328, 1.39)), "wheel 1");
+    wheelNodes[1] = carGraph.addNode(carNode, glm::translate(glm::mat4(1.0f), glm::vec3(-.7432, .328, -1.296)), "wheel 2");
+    wheelNodes[2] = carGraph.addNode(carNode, glm::translate(turned, glm::vec3(-.7432, .328, 1.296)), "wheel 3");
+    wheelNodes[3] = carGraph.addNode(carNode, glm::translate(turned, glm::vec3(-.7432, .328, -1.39)), "wheel 4");
+}
+
 void drawGui(){
     // Start the Dear ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
@@ -302,11 +384,36 @@ void drawGui(){
     {
         ImGui::Begin("Settings");
 
+        if (!modelLoader->allDone())
+        {
+            ImGui::Text("Loading models: %d / %d", (int) modelLoader->readyCount(), (int) modelLoader->modelCount());
+            ImGui::ProgressBar(modelLoader->progress());
+            ImGui::Separator();
+        }
+
         ImGui::Text("Shader option: ");
         ImGui::SliderFloat("Reflection factor", &config.reflectionFactor, 0.0f, 1.0f);
         ImGui::SliderFloat("Refraction index (model)", &config.n2, 1.0f, 2.5f);
         ImGui::Separator();
 
+        ImGui::Checkbox("meshlet culling", &config.meshletCulling);
+        ImGui::Text("meshlets culled: %.1f%% (%d frustum, %d back facing, of %d)", cullStats.cullRate() * 100.0f,
+                    (int) cullStats.frustumCulled, (int) cullStats.coneCulled, (int) cullStats.meshlets);
+        ImGui::Text("triangles submitted: %d of %d, %d draw ranges", (int) cullStats.trianglesSubmitted,
+                    (int) cullStats.triangles, (int) cullStats.drawRanges);
+        ImGui::Checkbox("uniform location cache", &Shader::cacheLocations());
+        ImGui::Text("uniform calls: %d (%d sets, %d location queries)", (int) uniformCalls.total(),
+                    (int) uniformCalls.uniformSets, (int) uniformCalls.locationQueries);
+        ImGui::Checkbox("filter redundant state changes", &GLState::instance().filtering);
+        ImGui::Text("state calls: %d issued, %d filtered", (int) stateCalls.issued, (int) stateCalls.filtered);
+        const RenderQueue::Stats &queueStats = renderQueue.lastStats();
+        ImGui::Text("render queue: %d draws sorted in %.1f us", (int) queueStats.draws, queueStats.sortMicroseconds);
+        if (queueStats.droppedDraws > 0)
+            ImGui::Text("  %d draws dropped, the queue is full", (int) queueStats.droppedDraws);
+        ImGui::Text("program changes: %d (%d unsorted), material changes: %d (%d unsorted)", (int) queueStats.programChanges,
+                    (int) queueStats.programChangesUnsorted, (int) queueStats.materialChanges, (int) queueStats.materialChangesUnsorted);
+        ImGui::Separator();
+
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
         ImGui::End();
     }
@@ -318,6 +425,7 @@ void drawGui(){
 
 
 void drawScene(){
+    GLState &state = GLState::instance();
     shader->use();
 
     shader->setFloat("reflectionFactor", config.reflectionFactor);
@@ -335,57 +443,51 @@ void drawScene(){
 
     // set up skybox texture
     shader->setInt("skybox", 4);
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-
-
-    // draw wheel
-    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(-.7432, .328, 1.39));
-    shader->setMat4("model", model);
-    shader->setMat4("modelInvT", glm::inverse(glm::transpose(model)));
-    carWheel->Draw(*shader);
-
-    // draw wheel
-    model = glm::translate(glm::mat4(1.0f), glm::vec3(-.7432, .328, -1.296));
-    shader->setMat4("model", model);
-    shader->setMat4("modelInvT", glm::inverse(glm::transpose(model)));
-    carWheel->Draw(*shader);
-
-    // draw wheel
-    model = glm::rotate(glm::mat4(1.0f), glm::pi<float>(), glm::vec3(0.0, 1.0, 0.0));
-    model = glm::translate(model, glm::vec3(-.7432, .328, 1.296));
-    shader->setMat4("model", model);
-    shader->setMat4("modelInvT", glm::inverse(glm::transpose(model)));
-    carWheel->Draw(*shader);
-
-    // draw wheel
-    model = glm::rotate(glm::mat4(1.0f), glm::pi<float>(), glm::vec3(0.0, 1.0, 0.0));
-    model = glm::translate(model, glm::vec3(-.7432, .328, -1.39));
-    shader->setMat4("model", model);
-    shader->setMat4("modelInvT", glm::inverse(glm::transpose(model)));
-    carWheel->Draw(*shader);
+    state.bindTexture(4, GL_TEXTURE_CUBE_MAP, cubemapTexture);
+
+
+    // the car does not move, only the dirty nodes are recomputed so this costs nothing after the first frame
+    carGraph.update();
+
+    // the meshlets outside of the view or facing away from the camera are not drawn
+    meshlet::View cullView(viewProjection, camera.Position);
+    cullView.frustumCulling = cullView.backfaceCulling = config.meshletCulling;
+
+    // the world matrix of every node is combined with the transforms of the nodes inside the model file
+    auto setModel = [](Shader &shader, const glm::mat4 &model){
+        shader.setMat4("model", model);
+        shader.setMat4("modelInvT", glm::inverse(glm::transpose(model)));
+    };
+
+    // the meshes are recorded in the render queue, and drawn sorted by program, material and depth
+    // (see render_queue.h). The windows are not blended here, everything is opaque
+    renderQueue.begin(view);
+
+    // draw wheels
+    for (int wheel : wheelNodes)
+        renderQueue.add(RenderQueue::PASS_OPAQUE, *carWheel, *shader, carGraph.world(wheel), setModel, &cullView);
 
     // draw the rest of the car
-    model = glm::mat4(1.0f);
-    shader->setMat4("model", model);
-    shader->setMat4("modelInvT", glm::inverse(glm::transpose(model)));
-    carBody->Draw(*shader);
-    carPaint->Draw(*shader);
-    carWindow->Draw(*shader);
+    const glm::mat4 &body = carGraph.world(bodyNode);
+    renderQueue.add(RenderQueue::PASS_OPAQUE, *carBody, *shader, body, setModel, &cullView);
+    renderQueue.add(RenderQueue::PASS_OPAQUE, *carPaint, *shader, body, setModel, &cullView);
+    renderQueue.add(RenderQueue::PASS_OPAQUE, *carWindow, *shader, body, setModel, &cullView);
+
+    renderQueue.sort();
+    renderQueue.submit(RenderQueue::PASS_OPAQUE);
+    cullStats = cullView.stats;
 
     // draw skybox as last
-    glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+    state.depthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
     skyboxShader->use();
     skyboxShader->setMat4("projection", projection);
     skyboxShader->setMat4("view", view);
     skyboxShader->setInt("skybox", 0);
     // skybox cube
-    glBindVertexArray(skyboxVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    state.bindVertexArray(skyboxVAO);
+    state.bindTexture(0, GL_TEXTURE_CUBE_MAP, cubemapTexture);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-    glDepthFunc(GL_LESS); // set depth function back to default
+    state.depthFunc(GL_LESS); // set depth function back to default
 }
 
 
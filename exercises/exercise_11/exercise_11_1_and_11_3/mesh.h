@@ -7,6 +7,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <shader.h>
+#include <gl_state.h>
+#include <packed_vertex.h>
+#include <meshlet.h>
 
 #include <string>
 #include <fstream>
@@ -41,30 +44,122 @@ public:
     vector<unsigned int> indices;
     vector<Texture> textures;
     unsigned int VAO;
+    unsigned int indexCount;
+    unsigned int vertexCount;
+    // if packed, the GPU buffer holds PackedVertex (see packed_vertex.h) instead of Vertex,
+    // the shader needs the bounds to decode the positions
+    bool packed;
+    glm::vec3 boundsMin, boundsSize; // bounding box of the vertices, packed or not
+    // clusters of the index buffer that are culled on the CPU when the mesh is drawn with a view (see meshlet.h),
+    // if empty the whole mesh is always drawn
+    vector<meshlet::Meshlet> meshlets;
 
     /*  Functions  */
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool packed = false)
     {
+        this->packed = packed;
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
     }
 
-    // render the mesh
-    void Draw(Shader shader)
+    // constructor that uploads the data straight from memory owned by someone else (e.g. a memory mapped mesh cache),
+    // the vertices and indices are not kept on the CPU side, so the vertices and indices vectors stay empty
+    Mesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, vector<Texture> textures,
+         bool packed = false)
     {
-        // bind appropriate textures
+        this->packed = packed;
+        this->textures = textures;
+        setupMesh(vertexData, vertexCount, indexData, indexCount);
+    }
+
+    // bytes of GPU memory used by the vertices
+    size_t vertexBufferSize() const
+    {
+        return (size_t) vertexCount * (packed ? sizeof(PackedVertex) : sizeof(Vertex));
+    }
+
+    glm::vec3 boundsCenter() const
+    {
+        return boundsMin + boundsSize * 0.5f;
+    }
+
+    // render the mesh. With a view, only the meshlets that can be seen by its camera are drawn, model is the
+    // transform of the mesh
+    void Draw(Shader &shader, meshlet::View *view = nullptr, const glm::mat4 &model = glm::mat4(1.0f))
+    {
+        bool culled = view && !meshlets.empty();
+        if (culled)
+        {
+            drawCounts.clear();
+            drawOffsets.clear();
+            meshlet::cull(meshlets, meshlet::Frustum(*view, model), drawCounts, drawOffsets, view->stats);
+            if (drawCounts.empty())
+                return;
+        }
+        else if (view)
+        {
+            view->stats.triangles += indexCount / 3;
+            view->stats.trianglesSubmitted += indexCount / 3;
+            view->stats.drawRanges++;
+        }
+
+        // the sampler names and the locations only change with the program (or the textures)
+        if (shader.ID != locationsProgram || samplerLocations.size() != textures.size())
+            findLocations(shader);
+
+        // bind the textures, each sampler gets the unit of its texture. The bindings that are already there (the
+        // previous mesh had the same textures) are not sent again
+        GLState &state = GLState::instance();
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            shader.setInt(samplerLocations[i], i);
+            state.bindTexture(i, GL_TEXTURE_2D, textures[i].id);
+        }
+
+        // tell the shader how to decode the vertices
+        shader.setInt(packedVertexLocation, packed);
+        if (packed)
+        {
+            shader.setVec3(boundsMinLocation, boundsMin);
+            shader.setVec3(boundsSizeLocation, boundsSize);
+        }
+
+        // draw mesh
+        // the vertex array and the textures stay bound, the next draw changes what it needs
+        state.bindVertexArray(VAO);
+        if (culled)
+            glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(), (GLsizei) drawCounts.size());
+        else
+            glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+    }
+
+private:
+    /*  Render data  */
+    unsigned int VBO, EBO;
+    // index ranges of the visible meshlets, kept to not allocate them every frame
+    vector<GLsizei> drawCounts;
+    vector<const void*> drawOffsets;
+    // uniform locations in the program that drew the mesh last
+    unsigned int locationsProgram = 0;
+    vector<GLint> samplerLocations; // one per texture
+    GLint packedVertexLocation = -1, boundsMinLocation = -1, boundsSizeLocation = -1;
+
+    // looks up the uniforms the mesh sets in the program of shader
+    void findLocations(const Shader &shader)
+    {
+        locationsProgram = shader.ID;
+        samplerLocations.clear();
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int ambientNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -76,45 +171,58 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_ambient")
                 number = std::to_string(ambientNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            samplerLocations.push_back(shader.location(name + number));
         }
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        packedVertexLocation = shader.location("packedVertex");
+        boundsMinLocation = shader.location("boundsMin");
+        boundsSizeLocation = shader.location("boundsSize");
     }
 
-private:
-    /*  Render data  */
-    unsigned int VBO, EBO;
-
     /*  Functions    */
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount)
     {
+        this->indexCount = (unsigned int) indexCount;
+        this->vertexCount = (unsigned int) vertexCount;
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
         glBindVertexArray(VAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (packed)
+        {
+            vector<PackedVertex> packedVertices = packing::pack(vertexData, vertexCount, boundsMin, boundsSize);
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(PackedVertex), packedVertices.data(), GL_STATIC_DRAW);
+
+            // the integers are normalized by the GPU (to [0, 1] or [-1, 1]), the half floats converted to floats.
+            // the shader gets a vec4 position (w is the sign of the bitangent), the octahedral normal and tangent in
+            // the xy of the vec3 attributes, and computes the bitangent (location 4 is not used)
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, tangent));
+            glDisableVertexAttribArray(4);
+
+            glBindVertexArray(0);
+            return;
+        }
+
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
+        packing::bounds(vertexData, vertexCount, boundsMin, boundsSize);
 
         // set the vertex attribute pointers
         // vertex Positions
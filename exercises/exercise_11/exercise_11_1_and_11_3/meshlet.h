@@ -0,0 +1,254 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+// Splits the index buffer of a mesh into small clusters of triangles (meshlets) that can be culled on the CPU every
+// frame, so that the parts of a model that are outside of the view or that face away from the camera are not sent to
+// the GPU. Building is done once when the model is loaded, culling every frame for every mesh that is drawn.
+//
+// build walks the triangles in index buffer order (already optimized by mesh_optimizer.h, so neighbouring triangles
+// are close in space) and starts a new meshlet when the current one would have more than MAX_VERTICES vertices or
+// MAX_TRIANGLES triangles, or when the triangle faces too far away from the others. The index buffer is not changed,
+// every meshlet is a range of it.
+// Every meshlet has
+//   - a bounding sphere, tested against the 6 planes of the view frustum
+//   - a normal cone (axis and spread of the triangle normals). The meshlet is back facing if the camera is behind the
+//     planes of all its triangles, which is tested with the cone and the sphere only (the test is conservative, it
+//     never culls a triangle that faces the camera). Only valid when the triangles are drawn with GL_CULL_FACE
+//
+// cull keeps the visible meshlets and merges the ones that follow each other in the index buffer, the result is a list
+// of index ranges for a single glMultiDrawElements call.
+// The culling is done in the space of the mesh: the frustum planes come from viewProjection * model, and the camera
+// position is moved to mesh space, so the bounds never have to be transformed.
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+namespace meshlet {
+
+    // limits of a meshlet, the usual sizes of mesh shader clusters
+    const unsigned int MAX_VERTICES = 64;
+    const unsigned int MAX_TRIANGLES = 124;
+    // a triangle whose normal is further than this from the normal of the meshlet starts a new meshlet, so that the
+    // normal cones stay narrow enough to cull something (cosine of 60 degrees). Only once the meshlet has
+    // MIN_TRIANGLES, so that noisy meshes are not cut into tiny meshlets
+    const float MAX_NORMAL_SPREAD = 0.5f;
+    const unsigned int MIN_TRIANGLES = 32;
+
+    struct Meshlet {
+        uint32_t indexOffset;   // first index of the meshlet in the index buffer
+        uint32_t triangleCount;
+        uint32_t vertexCount;   // different vertices used by the triangles
+        glm::vec3 center;       // bounding sphere
+        float radius;
+        glm::vec3 coneAxis;     // average direction of the triangle normals
+        float coneCutoff;       // sine of the largest angle between a normal and the axis, 1 if the cone can't cull
+    };
+
+    struct Stats {
+        size_t meshlets = 0;
+        size_t frustumCulled = 0;
+        size_t coneCulled = 0;
+        size_t triangles = 0;          // triangles of the meshes that were drawn
+        size_t trianglesSubmitted = 0; // triangles left after the culling
+        size_t drawRanges = 0;         // index ranges given to glMultiDrawElements
+
+        // fraction of the meshlets that were culled
+        float cullRate() const { return meshlets ? (float) (frustumCulled + coneCulled) / meshlets : 0.0f; }
+
+        Stats &operator+=(const Stats &other)
+        {
+            meshlets += other.meshlets;
+            frustumCulled += other.frustumCulled;
+            coneCulled += other.coneCulled;
+            triangles += other.triangles;
+            trianglesSubmitted += other.trianglesSubmitted;
+            drawRanges += other.drawRanges;
+            return *this;
+        }
+    };
+
+    // the camera the meshes are culled against, and the statistics of what was culled
+    struct View {
+        glm::mat4 viewProjection;
+        glm::vec3 eye;                  // camera position in world space
+        bool frustumCulling = true;
+        bool backfaceCulling = true;    // cull with the normal cones, only while GL_CULL_FACE is enabled
+        Stats stats;
+
+        View(const glm::mat4 &viewProjection, const glm::vec3 &eye) : viewProjection(viewProjection), eye(eye) {}
+    };
+
+    // culling volume of one draw, in the space of the mesh
+    struct Frustum {
+        glm::vec4 planes[6]; // xyz normal pointing inside (unit length), w distance
+        glm::vec3 eye;
+        bool cullPlanes, cullCone;
+
+        Frustum(const View &view, const glm::mat4 &model)
+        {
+            // Gribb and Hartmann, the clip volume -w <= x, y, z <= w seen from mesh space
+            glm::mat4 m = view.viewProjection * model;
+            glm::vec4 rows[4];
+            for (int r = 0; r < 4; r++)
+                rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+            for (int i = 0; i < 6; i++)
+            {
+                planes[i] = i % 2 ? rows[3] - rows[i / 2] : rows[3] + rows[i / 2];
+                planes[i] /= glm::length(glm::vec3(planes[i]));
+            }
+            eye = glm::vec3(glm::inverse(model) * glm::vec4(view.eye, 1.0f));
+            cullPlanes = view.frustumCulling;
+            // a mirroring transform swaps the front and the back faces
+            cullCone = view.backfaceCulling && glm::determinant(glm::mat3(model)) > 0;
+        }
+    };
+
+    inline bool frustumCulled(const Meshlet &meshlet, const Frustum &frustum)
+    {
+        for (const glm::vec4 &plane : frustum.planes)
+            if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius)
+                return true;
+        return false;
+    }
+
+    // true if the camera at eye is behind the planes of all the triangles of the meshlet
+    inline bool coneCulled(const Meshlet &meshlet, const glm::vec3 &eye)
+    {
+        glm::vec3 toCenter = meshlet.center - eye;
+        return glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+    }
+
+    // splits the triangles of indices into meshlets, positionOf(vertex) returns the position of a vertex
+    template <class Vertex, class Index, class PositionOf>
+    std::vector<Meshlet> build(const Vertex *vertices, size_t vertexCount, const Index *indices, size_t indexCount,
+                               PositionOf positionOf)
+    {
+        std::vector<Meshlet> meshlets;
+        std::vector<uint32_t> usedBy(vertexCount, UINT32_MAX); // last meshlet that used each vertex
+        std::vector<glm::vec3> normals; // of the triangles of the current meshlet
+        glm::vec3 normalSum(0.0f);
+
+        // bounds of the current meshlet, it is the last one of meshlets
+        auto finish = [&]() {
+            Meshlet &meshlet = meshlets.back();
+            glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY);
+            for (size_t i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.triangleCount * 3; i++)
+            {
+                glm::vec3 position = positionOf(vertices[indices[i]]);
+                boundsMin = glm::min(boundsMin, position);
+                boundsMax = glm::max(boundsMax, position);
+            }
+            meshlet.center = (boundsMin + boundsMax) * 0.5f;
+            float radius2 = 0;
+            for (size_t i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.triangleCount * 3; i++)
+            {
+                glm::vec3 offset = positionOf(vertices[indices[i]]) - meshlet.center;
+                radius2 = std::max(radius2, glm::dot(offset, offset));
+            }
+            // a little margin for the rounding of the culling math
+            meshlet.radius = std::sqrt(radius2) * 1.0001f + 1e-6f;
+
+            // the cone can't cull if the normals spread over more than about 84 degrees, or if there are no normals
+            float sumLength = glm::length(normalSum);
+            meshlet.coneAxis = sumLength > 0 ? normalSum / sumLength : glm::vec3(0.0f);
+            meshlet.coneCutoff = 1.0f;
+            if (sumLength > 0)
+            {
+                float minDot = 1.0f;
+                for (const glm::vec3 &normal : normals)
+                    minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+                if (minDot > 0.1f)
+                    meshlet.coneCutoff = std::min(std::sqrt(1.0f - minDot * minDot) + 1e-4f, 1.0f);
+            }
+        };
+
+        for (size_t i = 0; i + 2 < indexCount; i += 3)
+        {
+            // geometric normal of the triangle, counter clockwise triangles are front facing. Zero if degenerate
+            glm::vec3 a = positionOf(vertices[indices[i]]), b = positionOf(vertices[indices[i + 1]]),
+                      c = positionOf(vertices[indices[i + 2]]);
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float area = glm::length(normal);
+            normal = area > 0 ? normal / area : glm::vec3(0.0f);
+
+            uint32_t current = (uint32_t) meshlets.size() - 1;
+            unsigned int newVertices = 0;
+            for (size_t k = 0; k < 3; k++)
+            {
+                Index v = indices[i + k];
+                bool repeated = (k > 0 && v == indices[i]) || (k == 2 && v == indices[i + 1]);
+                newVertices += usedBy[v] != current && !repeated;
+            }
+            bool full = meshlets.empty() || meshlets.back().triangleCount == MAX_TRIANGLES ||
+                        meshlets.back().vertexCount + newVertices > MAX_VERTICES;
+            bool turned = normals.size() >= MIN_TRIANGLES && area > 0 && glm::length(normalSum) > 0 &&
+                          glm::dot(normal, glm::normalize(normalSum)) < MAX_NORMAL_SPREAD;
+            if (full || turned)
+            {
+                if (!meshlets.empty())
+                    finish();
+                Meshlet meshlet = {};
+                meshlet.indexOffset = (uint32_t) i;
+                meshlets.push_back(meshlet);
+                normals.clear();
+                normalSum = glm::vec3(0.0f);
+                current = (uint32_t) meshlets.size() - 1;
+            }
+
+            Meshlet &meshlet = meshlets.back();
+            for (size_t k = 0; k < 3; k++)
+                if (usedBy[indices[i + k]] != current)
+                {
+                    usedBy[indices[i + k]] = current;
+                    meshlet.vertexCount++;
+                }
+            meshlet.triangleCount++;
+            if (area > 0)
+            {
+                normals.push_back(normal);
+                normalSum += normal;
+            }
+        }
+        if (!meshlets.empty())
+            finish();
+        return meshlets;
+    }
+
+    // appends the index ranges of the meshlets that pass the culling to counts and offsets (in bytes, indexSize bytes
+    // per index), meshlets that follow each other in the index buffer are merged into one range
+    inline void cull(const std::vector<Meshlet> &meshlets, const Frustum &frustum, std::vector<int> &counts,
+                     std::vector<const void*> &offsets, Stats &stats, size_t indexSize = sizeof(uint32_t))
+    {
+        size_t nextIndex = SIZE_MAX; // end of the last range
+        for (const Meshlet &meshlet : meshlets)
+        {
+            stats.meshlets++;
+            stats.triangles += meshlet.triangleCount;
+            if (frustum.cullPlanes && frustumCulled(meshlet, frustum))
+            {
+                stats.frustumCulled++;
+                continue;
+            }
+            if (frustum.cullCone && coneCulled(meshlet, frustum.eye))
+            {
+                stats.coneCulled++;
+                continue;
+            }
+            stats.trianglesSubmitted += meshlet.triangleCount;
+            if (meshlet.indexOffset == nextIndex)
+                counts.back() += (int) meshlet.triangleCount * 3;
+            else
+            {
+                counts.push_back((int) meshlet.triangleCount * 3);
+                offsets.push_back((const void*) (meshlet.indexOffset * indexSize));
+                stats.drawRanges++;
+            }
+            nextIndex = meshlet.indexOffset + meshlet.triangleCount * 3;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+// Loads models in the background, so that the start up time is close to the time of the slowest model instead of the
+// sum of all of them.
+//
+// The loading of a Model is split in the stages of model.h:
+// - prepare (mesh cache or assimp import, mesh optimization) runs on a worker thread, one job per model
+// - the textures of the model are decoded on the worker threads, one job per texture
+// - once all its textures are decoded, the model is queued for upload. The GL objects can only be created on the
+//   thread of the GL context, so processUploads, called once per frame by the render loop, runs upload steps (one
+//   texture or mesh each) until its time budget is used up.
+// Models draw nothing until they are ready, the render loop can start right away and show them as they come in.
+// A model whose file could not be read is done without ever being ready, it is counted by failedCount.
+
+#include <model.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+class ModelLoader {
+public:
+    // threads: number of worker threads, 0 means one per core
+    explicit ModelLoader(unsigned int threads = 0)
+    {
+        if (threads == 0)
+            threads = max(thread::hardware_concurrency(), 1u);
+        for (unsigned int i = 0; i < threads; i++)
+            workers.push_back(thread(&ModelLoader::workLoop, this));
+    }
+
+    ModelLoader(ModelLoader const&) = delete;
+    void operator=(ModelLoader const&) = delete;
+
+    // the jobs that did not start yet are dropped, the models they belong to never become ready
+    ~ModelLoader()
+    {
+        {
+            lock_guard<mutex> lock(jobMutex);
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+        for (thread &worker : workers)
+            worker.join();
+    }
+
+    // starts loading a model (the arguments are the ones of the Model constructor) and returns it right away.
+    // the model belongs to the caller and must outlive the loading
+    Model *load(string const &path, bool gamma = false, bool packed = false)
+    {
+        Model *model = new Model(path, gamma, packed, true);
+        loading.push_back(unique_ptr<Loading>(new Loading(model)));
+        Loading *state = loading.back().get();
+        submit([this, state]{ prepare(state); });
+        return model;
+    }
+
+    // runs upload steps for about budgetSeconds (at least one step if there is anything to upload).
+    // must be called by the thread of the GL context
+    void processUploads(double budgetSeconds = 0.004)
+    {
+        auto start = chrono::high_resolution_clock::now();
+        {
+            lock_guard<mutex> lock(uploadMutex);
+            uploading.insert(uploading.end(), uploadQueue.begin(), uploadQueue.end());
+            uploadQueue.clear();
+        }
+        // the oldest model first, so that the models become ready one after the other
+        while (!uploading.empty())
+        {
+            if (uploading.front()->uploadStep())
+            {
+                if (uploading.front()->hasFailed())
+                    failedModels++;
+                else
+                    readyModels++;
+                uploading.pop_front();
+            }
+            chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+            if (elapsed.count() >= budgetSeconds)
+                break;
+        }
+    }
+
+    // blocks until all the models are done, uploading them as they come in. Same thread as processUploads.
+    // returns true if they are all ready, false if some of them failed
+    bool waitAll()
+    {
+        while (!allDone())
+        {
+            {
+                unique_lock<mutex> lock(uploadMutex);
+                uploadAvailable.wait(lock, [this]{ return !uploadQueue.empty() || !uploading.empty(); });
+            }
+            processUploads(numeric_limits<double>::infinity());
+        }
+        return allReady();
+    }
+
+    size_t modelCount() const { return loading.size(); }
+    size_t readyCount() const { return readyModels; }
+    size_t failedCount() const { return failedModels; }
+    // every model is either ready or failed
+    bool allDone() const { return readyModels + failedModels == loading.size(); }
+    bool allReady() const { return readyModels == loading.size(); }
+    // fraction of the models that are done, 1 if there are none
+    float progress() const { return loading.empty() ? 1.0f : (float) (readyModels + failedModels) / loading.size(); }
+
+private:
+    struct Loading {
+        explicit Loading(Model *model) : model(model) {}
+        Model *model;
+        atomic<size_t> texturesLeft{0}; // textures still being decoded
+    };
+
+    vector<thread> workers;
+    deque<function<void()>> jobs;
+    mutex jobMutex;
+    condition_variable jobAvailable;
+    bool stopping = false;
+
+    // models with all their CPU work done, filled by the workers and emptied by processUploads
+    deque<Model*> uploadQueue;
+    mutex uploadMutex;
+    condition_variable uploadAvailable;
+
+    // only used by the GL thread
+    vector<unique_ptr<Loading>> loading;
+    deque<Model*> uploading;
+    size_t readyModels = 0;
+    size_t failedModels = 0;
+
+    void submit(function<void()> job)
+    {
+        {
+            lock_guard<mutex> lock(jobMutex);
+            jobs.push_back(std::move(job));
+        }
+        jobAvailable.notify_one();
+    }
+
+    void workLoop()
+    {
+        while (true)
+        {
+            function<void()> job;
+            {
+                unique_lock<mutex> lock(jobMutex);
+                jobAvailable.wait(lock, [this]{ return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    // worker thread: reads the model, then decodes its textures in parallel
+    void prepare(Loading *state)
+    {
+        Model *model = state->model;
+        model->prepare();
+        size_t textureCount = model->pendingTextureCount();
+        if (textureCount == 0)
+        {
+            queueUpload(model);
+            return;
+        }
+        state->texturesLeft = textureCount;
+        for (size_t i = 0; i < textureCount; i++)
+            submit([this, state, i]{
+                // every job writes to its own texture only. The last one to finish queues the model
+                state->model->decodeTexture(i);
+                if (--state->texturesLeft == 0)
+                    queueUpload(state->model);
+            });
+    }
+
+    void queueUpload(Model *model)
+    {
+        {
+            lock_guard<mutex> lock(uploadMutex);
+            uploadQueue.push_back(model);
+        }
+        uploadAvailable.notify_one();
+    }
+};
+
+#endif
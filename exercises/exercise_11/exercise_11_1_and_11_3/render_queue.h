@@ -0,0 +1,225 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+// Draws recorded during the frame and submitted in an order that changes the state as little as possible.
+//
+// Every draw gets a 64 bit sort key (the top 6 bits are not used), the queue is sorted by the keys and then drawn in
+// that order:
+//   opaque:      pass (2 bits) | program (8) | material (12) | depth (16)          | draw index (20)
+//   transparent: pass (2 bits) | far - depth (16) | program (8) | material (12)    | draw index (20)
+// The opaque draws are grouped by program and then by material (the first texture of the mesh), and drawn front to
+// back within a group so that the depth test rejects more fragments. The transparent draws must blend back to front,
+// so there the depth comes first. The draw index at the bottom makes every key unique, and keeps the draws that have
+// the same key in the order they were added.
+// The depth is the distance of the center of the mesh bounds along the view direction.
+//
+// The keys are sorted with a radix sort, 3 passes of 13 bits over the 38 bits above the draw index. The draw indices
+// are added in order, so the bottom bits are sorted already, and a pass where all the keys have the same digit is
+// skipped.
+
+#include <glm/glm.hpp>
+
+#include <shader.h>
+#include <mesh.h>
+#include <model.h>
+#include <meshlet.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+class RenderQueue {
+public:
+    enum Pass { PASS_OPAQUE = 0, PASS_TRANSPARENT = 1 };
+
+    enum {
+        INDEX_BITS = 20, DEPTH_BITS = 16, MATERIAL_BITS = 12, PROGRAM_BITS = 8, PASS_BITS = 2,
+        PASS_SHIFT = INDEX_BITS + DEPTH_BITS + MATERIAL_BITS + PROGRAM_BITS,
+        MAX_DRAWS = 1 << INDEX_BITS
+    };
+
+    // sets the uniforms of one draw, before the mesh is drawn
+    typedef void (*SetUniforms)(Shader &shader, const glm::mat4 &model);
+
+    struct Draw {
+        Mesh *mesh;
+        Shader *shader;
+        SetUniforms setUniforms;
+        glm::mat4 model;
+        meshlet::View *view; // culls the meshlets of the mesh if not null
+    };
+
+    struct Stats {
+        size_t draws = 0;
+        size_t droppedDraws = 0;     // added after the queue was full (MAX_DRAWS), they are not drawn
+        size_t programChanges = 0;   // in the order the draws were submitted
+        size_t materialChanges = 0;
+        size_t programChangesUnsorted = 0;  // in the order the draws were added
+        size_t materialChangesUnsorted = 0;
+        double sortMicroseconds = 0;
+    };
+
+    // starts a frame, the depths are measured with the view matrix, up to farDistance
+    void begin(const glm::mat4 &view, float farDistance = 100.0f)
+    {
+        this->view = view;
+        this->farDistance = farDistance;
+        draws.clear();
+        keys.clear();
+        dropped = 0;
+        sorted = false;
+        lastSubmitted = nullptr;
+    }
+
+    void add(Pass pass, Mesh &mesh, Shader &shader, const glm::mat4 &model, SetUniforms setUniforms,
+             meshlet::View *cullView = nullptr)
+    {
+        // the draw index has INDEX_BITS bits, further draws are dropped and counted in the stats
+        if (draws.size() >= MAX_DRAWS)
+        {
+            dropped++;
+            return;
+        }
+        glm::vec4 center = view * (model * glm::vec4(mesh.boundsCenter(), 1.0f));
+        float depth = std::max(0.0f, std::min(-center.z / farDistance, 1.0f));
+        keys.push_back(makeKey(pass, shader.ID, materialOf(mesh), depth, (uint32_t) draws.size()));
+        draws.push_back(Draw{&mesh, &shader, setUniforms, model, cullView});
+    }
+
+    // adds every mesh of the model with the world matrix of its node (see Model::Draw), nothing if it is still loading
+    void add(Pass pass, Model &model, Shader &shader, const glm::mat4 &transform, SetUniforms setUniforms,
+             meshlet::View *cullView = nullptr)
+    {
+        if (!model.isReady())
+            return;
+        model.nodes.update();
+        for (size_t i = 0; i < model.meshes.size(); i++)
+        {
+            int node = model.meshNodes[i];
+            glm::mat4 world = node == SceneGraph::NO_PARENT ? transform : transform * model.nodes.world(node);
+            add(pass, model.meshes[i], shader, world, setUniforms, cullView);
+        }
+    }
+
+    void sort()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        sortKeys(keys, sortBuffer);
+        sorted = true;
+
+        stats = Stats();
+        stats.draws = draws.size();
+        stats.droppedDraws = dropped;
+        stats.sortMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+        const Draw *last = nullptr;
+        for (const Draw &draw : draws)
+        {
+            countChanges(last, draw, stats.programChangesUnsorted, stats.materialChangesUnsorted);
+            last = &draw;
+        }
+    }
+
+    // draws the draws of the pass, sorted. The caller sets the state of the pass (blending, culling) before
+    void submit(Pass pass)
+    {
+        if (!sorted)
+            sort();
+        // the passes are at the top of the keys, so the draws of a pass are next to each other
+        uint64_t first = (uint64_t) pass << PASS_SHIFT;
+        auto begin = std::lower_bound(keys.begin(), keys.end(), first);
+        Shader *shader = nullptr;
+        for (auto key = begin; key != keys.end() && *key >> PASS_SHIFT == (uint64_t) pass; ++key)
+        {
+            Draw &draw = draws[*key & (MAX_DRAWS - 1)];
+            countChanges(lastSubmitted, draw, stats.programChanges, stats.materialChanges);
+            lastSubmitted = &draw;
+            if (draw.shader != shader)
+            {
+                shader = draw.shader;
+                shader->use();
+            }
+            draw.setUniforms(*draw.shader, draw.model);
+            draw.mesh->Draw(*draw.shader, draw.view, draw.model);
+        }
+    }
+
+    // the statistics of the last sorted frame, the changes are counted while submitting
+    const Stats &lastStats() const { return stats; }
+
+    size_t size() const { return draws.size(); }
+
+    static uint64_t makeKey(Pass pass, unsigned int program, unsigned int material, float depth, uint32_t index)
+    {
+        const uint64_t maxDepth = (1u << DEPTH_BITS) - 1;
+        uint64_t quantized = (uint64_t) (std::max(0.0f, std::min(depth, 1.0f)) * maxDepth);
+        uint64_t key = (uint64_t) pass << PASS_SHIFT;
+        uint64_t programBits = program & ((1u << PROGRAM_BITS) - 1);
+        uint64_t materialBits = material & ((1u << MATERIAL_BITS) - 1);
+        if (pass == PASS_TRANSPARENT)
+            key |= (maxDepth - quantized) << (MATERIAL_BITS + PROGRAM_BITS + INDEX_BITS) |
+                   programBits << (MATERIAL_BITS + INDEX_BITS) | materialBits << INDEX_BITS;
+        else
+            key |= programBits << (MATERIAL_BITS + DEPTH_BITS + INDEX_BITS) |
+                   materialBits << (DEPTH_BITS + INDEX_BITS) | quantized << INDEX_BITS;
+        return key | (index & (MAX_DRAWS - 1));
+    }
+
+    // sorts keys whose draw indices (the bottom INDEX_BITS) are already in increasing order, buffer is scratch memory
+    static void sortKeys(vector<uint64_t> &keys, vector<uint64_t> &buffer)
+    {
+        const int DIGIT_BITS = 13, DIGITS = (PASS_SHIFT + PASS_BITS - INDEX_BITS + DIGIT_BITS - 1) / DIGIT_BITS,
+                  BUCKETS = 1 << DIGIT_BITS;
+        buffer.resize(keys.size());
+        // the histograms of all the digits in one read of the keys
+        vector<uint32_t> counts(DIGITS * BUCKETS, 0);
+        for (uint64_t key : keys)
+            for (int d = 0; d < DIGITS; d++)
+                counts[d * BUCKETS + ((key >> (INDEX_BITS + d * DIGIT_BITS)) & (BUCKETS - 1))]++;
+
+        uint64_t *from = keys.data(), *to = buffer.data();
+        for (int d = 0; d < DIGITS; d++)
+        {
+            uint32_t *count = &counts[d * BUCKETS];
+            int shift = INDEX_BITS + d * DIGIT_BITS;
+            if (!keys.empty() && count[(from[0] >> shift) & (BUCKETS - 1)] == keys.size())
+                continue;
+            uint32_t offset = 0;
+            for (int b = 0; b < BUCKETS; b++)
+            {
+                uint32_t c = count[b];
+                count[b] = offset;
+                offset += c;
+            }
+            for (size_t i = 0; i < keys.size(); i++)
+                to[count[(from[i] >> shift) & (BUCKETS - 1)]++] = from[i];
+            std::swap(from, to);
+        }
+        if (from != keys.data())
+            keys.swap(buffer);
+    }
+
+private:
+    glm::mat4 view = glm::mat4(1.0f);
+    float farDistance = 100.0f;
+    vector<Draw> draws;
+    vector<uint64_t> keys, sortBuffer;
+    size_t dropped = 0;
+    bool sorted = false;
+    Stats stats;
+    const Draw *lastSubmitted = nullptr;
+
+    static unsigned int materialOf(const Mesh &mesh)
+    {
+        return mesh.textures.empty() ? 0 : mesh.textures[0].id;
+    }
+
+    static void countChanges(const Draw *last, const Draw &draw, size_t &programChanges, size_t &materialChanges)
+    {
+        programChanges += !last || last->shader != draw.shader;
+        materialChanges += !last || materialOf(*last->mesh) != materialOf(*draw.mesh);
+    }
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+// Transform hierarchy stored as flat arrays, a parent always comes before its children.
+//
+// Every node has a local matrix (relative to its parent) and a world matrix (parent world * local). Changing a local
+// matrix only marks the node dirty, update then walks the arrays once, from the first dirty node to the end, and
+// recomputes the world matrices of the dirty nodes and of everything below them. Since the parents come first, the
+// world matrix of the parent is always up to date when a child is reached, and a node below a dirty node is found by
+// looking at the flag of its parent only.
+// The nodes that did not change cost a flag check, the world matrices can be used directly as model matrices.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+using namespace std;
+
+class SceneGraph {
+public:
+    enum { NO_PARENT = -1 };
+
+    // adds a node below parent (NO_PARENT for a root), returns its index. The parent must already be in the graph,
+    // which keeps the parents before their children
+    int addNode(int parent, const glm::mat4 &local = glm::mat4(1.0f), const string &name = "")
+    {
+        int node = (int) locals.size();
+        parents.push_back(parent >= 0 && parent < node ? parent : NO_PARENT);
+        locals.push_back(local);
+        worlds.push_back(local);
+        names.push_back(name);
+        dirty.push_back(1);
+        firstDirty = std::min(firstDirty, (size_t) node);
+        return node;
+    }
+
+    void setLocal(int node, const glm::mat4 &local)
+    {
+        locals[node] = local;
+        dirty[node] = 1;
+        firstDirty = std::min(firstDirty, (size_t) node);
+    }
+
+    // recomputes the world matrices that changed, returns how many were recomputed
+    size_t update()
+    {
+        size_t updated = 0;
+        for (size_t i = firstDirty; i < locals.size(); i++)
+        {
+            int parent = parents[i];
+            // dirty[parent] is still set during this pass if the parent was recomputed
+            if (!dirty[i] && (parent == NO_PARENT || !dirty[parent]))
+                continue;
+            dirty[i] = 1;
+            worlds[i] = parent == NO_PARENT ? locals[i] : worlds[parent] * locals[i];
+            updated++;
+        }
+        // the flags are cleared after the pass, so that the children could see them
+        for (size_t i = firstDirty; i < dirty.size(); i++)
+            dirty[i] = 0;
+        firstDirty = locals.size();
+        return updated;
+    }
+
+    size_t size() const { return locals.size(); }
+    int parent(int node) const { return parents[node]; }
+    const string &name(int node) const { return names[node]; }
+    const glm::mat4 &local(int node) const { return locals[node]; }
+    // world matrix as of the last update
+    const glm::mat4 &world(int node) const { return worlds[node]; }
+    const vector<glm::mat4> &worldMatrices() const { return worlds; }
+
+    // first node with that name, NO_PARENT if there is none
+    int find(const string &name) const
+    {
+        for (size_t i = 0; i < names.size(); i++)
+            if (names[i] == name)
+                return (int) i;
+        return NO_PARENT;
+    }
+
+    void clear()
+    {
+        parents.clear();
+        locals.clear();
+        worlds.clear();
+        names.clear();
+        dirty.clear();
+        firstDirty = 0;
+    }
+
+private:
+    vector<int> parents;
+    vector<glm::mat4> locals;
+    vector<glm::mat4> worlds;
+    vector<string> names;
+    vector<unsigned char> dirty;
+    size_t firstDirty = 0; // no node before it is dirty
+};
+
+#endif
@@ -1,5 +1,5 @@
 #version 330 core
-layout (location = 0) in vec3 position;
+layout (location = 0) in vec4 position; // w is the sign of the bitangent for packed vertices
 layout (location = 1) in vec3 normal;
 
 out VS_OUT {
@@ -12,12 +12,29 @@ uniform mat4 modelInvT;
 uniform mat4 view;
 uniform mat4 projection;
 
+// packed vertices (see packed_vertex.h): the position is relative to the bounds of the mesh, and the normal and
+// tangent are octahedral encoded in the xy of their attributes
+uniform bool packedVertex;
+uniform vec3 boundsMin;
+uniform vec3 boundsSize;
+
+vec3 octDecode(vec2 e) {
+   vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+   if (n.z < 0.0)
+      n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+   return normalize(n);
+}
+
 void main()
 {
+   // decode the vertex attributes
+   vec3 vertexPosition = packedVertex ? boundsMin + position.xyz * boundsSize : position.xyz;
+   vec3 vertexNormal = packedVertex ? octDecode(normal.xy) : normal;
+
    // we send the normal and position to the fragment shader in WORLD space
-   vout.normal = mat3(modelInvT) * normal;
-   vout.position = vec3(model * vec4(position, 1.0));
+   vout.normal = mat3(modelInvT) * vertexNormal;
+   vout.position = vec3(model * vec4(vertexPosition, 1.0));
    // this is just the usual
-   gl_Position = projection * view * model * vec4(position, 1.0);
+   gl_Position = projection * view * model * vec4(vertexPosition, 1.0);
 }
 
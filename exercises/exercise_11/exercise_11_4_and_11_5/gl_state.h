@@ -0,0 +1,214 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+// Cache of the OpenGL state that the draws set over and over: the program, the vertex array, the buffer bindings, the
+// textures of each unit, and the blend, depth and cull state.
+// GLState remembers the last value it set and drops a call that would set the same value again, so a draw only pays
+// for the state that is different from the previous draw. The state is unknown at the start and after invalidate,
+// the next call of every kind then reaches OpenGL.
+// Code that changes the state without GLState (texture and mesh uploads, ImGui) leaves the cache out of date, the
+// render loops call invalidate once per frame before drawing for that reason.
+//
+// The GL functions are called through a table (GLFunctions), so the cache can be tested without a GPU by giving it
+// functions that record the calls.
+// GL_ELEMENT_ARRAY_BUFFER is part of the vertex array, its bindings are not cached.
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+struct GLFunctions {
+    void (APIENTRY *useProgram)(GLuint program);
+    void (APIENTRY *bindVertexArray)(GLuint array);
+    void (APIENTRY *bindBuffer)(GLenum target, GLuint buffer);
+    void (APIENTRY *activeTexture)(GLenum texture);
+    void (APIENTRY *bindTexture)(GLenum target, GLuint texture);
+    void (APIENTRY *enable)(GLenum cap);
+    void (APIENTRY *disable)(GLenum cap);
+    void (APIENTRY *depthFunc)(GLenum func);
+    void (APIENTRY *depthMask)(GLboolean flag);
+    void (APIENTRY *blendFunc)(GLenum sfactor, GLenum dfactor);
+
+    // the functions loaded by glad, only valid after gladLoadGLLoader
+    static GLFunctions opengl()
+    {
+        GLFunctions functions;
+        functions.useProgram = glUseProgram;
+        functions.bindVertexArray = glBindVertexArray;
+        functions.bindBuffer = glBindBuffer;
+        functions.activeTexture = glActiveTexture;
+        functions.bindTexture = glBindTexture;
+        functions.enable = glEnable;
+        functions.disable = glDisable;
+        functions.depthFunc = glDepthFunc;
+        functions.depthMask = glDepthMask;
+        functions.blendFunc = glBlendFunc;
+        return functions;
+    }
+};
+
+class GLState {
+public:
+    enum { TEXTURE_UNITS = 16 };
+
+    struct Counts {
+        size_t issued = 0;   // calls that reached OpenGL
+        size_t filtered = 0; // calls dropped because the state already had the value
+        size_t total() const { return issued + filtered; }
+    };
+
+    // false sends every call to OpenGL (the counts still tell how many could have been dropped), to compare
+    bool filtering = true;
+
+    // the state of the OpenGL context, the first use must be after gladLoadGLLoader
+    static GLState &instance()
+    {
+        static GLState state(GLFunctions::opengl());
+        return state;
+    }
+
+    explicit GLState(const GLFunctions &functions) : gl(functions)
+    {
+        invalidate();
+    }
+
+    GLState(GLState const&) = delete;
+    void operator=(GLState const&) = delete;
+
+    // forgets the cached values, for after the state was changed without GLState
+    void invalidate()
+    {
+        program = vertexArray = arrayBuffer = uniformBuffer = activeUnit = UNKNOWN;
+        for (GLuint (&unit)[TEXTURE_TARGETS] : textures)
+            for (GLuint &texture : unit)
+                texture = UNKNOWN;
+        for (GLuint &cap : caps)
+            cap = UNKNOWN;
+        depthFunction = depthWrite = blendSource = blendDestination = UNKNOWN;
+    }
+
+    void useProgram(GLuint program)
+    {
+        if (changes(this->program, program))
+            gl.useProgram(program);
+    }
+
+    void bindVertexArray(GLuint vertexArray)
+    {
+        if (changes(this->vertexArray, vertexArray))
+            gl.bindVertexArray(vertexArray);
+    }
+
+    void bindBuffer(GLenum target, GLuint buffer)
+    {
+        GLuint *cached = target == GL_ARRAY_BUFFER ? &arrayBuffer : target == GL_UNIFORM_BUFFER ? &uniformBuffer : nullptr;
+        if (!cached)
+        {
+            counts.issued++;
+            gl.bindBuffer(target, buffer);
+        }
+        else if (changes(*cached, buffer))
+            gl.bindBuffer(target, buffer);
+    }
+
+    // binds texture to target in the texture unit (0 for GL_TEXTURE0), the active unit is only changed when the
+    // binding has to change
+    void bindTexture(GLuint unit, GLenum target, GLuint texture)
+    {
+        int slot = target == GL_TEXTURE_2D ? 0 : target == GL_TEXTURE_CUBE_MAP ? 1 : -1;
+        if (unit >= TEXTURE_UNITS || slot < 0)
+        {
+            activeTexture(unit);
+            counts.issued++;
+            gl.bindTexture(target, texture);
+        }
+        else if (textures[unit][slot] != texture || !filtering)
+        {
+            activeTexture(unit);
+            changes(textures[unit][slot], texture);
+            gl.bindTexture(target, texture);
+        }
+        else
+            counts.filtered++;
+    }
+
+    // makes the texture unit active, for code that binds textures without GLState
+    void activeTexture(GLuint unit)
+    {
+        if (changes(activeUnit, unit))
+            gl.activeTexture(GL_TEXTURE0 + unit);
+    }
+
+    // GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE are cached, the other capabilities are passed on
+    void setEnabled(GLenum cap, bool enabled)
+    {
+        int slot = cap == GL_BLEND ? 0 : cap == GL_DEPTH_TEST ? 1 : cap == GL_CULL_FACE ? 2 : -1;
+        if (slot >= 0 && !changes(caps[slot], enabled))
+            return;
+        if (slot < 0)
+            counts.issued++;
+        if (enabled)
+            gl.enable(cap);
+        else
+            gl.disable(cap);
+    }
+    void enable(GLenum cap) { setEnabled(cap, true); }
+    void disable(GLenum cap) { setEnabled(cap, false); }
+
+    void depthFunc(GLenum function)
+    {
+        if (changes(depthFunction, function))
+            gl.depthFunc(function);
+    }
+
+    void depthMask(bool write)
+    {
+        if (changes(depthWrite, write))
+            gl.depthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    void blendFunc(GLenum source, GLenum destination)
+    {
+        if (blendSource != source || blendDestination != destination || !filtering)
+        {
+            blendSource = source;
+            blendDestination = destination;
+            counts.issued++;
+            gl.blendFunc(source, destination);
+        }
+        else
+            counts.filtered++;
+    }
+
+    // calls since the last reset, reset them once per frame
+    const Counts &callCounts() const { return counts; }
+    void resetCallCounts() { counts = Counts(); }
+
+private:
+    // no GL name or enum has this value
+    enum : GLuint { UNKNOWN = 0xFFFFFFFFu };
+    enum { TEXTURE_TARGETS = 2 }; // GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP
+
+    GLFunctions gl;
+    Counts counts;
+
+    GLuint program, vertexArray, arrayBuffer, uniformBuffer, activeUnit;
+    GLuint textures[TEXTURE_UNITS][TEXTURE_TARGETS];
+    GLuint caps[3]; // GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE
+    GLuint depthFunction, depthWrite, blendSource, blendDestination;
+
+    // true if the call has to reach OpenGL, and then cached becomes value
+    bool changes(GLuint &cached, GLuint value)
+    {
+        if (cached == value && filtering)
+        {
+            counts.filtered++;
+            return false;
+        }
+        cached = value;
+        counts.issued++;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,444 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+// Binary cache of the meshes of a model, so that the assimp import (triangulation, tangent space, ...) only runs once.
+//
+// After a model is imported, the final Vertex and index arrays of every Mesh, the type and path of its textures and
+// the node hierarchy of the model (see scene_graph.h) are written to <model path>.meshcache. On the next launch the
+// cache is memory mapped and the arrays are uploaded to the GPU straight from the mapping, without any parsing.
+//
+// The cache is ignored (and rewritten after the import) if its version, the size of Vertex or the assimp flags don't
+// match, or if the size or modification time of the source file or of one of its material libraries (the mtllib
+// files of an OBJ) changed. A cache that does not hold together (a record outside the file, a node whose parent does
+// not come before it, an index past the vertices of its mesh) is ignored too.
+// Numbers are stored in the byte order of the machine, the cache is meant to live next to the build, not to be shipped.
+//
+// File layout, every array starts at a multiple of 16 bytes:
+//   Header
+//   MeshRecord[meshCount]
+//   NodeRecord[nodeCount]
+//   DependencyRecord[dependencyCount], then the node names and the dependency paths
+//   per mesh: textures (uint32 type length, uint32 path length, type, path), Vertex[vertexCount], uint32[indexCount]
+
+#include <mesh.h>
+#include <scene_graph.h>
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// a mesh as stored in the cache, the pointers point into the mapped file and are valid while the cache is open
+struct CachedMesh {
+    const Vertex *vertices;
+    unsigned int vertexCount;
+    const unsigned int *indices;
+    unsigned int indexCount;
+    vector<Texture> textures; // only type and path are set
+    int node;                 // node of the mesh in nodes()
+};
+
+class MeshCache {
+public:
+    // increase it when the content changes, 2: meshes are reordered by mesh_optimizer.h, 3: node hierarchy,
+    // 4: material libraries
+    static const uint32_t VERSION = 4;
+
+    MeshCache() = default;
+    MeshCache(MeshCache const&) = delete;
+    void operator=(MeshCache const&) = delete;
+    ~MeshCache() { close(); }
+
+    static string cachePath(const string &sourcePath) { return sourcePath + ".meshcache"; }
+
+    // maps the cache of sourcePath, returns false if there is no cache or it is out of date
+    bool open(const string &sourcePath, unsigned int importFlags)
+    {
+        close();
+        Header expected;
+        if (!makeHeader(sourcePath, importFlags, 0, expected) || !map(cachePath(sourcePath)))
+            return false;
+
+        Header header;
+        if (length < sizeof(Header))
+            return fail();
+        memcpy(&header, bytes, sizeof(Header));
+        if (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version ||
+            header.vertexSize != expected.vertexSize || header.importFlags != expected.importFlags ||
+            header.sourceSize != expected.sourceSize || header.sourceTime != expected.sourceTime)
+            return fail();
+        uint64_t nodesOffset = sizeof(Header) + (uint64_t) header.meshCount * sizeof(MeshRecord);
+        uint64_t dependenciesOffset = nodesOffset + (uint64_t) header.nodeCount * sizeof(NodeRecord);
+        if (header.meshCount > (length - sizeof(Header)) / sizeof(MeshRecord) ||
+            !inside(nodesOffset, (uint64_t) header.nodeCount * sizeof(NodeRecord)) ||
+            !inside(dependenciesOffset, (uint64_t) header.dependencyCount * sizeof(DependencyRecord)))
+            return fail();
+
+        const DependencyRecord *dependencyRecords = (const DependencyRecord *) (bytes + dependenciesOffset);
+        for (uint32_t d = 0; d < header.dependencyCount; d++)
+        {
+            const DependencyRecord &record = dependencyRecords[d];
+            if (!inside(record.pathOffset, record.pathLength))
+                return fail();
+            DependencyRecord current;
+            makeDependency(sourcePath, string(bytes + record.pathOffset, record.pathLength), current);
+            if (current.size != record.size || current.time != record.time)
+                return fail();
+        }
+
+        const NodeRecord *nodeRecords = (const NodeRecord *) (bytes + nodesOffset);
+        for (uint32_t n = 0; n < header.nodeCount; n++)
+        {
+            const NodeRecord &record = nodeRecords[n];
+            // a parent always comes before its children (see scene_graph.h)
+            if (!inside(record.nameOffset, record.nameLength) ||
+                (record.parent != SceneGraph::NO_PARENT && (record.parent < 0 || (uint32_t) record.parent >= n)))
+                return fail();
+            glm::mat4 local;
+            memcpy(&local, record.local, sizeof(local));
+            cachedNodes.addNode(record.parent, local, string(bytes + record.nameOffset, record.nameLength));
+        }
+        cachedNodes.update();
+
+        const MeshRecord *records = (const MeshRecord *) (bytes + sizeof(Header));
+        cachedMeshes.resize(header.meshCount);
+        for (uint32_t m = 0; m < header.meshCount; m++)
+        {
+            const MeshRecord &record = records[m];
+            CachedMesh &mesh = cachedMeshes[m];
+            if (!inside(record.vertexOffset, (uint64_t) record.vertexCount * sizeof(Vertex)) ||
+                !inside(record.indexOffset, (uint64_t) record.indexCount * sizeof(unsigned int)))
+                return fail();
+            mesh.vertices = (const Vertex *) (bytes + record.vertexOffset);
+            mesh.vertexCount = record.vertexCount;
+            mesh.indices = (const unsigned int *) (bytes + record.indexOffset);
+            mesh.indexCount = record.indexCount;
+            for (uint32_t i = 0; i < record.indexCount; i++)
+                if (mesh.indices[i] >= record.vertexCount)
+                    return fail();
+            mesh.node = record.node < header.nodeCount ? (int) record.node : SceneGraph::NO_PARENT;
+
+            uint64_t offset = record.textureOffset;
+            for (uint32_t t = 0; t < record.textureCount; t++)
+            {
+                uint32_t lengths[2];
+                if (!inside(offset, sizeof(lengths)))
+                    return fail();
+                memcpy(lengths, bytes + offset, sizeof(lengths));
+                offset += sizeof(lengths);
+                if (!inside(offset, (uint64_t) lengths[0] + lengths[1]))
+                    return fail();
+                Texture texture;
+                texture.id = 0;
+                texture.type.assign(bytes + offset, lengths[0]);
+                texture.path.assign(bytes + offset + lengths[0], lengths[1]);
+                offset += lengths[0] + lengths[1];
+                mesh.textures.push_back(texture);
+            }
+        }
+        return true;
+    }
+
+    const vector<CachedMesh> &meshes() const { return cachedMeshes; }
+    const SceneGraph &nodes() const { return cachedNodes; }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes) munmap((void *) bytes, length);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        bytes = nullptr;
+        length = 0;
+        cachedMeshes.clear();
+        cachedNodes.clear();
+    }
+
+    // writes the cache of sourcePath, the meshes must still have their vertices and indices (as after an import).
+    // MeshType is anything with vertices, indices and textures members like Mesh, and a node member (index in nodes)
+    template<class MeshType>
+    static bool write(const string &sourcePath, unsigned int importFlags, const vector<MeshType> &meshes, const SceneGraph &nodes)
+    {
+        Header header;
+        if (!makeHeader(sourcePath, importFlags, (uint32_t) meshes.size(), header))
+            return false;
+        header.nodeCount = (uint32_t) nodes.size();
+        vector<string> dependencies = materialLibraries(sourcePath);
+        header.dependencyCount = (uint32_t) dependencies.size();
+
+        // lay out the file first, so that it can be written front to back
+        vector<MeshRecord> records(meshes.size());
+        vector<NodeRecord> nodeRecords(nodes.size());
+        vector<DependencyRecord> dependencyRecords(dependencies.size());
+        uint64_t offset = sizeof(Header) + records.size() * sizeof(MeshRecord) + nodeRecords.size() * sizeof(NodeRecord) +
+                          dependencyRecords.size() * sizeof(DependencyRecord);
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            NodeRecord &record = nodeRecords[n];
+            memset(&record, 0, sizeof(NodeRecord));
+            memcpy(record.local, &nodes.local((int) n), sizeof(record.local));
+            record.parent = nodes.parent((int) n);
+            record.nameOffset = offset;
+            record.nameLength = (uint32_t) nodes.name((int) n).size();
+            offset += record.nameLength;
+        }
+        for (size_t d = 0; d < dependencies.size(); d++)
+        {
+            DependencyRecord &record = dependencyRecords[d];
+            makeDependency(sourcePath, dependencies[d], record);
+            record.pathOffset = offset;
+            record.pathLength = (uint32_t) dependencies[d].size();
+            offset += record.pathLength;
+        }
+        offset = align(offset);
+        for (size_t m = 0; m < meshes.size(); m++)
+        {
+            MeshRecord &record = records[m];
+            memset(&record, 0, sizeof(MeshRecord));
+            record.node = (uint32_t) meshes[m].node;
+            record.textureOffset = offset;
+            record.textureCount = (uint32_t) meshes[m].textures.size();
+            for (const Texture &texture : meshes[m].textures)
+                offset += 2 * sizeof(uint32_t) + texture.type.size() + texture.path.size();
+            record.vertexOffset = offset = align(offset);
+            record.vertexCount = (uint32_t) meshes[m].vertices.size();
+            offset += (uint64_t) record.vertexCount * sizeof(Vertex);
+            record.indexOffset = offset = align(offset);
+            record.indexCount = (uint32_t) meshes[m].indices.size();
+            offset = align(offset + (uint64_t) record.indexCount * sizeof(unsigned int));
+        }
+
+        // write to a temporary file and rename it, so that an interrupted write never leaves a broken cache behind
+        string path = cachePath(sourcePath);
+        string temporaryPath = path + ".tmp";
+        FILE *out = fopen(temporaryPath.c_str(), "wb");
+        if (!out)
+            return false;
+        uint64_t written = 0;
+        bool ok = put(out, &header, sizeof(Header), written) &&
+                  put(out, records.data(), records.size() * sizeof(MeshRecord), written) &&
+                  put(out, nodeRecords.data(), nodeRecords.size() * sizeof(NodeRecord), written) &&
+                  put(out, dependencyRecords.data(), dependencyRecords.size() * sizeof(DependencyRecord), written);
+        for (size_t n = 0; n < nodes.size() && ok; n++)
+            ok = put(out, nodes.name((int) n).data(), nodeRecords[n].nameLength, written);
+        for (size_t d = 0; d < dependencies.size() && ok; d++)
+            ok = put(out, dependencies[d].data(), dependencyRecords[d].pathLength, written);
+        for (size_t m = 0; m < meshes.size() && ok; m++)
+        {
+            ok = pad(out, records[m].textureOffset, written);
+            for (const Texture &texture : meshes[m].textures)
+            {
+                uint32_t lengths[2] = {(uint32_t) texture.type.size(), (uint32_t) texture.path.size()};
+                ok = ok && put(out, lengths, sizeof(lengths), written) &&
+                     put(out, texture.type.data(), lengths[0], written) &&
+                     put(out, texture.path.data(), lengths[1], written);
+            }
+            ok = ok && pad(out, records[m].vertexOffset, written) &&
+                 put(out, meshes[m].vertices.data(), meshes[m].vertices.size() * sizeof(Vertex), written) &&
+                 pad(out, records[m].indexOffset, written) &&
+                 put(out, meshes[m].indices.data(), meshes[m].indices.size() * sizeof(unsigned int), written);
+        }
+        ok = fclose(out) == 0 && ok;
+
+        remove(path.c_str()); // rename does not replace an existing file on Windows
+        if (!ok || rename(temporaryPath.c_str(), path.c_str()) != 0)
+        {
+            remove(temporaryPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t vertexSize;
+        uint32_t importFlags;
+        uint32_t meshCount;
+        uint32_t nodeCount;
+        uint32_t dependencyCount;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+    };
+
+    struct MeshRecord {
+        uint64_t textureOffset;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint32_t textureCount;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t node;
+    };
+
+    struct NodeRecord {
+        float local[16]; // column major, as glm
+        int32_t parent;
+        uint32_t nameLength;
+        uint64_t nameOffset;
+    };
+
+    // a file the import also read, with its size and modification time when the cache was written
+    struct DependencyRecord {
+        uint64_t size;    // UINT64_MAX if the file did not exist
+        int64_t time;
+        uint64_t pathOffset;
+        uint32_t pathLength; // the path is relative to the directory of the source file
+        uint32_t padding;
+    };
+
+    const char *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    vector<CachedMesh> cachedMeshes;
+    SceneGraph cachedNodes;
+
+    // header the cache of sourcePath should have, fails if the source file does not exist
+    static bool makeHeader(const string &sourcePath, unsigned int importFlags, uint32_t meshCount, Header &header)
+    {
+        struct stat sourceStat;
+        if (stat(sourcePath.c_str(), &sourceStat) != 0)
+            return false;
+        memset(&header, 0, sizeof(Header));
+        memcpy(header.magic, "MESHCACH", sizeof(header.magic));
+        header.version = VERSION;
+        header.vertexSize = sizeof(Vertex);
+        header.importFlags = importFlags;
+        header.meshCount = meshCount;
+        header.sourceSize = (uint64_t) sourceStat.st_size;
+        header.sourceTime = (int64_t) sourceStat.st_mtime;
+        return true;
+    }
+
+    static string directoryOf(const string &sourcePath)
+    {
+        size_t slash = sourcePath.find_last_of("/\\");
+        return slash == string::npos ? string() : sourcePath.substr(0, slash + 1);
+    }
+
+    static void makeDependency(const string &sourcePath, const string &dependency, DependencyRecord &record)
+    {
+        memset(&record, 0, sizeof(DependencyRecord));
+        struct stat dependencyStat;
+        if (stat((directoryOf(sourcePath) + dependency).c_str(), &dependencyStat) != 0)
+        {
+            record.size = UINT64_MAX;
+            return;
+        }
+        record.size = (uint64_t) dependencyStat.st_size;
+        record.time = (int64_t) dependencyStat.st_mtime;
+    }
+
+    // the material libraries named by the mtllib lines of an OBJ file (none for other formats). Only read when the
+    // cache is written, the import has just read the whole file anyway
+    static vector<string> materialLibraries(const string &sourcePath)
+    {
+        vector<string> libraries;
+        size_t dot = sourcePath.find_last_of('.');
+        string extension = dot == string::npos ? string() : sourcePath.substr(dot + 1);
+        for (char &c : extension)
+            c = (char) tolower((unsigned char) c);
+        FILE *in = extension == "obj" ? fopen(sourcePath.c_str(), "rb") : nullptr;
+        if (!in)
+            return libraries;
+        char line[4096];
+        while (fgets(line, sizeof(line), in))
+        {
+            if (strncmp(line, "mtllib", 6) != 0 || !isspace((unsigned char) line[6]))
+                continue;
+            // the names are separated by white space
+            for (const char *c = line + 6; *c;)
+            {
+                while (isspace((unsigned char) *c))
+                    c++;
+                const char *end = c;
+                while (*end && !isspace((unsigned char) *end))
+                    end++;
+                string name(c, end);
+                if (!name.empty() && find(libraries.begin(), libraries.end(), name) == libraries.end())
+                    libraries.push_back(name);
+                c = end;
+            }
+        }
+        fclose(in);
+        return libraries;
+    }
+
+    static uint64_t align(uint64_t offset) { return (offset + 15) & ~(uint64_t) 15; }
+
+    static bool put(FILE *out, const void *data, size_t size, uint64_t &written)
+    {
+        written += size;
+        return size == 0 || fwrite(data, 1, size, out) == size;
+    }
+
+    static bool pad(FILE *out, uint64_t offset, uint64_t &written)
+    {
+        static const char zeros[16] = {};
+        return offset >= written && put(out, zeros, (size_t) (offset - written), written);
+    }
+
+    bool inside(uint64_t offset, uint64_t size) const { return offset <= length && size <= length - offset; }
+
+    bool fail()
+    {
+        close();
+        return false;
+    }
+
+    bool map(const string &path)
+    {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+            return fail();
+        length = (size_t) fileSize.QuadPart;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        bytes = mapping ? (const char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+            return fail();
+        length = (size_t) fileStat.st_size;
+        void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        bytes = address == MAP_FAILED ? nullptr : (const char *) address;
+#endif
+        return bytes ? true : fail();
+    }
+};
+
+#endif
@@ -12,6 +12,10 @@
 #include <assimp/postprocess.h>
 
 #include <mesh.h>
+#include <mesh_cache.h>
+#include <mesh_optimizer.h>
+#include <scene_graph.h>
+#include <texture_cache.h>
 #include <shader.h>
 
 #include <string>
@@ -19,6 +23,7 @@
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
@@ -28,66 +33,259 @@ class Model
 {
 public:
     /*  Model Data */
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// stores all the textures of the model, they are shared with the other models by the TextureCache (texture_cache.h)
     vector<Mesh> meshes;
     string directory;
     bool gammaCorrection;
+    bool packedVertices; // upload the vertices in the packed format (see packed_vertex.h)
+    bool loadedFromCache = false; // true if the meshes came from the mesh cache instead of an assimp import
+    // vertex cache efficiency of the imported meshes before and after reordering them (see mesh_optimizer.h),
+    // summed over all the meshes. Only set by an import, the cached meshes are already optimized
+    meshopt::CacheStats cacheStatsBefore, cacheStatsAfter;
+    // the node hierarchy of the file, with the transform of every node (see scene_graph.h)
+    SceneGraph nodes;
+    vector<int> meshNodes; // node of each mesh in nodes
 
     /*  Functions   */
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // if deferred, nothing is loaded yet: the loading is done in stages by prepare, decodeTexture and uploadStep
+    // (ModelLoader in model_loader.h runs them on worker threads and the GL thread)
+    Model(string const &path, bool gamma = false, bool packed = false, bool deferred = false)
+        : gammaCorrection(gamma), packedVertices(packed), path(path)
     {
-        loadModel(path);
+        if (!deferred)
+            loadModel();
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader shader)
+    // draws the model, and thus all its meshes. a model that is still loading draws nothing
+    void Draw(Shader &shader)
     {
+        if (!ready)
+            return;
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
 
-private:
-    /*  Functions   */
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    // draws the model with the model matrix, only the meshlets (see meshlet.h) that can be seen from view are drawn
+    void Draw(Shader &shader, meshlet::View &view, const glm::mat4 &model)
+    {
+        if (!ready)
+            return;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(shader, &view, model);
+    }
+
+    // draws every mesh with the world matrix of its node: setTransform(transform * node world) is called before each
+    // mesh, so that the caller can set the matrix uniforms the way its shader wants them.
+    // if there is a view, the meshlets that it can't see are culled
+    template <class SetTransform>
+    void Draw(Shader &shader, const glm::mat4 &transform, SetTransform setTransform, meshlet::View *view = nullptr)
+    {
+        if (!ready)
+            return;
+        nodes.update();
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            int node = meshNodes[i];
+            glm::mat4 world = node == SceneGraph::NO_PARENT ? transform : transform * nodes.world(node);
+            setTransform(world);
+            meshes[i].Draw(shader, view, world);
+        }
+    }
+
+    bool isReady() const { return ready; }
+    // true if the file could not be read, the model then never becomes ready
+    bool hasFailed() const { return failed; }
+
+    /*  Loading in stages  */
+    // 1. reads the model into CPU memory, from the mesh cache or with assimp. No GL calls, can run on any thread
+    void prepare()
     {
+        const unsigned int importFlags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        if (prepareCachedModel(importFlags))
+        {
+            buildMeshlets();
+            return;
+        }
+
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, importFlags);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            failed = true;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+        nodes.update();
+
+        for (meshopt::CacheStats *stats : {&cacheStatsBefore, &cacheStatsAfter})
+        {
+            stats->acmr = importedTriangles ? (float) stats->transformedVertices / importedTriangles : 0;
+            stats->atvr = importedVertices ? (float) stats->transformedVertices / importedVertices : 0;
+        }
+        cout << path << ": vertex cache ACMR " << cacheStatsBefore.acmr << " -> " << cacheStatsAfter.acmr
+             << ", ATVR " << cacheStatsBefore.atvr << " -> " << cacheStatsAfter.atvr << endl;
+
+        if (!MeshCache::write(path, importFlags, preparedMeshes, nodes))
+            cout << "WARNING::MESH_CACHE:: could not write " << MeshCache::cachePath(path) << endl;
+        buildMeshlets();
+    }
+
+    // 2. decodes the texture files (after prepare) that are not in the texture cache yet.
+    //    No GL calls, different textures can be decoded in parallel
+    size_t pendingTextureCount() const { return pendingTextures.size(); }
+    const vector<Texture> &pendingTextureList() const { return pendingTextures; }
+    void decodeTexture(size_t i) { TextureCache::instance().decode(textureHandles[i]); }
+
+    // 3. creates the GL objects, one texture or one mesh per call so that the work can be spread over several frames.
+    //    must run on the thread of the GL context, returns true once the model is done: ready to draw, or failed
+    //    (there is nothing to upload then)
+    bool uploadStep()
+    {
+        if (ready || failed)
+            return true;
+        if (uploaded < pendingTextures.size())
+        {
+            // textures that are already in the cache are not uploaded again
+            Texture texture = pendingTextures[uploaded];
+            texture.id = TextureCache::instance().upload(textureHandles[uploaded++]);
+            textures_loaded.push_back(texture);
+        }
+        else if (uploaded < pendingTextures.size() + preparedMeshes.size())
+        {
+            PreparedMesh &prepared = preparedMeshes[uploaded++ - pendingTextures.size()];
+            for (Texture &texture : prepared.textures)
+                texture.id = textures_loaded[textureIndex[texture.path]].id;
+            if (prepared.vertexData)
+                // the vertex and index data are uploaded directly from the mapped mesh cache
+                meshes.push_back(Mesh(prepared.vertexData, prepared.vertexCount, prepared.indexData, prepared.indexCount,
+                                      prepared.textures, packedVertices));
+            else
+                meshes.push_back(Mesh(std::move(prepared.vertices), std::move(prepared.indices), prepared.textures, packedVertices));
+            meshes.back().meshlets = std::move(prepared.meshlets);
+            meshNodes.push_back(prepared.node);
+        }
+        if (uploaded == pendingTextures.size() + preparedMeshes.size())
+        {
+            // everything is on the GPU, the CPU side copies are not needed anymore
+            cache.close();
+            pendingTextures.clear();
+            textureIndex.clear();
+            preparedMeshes.clear();
+            uploaded = 0;
+            ready = true;
+        }
+        return ready;
+    }
+
+private:
+    // a mesh read by prepare and not uploaded yet. After an import it owns its vertices and indices, when it comes from
+    // the mesh cache it points into the mapped file instead. The texture ids are only known after the upload
+    struct PreparedMesh {
+        vector<Vertex> vertices;
+        vector<unsigned int> indices;
+        vector<Texture> textures;
+        const Vertex *vertexData = nullptr;
+        const unsigned int *indexData = nullptr;
+        size_t vertexCount = 0, indexCount = 0;
+        int node = SceneGraph::NO_PARENT; // node of the mesh in nodes
+        vector<meshlet::Meshlet> meshlets;
+    };
+
+    string path;
+    bool ready = false;
+    bool failed = false;
+    MeshCache cache; // kept open until the meshes are uploaded
+    vector<PreparedMesh> preparedMeshes;
+    vector<Texture> pendingTextures; // the textures of the model, in upload order
+    unordered_map<string, size_t> textureIndex; // position of each path in pendingTextures
+    vector<TextureCache::Handle> textureHandles; // same order as pendingTextures, keeps them in the cache while the model lives
+    size_t uploaded = 0; // upload steps done so far
+    size_t importedVertices = 0, importedTriangles = 0;
+
+    /*  Functions   */
+    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // the result of the import is saved to a mesh cache (see mesh_cache.h), later runs load the cache instead.
+    void loadModel()
+    {
+        prepare();
+        for (size_t i = 0; i < pendingTextureCount(); i++)
+            decodeTexture(i);
+        while (!uploadStep());
+    }
+
+    // splits the prepared meshes into meshlets for the culling, they are not in the mesh cache since they are quick to build
+    void buildMeshlets()
+    {
+        for (PreparedMesh &prepared : preparedMeshes)
+        {
+            const Vertex *vertices = prepared.vertexData ? prepared.vertexData : prepared.vertices.data();
+            const unsigned int *indices = prepared.indexData ? prepared.indexData : prepared.indices.data();
+            size_t vertexCount = prepared.vertexData ? prepared.vertexCount : prepared.vertices.size();
+            size_t indexCount = prepared.indexData ? prepared.indexCount : prepared.indices.size();
+            prepared.meshlets = meshlet::build(vertices, vertexCount, indices, indexCount,
+                                               [](const Vertex &v) { return v.Position; });
+        }
+    }
+
+    // reads the meshes from the mesh cache, returns false if there is no up to date cache
+    bool prepareCachedModel(unsigned int importFlags)
+    {
+        if (!cache.open(path, importFlags))
+            return false;
+
+        for (const CachedMesh &cached : cache.meshes())
+        {
+            PreparedMesh prepared;
+            for (const Texture &texture : cached.textures)
+                prepared.textures.push_back(materialTexture(texture.path, texture.type));
+            prepared.vertexData = cached.vertices;
+            prepared.vertexCount = cached.vertexCount;
+            prepared.indexData = cached.indices;
+            prepared.indexCount = cached.indexCount;
+            prepared.node = cached.node;
+            preparedMeshes.push_back(prepared);
+        }
+        nodes = cache.nodes();
+        nodes.update();
+        loadedFromCache = true;
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // the node is added to nodes below parent, with its transform
+    void processNode(aiNode *node, const aiScene *scene, int parent = SceneGraph::NO_PARENT)
     {
+        // assimp matrices are row major, glm ones column major
+        const aiMatrix4x4 &m = node->mTransformation;
+        int index = nodes.addNode(parent, glm::mat4(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2,
+                                                    m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4), node->mName.C_Str());
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            preparedMeshes.push_back(processMesh(mesh, scene));
+            preparedMeshes.back().node = index;
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, index);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    PreparedMesh processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
         vector<Vertex> vertices;
@@ -163,12 +361,24 @@ private:
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_ambient");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // reorder the triangles and vertices for the vertex cache, overdraw and vertex fetch
+        meshopt::CacheStats before, after;
+        meshopt::optimizeMesh(vertices, indices, [](const Vertex &v){ return v.Position; }, &before, &after);
+        cacheStatsBefore.transformedVertices += before.transformedVertices;
+        cacheStatsAfter.transformedVertices += after.transformedVertices;
+        importedVertices += vertices.size();
+        importedTriangles += indices.size() / 3;
+
+        // return the extracted mesh data, the mesh object is created by uploadStep
+        PreparedMesh prepared;
+        prepared.vertices.swap(vertices);
+        prepared.indices.swap(indices);
+        prepared.textures.swap(textures);
+        return prepared;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
+    // checks all material textures of a given type and adds the textures that are not loaded yet to the textures to load.
+    // the required info is returned as a Texture struct, its id is set when the mesh is uploaded.
     vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
     {
         vector<Texture> textures;
@@ -176,69 +386,49 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(materialTexture(str.C_Str(), typeName));
         }
         return textures;
     }
+
+    // texture at path (relative to the model directory), it is added to the textures of the model unless it is already
+    // there. The texture itself comes from the texture cache, it is shared by all the models that use the same file
+    Texture materialTexture(string const &path, string const &typeName)
+    {
+        Texture texture;
+        texture.id = 0;
+        texture.type = typeName;
+        texture.path = path;
+        if (textureIndex.insert(make_pair(path, pendingTextures.size())).second)
+        {
+            pendingTextures.push_back(texture);
+            textureHandles.push_back(TextureCache::instance().acquire(TextureCache::canonicalPath(directory, path)));
+        }
+        return texture;
+    }
 };
 
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    TextureData texture;
+    decodeTexture(texture, directory + '/' + string(path));
+    return uploadTexture(texture);
+}
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
+// compresses the textures of the model at path to .texbake files (see texture_baker.h), no GL context needed
+bool bakeModelTextures(string const &path, texbake::BakeStats &stats)
+{
+    Model model(path, false, false, true);
+    model.prepare();
+    bool ok = true;
+    for (const Texture &texture : model.pendingTextureList())
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        string filename = TextureCache::canonicalPath(model.directory, texture.path);
+        bool baked = texbake::bakeFile(filename, texture.type == "texture_normal", stats);
+        cout << (baked ? "baked " : "could not bake ") << filename << endl;
+        ok = ok && baked;
     }
-
-    return textureID;
+    return ok;
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,214 @@
+#ifndef PACKED_VERTEX_H
+#define PACKED_VERTEX_H
+
+// Compact vertex format, 20 bytes instead of the 56 bytes of Vertex (mesh.h):
+// - position: 16 bit unsigned normalized, relative to the bounding box of the mesh (boundsMin + p * boundsSize).
+//   The error is at most half a step, boundsSize / 65535 / 2 on each axis
+// - normal and tangent: octahedral encoding, the unit sphere is folded into a square (an octahedron unwrapped), so a
+//   direction takes 2 signed normalized 16 bit numbers instead of 3 floats. The error is below 0.01 degrees
+// - bitangent: it is always +/- cross(normal, tangent), so only its sign is stored, in the w of the position, which
+//   would be padding otherwise (0 means -1, 65535 means +1)
+// - texture coordinates: half floats, relative error 1/2048 (enough for textures up to 2048 texels per uv unit)
+//
+// The GPU converts the normalized integers and half floats to floats when the vertex is fetched (see Mesh::setupMesh),
+// the vertex shader decodes the rest (boundsMin/boundsSize uniforms and octDecode, see the shaders).
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct PackedVertex {
+    uint16_t position[4]; // xyz: position in the bounds, w: sign of the bitangent
+    int16_t normal[2];    // octahedral
+    int16_t tangent[2];   // octahedral
+    uint16_t texCoords[2]; // half floats
+};
+
+namespace packing {
+
+    // float to half float, rounded to nearest even, overflows become infinity
+    inline uint16_t floatToHalf(float value)
+    {
+        uint32_t f;
+        memcpy(&f, &value, sizeof(f));
+        uint32_t sign = (f >> 16) & 0x8000u;
+        uint32_t exponent = (f >> 23) & 0xffu;
+        uint32_t mantissa = f & 0x7fffffu;
+
+        if (exponent == 0xff) // inf or nan
+            return (uint16_t) (sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+        int e = (int) exponent - 127 + 15;
+        if (e >= 31)
+            return (uint16_t) (sign | 0x7c00u);
+        if (e <= 0)
+        {
+            // denormal half (or zero): shift the mantissa, with its implicit 1, into place
+            if (e < -10)
+                return (uint16_t) sign;
+            mantissa |= 0x800000u;
+            uint32_t shift = (uint32_t) (14 - e);
+            uint32_t half = mantissa >> shift;
+            uint32_t rest = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (half & 1u)))
+                half++;
+            return (uint16_t) (sign | half);
+        }
+        uint32_t half = ((uint32_t) e << 10) | (mantissa >> 13);
+        uint32_t rest = mantissa & 0x1fffu;
+        // rounding can carry into the exponent, which is still the right result (up to infinity)
+        if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+            half++;
+        return (uint16_t) (sign | half);
+    }
+
+    inline float halfToFloat(uint16_t half)
+    {
+        uint32_t sign = (uint32_t) (half & 0x8000u) << 16;
+        uint32_t exponent = (half >> 10) & 0x1fu;
+        uint32_t mantissa = half & 0x3ffu;
+        uint32_t f;
+        if (exponent == 0x1f)
+            f = sign | 0x7f800000u | (mantissa << 13);
+        else if (exponent != 0)
+            f = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+        else if (mantissa == 0)
+            f = sign;
+        else
+        {
+            // denormal half, normalize it
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400u))
+            {
+                mantissa <<= 1;
+                exponent--;
+            }
+            f = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+        }
+        float value;
+        memcpy(&value, &f, sizeof(value));
+        return value;
+    }
+
+    inline int16_t toSnorm16(float value)
+    {
+        return (int16_t) std::lround(std::max(-1.0f, std::min(1.0f, value)) * 32767.0f);
+    }
+
+    // the conversion of OpenGL 4.2 and later, older versions use (2 * value + 1) / 65535, the difference is less than a step
+    inline float fromSnorm16(int16_t value)
+    {
+        return std::max(value / 32767.0f, -1.0f);
+    }
+
+    // octahedral decoding, the same as octDecode in the shaders
+    inline glm::vec3 octDecode(glm::vec2 e)
+    {
+        glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+        if (n.z < 0)
+        {
+            float x = n.x;
+            n.x = (1.0f - std::abs(n.y)) * (x >= 0 ? 1.0f : -1.0f);
+            n.y = (1.0f - std::abs(x)) * (n.y >= 0 ? 1.0f : -1.0f);
+        }
+        return glm::normalize(n);
+    }
+
+    // octahedral encoding of the direction d (does not need to be unit length), zero vectors become (0, 0, 1).
+    // rounding each coordinate to the nearest step is not always the closest direction, so the 4 neighbouring steps
+    // are tried and the best one is kept
+    inline void octEncode(const glm::vec3 &d, int16_t out[2])
+    {
+        float l1 = std::abs(d.x) + std::abs(d.y) + std::abs(d.z);
+        if (!(l1 > 0))
+        {
+            out[0] = out[1] = 0;
+            return;
+        }
+        glm::vec3 n = d / l1;
+        glm::vec2 e(n.x, n.y);
+        if (n.z < 0)
+        {
+            e.x = (1.0f - std::abs(n.y)) * (n.x >= 0 ? 1.0f : -1.0f);
+            e.y = (1.0f - std::abs(n.x)) * (n.y >= 0 ? 1.0f : -1.0f);
+        }
+
+        glm::vec3 unit = glm::normalize(d);
+        float best = -2.0f;
+        for (int k = 0; k < 4; k++)
+        {
+            float x = (k & 1 ? std::ceil(e.x * 32767.0f) : std::floor(e.x * 32767.0f)) / 32767.0f;
+            float y = (k & 2 ? std::ceil(e.y * 32767.0f) : std::floor(e.y * 32767.0f)) / 32767.0f;
+            int16_t candidate[2] = {toSnorm16(x), toSnorm16(y)};
+            float similarity = glm::dot(unit, octDecode(glm::vec2(fromSnorm16(candidate[0]), fromSnorm16(candidate[1]))));
+            if (similarity > best)
+            {
+                best = similarity;
+                out[0] = candidate[0];
+                out[1] = candidate[1];
+            }
+        }
+    }
+
+    // the functions below take the Vertex of mesh.h (any type with the same members works)
+
+    // bounding box of the positions, the size is never 0 (flat meshes still get a valid scale)
+    template<class Vertex>
+    void bounds(const Vertex *vertices, size_t count, glm::vec3 &boundsMin, glm::vec3 &boundsSize)
+    {
+        glm::vec3 lo(0.0f), hi(0.0f);
+        for (size_t i = 0; i < count; i++)
+        {
+            lo = i == 0 ? vertices[i].Position : glm::min(lo, vertices[i].Position);
+            hi = i == 0 ? vertices[i].Position : glm::max(hi, vertices[i].Position);
+        }
+        boundsMin = lo;
+        boundsSize = glm::max(hi - lo, glm::vec3(1e-20f));
+    }
+
+    template<class Vertex>
+    PackedVertex pack(const Vertex &v, const glm::vec3 &boundsMin, const glm::vec3 &boundsSize)
+    {
+        PackedVertex p;
+        for (int i = 0; i < 3; i++)
+        {
+            float t = (v.Position[i] - boundsMin[i]) / boundsSize[i];
+            p.position[i] = (uint16_t) std::lround(std::max(0.0f, std::min(1.0f, t)) * 65535.0f);
+        }
+        bool positive = glm::dot(glm::cross(v.Normal, v.Tangent), v.Bitangent) >= 0;
+        p.position[3] = positive ? 65535 : 0;
+        octEncode(v.Normal, p.normal);
+        octEncode(v.Tangent, p.tangent);
+        p.texCoords[0] = floatToHalf(v.TexCoords.x);
+        p.texCoords[1] = floatToHalf(v.TexCoords.y);
+        return p;
+    }
+
+    // the inverse of pack, as done by the GPU and the vertex shader (used to check the error on the CPU)
+    template<class Vertex>
+    Vertex unpack(const PackedVertex &p, const glm::vec3 &boundsMin, const glm::vec3 &boundsSize)
+    {
+        Vertex v;
+        v.Position = boundsMin + glm::vec3(p.position[0], p.position[1], p.position[2]) / 65535.0f * boundsSize;
+        v.Normal = octDecode(glm::vec2(fromSnorm16(p.normal[0]), fromSnorm16(p.normal[1])));
+        v.Tangent = octDecode(glm::vec2(fromSnorm16(p.tangent[0]), fromSnorm16(p.tangent[1])));
+        v.Bitangent = glm::cross(v.Normal, v.Tangent) * (p.position[3] ? 1.0f : -1.0f);
+        v.TexCoords = glm::vec2(halfToFloat(p.texCoords[0]), halfToFloat(p.texCoords[1]));
+        return v;
+    }
+
+    template<class Vertex>
+    std::vector<PackedVertex> pack(const Vertex *vertices, size_t count, glm::vec3 &boundsMin, glm::vec3 &boundsSize)
+    {
+        bounds(vertices, count, boundsMin, boundsSize);
+        std::vector<PackedVertex> packed(count);
+        for (size_t i = 0; i < count; i++)
+            packed[i] = pack(vertices[i], boundsMin, boundsSize);
+        return packed;
+    }
+}
+
+#endif
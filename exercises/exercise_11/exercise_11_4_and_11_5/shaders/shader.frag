@@ -10,9 +10,15 @@ in VS_OUT {
    mat3 invTBN;
 } fs_in;
 
-// light uniform variables
-uniform vec3 ambientLightColor;
-uniform vec3 lightColor;
+// per frame values, shared by the programs through a uniform buffer (FrameUniforms in main.cpp)
+layout (std140) uniform Frame {
+   mat4 projection;   // camera projection matrix
+   mat4 view;         // represents the world in the eye coord space
+   vec3 viewPosition;
+   vec3 ambientLightColor;
+   vec3 lightDirection;
+   vec3 lightColor;
+};
 
 // material properties
 uniform float ambientOcclusionMix;
@@ -27,9 +33,6 @@ uniform sampler2D texture_ambient1;
 // skybox cubemap
 uniform samplerCube skybox;
 
-// camera position
-uniform vec3 viewPosition;
-
 // output color
 out vec4 FragColor;
 
@@ -46,8 +49,10 @@ void main()
 
    // TODO exercise 10.4 normal texture sampling and range adjustment
    // fix normal range: rgb sampled value is in the range [0,1], but xyz normal vectors must be in the range [-1,1]
-   vec3 N = texture(texture_normal1, fs_in.textCoord).rgb;
-   N = normalize(N * 2.0 - 1.0);
+   // only x and y are used, z is rebuilt from them (it is always positive in tangent space), baked normal maps are
+   // compressed to BC5 which only has two channels (see texture_baker.h)
+   vec2 normalXY = texture(texture_normal1, fs_in.textCoord).rg * 2.0 - 1.0;
+   vec3 N = normalize(vec3(normalXY, sqrt(max(0.0, 1.0 - dot(normalXY, normalXY)))));
 
    // mix the vertex normal and the normal map texture so we can visualize the difference with it makes with a slider
    N = normalize(mix(fs_in.Norm_tangent, N, normalMappingMix));
@@ -1,5 +1,5 @@
 #version 330 core
-layout (location = 0) in vec3 vertex;
+layout (location = 0) in vec4 vertex; // w is the sign of the bitangent for packed vertices
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 textCoord;
 layout (location = 3) in vec3 tangent;
@@ -14,28 +14,50 @@ out VS_OUT {
    mat3 invTBN;
 } vs_out;
 
+// per frame values, shared by the programs through a uniform buffer (FrameUniforms in main.cpp)
+layout (std140) uniform Frame {
+   mat4 projection;   // camera projection matrix
+   mat4 view;         // represents the world in the eye coord space
+   vec3 viewPosition;
+   vec3 ambientLightColor;
+   vec3 lightDirection;
+   vec3 lightColor;
+};
+
 // transformations
-uniform mat4 projection;   // camera projection matrix
-uniform mat4 view;         // represents the world in the eye coord space
 uniform mat4 model;        // represents model in the world coord space
 uniform mat3 modelInvTra;  // inverse of the transpose of the model matrix, used to rotate vectors while preserving angles
 
-// light uniform variables
-uniform vec3 lightDirection;
-uniform vec3 viewPosition;
 
+// packed vertices (see packed_vertex.h): the position is relative to the bounds of the mesh, and the normal and
+// tangent are octahedral encoded in the xy of their attributes
+uniform bool packedVertex;
+uniform vec3 boundsMin;
+uniform vec3 boundsSize;
+
+vec3 octDecode(vec2 e) {
+   vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+   if (n.z < 0.0)
+      n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+   return normalize(n);
+}
 
 void main() {
+   // decode the vertex attributes
+   vec3 vertexPosition = packedVertex ? boundsMin + vertex.xyz * boundsSize : vertex.xyz;
+   vec3 vertexNormal = packedVertex ? octDecode(normal.xy) : normal;
+   vec3 vertexTangent = packedVertex ? octDecode(tangent.xy) : tangent;
+
    // send text coord to fragment shader
    vs_out.textCoord = textCoord;
 
    // vertex normal in world space
-   vec3 N = normalize(modelInvTra * normal);
+   vec3 N = normalize(modelInvTra * vertexNormal);
 
    // TODO exercise 10.4 compute the TBN matrix, which maps from world space to Tangent space
    //  notice that tangent and bitangent are given as vertex properties
    //  try to ensure that the 3 vectors you use to define TBN are perpecndicular
-   vec3 T = normalize(vec3(model * vec4(tangent, 0.0)));
+   vec3 T = normalize(vec3(model * vec4(vertexTangent, 0.0)));
 
    T = normalize(T - dot(T, N) * N);
 
@@ -54,5 +76,5 @@ void main() {
    vs_out.Norm_tangent = TBN * N;
 
    // final vertex transform (for opengl rendering)
-   gl_Position = projection * view * model * vec4(vertex, 1.0);
+   gl_Position = projection * view * model * vec4(vertexPosition, 1.0);
 }
\ No newline at end of file
@@ -3,8 +3,15 @@ layout (location = 0) in vec3 vertex;
 
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+// per frame values, shared by the programs through a uniform buffer (FrameUniforms in main.cpp)
+layout (std140) uniform Frame {
+   mat4 projection;
+   mat4 view;
+   vec3 viewPosition;
+   vec3 ambientLightColor;
+   vec3 lightDirection;
+   vec3 lightColor;
+};
 
 void main()
 {
@@ -0,0 +1,58 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+// A uniform buffer object holding one std140 uniform block, for the values that are the same for every program in a
+// frame (camera, lights). The buffer is updated once per frame with a single upload, and every program that declares
+// the block reads it from the binding point, instead of each program getting its own glUniform calls.
+//
+// Block is a struct with the std140 layout of the GLSL block: scalars take 4 bytes, vec3 and vec4 are 16 byte
+// aligned, and a mat4 is 4 vec4 columns. A vec3 of the block is kept in a glm::vec4 here (or followed by a float), so
+// that the next member starts where the GPU expects it.
+
+#include <glad/glad.h>
+#include <shader.h>
+#include <gl_state.h>
+
+#include <string>
+
+template <class Block>
+class UniformBuffer
+{
+public:
+    Block data;
+
+    explicit UniformBuffer(GLuint binding) : binding(binding)
+    {
+        glGenBuffers(1, &id);
+        glBindBuffer(GL_UNIFORM_BUFFER, id);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, id);
+    }
+    ~UniformBuffer()
+    {
+        glDeleteBuffers(1, &id);
+    }
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer &operator=(const UniformBuffer&) = delete;
+
+    // makes the block with that name in the program of shader read this buffer
+    void attach(const Shader &shader, const std::string &blockName) const
+    {
+        shader.bindUniformBlock(blockName, binding);
+    }
+
+    // uploads data, after changing it and before drawing
+    void update()
+    {
+        Shader::callCounts().bufferUpdates++;
+        GLState::instance().bindBuffer(GL_UNIFORM_BUFFER, id);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &data);
+    }
+
+private:
+    GLuint id;
+    GLuint binding;
+};
+
+#endif
@@ -2,14 +2,17 @@
 #include <GLFW/glfw3.h>
 
 #include <shader_s.h>
+#include <particle_buffer.h>
 
 #include <iostream>
 #include <vector>
 #include <chrono>
+#include <string>
 
 void bindAttributes();
 void createVertexBufferObject();
 void emitParticle(float x, float y, float velocityX, float velocityY, float currentTime);
+int runEmitBenchmark(GLFWwindow* window);
 // glfw functions
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
@@ -21,17 +24,17 @@ const unsigned int SCR_HEIGHT = 600;
 // application global variables
 float lastX, lastY;                             // used to compute delta movement of the mouse
 float currentTime;
-unsigned int VAO, VBO;                          // vertex array and buffer objects
+unsigned int VAO;                               // vertex array object
 const unsigned int vertexBufferSize = 65536;    // # of particles
 
 // TODO 2.2 update the number of attributes in a particle
 const unsigned int particleSize = 5;            // particle attributes
 
 const unsigned int sizeOfFloat = 4;             // bytes in a float
-unsigned int particleId = 0;                    // keep track of last particle to be updated
+ParticleBuffer particles(vertexBufferSize, particleSize); // the particles, emitted in a ring and uploaded once per frame
 Shader *shaderProgram;                          // our shader program
 
-int main()
+int main(int argc, char* argv[])
 {
     // glfw: initialize and configure
     // ------------------------------
@@ -80,6 +83,10 @@ int main()
 
     createVertexBufferObject();
 
+    // usage: --emit-benchmark
+    if (argc >= 2 && std::string(argv[1]) == "--emit-benchmark")
+        return runEmitBenchmark(window);
+
     // render every loopInterval seconds
     float loopInterval = 0.02f;
     auto begin = std::chrono::high_resolution_clock::now();
@@ -107,9 +114,11 @@ int main()
         shaderProgram->setFloat("currentTime", currentTime);
 
 
-        // render particles
+        // upload the particles emitted in this frame (at most two uploads) and render them
+        particles.flush();
         glBindVertexArray(VAO);
-        glDrawArrays(GL_POINTS, 0, vertexBufferSize);
+        glDrawArrays(GL_POINTS, particles.firstVertex(), vertexBufferSize);
+        particles.fence();
 
         // show the frame buffer
         glfwSwapBuffers(window);
@@ -126,7 +135,7 @@ int main()
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    particles.destroy();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -157,25 +166,16 @@ void bindAttributes(){
 
 void createVertexBufferObject(){
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
     glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-    // initialize particle buffer, set all values to 0
-    std::vector<float> data(vertexBufferSize * particleSize);
-    for(unsigned int i = 0; i < data.size(); i++)
-        data[i] = 0.0f;
 
-    // allocate at openGL controlled memory
-    glBufferData(GL_ARRAY_BUFFER, vertexBufferSize * particleSize * sizeOfFloat, &data[0], GL_DYNAMIC_DRAW);
+    // allocate at openGL controlled memory, all values set to 0
+    particles.create();
     bindAttributes();
 }
 
 void emitParticle(float x, float y, float velocityX, float velocityY, float timeOfBirth){
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    float data[particleSize];
+    // the particle is uploaded with the others emitted in this frame, see the render loop
+    float *data = particles.emit();
     data[0] = x;
     data[1] = y,
     data[2] = velocityX,
@@ -183,12 +183,66 @@ void emitParticle(float x, float y, float velocityX, float velocityY, float time
     data[4] = timeOfBirth;
 
     // TODO 2.2 , add velocity and timeOfBirth to the particle data
+}
 
+// CPU time to emit and upload 1M particles per second (at 60 frames per second): one glBufferSubData per particle,
+// as emitParticle used to do, against the ring with mapped ranges and the ring persistently mapped
+int runEmitBenchmark(GLFWwindow* window){
+    glfwSwapInterval(0); // don't wait for the screen refresh
+    const int frames = 120, particlesPerFrame = 1000000 / 60;
+    const char* methods[] = {"glBufferSubData per particle", "ring, mapped ranges", "ring, persistently mapped"};
+    for (int method = 0; method < 3; method++)
+    {
+        unsigned int benchmarkVAO;
+        glGenVertexArrays(1, &benchmarkVAO);
+        glBindVertexArray(benchmarkVAO);
+        ParticleBuffer buffer(vertexBufferSize, particleSize);
+        buffer.create(method == 2);
+        bindAttributes();
+        if (method == 2 && !buffer.isPersistentlyMapped())
+        {
+            std::cout << methods[method] << ": not supported (needs OpenGL 4.4 or GL_ARB_buffer_storage)" << std::endl;
+            buffer.destroy();
+            glDeleteVertexArrays(1, &benchmarkVAO);
+            continue;
+        }
 
-
-    // upload only parts of the buffer
-    glBufferSubData(GL_ARRAY_BUFFER, particleId * particleSize * sizeOfFloat, particleSize * sizeOfFloat, data);
-    particleId = (particleId + 1) % vertexBufferSize;
+        unsigned int slot = 0;
+        std::chrono::duration<double> cpuTime(0);
+        for (int frame = 0; frame < frames; frame++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < particlesPerFrame; i++)
+            {
+                float particle[particleSize] = {(float) rand() / RAND_MAX * 2.0f - 1.0f, (float) rand() / RAND_MAX * 2.0f - 1.0f,
+                                                .1f, .1f, (float) frame / 60.0f + 0.001f};
+                if (method == 0)
+                {
+                    glBufferSubData(GL_ARRAY_BUFFER, slot * particleSize * sizeOfFloat, particleSize * sizeOfFloat, particle);
+                    slot = (slot + 1) % vertexBufferSize;
+                }
+                else
+                    std::copy(particle, particle + particleSize, buffer.emit());
+            }
+            buffer.flush();
+            cpuTime += std::chrono::high_resolution_clock::now() - start;
+
+            glClear(GL_COLOR_BUFFER_BIT);
+            shaderProgram->use();
+            shaderProgram->setFloat("currentTime", (float) frame / 60.0f);
+            glDrawArrays(GL_POINTS, buffer.firstVertex(), vertexBufferSize);
+            buffer.fence();
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        std::cout << methods[method] << ": " << cpuTime.count() * 1000.0 / frames << " ms per frame, "
+                  << frames * particlesPerFrame / cpuTime.count() / 1.0e6 << "M particles per second of CPU time"
+                  << std::endl;
+        buffer.destroy();
+        glDeleteVertexArrays(1, &benchmarkVAO);
+    }
+    glfwTerminate();
+    return 0;
 }
 
 
@@ -10,6 +10,7 @@
 
 #include "plane_model.h"
 #include "primitives.h"
+#include "scene_graph.h"
 
 // structure to hold render info
 // -----------------------------
@@ -22,6 +23,12 @@ struct SceneObject{
     }
 };
 
+// a mesh drawn with the world matrix of a node of the scene graph
+struct SceneDrawable{
+    int node;
+    const SceneObject *object;
+};
+
 // function declarations
 // ---------------------
 unsigned int createArrayBuffer(const std::vector<float> &array);
@@ -36,8 +43,10 @@ void cursorInRange(float screenX, float screenY, int screenW, int screenH, float
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void cursor_input_callback(GLFWwindow* window, double posX, double posY);
-void drawCube(glm::mat4 model);
-void drawPlane(glm::mat4 model);
+int addCube(SceneGraph &graph, const glm::mat4 &transform, std::vector<SceneDrawable> *drawables);
+int addPlane(SceneGraph &graph, const glm::mat4 &transform, std::vector<SceneDrawable> *drawables);
+glm::mat4 propellerTransform(float time);
+int runSceneGraphBenchmark();
 
 // screen settings
 // ---------------
@@ -53,6 +62,11 @@ SceneObject planeWing;
 SceneObject planePropeller;
 Shader* shaderProgram;
 
+// transform hierarchy of the scene (see scene_graph.h), the parts of each plane are children of the plane
+SceneGraph scene;
+std::vector<SceneDrawable> drawables;
+std::vector<int> propellerNodes; // the nodes animated every frame
+
 // global variables used for control
 // ---------------------------------
 float currentTime;
@@ -61,8 +75,13 @@ glm::vec3 camPosition(.0f, 1.6f, 0.0f);
 float linearSpeed = 0.15f, rotationGain = 30.0f;
 
 
-int main()
+int main(int argc, char* argv[])
 {
+    // CPU only benchmark of the scene graph updates, no window needed
+    for (int i = 1; i < argc; i++)
+        if (std::string(argv[i]) == "--scene-graph-benchmark")
+            return runSceneGraphBenchmark();
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -154,8 +173,6 @@ int main()
 
 void drawObjects(){
 
-    glm::mat4 scale = glm::scale(1.f, 1.f, 1.f);
-
     // NEW!
     // update the camera pose and projection, and compose the two into the viewProjection with a matrix multiplication
     // projection * view = world_to_view -> view_to_perspective_projection
@@ -169,52 +186,115 @@ void drawObjects(){
     shaderProgram->setMat4("model", viewProjection);
     floorObj.drawSceneObject();
 
-    // draw 2 cubes and 2 planes in different locations and with different orientations
-    drawCube(viewProjection * glm::translate(2.0f, 1.f, 2.0f) * glm::rotateY(glm::half_pi<float>()) * scale);
-    drawCube(viewProjection * glm::translate(-2.0f, 1.f, -2.0f) * glm::rotateY(glm::quarter_pi<float>()) * scale);
+    // spin the propellers, only their world matrices are recomputed
+    for (int propeller : propellerNodes)
+        scene.setLocal(propeller, propellerTransform(currentTime));
+    scene.update();
 
-    drawPlane(viewProjection * glm::translate(-2.0f, .5f, 2.0f) * glm::rotateX(glm::quarter_pi<float>()) * scale);
-    drawPlane(viewProjection * glm::translate(2.0f, .5f, -2.0f) * glm::rotateX(glm::quarter_pi<float>() * 3.f) * scale);
+    // draw the cubes and planes
+    for (const SceneDrawable &drawable : drawables){
+        shaderProgram->setMat4("model", viewProjection * scene.world(drawable.node));
+        drawable.object->drawSceneObject();
+    }
 }
 
 
-void drawCube(glm::mat4 model){
-    // draw object
-    shaderProgram->setMat4("model", model);
-    cube.drawSceneObject();
+// adds a cube below the root of graph, returns its node. drawables (if not null) gets the mesh of the cube
+int addCube(SceneGraph &graph, const glm::mat4 &transform, std::vector<SceneDrawable> *drawables){
+    int node = graph.addNode(SceneGraph::NO_PARENT, transform, "cube");
+    if (drawables)
+        drawables->push_back({node, &cube});
+    return node;
 }
 
 
-void drawPlane(glm::mat4 model){
-
-    // draw plane body and right wing
-    shaderProgram->setMat4("model", model);
-    planeBody.drawSceneObject();
-    planeWing.drawSceneObject();
-
+// adds a plane below the root of graph, returns the node of its propeller. drawables (if not null) gets the meshes of
+// the plane
+int addPlane(SceneGraph &graph, const glm::mat4 &transform, std::vector<SceneDrawable> *drawables){
+    // plane body and right wing
+    int plane = graph.addNode(SceneGraph::NO_PARENT, transform, "plane");
     // propeller,
-    glm::mat4 propeller = model * glm::translate(.0f, .5f, .0f) *
-                          glm::rotate(currentTime * 10.0f, glm::vec3(0.0,1.0,0.0)) *
-                          glm::rotate(glm::half_pi<float>(), glm::vec3(1.0,0.0,0.0)) *
-                          glm::scale(.5f, .5f, .5f);
+    int propeller = graph.addNode(plane, propellerTransform(0.0f), "propeller");
+    // right wing back,
+    int wingRightBack = graph.addNode(plane, glm::translate(0.0f, -0.5f, 0.0f) * glm::scale(.5f,.5f,.5f), "wing right back");
+    // left wing,
+    int wingLeft = graph.addNode(plane, glm::scale(-1.0f, 1.0f, 1.0f), "wing left");
+    // left wing back,
+    int wingLeftBack = graph.addNode(plane, glm::translate(0.0f, -0.5f, 0.0f) * glm::scale(-.5f,.5f,.5f), "wing left back");
+
+    if (drawables){
+        drawables->push_back({plane, &planeBody});
+        drawables->push_back({plane, &planeWing});
+        drawables->push_back({propeller, &planePropeller});
+        drawables->push_back({wingRightBack, &planeWing});
+        drawables->push_back({wingLeft, &planeWing});
+        drawables->push_back({wingLeftBack, &planeWing});
+    }
+    return propeller;
+}
 
-    shaderProgram->setMat4("model", propeller);
-    planePropeller.drawSceneObject();
 
-    // right wing back,
-    glm::mat4 wingRightBack = model * glm::translate(0.0f, -0.5f, 0.0f) * glm::scale(.5f,.5f,.5f);
-    shaderProgram->setMat4("model", wingRightBack);
-    planeWing.drawSceneObject();
+// local transform of the propeller relative to the plane
+glm::mat4 propellerTransform(float time){
+    return glm::translate(.0f, .5f, .0f) *
+           glm::rotate(time * 10.0f, glm::vec3(0.0,1.0,0.0)) *
+           glm::rotate(glm::half_pi<float>(), glm::vec3(1.0,0.0,0.0)) *
+           glm::scale(.5f, .5f, .5f);
+}
 
-    // left wing,
-    glm::mat4 wingLeft = model * glm::scale(-1.0f, 1.0f, 1.0f);
-    shaderProgram->setMat4("model", wingLeft);
-    planeWing.drawSceneObject();
 
-    // left wing back,
-    glm::mat4 wingLeftBack =  model *  glm::translate(0.0f, -0.5f, 0.0f) * glm::scale(-.5f,.5f,.5f);
-    shaderProgram->setMat4("model", wingLeftBack);
-    planeWing.drawSceneObject();
+// times the scene graph with thousands of planes whose propellers spin every frame, against recomputing every matrix
+// of every plane the way a hand written drawPlane would
+int runSceneGraphBenchmark(){
+    const int planeCount = 10000, frames = 200;
+    SceneGraph graph;
+    std::vector<int> propellers;
+    for (int i = 0; i < planeCount; i++)
+        propellers.push_back(addPlane(graph, glm::translate((float) (i % 100), .5f, (float) (i / 100)) *
+                                             glm::rotateX(glm::quarter_pi<float>()), nullptr));
+
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t updated = graph.update();
+    std::chrono::duration<double, std::micro> firstUpdate = std::chrono::high_resolution_clock::now() - start;
+    std::cout << graph.size() << " nodes, first update: " << updated << " world matrices in " << firstUpdate.count() << " us" << std::endl;
+
+    // nothing changed, the update only checks the dirty flags
+    start = std::chrono::high_resolution_clock::now();
+    updated = graph.update();
+    std::chrono::duration<double, std::micro> cleanUpdate = std::chrono::high_resolution_clock::now() - start;
+    std::cout << "update without changes: " << updated << " world matrices in " << cleanUpdate.count() << " us" << std::endl;
+
+    // only the propellers move
+    std::chrono::duration<double, std::micro> animated(0);
+    for (int frame = 0; frame < frames; frame++){
+        glm::mat4 spin = propellerTransform(frame * 0.02f);
+        start = std::chrono::high_resolution_clock::now();
+        for (int propeller : propellers)
+            graph.setLocal(propeller, spin);
+        updated = graph.update();
+        animated += std::chrono::high_resolution_clock::now() - start;
+    }
+    std::cout << "spinning " << planeCount << " propellers: " << updated << " world matrices in "
+              << animated.count() / frames << " us per frame" << std::endl;
+
+    // every matrix of every plane recomputed every frame, like drawPlane did
+    std::chrono::duration<double, std::micro> flat(0);
+    glm::mat4 sum(0.0f);
+    for (int frame = 0; frame < frames; frame++){
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < planeCount; i++){
+            const glm::mat4 &model = graph.local(graph.parent(propellers[i]));
+            sum += model * propellerTransform(frame * 0.02f);
+            sum += model * glm::translate(0.0f, -0.5f, 0.0f) * glm::scale(.5f,.5f,.5f);
+            sum += model * glm::scale(-1.0f, 1.0f, 1.0f);
+            sum += model * glm::translate(0.0f, -0.5f, 0.0f) * glm::scale(-.5f,.5f,.5f);
+        }
+        flat += std::chrono::high_resolution_clock::now() - start;
+    }
+    volatile float sink = sum[0][0]; // keeps the compiler from dropping the loop
+    (void) sink;
+    std::cout << "recomputing every part of every plane: " << flat.count() / frames << " us per frame" << std::endl;
+    return 0;
 }
 
 
@@ -240,6 +320,14 @@ void setup(){
 
     planePropeller.VAO = createVertexArray(planePropellerVertices, planePropellerColors, planePropellerIndices);
     planePropeller.vertexCount = planePropellerIndices.size();
+
+    // place 2 cubes and 2 planes in different locations and with different orientations
+    glm::mat4 scale = glm::scale(1.f, 1.f, 1.f);
+    addCube(scene, glm::translate(2.0f, 1.f, 2.0f) * glm::rotateY(glm::half_pi<float>()) * scale, &drawables);
+    addCube(scene, glm::translate(-2.0f, 1.f, -2.0f) * glm::rotateY(glm::quarter_pi<float>()) * scale, &drawables);
+
+    propellerNodes.push_back(addPlane(scene, glm::translate(-2.0f, .5f, 2.0f) * glm::rotateX(glm::quarter_pi<float>()) * scale, &drawables));
+    propellerNodes.push_back(addPlane(scene, glm::translate(2.0f, .5f, -2.0f) * glm::rotateX(glm::quarter_pi<float>() * 3.f) * scale, &drawables));
 }
 
 
@@ -9,6 +9,7 @@
 #include "srl_line_renderer.h"
 #include "srl_triangle_renderer.h"
 #include "primitives.h"
+#include "mesh_optimizer.h"
 
 // glfw callbacks
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -34,6 +35,11 @@ srl::LineRenderer lRenderer;
 srl::TriangleRenderer tRenderer;
 srl::Renderer* srlRenderer = &tRenderer;
 
+// still image, rendered tile by tile to a file when S is pressed
+const unsigned int still_W = 8192, still_H = 8192, stillTileSize = 256;
+const char* stillPath = "srl_still.ppm";
+bool saveStill = false;
+
 int main()
 {
     // glfw: initialize and configure
@@ -90,6 +96,26 @@ int main()
         vtsCube.push_back(v);
     }
 
+    // the same cube as an indexed mesh: the corners shared by two triangles of a face are stored once, and the
+    // triangles and vertices are reordered for the vertex cache (see mesh_optimizer.h)
+    std::vector<srl::vertex> vtsCubeIndexed;
+    std::vector<uint16_t> cubeIndices;
+    for (const srl::vertex &v : vtsCube){
+        unsigned int i = 0;
+        while (i < vtsCubeIndexed.size() && !(vtsCubeIndexed[i].pos == v.pos && vtsCubeIndexed[i].norm == v.norm &&
+                                              vtsCubeIndexed[i].col == v.col && vtsCubeIndexed[i].uv == v.uv))
+            i++;
+        if (i == vtsCubeIndexed.size())
+            vtsCubeIndexed.push_back(v);
+        cubeIndices.push_back((uint16_t) i);
+    }
+    meshopt::CacheStats cacheBefore, cacheAfter;
+    meshopt::optimizeMesh(vtsCubeIndexed, cubeIndices, [](const srl::vertex &v){ return glm::vec3(v.pos); },
+                          &cacheBefore, &cacheAfter);
+    std::cout << "cube: " << vtsCubeIndexed.size() << " vertices instead of " << vtsCube.size()
+              << ", vertex cache ACMR " << cacheBefore.acmr << " -> " << cacheAfter.acmr
+              << ", ATVR " << cacheBefore.atvr << " -> " << cacheAfter.atvr << std::endl;
+
 
     // camera
     // ------
@@ -137,6 +163,7 @@ int main()
     std::cout << "1 - use point renderer" << std::endl;
     std::cout << "2 - use line renderer" << std::endl;
     std::cout << "3 - use triangle renderer" << std::endl;
+    std::cout << "S - save a " << still_W << "x" << still_H << " still to " << stillPath << std::endl;
 
     while (!glfwWindowShouldClose(window))
     {
@@ -150,7 +177,30 @@ int main()
         customBuffer.clearBuffer(srl::Colors::toRGBA32(srl::Colors::black));
         customZBuffer.clearBuffer(1.0f);
 
-        srlRenderer->render(vtsCube, trackballRotation() * storedRotation, viewProj, customBuffer, customZBuffer);
+        srlRenderer->render(vtsCubeIndexed, cubeIndices, trackballRotation() * storedRotation, viewProj, customBuffer, customZBuffer);
+
+        // render the current view to a file, the full resolution image never needs to fit in memory
+        if (saveStill) {
+            saveStill = false;
+            glm::mat4 stillViewProj = glm::perspectiveFov<float>(glm::radians(70.0f),
+                                                                 (float)still_W , (float)still_H, .5f, 5.0f)
+                                      * glm::lookAt<float>(glm::vec3(.0f, .0f, 2.5f),
+                                                           glm::vec3(.0f, .0f, .0f),
+                                                           glm::vec3(.0f, 1.f, .0f));
+            auto stillStart = std::chrono::high_resolution_clock::now();
+            TiledImageWriter writer;
+            if (writer.open(stillPath, still_W, still_H)) {
+                srlRenderer->renderTiled(vtsCube, trackballRotation() * storedRotation, stillViewProj,
+                                         still_W, still_H, stillTileSize, writer);
+                bool written = writer.close();
+                std::chrono::duration<double> stillTime = std::chrono::high_resolution_clock::now() - stillStart;
+                std::cout << (written ? "saved " : "failed to write ") << stillPath << " in " << stillTime.count()
+                          << "s (renderer waited " << writer.stats().blocked_seconds << "s for the writer, writer busy "
+                          << writer.stats().write_seconds << "s)" << std::endl;
+            }
+            else
+                std::cout << "could not open " << stillPath << std::endl;
+        }
 
         // show our rendered image
         // -----------------------
@@ -268,6 +318,9 @@ void key_input_callback(GLFWwindow* window, int button, int other,int action, in
     if (button == GLFW_KEY_3 && action == GLFW_PRESS){
         srlRenderer = &tRenderer;
     }
+    if (button == GLFW_KEY_S && action == GLFW_PRESS){
+        saveStill = true;
+    }
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -0,0 +1,374 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+// Reorders the triangles and vertices of an indexed triangle mesh so that the GPU does less work drawing it.
+// Nothing is added or removed, only the order changes (the winding of every triangle is kept), so the result draws
+// exactly the same image. Run it once when the mesh is imported, not every frame.
+//
+// 1. optimizeVertexCache: the GPU keeps the last transformed vertices in a small cache (post-transform cache), a vertex
+//    shared by consecutive triangles is only shaded once. Triangles are ordered so that they reuse the vertices still
+//    in the cache, using Tom Forsyth's "Linear-Speed Vertex Cache Optimisation" (greedy, each step emits the triangle
+//    whose vertices have the best score, the score rewards vertices that are recent in the cache and that have few
+//    triangles left, so that no triangle is left behind).
+// 2. optimizeOverdraw: the cache optimized order is cut into clusters, without cutting where it would cost much cache
+//    efficiency, and the clusters are sorted so that the ones facing outwards come first. Those are usually in front
+//    of the others, so more hidden fragments are rejected by the early depth test (Sander et al. 2007, "Fast Triangle
+//    Reordering for Vertex Locality and Reduced Overdraw").
+// 3. optimizeVertexFetch: vertices are stored in the order they are first used, so that reading them from the vertex
+//    buffer goes through memory more or less sequentially. Vertices no triangle uses are removed.
+//
+// The quality of a triangle order is measured with a simulated FIFO cache:
+//   ACMR (average cache miss ratio) = transformed vertices / triangles, between 0.5 (ideal on big meshes) and 3
+//   ATVR (average transformed vertex ratio) = transformed vertices / vertices, 1 is ideal
+//
+// The functions work on any vertex type, and on 16 or 32 bit indices, for the GL Mesh as well as for the software
+// renderer (srl), which takes the same vertex and index arrays.
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+namespace meshopt {
+
+    // size of the simulated FIFO cache, roughly what GPUs have
+    const unsigned int FIFO_CACHE_SIZE = 16;
+    // size of the (LRU) cache modelled by the optimizer, bigger than the real one so the order works well on any GPU
+    const unsigned int OPTIMIZER_CACHE_SIZE = 32;
+
+    struct CacheStats {
+        size_t transformedVertices = 0;
+        float acmr = 0;
+        float atvr = 0;
+    };
+
+    namespace detail {
+
+        // FIFO cache of the last cacheSize transformed vertices
+        class FifoCache {
+        public:
+            FifoCache(size_t vertexCount, unsigned int cacheSize)
+                : addedAt(vertexCount, 0), size(cacheSize), time(cacheSize) {}
+
+            // returns true if v was not in the cache (and had to be transformed), v is in the cache afterwards
+            bool miss(size_t v)
+            {
+                // v is in the cache if less than size misses happened since it was added
+                if (time - addedAt[v] < size)
+                    return false;
+                addedAt[v] = ++time;
+                return true;
+            }
+
+            // empties the cache (time only grows, so this does not need to touch addedAt)
+            void clear() { time += size; }
+
+        private:
+            std::vector<size_t> addedAt;
+            size_t size;
+            size_t time;
+        };
+
+        // score of a vertex given its position in the cache (-1 if not in it) and the number of triangles that still
+        // use it, the constants are the ones suggested by Forsyth
+        struct ScoreTable {
+            static const unsigned int MAX_VALENCE = 32;
+            float cache[OPTIMIZER_CACHE_SIZE];
+            float valence[MAX_VALENCE + 1];
+
+            ScoreTable()
+            {
+                for (unsigned int i = 0; i < OPTIMIZER_CACHE_SIZE; i++)
+                {
+                    // the last triangle's vertices get a fixed score, so that the next triangle is not just a strip
+                    if (i < 3)
+                        cache[i] = 0.75f;
+                    else
+                        cache[i] = std::pow(1.0f - (i - 3) / (float) (OPTIMIZER_CACHE_SIZE - 3), 1.5f);
+                }
+                valence[0] = 0;
+                for (unsigned int i = 1; i <= MAX_VALENCE; i++)
+                    valence[i] = 2.0f / std::sqrt((float) i);
+            }
+
+            float score(int cachePosition, unsigned int liveTriangles) const
+            {
+                if (liveTriangles == 0)
+                    return -1.0f; // the vertex will never be needed again
+                float s = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+                return s + valence[liveTriangles < MAX_VALENCE ? liveTriangles : MAX_VALENCE];
+            }
+        };
+
+        // FIFO cache misses of the triangles [first, last), starting from an empty cache
+        template<class Index>
+        size_t clusterMisses(const std::vector<Index> &indices, size_t first, size_t last, FifoCache &fifo)
+        {
+            size_t misses = 0;
+            fifo.clear();
+            for (size_t i = first * 3; i < last * 3; i++)
+                misses += fifo.miss(indices[i]);
+            return misses;
+        }
+    }
+
+    // simulates a FIFO post-transform cache of cacheSize vertices drawing the triangles in order
+    template<class Index>
+    CacheStats analyzeVertexCache(const std::vector<Index> &indices, size_t vertexCount,
+                                  unsigned int cacheSize = FIFO_CACHE_SIZE)
+    {
+        detail::FifoCache fifo(vertexCount, cacheSize);
+        CacheStats stats;
+        for (Index index : indices)
+            stats.transformedVertices += fifo.miss(index);
+        size_t triangleCount = indices.size() / 3;
+        stats.acmr = triangleCount ? (float) stats.transformedVertices / triangleCount : 0;
+        stats.atvr = vertexCount ? (float) stats.transformedVertices / vertexCount : 0;
+        return stats;
+    }
+
+    // reorders the triangles for the post-transform vertex cache (Forsyth)
+    template<class Index>
+    void optimizeVertexCache(std::vector<Index> &indices, size_t vertexCount)
+    {
+        static const detail::ScoreTable table;
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return;
+
+        // triangles using each vertex, live triangles are kept at the front of each vertex's list
+        std::vector<uint32_t> liveTriangles(vertexCount, 0);
+        for (Index index : indices)
+            liveTriangles[index]++;
+        std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            firstTriangle[v + 1] = firstTriangle[v] + liveTriangles[v];
+        std::vector<uint32_t> vertexTriangles(indices.size());
+        {
+            std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++)
+                vertexTriangles[fill[indices[i]]++] = (uint32_t) (i / 3);
+        }
+
+        std::vector<float> vertexScore(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            vertexScore[v] = table.score(-1, liveTriangles[v]);
+        std::vector<float> triangleScore(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++)
+            triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        std::vector<bool> emitted(triangleCount, false);
+
+        std::vector<Index> result;
+        result.reserve(indices.size());
+        std::vector<uint32_t> cache, newCache;
+        cache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+        newCache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+
+        size_t nextUnemitted = 0; // for when no triangle touches the cache, the next one in the original order
+        int64_t best = -1;
+        while (result.size() < indices.size())
+        {
+            if (best < 0)
+            {
+                while (emitted[nextUnemitted])
+                    nextUnemitted++;
+                best = (int64_t) nextUnemitted;
+            }
+
+            // emit the triangle, and remove it from the lists of its vertices
+            uint32_t triangle = (uint32_t) best;
+            emitted[triangle] = true;
+            newCache.clear();
+            for (int k = 0; k < 3; k++)
+            {
+                Index v = indices[triangle * 3 + k];
+                result.push_back(v);
+                uint32_t *list = &vertexTriangles[firstTriangle[v]];
+                for (uint32_t i = 0; i < liveTriangles[v]; i++)
+                {
+                    if (list[i] == triangle)
+                    {
+                        std::swap(list[i], list[liveTriangles[v] - 1]);
+                        break;
+                    }
+                }
+                liveTriangles[v]--;
+                if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) // degenerate triangles
+                    newCache.push_back(v);
+            }
+
+            // the triangle's vertices move to the front of the (LRU) cache
+            size_t emittedVertices = newCache.size();
+            for (uint32_t v : cache)
+                if (std::find(newCache.begin(), newCache.begin() + emittedVertices, v) == newCache.begin() + emittedVertices)
+                    newCache.push_back(v);
+            // the vertices pushed out of the cache lose their cache score
+            for (size_t i = OPTIMIZER_CACHE_SIZE; i < newCache.size(); i++)
+            {
+                uint32_t v = newCache[i];
+                float score = table.score(-1, liveTriangles[v]);
+                float delta = score - vertexScore[v];
+                vertexScore[v] = score;
+                for (uint32_t t = 0; t < liveTriangles[v]; t++)
+                    triangleScore[vertexTriangles[firstTriangle[v] + t]] += delta;
+            }
+            newCache.resize(std::min<size_t>(newCache.size(), OPTIMIZER_CACHE_SIZE));
+            cache.swap(newCache);
+
+            // update the scores of the cached vertices, and pick the best triangle among the ones they are used by
+            best = -1;
+            float bestScore = -1.0f;
+            for (size_t i = 0; i < cache.size(); i++)
+            {
+                uint32_t v = cache[i];
+                float score = table.score((int) i, liveTriangles[v]);
+                float delta = score - vertexScore[v];
+                vertexScore[v] = score;
+                for (uint32_t t = 0; t < liveTriangles[v]; t++)
+                    triangleScore[vertexTriangles[firstTriangle[v] + t]] += delta;
+            }
+            for (uint32_t v : cache)
+            {
+                for (uint32_t t = 0; t < liveTriangles[v]; t++)
+                {
+                    uint32_t candidate = vertexTriangles[firstTriangle[v] + t];
+                    if (triangleScore[candidate] > bestScore)
+                    {
+                        bestScore = triangleScore[candidate];
+                        best = candidate;
+                    }
+                }
+            }
+        }
+        indices.swap(result);
+    }
+
+    // reorders clusters of triangles so that outward facing ones are drawn first, the cache order within a cluster is
+    // kept and the ACMR grows by at most the factor threshold. Run it after optimizeVertexCache.
+    // positionOf(vertex) returns the vertex position as a glm::vec3
+    template<class Index, class Vertex, class PositionOf>
+    void optimizeOverdraw(std::vector<Index> &indices, const std::vector<Vertex> &vertices, PositionOf positionOf,
+                          float threshold = 1.05f)
+    {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return;
+
+        // hard cluster boundaries: the first triangle, and triangles that miss all their vertices (the cache has no
+        // useful content there)
+        detail::FifoCache fifo(vertices.size(), FIFO_CACHE_SIZE);
+        std::vector<size_t> hardBoundaries;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            int misses = fifo.miss(indices[t * 3]) + fifo.miss(indices[t * 3 + 1]) + fifo.miss(indices[t * 3 + 2]);
+            if (t == 0 || misses == 3)
+                hardBoundaries.push_back(t);
+        }
+        hardBoundaries.push_back(triangleCount);
+
+        // soft boundaries: inside a hard cluster, a new cluster can start as soon as the current one is about as cache
+        // efficient as the whole hard cluster (starting a cluster with an empty cache costs a few misses)
+        std::vector<size_t> clusterStart;
+        for (size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+        {
+            size_t first = hardBoundaries[h], last = hardBoundaries[h + 1];
+            float limit = threshold * detail::clusterMisses(indices, first, last, fifo) / (float) (last - first);
+
+            clusterStart.push_back(first);
+            size_t misses = 0;
+            fifo.clear();
+            for (size_t t = first; t < last; t++)
+            {
+                misses += fifo.miss(indices[t * 3]) + fifo.miss(indices[t * 3 + 1]) + fifo.miss(indices[t * 3 + 2]);
+                if (t + 1 < last && misses <= limit * (t + 1 - clusterStart.back()))
+                {
+                    clusterStart.push_back(t + 1);
+                    misses = 0;
+                    fifo.clear();
+                }
+            }
+        }
+        clusterStart.push_back(triangleCount);
+
+        // sort key of a cluster: how much it faces away from the center of the mesh,
+        // dot(cluster centroid - mesh centroid, cluster normal), both area weighted
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0;
+        std::vector<glm::vec3> clusterCentroid(clusterStart.size() - 1, glm::vec3(0.0f));
+        std::vector<glm::vec3> clusterNormal(clusterStart.size() - 1, glm::vec3(0.0f));
+        std::vector<float> clusterArea(clusterStart.size() - 1, 0.0f);
+        for (size_t c = 0; c + 1 < clusterStart.size(); c++)
+        {
+            for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+            {
+                glm::vec3 p0 = positionOf(vertices[indices[t * 3]]);
+                glm::vec3 p1 = positionOf(vertices[indices[t * 3 + 1]]);
+                glm::vec3 p2 = positionOf(vertices[indices[t * 3 + 2]]);
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0); // its length is twice the area
+                float area = glm::length(normal);
+                clusterCentroid[c] += (p0 + p1 + p2) * (area / 3.0f);
+                clusterNormal[c] += normal;
+                clusterArea[c] += area;
+            }
+            meshCentroid += clusterCentroid[c];
+            meshArea += clusterArea[c];
+        }
+        if (meshArea > 0)
+            meshCentroid /= meshArea;
+
+        std::vector<float> key(clusterStart.size() - 1);
+        std::vector<uint32_t> order(clusterStart.size() - 1);
+        for (size_t c = 0; c < order.size(); c++)
+        {
+            glm::vec3 centroid = clusterArea[c] > 0 ? clusterCentroid[c] / clusterArea[c] : meshCentroid;
+            float normalLength = glm::length(clusterNormal[c]);
+            key[c] = normalLength > 0 ? glm::dot(centroid - meshCentroid, clusterNormal[c] / normalLength) : 0.0f;
+            order[c] = (uint32_t) c;
+        }
+        std::stable_sort(order.begin(), order.end(), [&key](uint32_t a, uint32_t b){ return key[a] > key[b]; });
+
+        std::vector<Index> result;
+        result.reserve(indices.size());
+        for (uint32_t c : order)
+            result.insert(result.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+        indices.swap(result);
+    }
+
+    // stores the vertices in the order the indices first use them, returns the new number of vertices
+    template<class Vertex, class Index>
+    size_t optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<Index> &indices)
+    {
+        const uint32_t unused = ~0u;
+        std::vector<uint32_t> remap(vertices.size(), unused);
+        std::vector<Vertex> result;
+        result.reserve(vertices.size());
+        for (Index &index : indices)
+        {
+            if (remap[index] == unused)
+            {
+                remap[index] = (uint32_t) result.size();
+                result.push_back(vertices[index]);
+            }
+            index = (Index) remap[index];
+        }
+        vertices.swap(result);
+        return vertices.size();
+    }
+
+    // all three passes, the cache statistics before and after are returned if requested
+    template<class Vertex, class Index, class PositionOf>
+    void optimizeMesh(std::vector<Vertex> &vertices, std::vector<Index> &indices, PositionOf positionOf,
+                      CacheStats *before = nullptr, CacheStats *after = nullptr)
+    {
+        if (before)
+            *before = analyzeVertexCache(indices, vertices.size());
+        optimizeVertexCache(indices, vertices.size());
+        optimizeOverdraw(indices, vertices, positionOf);
+        optimizeVertexFetch(vertices, indices);
+        if (after)
+            *after = analyzeVertexCache(indices, vertices.size());
+    }
+}
+
+#endif
@@ -66,8 +66,8 @@ namespace srl {
 
         // normalized device coordinates to screen space
         void toScreenSpace(int width, int height) override  {
-            float halfW = width / 2;
-            float halfH = height / 2;
+            float halfW = width * 0.5f;
+            float halfH = height * 0.5f;
             glm::mat4 toWindowSpace = glm::scale(glm::vec3(halfW, halfH, 1.f)) * glm::translate(glm::vec3(1.f, 1.f, 0.f));
             for(auto &p : m_primitives) {
                 p.v1.pos = toWindowSpace * p.v1.pos;
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include "glm/glm.hpp"
 #include "srl_types.h"
+#include "tiled_image_writer.h"
 
 
 namespace srl {
@@ -45,6 +46,70 @@ namespace srl {
 
         }
 
+        // render an indexed mesh (e.g. from an OBJ loader that merges shared vertices), Index can be 16 or 32 bits.
+        // the vertex stage runs once per unique vertex, the primitives are then assembled in index order
+        template<class Index>
+        void render(const std::vector<vertex> &vts,
+                    const std::vector<Index> &indices,
+                    const glm::mat4 &m,
+                    const glm::mat4 &vp,
+                    CustomFrameBuffer <uint32_t> &fb,
+                    CustomFrameBuffer <float> &db) {
+
+            std::vector<vertex> _vts = vts;
+            std::vector<fragment> _frs;
+            glm::mat4 modelViewProjection = vp * m;
+
+            processVertices(modelViewProjection, _vts);
+
+            std::vector<vertex> _assembled;
+            _assembled.reserve(indices.size());
+            for (Index i : indices)
+                _assembled.push_back(_vts[i]);
+
+            assemblePrimitives(_assembled);
+            clipPrimitives();
+            divideByW();
+            toScreenSpace(fb.W, fb.H);
+            backfaceCulling();
+            rasterPrimitives(_frs);
+            processFragments(_frs);
+            writeToFrameBuffer(_frs, fb, db);
+        }
+
+        // render a W x H image tile by tile, every finished tile is handed to the writer, which stores it in the
+        // background while the next tile is rendered. Only the tiles in flight are in memory, never the whole image
+        void renderTiled(const std::vector<vertex> &vts,
+                         const glm::mat4 &m,
+                         const glm::mat4 &vp,
+                         unsigned int W, unsigned int H,
+                         unsigned int tileSize,
+                         TiledImageWriter &writer) {
+            CustomFrameBuffer<uint32_t> tileFb(tileSize, tileSize);
+            CustomFrameBuffer<float> tileDb(tileSize, tileSize);
+
+            float halfW = W * 0.5f, halfH = H * 0.5f, halfTile = tileSize * 0.5f;
+            for (unsigned int y = 0; y < H; y += tileSize) {
+                for (unsigned int x = 0; x < W; x += tileSize) {
+                    // each tile goes through the regular pipeline, with a projection that maps the region of the tile
+                    // to the whole normalized device coordinates range, so clipping removes everything outside the tile
+                    glm::mat4 toTile(1.0f);
+                    toTile[0][0] = halfW / halfTile;
+                    toTile[1][1] = halfH / halfTile;
+                    toTile[3][0] = (halfW - x) / halfTile - 1.0f;
+                    toTile[3][1] = (halfH - y) / halfTile - 1.0f;
+
+                    tileFb.clearBuffer(Colors::toRGBA32(Colors::black));
+                    tileDb.clearBuffer(1.0f);
+                    render(vts, m, toTile * vp, tileFb, tileDb);
+
+                    std::vector<uint32_t> pixels = writer.acquireBuffer(tileSize, tileSize);
+                    std::copy(tileFb.buffer, tileFb.buffer + tileSize * tileSize, pixels.begin());
+                    writer.submit(x, y, tileSize, tileSize, std::move(pixels));
+                }
+            }
+        }
+
         virtual ~Renderer(){};
     private:
 
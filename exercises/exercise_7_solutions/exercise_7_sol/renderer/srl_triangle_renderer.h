@@ -155,8 +155,8 @@ namespace srl {
 
         // normalized device coordinates to window coordinates
         void toScreenSpace(int width, int height) override  {
-            float halfW = width / 2;
-            float halfH = height / 2;
+            float halfW = width * 0.5f;
+            float halfH = height * 0.5f;
             glm::mat4 toWindowSpace = glm::scale(glm::vec3(halfW, halfH, 1.f)) * glm::translate(glm::vec3(1.f, 1.f, 0.f));
             for(auto &tri : m_primitives) {
                 tri.v1.pos = toWindowSpace * tri.v1.pos;
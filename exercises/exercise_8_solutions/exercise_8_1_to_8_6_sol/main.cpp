@@ -3,6 +3,14 @@
 #include <iostream>
 
 #include <vector>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <thread>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
 
 // NEW! as our scene gets more complex, we start using more helper classes
 //  I recommend that you read through the camera.h and model.h files to see if you can map the the previous
@@ -19,6 +27,10 @@
 // ---------------------
 void drawObjects();
 void drawGui();
+// writes a wavy grid of gridSize x gridSize quads (with uvs and normals) to an OBJ file
+int generateOBJ(const char* path, unsigned int gridSize);
+// loads an OBJ file with the fscanf loader, the new parser (flat and indexed) and assimp, and compares the results and times
+int runOBJBenchmark(const char* path);
 
 // glfw and input functions
 // ------------------------
@@ -49,6 +61,7 @@ float lastX = (float)SCR_WIDTH / 2.0;
 float lastY = (float)SCR_HEIGHT / 2.0;
 float deltaTime;
 bool isPaused = false; // stop camera movement when GUI is open
+Shader::CallCounts uniformCalls; // uniform GL calls of the last frame
 
 
 // structure to hold lighting info
@@ -85,8 +98,14 @@ struct Config {
 
 
 
-int main()
+int main(int argc, char* argv[])
 {
+    // usage: --obj-generate file.obj [grid size], --obj-benchmark file.obj
+    if (argc >= 3 && std::string(argv[1]) == "--obj-generate")
+        return generateOBJ(argv[2], argc > 3 ? atoi(argv[3]) : 1000);
+    if (argc >= 3 && std::string(argv[1]) == "--obj-benchmark")
+        return runOBJBenchmark(argv[2]);
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -166,6 +185,8 @@ int main()
 
         shader->use();
         drawObjects();
+        uniformCalls = Shader::callCounts();
+        Shader::callCounts() = Shader::CallCounts();
 
         if (isPaused) {
             drawGui();
@@ -243,6 +264,11 @@ void drawGui(){
             if (ImGui::RadioButton("Gouraud Shading", shader == gouraud_shading)) { shader = gouraud_shading; }
             if (ImGui::RadioButton("Phong Shading", shader == phong_shading)) { shader = phong_shading; }
         }
+        ImGui::Separator();
+
+        ImGui::Checkbox("uniform location cache", &Shader::cacheLocations());
+        ImGui::Text("uniform calls: %d (%d sets, %d location queries)", (int) uniformCalls.total(),
+                    (int) uniformCalls.uniformSets, (int) uniformCalls.locationQueries);
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
         ImGui::End();
     }
@@ -295,51 +321,55 @@ void drawObjects(){
     shader->setMat4("projection", projection);
     shader->setMat4("view", view);
 
+    // the model matrices are set for every object, by location (the shading model can change, so once per frame)
+    GLint modelLocation = shader->location("model");
+    GLint invTransposeModelLocation = shader->location("invTransposeModel");
+
     // NEW! we use the Model class to load the geometry and dispatch the render commands to OpenGL
     // draw car
     glm::mat4 model = glm::mat4(1.0f);
-    shader->setMat4("model", model);
+    shader->setMat4(modelLocation, model);
     glm::mat4 invTransposeModel = glm::inverse(glm::transpose(model));
-    shader->setMat4("invTransposeModel", invTransposeModel);
+    shader->setMat4(invTransposeModelLocation, invTransposeModel);
     carModel->Draw();
 
     // draw wheel
     model = glm::translate(glm::mat4(1.0f), glm::vec3(-.7432, .328, 1.39));
-    shader->setMat4("model", model);
+    shader->setMat4(modelLocation, model);
     invTransposeModel = glm::inverse(glm::transpose(model));
-    shader->setMat4("invTransposeModel", invTransposeModel);
+    shader->setMat4(invTransposeModelLocation, invTransposeModel);
     carWheel->Draw();
 
     // draw wheel
     model = glm::translate(glm::mat4(1.0f), glm::vec3(-.7432, .328, -1.39));
-    shader->setMat4("model", model);
+    shader->setMat4(modelLocation, model);
     invTransposeModel = glm::inverse(glm::transpose(model));
-    shader->setMat4("invTransposeModel", invTransposeModel);
+    shader->setMat4(invTransposeModelLocation, invTransposeModel);
     carWheel->Draw();
 
     // draw wheel
     model = glm::rotate(glm::mat4(1.0f), glm::pi<float>(), glm::vec3(0.0, 1.0, 0.0));
     model = glm::translate(model, glm::vec3(-.7432, .328, 1.39));
-    shader->setMat4("model", model);
+    shader->setMat4(modelLocation, model);
     invTransposeModel = glm::inverse(glm::transpose(model));
-    shader->setMat4("invTransposeModel", invTransposeModel);
+    shader->setMat4(invTransposeModelLocation, invTransposeModel);
     carWheel->Draw();
 
     // draw wheel
     model = glm::rotate(glm::mat4(1.0f), glm::pi<float>(), glm::vec3(0.0, 1.0, 0.0));
     model = glm::translate(model, glm::vec3(-.7432, .328, -1.39));
-    shader->setMat4("model", model);
+    shader->setMat4(modelLocation, model);
     invTransposeModel = glm::inverse(glm::transpose(model));
-    shader->setMat4("invTransposeModel", invTransposeModel);
+    shader->setMat4(invTransposeModelLocation, invTransposeModel);
     carWheel->Draw();
 
     // draw floor,
     // NEW! notice that we overwrite the value of one of the uniform variables to set a different floor color
     shader->setVec3("reflectionColor", .2, .5, .2);
     model = glm::scale(glm::mat4(1.0), glm::vec3(5.f, 5.f, 5.f));
-    shader->setMat4("model", model);
+    shader->setMat4(modelLocation, model);
     invTransposeModel = glm::inverse(glm::transpose(model));
-    shader->setMat4("invTransposeModel", invTransposeModel);
+    shader->setMat4(invTransposeModelLocation, invTransposeModel);
     floorModel->Draw();
 
 }
@@ -412,4 +442,104 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
-}
\ No newline at end of file
+}
+
+
+int generateOBJ(const char* path, unsigned int gridSize){
+    FILE* file = fopen(path, "w");
+    if (!file){
+        std::cout << "Failed to open " << path << std::endl;
+        return 1;
+    }
+    unsigned int side = gridSize + 1;
+    for (unsigned int j = 0; j < side; j++){
+        for (unsigned int i = 0; i < side; i++){
+            float x = float(i) / gridSize * 2.f - 1.f, z = float(j) / gridSize * 2.f - 1.f;
+            float y = .1f * sinf(x * 20.f) * cosf(z * 20.f);
+            glm::vec3 normal = glm::normalize(glm::vec3(-2.f * cosf(x * 20.f) * cosf(z * 20.f), 1.f,
+                                                        2.f * sinf(x * 20.f) * sinf(z * 20.f)));
+            fprintf(file, "v %f %f %f\nvt %f %f\nvn %f %f %f\n", x, y, z, float(i) / gridSize, float(j) / gridSize,
+                    normal.x, normal.y, normal.z);
+        }
+    }
+    for (unsigned int j = 0; j < gridSize; j++){
+        for (unsigned int i = 0; i < gridSize; i++){
+            unsigned int a = j * side + i + 1, b = a + 1, c = a + side + 1, d = a + side;
+            fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, d, d, d, c, c, c, b, b, b);
+        }
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    std::cout << (ok ? "Wrote " : "Failed to write ") << path << std::endl;
+    return ok ? 0 : 1;
+}
+
+int runOBJBenchmark(const char* path){
+    using namespace std;
+    using clock = chrono::high_resolution_clock;
+    auto seconds = [](clock::time_point start){ return chrono::duration<double>(clock::now() - start).count(); };
+
+    obj::MappedFile file;
+    if (!file.open(path)){
+        cout << "Failed to open " << path << endl;
+        return 1;
+    }
+    double megabytes = file.size() / (1024.0 * 1024.0);
+    cout << path << ": " << megabytes << " MB" << endl;
+
+    // parser alone, with an increasing number of threads
+    unsigned int maxThreads = max(thread::hardware_concurrency(), 1u);
+    for (unsigned int threads = 1; ; threads = min(threads * 2, maxThreads)){
+        obj::Data data;
+        auto start = clock::now();
+        bool ok = obj::parse(file.data(), file.data() + file.size(), data, threads);
+        double time = seconds(start);
+        cout << "obj::parse, " << threads << " threads: " << time << " s (" << megabytes / time << " MB/s), "
+             << data.corners.size() / 3 << " triangles" << (ok ? "" : " FAILED") << endl;
+        if (threads == maxThreads) break;
+    }
+
+    vector<glm::vec3> vertices, normals, fscanfVertices, fscanfNormals;
+    vector<glm::vec2> uvs, fscanfUvs;
+    auto start = clock::now();
+    bool ok = loadOBJ(path, vertices, uvs, normals);
+    double time = seconds(start);
+    cout << "loadOBJ (parser + expansion): " << time << " s (" << megabytes / time << " MB/s)" << (ok ? "" : " FAILED") << endl;
+
+    obj::IndexedMesh indexed;
+    start = clock::now();
+    bool indexedOk = loadOBJIndexed(path, indexed);
+    time = seconds(start);
+    size_t flatBytes = vertices.size() * sizeof(Vertex);
+    size_t indexedBytes = indexed.vertices.size() * sizeof(Vertex) + indexed.indexCount() * indexed.indexSize();
+    cout << "loadOBJIndexed: " << time << " s" << (indexedOk ? "" : " FAILED") << ", " << indexed.vertices.size()
+         << " unique vertices for " << indexed.indexCount() << " corners, " << indexed.indexSize() * 8 << " bit indices, "
+         << indexedBytes / (1024.0 * 1024.0) << " MB instead of " << flatBytes / (1024.0 * 1024.0) << " MB" << endl;
+
+    start = clock::now();
+    bool fscanfOk = loadOBJWithFscanf(path, fscanfVertices, fscanfUvs, fscanfNormals);
+    time = seconds(start);
+    cout << "loadOBJWithFscanf: " << time << " s (" << megabytes / time << " MB/s)" << (fscanfOk ? "" : " FAILED") << endl;
+    if (ok && fscanfOk){
+        float maxDifference = 0;
+        bool sameSize = vertices.size() == fscanfVertices.size();
+        for (size_t i = 0; sameSize && i < vertices.size(); i++){
+            maxDifference = max(maxDifference, glm::length(vertices[i] - fscanfVertices[i]));
+            maxDifference = max(maxDifference, glm::length(normals[i] - fscanfNormals[i]));
+            maxDifference = max(maxDifference, glm::length(uvs[i] - fscanfUvs[i]));
+        }
+        cout << "  same output as loadOBJ: " << (sameSize ? "yes" : "no, different vertex count")
+             << ", largest difference " << maxDifference << endl;
+    }
+
+    Assimp::Importer importer;
+    start = clock::now();
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+    time = seconds(start);
+    unsigned int assimpTriangles = 0;
+    for (unsigned int m = 0; scene && m < scene->mNumMeshes; m++)
+        assimpTriangles += scene->mMeshes[m]->mNumFaces;
+    cout << "assimp: " << time << " s (" << megabytes / time << " MB/s), " << assimpTriangles << " triangles"
+         << (scene ? "" : " FAILED") << endl;
+    return 0;
+}
@@ -30,7 +30,7 @@ public:
 
     /*  Mesh Data  */
     std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
+    unsigned int indexCount;
     unsigned int VAO;
 
     /*  Functions  */
@@ -38,17 +38,24 @@ public:
     Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices)//, vector<Texture> textures)
     {
         this->vertices = vertices;
-        this->indices = indices;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(indices.data(), indices.size(), GL_UNSIGNED_INT);
+    }
+
+    // indexCount indices of indexType (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) at indexData are uploaded as they are,
+    // meshes with up to 65536 vertices can use 16 bit indices, half the memory of 32 bit ones
+    Mesh(std::vector<Vertex> vertices, const void *indexData, unsigned int indexCount, GLenum indexType)
+    {
+        this->vertices = vertices;
+        setupMesh(indexData, indexCount, indexType);
     }
 
     // render the mesh
     void Draw()
     {
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
@@ -58,11 +65,15 @@ public:
 private:
     /*  Render data  */
     unsigned int VBO, EBO;
+    GLenum indexType;
 
     /*  Functions    */
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const void *indexData, unsigned int indexCount, GLenum indexType)
     {
+        this->indexCount = indexCount;
+        this->indexType = indexType;
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -77,7 +88,8 @@ private:
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize, indexData, GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
         // vertex Positions
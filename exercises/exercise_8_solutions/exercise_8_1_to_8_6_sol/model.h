@@ -52,14 +52,25 @@ private:
     // loads a model
     void loadModel(string const &path)
     {
+        // vertices shared by several triangles are stored (and processed by the vertex shader) only once
+        obj::IndexedMesh mesh;
+        if (!loadOBJIndexed(path.c_str(), mesh) || mesh.vertices.empty())
+            return;
+        meshes.push_back(processMesh(mesh));
+    }
 
-        std::vector<glm::vec3> vertices;
-        std::vector<glm::vec2> uvs;
-        std::vector<glm::vec3> normals;
-
-        loadOBJ(path.c_str(), vertices, uvs, normals);
-        meshes.push_back(processMesh(vertices, uvs, normals));
-
+    Mesh processMesh(const obj::IndexedMesh & inMesh)
+    {
+        std::vector<Vertex> vertices(inMesh.vertices.size());
+        for(unsigned int i = 0; i < inMesh.vertices.size(); i++)
+        {
+            vertices[i].Position = inMesh.vertices[i].position;
+            vertices[i].Normal = inMesh.vertices[i].normal;
+            vertices[i].TexCoords = inMesh.vertices[i].uv;
+        }
+        // the 16 or 32 bit indices go to the GPU without being converted
+        return Mesh(vertices, inMesh.indexData(), (unsigned int) inMesh.indexCount(),
+                    inMesh.has16BitIndices() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
     }
 
 
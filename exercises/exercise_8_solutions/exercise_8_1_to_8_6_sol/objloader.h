@@ -11,7 +11,7 @@
 
 #include <glm/glm.hpp>
 
-#include "objloader.h"
+#include "objparser.h"
 
 // Very, VERY simple OBJ loader.
 // Here is a short list of features a real function would provide :
@@ -25,129 +25,8 @@
 
 
 
-bool loadOBJ(
-        const char * path,
-        std::vector<float> & out_vertices,
-        std::vector<float> & out_uvs,
-        std::vector<float> & out_normals
-){
-    printf("Loading OBJ file %s...\n", path);
-
-    std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-    std::vector<float> temp_vertices;
-    std::vector<float> temp_uvs;
-    std::vector<float> temp_normals;
-
-
-    FILE * file = fopen(path, "r");
-    if( file == NULL ){
-        printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
-        getchar();
-        return false;
-    }
-
-    while( 1 ){
-
-        char lineHeader[128];
-        // read the first word of the line
-        int res = fscanf(file, "%s", lineHeader);
-        if (res == EOF)
-            break; // EOF = End Of File. Quit the loop.
-
-        // else : parse lineHeader
-
-        if ( strcmp( lineHeader, "v" ) == 0 ){
-            float x, y, z;
-            fscanf(file, "%f %f %f\n", &x, &y, &z );
-            temp_vertices.push_back(x);
-            temp_vertices.push_back(y);
-            temp_vertices.push_back(z);
-        }else if ( strcmp( lineHeader, "vt" ) == 0 ){
-            float u, v;
-            fscanf(file, "%f %f\n", &u, &v );
-            v = -v; // Invert V coordinate since we will only use DDS texture, which are inverted. Remove if you want to use TGA or BMP loaders.
-            temp_uvs.push_back(u);
-            temp_uvs.push_back(v);
-        }else if ( strcmp( lineHeader, "vn" ) == 0 ){
-            float nx, ny, nz;
-            fscanf(file, "%f %f %f\n", &nx, &ny, &nz );
-            temp_normals.push_back(nx);
-            temp_normals.push_back(ny);
-            temp_normals.push_back(nz);
-        }else if ( strcmp( lineHeader, "f" ) == 0 ){
-            std::string vertex1, vertex2, vertex3;
-            unsigned int vertexIndex[4], uvIndex[4], normalIndex[4];
-            int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
-                                 &vertexIndex[0], &uvIndex[0], &normalIndex[0],
-                                 &vertexIndex[1], &uvIndex[1], &normalIndex[1],
-                                 &vertexIndex[2], &uvIndex[2], &normalIndex[2],
-                                 &vertexIndex[3], &uvIndex[3], &normalIndex[3]);
-            if (matches != 9 && matches != 12){
-                printf("File can't be read by our simple parser :-( Try exporting with other options\n");
-                fclose(file);
-                return false;
-            }
-            // triangle info
-            vertexIndices.push_back(vertexIndex[0]);
-            vertexIndices.push_back(vertexIndex[1]);
-            vertexIndices.push_back(vertexIndex[2]);
-            uvIndices    .push_back(uvIndex[0]);
-            uvIndices    .push_back(uvIndex[1]);
-            uvIndices    .push_back(uvIndex[2]);
-            normalIndices.push_back(normalIndex[0]);
-            normalIndices.push_back(normalIndex[1]);
-            normalIndices.push_back(normalIndex[2]);
-            if (matches == 12){
-                // if a quad is defined, load as a second triangle
-                vertexIndices.push_back(vertexIndex[0]);
-                vertexIndices.push_back(vertexIndex[2]);
-                vertexIndices.push_back(vertexIndex[3]);
-                uvIndices    .push_back(uvIndex[0]);
-                uvIndices    .push_back(uvIndex[2]);
-                uvIndices    .push_back(uvIndex[3]);
-                normalIndices.push_back(normalIndex[0]);
-                normalIndices.push_back(normalIndex[2]);
-                normalIndices.push_back(normalIndex[3]);
-            }
-        }else{
-            // Probably a comment, eat up the rest of the line
-            char stupidBuffer[1000];
-            fgets(stupidBuffer, 1000, file);
-        }
-
-    }
-
-    // For each vertex of each triangle
-    for( unsigned int i=0; i<vertexIndices.size(); i++ ){
-
-        // Get the indices of its attributes
-        unsigned int vertexIndex = vertexIndices[i];
-        unsigned int uvIndex = uvIndices[i];
-        unsigned int normalIndex = normalIndices[i];
-
-        // Get the attributes thanks to the index
-        float x = temp_vertices[ (vertexIndex-1) * 3 ];
-        float y = temp_vertices[ (vertexIndex-1) * 3 +1 ];
-        float z = temp_vertices[ (vertexIndex-1) * 3 +2 ];
-        float u = temp_uvs[ (uvIndex-1) * 2 ];
-        float v = temp_uvs[ (uvIndex-1) * 2 +1 ];
-        float nx = temp_normals[ (normalIndex-1) * 3 ];
-        float ny = temp_normals[ (normalIndex-1) * 3 +1 ];
-        float nz = temp_normals[ (normalIndex-1) * 3 +2 ];
-
-        // Put the attributes in buffers
-        out_vertices.push_back(x); out_vertices.push_back(y); out_vertices.push_back(z);
-        out_uvs.push_back(u); out_uvs.push_back(v);
-        out_normals.push_back(nx); out_normals.push_back(ny); out_normals.push_back(nz);
-
-    }
-    fclose(file);
-    return true;
-}
-
-
-
-bool loadOBJ(
+// the original fscanf based loader, kept to compare with the parser in objparser.h (see --obj-benchmark in main.cpp)
+bool loadOBJWithFscanf(
         const char * path,
         std::vector<glm::vec3> & out_vertices,
         std::vector<glm::vec2> & out_uvs,
@@ -257,4 +136,95 @@ bool loadOBJ(
 }
 
 
+// calls corner(i, position, uv, normal) for the i-th corner of every triangle of data.
+// missing uvs are (0, 0) and missing normals are replaced by the face normal
+template<class CornerFunction>
+void expandCorners(const obj::Data & data, const CornerFunction & corner){
+    for (size_t t = 0; t < data.corners.size(); t += 3){
+        const obj::Corner * corners = &data.corners[t];
+        glm::vec3 faceNormal = obj::faceNormal(data, t / 3);
+
+        for (size_t k = 0; k < 3; k++){
+            const obj::Corner & c = corners[k];
+            // Invert V coordinate since we will only use DDS texture, which are inverted. Remove if you want to use TGA or BMP loaders.
+            glm::vec2 uv = c.vt >= 0 ? glm::vec2(data.uvs[c.vt].x, -data.uvs[c.vt].y) : glm::vec2(0.0f);
+            corner(t + k, data.positions[c.v], uv, c.vn >= 0 ? data.normals[c.vn] : faceNormal);
+        }
+    }
+}
+
+
+// flat float arrays (3 floats per position and normal, 2 per uv), parsed with the multithreaded parser in objparser.h
+bool loadOBJ(
+        const char * path,
+        std::vector<float> & out_vertices,
+        std::vector<float> & out_uvs,
+        std::vector<float> & out_normals
+){
+    printf("Loading OBJ file %s...\n", path);
+
+    obj::Data data;
+    if (!obj::parse(path, data))
+        return false;
+
+    size_t first = out_vertices.size() / 3;
+    out_vertices.resize((first + data.corners.size()) * 3);
+    out_uvs.resize((first + data.corners.size()) * 2);
+    out_normals.resize((first + data.corners.size()) * 3);
+    expandCorners(data, [&](size_t i, const glm::vec3 & position, const glm::vec2 & uv, const glm::vec3 & normal){
+        for (int axis = 0; axis < 3; axis++){
+            out_vertices[(first + i) * 3 + axis] = position[axis];
+            out_normals[(first + i) * 3 + axis] = normal[axis];
+        }
+        out_uvs[(first + i) * 2] = uv.x;
+        out_uvs[(first + i) * 2 + 1] = uv.y;
+    });
+    return true;
+}
+
+
+// same output as loadOBJWithFscanf, parsed with the multithreaded parser in objparser.h.
+// faces may also be v, v/vt or v//vn: missing uvs are (0, 0) and missing normals are replaced by the face normal
+bool loadOBJ(
+        const char * path,
+        std::vector<glm::vec3> & out_vertices,
+        std::vector<glm::vec2> & out_uvs,
+        std::vector<glm::vec3> & out_normals
+){
+    printf("Loading OBJ file %s...\n", path);
+
+    obj::Data data;
+    if (!obj::parse(path, data))
+        return false;
+
+    size_t first = out_vertices.size();
+    out_vertices.resize(first + data.corners.size());
+    out_uvs.resize(first + data.corners.size());
+    out_normals.resize(first + data.corners.size());
+    expandCorners(data, [&](size_t i, const glm::vec3 & position, const glm::vec2 & uv, const glm::vec3 & normal){
+        out_vertices[first + i] = position;
+        out_uvs[first + i] = uv;
+        out_normals[first + i] = normal;
+    });
+    return true;
+}
+
+
+// indexed version of loadOBJ: shared vertices are stored once, triangles are given by 16 or 32 bit indices
+// (see obj::buildIndexedMesh). This uses a fraction of the memory of the flat arrays and lets the GPU reuse the
+// results of the vertex shader
+bool loadOBJIndexed(const char * path, obj::IndexedMesh & out_mesh){
+    printf("Loading OBJ file %s...\n", path);
+
+    obj::Data data;
+    if (!obj::parse(path, data))
+        return false;
+    obj::buildIndexedMesh(data, out_mesh);
+    // Invert V coordinate since we will only use DDS texture, which are inverted. Remove if you want to use TGA or BMP loaders.
+    for (obj::Vertex & vertex : out_mesh.vertices)
+        vertex.uv.y = -vertex.uv.y;
+    return true;
+}
+
+
 #endif //GRAPHICSPROGRAMMINGEXERCISES_OBJLOADER_H
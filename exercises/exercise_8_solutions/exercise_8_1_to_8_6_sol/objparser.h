@@ -0,0 +1,553 @@
+#ifndef GRAPHICSPROGRAMMINGEXERCISES_OBJPARSER_H
+#define GRAPHICSPROGRAMMINGEXERCISES_OBJPARSER_H
+
+// Fast OBJ parser.
+//
+// The file is memory mapped and split into chunks that start and end at line boundaries, each chunk is parsed by its
+// own thread into its own arrays, and the arrays are concatenated in file order, so the result does not depend on the
+// number of threads. Numbers are parsed by hand (no fscanf/strtof), which is much faster and ignores the C locale.
+//
+// Supported: v, vt, vn, and faces with any number of corners (triangulated as a fan) in the forms
+// v, v/vt, v//vn and v/vt/vn, with positive (1-based) or negative (relative) indices.
+// Everything else (comments, o, g, s, usemtl, mtllib, ...) is skipped.
+//
+// buildIndexedMesh turns the parsed data into an indexed mesh: every distinct (v, vt, vn) triple becomes one vertex
+// of an interleaved vertex buffer, and triangles are given by a 16 or 32 bit index buffer (ready for glDrawElements).
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+#include <glm/glm.hpp>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace obj {
+
+    // one corner of a triangle, 0-based indices into Data::positions, uvs and normals, -1 if the attribute is missing
+    struct Corner {
+        int32_t v, vt, vn;
+    };
+
+    struct Data {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> uvs;
+        std::vector<glm::vec3> normals;
+        std::vector<Corner> corners; // 3 per triangle
+    };
+
+    // interleaved vertex, same layout as the Vertex of mesh.h
+    struct Vertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 uv;
+    };
+
+    struct IndexedMesh {
+        std::vector<Vertex> vertices;
+        // only one of the index buffers is used: 16 bit indices if there are at most 65536 vertices
+        std::vector<uint16_t> indices16;
+        std::vector<uint32_t> indices32;
+
+        bool has16BitIndices() const { return vertices.size() <= 65536; }
+        size_t indexCount() const { return has16BitIndices() ? indices16.size() : indices32.size(); }
+        size_t indexSize() const { return has16BitIndices() ? sizeof(uint16_t) : sizeof(uint32_t); }
+        const void *indexData() const { return has16BitIndices() ? (const void *) indices16.data() : (const void *) indices32.data(); }
+    };
+
+    // read only view of a whole file, memory mapped
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        MappedFile(MappedFile const&) = delete;
+        void operator=(MappedFile const&) = delete;
+        ~MappedFile() { close(); }
+
+        bool open(const char *path) {
+            close();
+#ifdef _WIN32
+            file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return false;
+            LARGE_INTEGER file_size;
+            if (!GetFileSizeEx(file, &file_size)) {
+                close();
+                return false;
+            }
+            length = (size_t) file_size.QuadPart;
+            if (length == 0)
+                return true;
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            bytes = mapping ? (const char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+            fd = ::open(path, O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat file_stat;
+            if (fstat(fd, &file_stat) != 0) {
+                close();
+                return false;
+            }
+            length = (size_t) file_stat.st_size;
+            if (length == 0)
+                return true;
+            void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            bytes = address == MAP_FAILED ? nullptr : (const char *) address;
+            if (bytes)
+                madvise(address, length, MADV_SEQUENTIAL);
+#endif
+            if (!bytes) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close() {
+#ifdef _WIN32
+            if (bytes) UnmapViewOfFile(bytes);
+            if (mapping) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+            mapping = nullptr;
+            file = INVALID_HANDLE_VALUE;
+#else
+            if (bytes) munmap((void *) bytes, length);
+            if (fd >= 0) ::close(fd);
+            fd = -1;
+#endif
+            bytes = nullptr;
+            length = 0;
+        }
+
+        const char *data() const { return bytes; }
+        size_t size() const { return length; }
+
+    private:
+        const char *bytes = nullptr;
+        size_t length = 0;
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#else
+        int fd = -1;
+#endif
+    };
+
+    namespace detail {
+
+        inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
+        inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+        inline const char *skipSpaces(const char *p, const char *end) {
+            while (p < end && isSpace(*p)) p++;
+            return p;
+        }
+        inline const char *skipLine(const char *p, const char *end) {
+            const char *newline = (const char *) memchr(p, '\n', end - p);
+            return newline ? newline + 1 : end;
+        }
+
+        // [+-]digits[.digits][(e|E)[+-]digits], the digits are accumulated in an integer and scaled once at the end.
+        // The result is within one unit in the last place of what strtof returns
+        inline bool parseFloat(const char *&p, const char *end, float &value) {
+            static const double powers_of_10[] = {
+                    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+            const char *s = p;
+            bool negative = false;
+            if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+
+            uint64_t mantissa = 0;
+            int exponent = 0, digits = 0;
+            for (; s < end && isDigit(*s); s++, digits++) {
+                if (mantissa < 1000000000000000000ull) mantissa = mantissa * 10 + (*s - '0');
+                else exponent++; // ignore digits beyond what a float can represent
+            }
+            if (s < end && *s == '.') {
+                for (s++; s < end && isDigit(*s); s++, digits++) {
+                    if (mantissa < 1000000000000000000ull) {
+                        mantissa = mantissa * 10 + (*s - '0');
+                        exponent--;
+                    }
+                }
+            }
+            if (digits == 0)
+                return false;
+            if (s < end && (*s == 'e' || *s == 'E')) {
+                const char *e = s + 1;
+                bool negative_exponent = false;
+                if (e < end && (*e == '-' || *e == '+')) negative_exponent = *e++ == '-';
+                if (e < end && isDigit(*e)) {
+                    int explicit_exponent = 0;
+                    for (; e < end && isDigit(*e); e++)
+                        explicit_exponent = std::min(explicit_exponent * 10 + (*e - '0'), 10000);
+                    exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+                    s = e;
+                }
+            }
+
+            double result = (double) mantissa;
+            while (exponent > 22) { result *= 1e22; exponent -= 22; }
+            while (exponent < -22) { result /= 1e22; exponent += 22; }
+            result = exponent >= 0 ? result * powers_of_10[exponent] : result / powers_of_10[-exponent];
+            value = (float) (negative ? -result : result);
+            p = s;
+            return true;
+        }
+
+        inline bool parseInt(const char *&p, const char *end, int64_t &value) {
+            const char *s = p;
+            bool negative = false;
+            if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+            if (s >= end || !isDigit(*s))
+                return false;
+            int64_t result = 0;
+            for (; s < end && isDigit(*s); s++)
+                result = std::min<int64_t>(result * 10 + (*s - '0'), INT32_MAX);
+            value = negative ? -result : result;
+            p = s;
+            return true;
+        }
+
+        // what one thread produces for its chunk. Indices that were negative in the file are relative to the elements
+        // read so far in the WHOLE file, they are resolved within the chunk and fixed once all chunks are parsed
+        struct Chunk {
+            Data data;
+            std::vector<size_t> relative; // 3 * corner + attribute (0: v, 1: vt, 2: vn) of each relative index
+            const char *error = nullptr;  // start of the first malformed line
+        };
+
+        // one of -1 (missing), 1-based or negative; bit "attribute" of relative is set for negative indices
+        inline bool resolveIndex(int64_t index, size_t count, unsigned int attribute, int32_t &resolved, unsigned int &relative) {
+            if (index == 0)
+                return false;
+            resolved = (int32_t) (index > 0 ? index - 1 : (int64_t) count + index);
+            if (index < 0) relative |= 1u << attribute;
+            return true;
+        }
+
+        // v, v/vt, v//vn or v/vt/vn
+        inline bool parseCorner(const char *&p, const char *end, const Data &data, Corner &corner, unsigned int &relative) {
+            int64_t index;
+            corner = Corner{-1, -1, -1};
+            relative = 0;
+            if (!parseInt(p, end, index) || !resolveIndex(index, data.positions.size(), 0, corner.v, relative))
+                return false;
+            if (p < end && *p == '/') {
+                p++;
+                if (p < end && *p != '/' &&
+                    (!parseInt(p, end, index) || !resolveIndex(index, data.uvs.size(), 1, corner.vt, relative)))
+                    return false;
+                if (p < end && *p == '/') {
+                    p++;
+                    if (!parseInt(p, end, index) || !resolveIndex(index, data.normals.size(), 2, corner.vn, relative))
+                        return false;
+                }
+            }
+            return p >= end || isSpace(*p) || *p == '\n';
+        }
+
+        inline void addCorner(Chunk &chunk, const Corner &corner, unsigned int relative) {
+            size_t slot = chunk.data.corners.size() * 3;
+            for (unsigned int attribute = 0; attribute < 3; attribute++)
+                if (relative & (1u << attribute))
+                    chunk.relative.push_back(slot + attribute);
+            chunk.data.corners.push_back(corner);
+        }
+
+        // the corners of a face after "f", triangulated as a fan: (0, 1, 2), (0, 2, 3), ...
+        inline bool parseFace(const char *&p, const char *end, Chunk &chunk) {
+            Corner first{}, previous{}, corner;
+            unsigned int first_relative = 0, previous_relative = 0, relative;
+            unsigned int count = 0;
+            while (true) {
+                p = skipSpaces(p, end);
+                if (p >= end || *p == '\n' || *p == '#')
+                    break;
+                if (!parseCorner(p, end, chunk.data, corner, relative))
+                    return false;
+                if (++count >= 3) {
+                    addCorner(chunk, first, first_relative);
+                    addCorner(chunk, previous, previous_relative);
+                    addCorner(chunk, corner, relative);
+                }
+                if (count == 1) {
+                    first = corner;
+                    first_relative = relative;
+                }
+                previous = corner;
+                previous_relative = relative;
+            }
+            return count >= 3;
+        }
+
+        // parses up to "count" floats, missing ones keep their value
+        inline bool parseFloats(const char *&p, const char *end, float *values, unsigned int count, unsigned int required) {
+            for (unsigned int i = 0; i < count; i++) {
+                p = skipSpaces(p, end);
+                if (p >= end || *p == '\n' || *p == '#')
+                    return i >= required;
+                if (!parseFloat(p, end, values[i]))
+                    return false;
+            }
+            return true;
+        }
+
+        // parses the lines in [begin, end), begin must be at the start of a line
+        inline void parseChunk(const char *begin, const char *end, Chunk &chunk) {
+            Data &data = chunk.data;
+            const char *p = begin;
+            while (p < end) {
+                const char *line = p;
+                p = skipSpaces(p, end);
+                if (p >= end)
+                    break;
+
+                bool ok = true;
+                size_t remaining = end - p;
+                if (remaining > 1 && p[0] == 'v' && isSpace(p[1])) {
+                    glm::vec3 position(0.0f);
+                    p += 1;
+                    ok = parseFloats(p, end, &position.x, 3, 3); // an optional w (or a color) may follow
+                    data.positions.push_back(position);
+                }
+                else if (remaining > 2 && p[0] == 'v' && p[1] == 't' && isSpace(p[2])) {
+                    glm::vec2 uv(0.0f);
+                    p += 2;
+                    ok = parseFloats(p, end, &uv.x, 2, 1);
+                    data.uvs.push_back(uv);
+                }
+                else if (remaining > 2 && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+                    glm::vec3 normal(0.0f);
+                    p += 2;
+                    ok = parseFloats(p, end, &normal.x, 3, 3);
+                    data.normals.push_back(normal);
+                }
+                else if (remaining > 1 && p[0] == 'f' && isSpace(p[1])) {
+                    p += 1;
+                    ok = parseFace(p, end, chunk);
+                }
+
+                if (!ok && !chunk.error)
+                    chunk.error = line;
+                p = skipLine(p, end);
+            }
+        }
+
+        // makes the relative indices of a chunk absolute, once its corner_count corners are in the merged data
+        // (at "corners"). returns false if any index is out of range
+        inline bool fixChunkIndices(const Chunk &chunk, const size_t base[4], Corner *corners, size_t corner_count,
+                                    const Data &out) {
+            bool ok = true;
+            for (size_t slot : chunk.relative) {
+                int32_t &index = (&corners[slot / 3].v)[slot % 3];
+                index += (int32_t) base[slot % 3];
+                ok = ok && index >= 0;
+            }
+            const int64_t position_count = (int64_t) out.positions.size();
+            const int64_t uv_count = (int64_t) out.uvs.size();
+            const int64_t normal_count = (int64_t) out.normals.size();
+            for (size_t i = 0; i < corner_count; i++) {
+                const Corner &c = corners[i];
+                ok = ok && c.v >= 0 && c.v < position_count && c.vt >= -1 && c.vt < uv_count &&
+                     c.vn >= -1 && c.vn < normal_count;
+            }
+            return ok;
+        }
+
+        // copies a chunk into its place in the merged data, see above
+        inline bool mergeChunk(const Chunk &chunk, const size_t base[4], Data &out) {
+            const Data &data = chunk.data;
+            std::copy(data.positions.begin(), data.positions.end(), out.positions.begin() + base[0]);
+            std::copy(data.uvs.begin(), data.uvs.end(), out.uvs.begin() + base[1]);
+            std::copy(data.normals.begin(), data.normals.end(), out.normals.begin() + base[2]);
+            std::copy(data.corners.begin(), data.corners.end(), out.corners.begin() + base[3]);
+            return fixChunkIndices(chunk, base, out.corners.data() + base[3], data.corners.size(), out);
+        }
+
+        inline size_t lineNumber(const char *begin, const char *position) {
+            return std::count(begin, position, '\n') + 1;
+        }
+    }
+
+    // parses the OBJ text in [begin, end) with up to "threads" threads (0: one per core), returns false on errors
+    inline bool parse(const char *begin, const char *end, Data &out, unsigned int threads = 0) {
+        out = Data();
+        size_t size = end - begin;
+        if (threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        // small files are not worth the threads
+        const size_t min_chunk_size = 1 << 20;
+        size_t chunk_count = std::max<size_t>(1, std::min<size_t>(threads, size / min_chunk_size));
+
+        // chunk boundaries, moved forward to the start of the next line
+        std::vector<const char *> bounds(chunk_count + 1);
+        bounds[0] = begin;
+        bounds[chunk_count] = end;
+        for (size_t i = 1; i < chunk_count; i++)
+            bounds[i] = std::max(bounds[i - 1], detail::skipLine(begin + size * i / chunk_count, end));
+
+        std::vector<detail::Chunk> chunks(chunk_count);
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < chunk_count; i++)
+            workers.emplace_back(detail::parseChunk, bounds[i], bounds[i + 1], std::ref(chunks[i]));
+        detail::parseChunk(bounds[0], bounds[1], chunks[0]);
+        for (std::thread &worker : workers)
+            worker.join();
+        workers.clear();
+
+        for (const detail::Chunk &chunk : chunks) {
+            if (chunk.error) {
+                const char *line_end = chunk.error;
+                while (line_end < end && *line_end != '\n' && *line_end != '\r') line_end++;
+                printf("OBJ parse error at line %zu: %.*s\n", detail::lineNumber(begin, chunk.error),
+                       (int) std::min<size_t>(line_end - chunk.error, 80), chunk.error);
+                return false;
+            }
+        }
+
+        // a single chunk is already the result
+        if (chunk_count == 1) {
+            const size_t base[4] = {0, 0, 0, 0};
+            out = std::move(chunks[0].data);
+            if (!detail::fixChunkIndices(chunks[0], base, out.corners.data(), out.corners.size(), out)) {
+                printf("OBJ face index out of range\n");
+                out = Data();
+                return false;
+            }
+            return true;
+        }
+
+        // where the data of each chunk goes in the merged arrays (positions, uvs, normals, corners)
+        std::vector<size_t> bases((chunk_count + 1) * 4, 0);
+        for (size_t i = 0; i < chunk_count; i++) {
+            const Data &data = chunks[i].data;
+            const size_t sizes[4] = {data.positions.size(), data.uvs.size(), data.normals.size(), data.corners.size()};
+            for (int k = 0; k < 4; k++)
+                bases[(i + 1) * 4 + k] = bases[i * 4 + k] + sizes[k];
+        }
+        out.positions.resize(bases[chunk_count * 4]);
+        out.uvs.resize(bases[chunk_count * 4 + 1]);
+        out.normals.resize(bases[chunk_count * 4 + 2]);
+        out.corners.resize(bases[chunk_count * 4 + 3]);
+
+        std::vector<char> merged(chunk_count, 0);
+        for (size_t i = 1; i < chunk_count; i++)
+            workers.emplace_back([&, i]() { merged[i] = detail::mergeChunk(chunks[i], &bases[i * 4], out); });
+        merged[0] = detail::mergeChunk(chunks[0], &bases[0], out);
+        for (std::thread &worker : workers)
+            worker.join();
+
+        if (std::find(merged.begin(), merged.end(), 0) != merged.end()) {
+            printf("OBJ face index out of range\n");
+            out = Data();
+            return false;
+        }
+        return true;
+    }
+
+    // the unit normal of the face-th triangle of data, (0, 1, 0) if the triangle is degenerate
+    inline glm::vec3 faceNormal(const Data &data, size_t face) {
+        const Corner *c = &data.corners[face * 3];
+        glm::vec3 p0 = data.positions[c[0].v], p1 = data.positions[c[1].v], p2 = data.positions[c[2].v];
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float normal_length = glm::length(normal);
+        return normal_length > 0 ? normal / normal_length : glm::vec3(0, 1, 0);
+    }
+
+    // merges the corners that share position, uv and normal into unique vertices (in order of first use).
+    // missing uvs are (0, 0) and missing normals are the face normal, as in the flat arrays of loadOBJ: such a corner
+    // is merged only with the corners of its own face, so the face normal is never shared with another face
+    inline void buildIndexedMesh(const Data &data, IndexedMesh &mesh) {
+        mesh = IndexedMesh();
+
+        // a missing normal (-1) is replaced by -2 - the index of the face in the key of the corner
+        auto key = [&](size_t i) {
+            Corner c = data.corners[i];
+            if (c.vn < 0)
+                c.vn = -2 - (int32_t) (i / 3);
+            return c;
+        };
+
+        // open addressing hash table from a corner to its vertex, kept at most half full
+        const uint32_t empty = UINT32_MAX;
+        auto hash = [](const Corner &c) {
+            uint64_t h = (uint64_t) (uint32_t) c.v * 0x9E3779B97F4A7C15ull;
+            h ^= (uint64_t) (uint32_t) c.vt * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+            h ^= (uint64_t) (uint32_t) c.vn * 0x165667B19E3779F9ull + (h >> 32);
+            return (size_t) (h ^ (h >> 31));
+        };
+        size_t capacity = 16;
+        while (capacity < data.positions.size() * 2) capacity *= 2;
+        std::vector<uint32_t> table(capacity, empty);
+        std::vector<Corner> unique;    // source corner of each vertex
+        std::vector<uint32_t> indices(data.corners.size());
+
+        for (size_t i = 0; i < data.corners.size(); i++) {
+            const Corner c = key(i);
+            size_t slot = hash(c) & (capacity - 1);
+            while (table[slot] != empty) {
+                const Corner &u = unique[table[slot]];
+                if (u.v == c.v && u.vt == c.vt && u.vn == c.vn) break;
+                slot = (slot + 1) & (capacity - 1);
+            }
+            if (table[slot] == empty) {
+                table[slot] = (uint32_t) unique.size();
+                unique.push_back(c);
+                if (unique.size() * 2 > capacity) {
+                    // grow and reinsert every vertex
+                    capacity *= 2;
+                    table.assign(capacity, empty);
+                    for (uint32_t v = 0; v < unique.size(); v++) {
+                        size_t s = hash(unique[v]) & (capacity - 1);
+                        while (table[s] != empty) s = (s + 1) & (capacity - 1);
+                        table[s] = v;
+                    }
+                    indices[i] = (uint32_t) unique.size() - 1;
+                    continue;
+                }
+            }
+            indices[i] = table[slot];
+        }
+
+        mesh.vertices.resize(unique.size());
+        for (size_t v = 0; v < unique.size(); v++) {
+            const Corner &c = unique[v];
+            mesh.vertices[v].position = data.positions[c.v];
+            mesh.vertices[v].normal = c.vn >= 0 ? data.normals[c.vn] : faceNormal(data, (size_t) (-2 - c.vn));
+            mesh.vertices[v].uv = c.vt >= 0 ? data.uvs[c.vt] : glm::vec2(0.0f);
+        }
+        if (mesh.has16BitIndices())
+            mesh.indices16.assign(indices.begin(), indices.end());
+        else
+            mesh.indices32.swap(indices);
+    }
+
+    // memory maps the file at path and parses it, see above
+    inline bool parse(const char *path, Data &out, unsigned int threads = 0) {
+        MappedFile file;
+        if (!file.open(path)) {
+            printf("Impossible to open the file %s\n", path);
+            out = Data();
+            return false;
+        }
+        return parse(file.data(), file.data() + file.size(), out, threads);
+    }
+}
+
+#endif //GRAPHICSPROGRAMMINGEXERCISES_OBJPARSER_H
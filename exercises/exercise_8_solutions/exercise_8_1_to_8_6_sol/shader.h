@@ -6,6 +6,9 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -90,6 +93,7 @@ public:
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        reflectUniforms();
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -103,66 +107,191 @@ public:
     {
         glUseProgram(ID);
     }
+    // location of a uniform, -1 if the program has no active uniform with that name (setting -1 does nothing).
+    // the locations are read once after linking, this is a hash table lookup instead of a glGetUniformLocation call.
+    // code that sets the same uniform every frame can keep the location and use the setters that take it
+    // ------------------------------------------------------------------------
+    GLint location(const std::string &name) const
+    {
+        if (!cacheLocations())
+        {
+            callCounts().locationQueries++;
+            return glGetUniformLocation(ID, name.c_str());
+        }
+        auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+    // connects the uniform block of the program with that name to a uniform buffer binding point (see uniform_buffer.h)
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string &name, GLuint binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+    // uniform related GL calls made by all the shaders, to see what a frame costs. Reset them once per frame
+    // ------------------------------------------------------------------------
+    struct CallCounts
+    {
+        size_t uniformSets = 0;     // glUniform*
+        size_t locationQueries = 0; // glGetUniformLocation, none while the locations are cached
+        size_t bufferUpdates = 0;   // uniform buffer uploads
+        size_t total() const { return uniformSets + locationQueries + bufferUpdates; }
+    };
+    static CallCounts &callCounts()
+    {
+        static CallCounts counts;
+        return counts;
+    }
+    // false looks the location up with glGetUniformLocation on every set, as it was done before the location table
+    static bool &cacheLocations()
+    {
+        static bool enabled = true;
+        return enabled;
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setBool(location(name), value);
+    }
+    void setBool(GLint location, bool value) const
+    {
+        callCounts().uniformSets++;
+        glUniform1i(location, (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setInt(location(name), value);
+    }
+    void setInt(GLint location, int value) const
+    {
+        callCounts().uniformSets++;
+        glUniform1i(location, value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setFloat(location(name), value);
+    }
+    void setFloat(GLint location, float value) const
+    {
+        callCounts().uniformSets++;
+        glUniform1f(location, value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec2(location(name), value);
     }
     void setVec2(const std::string &name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        setVec2(location(name), glm::vec2(x, y));
+    }
+    void setVec2(GLint location, const glm::vec2 &value) const
+    {
+        callCounts().uniformSets++;
+        glUniform2fv(location, 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec3(location(name), value);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        setVec3(location(name), glm::vec3(x, y, z));
+    }
+    void setVec3(GLint location, const glm::vec3 &value) const
+    {
+        callCounts().uniformSets++;
+        glUniform3fv(location, 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec4(location(name), value);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        setVec4(location(name), glm::vec4(x, y, z, w));
+    }
+    void setVec4(GLint location, const glm::vec4 &value) const
+    {
+        callCounts().uniformSets++;
+        glUniform4fv(location, 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat2(location(name), mat);
+    }
+    void setMat2(GLint location, const glm::mat2 &mat) const
+    {
+        callCounts().uniformSets++;
+        glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(location(name), mat);
+    }
+    void setMat3(GLint location, const glm::mat3 &mat) const
+    {
+        callCounts().uniformSets++;
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(location(name), mat);
+    }
+    void setMat4(GLint location, const glm::mat4 &mat) const
+    {
+        callCounts().uniformSets++;
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // active uniforms of the program and their locations
+    std::unordered_map<std::string, GLint> uniformLocations;
+
+    // reads the names and locations of all the active uniforms of the linked program into uniformLocations
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> nameBuffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            // members of uniform blocks have no location, they are set through their buffer
+            if (location < 0)
+                continue;
+            // arrays are reported as "name[0]" (by most drivers), and can be set by "name" or by the name of each element
+            bool isArray = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0;
+            if (isArray || size > 1)
+            {
+                std::string base = isArray ? name.substr(0, name.size() - 3) : name;
+                uniformLocations[base] = location;
+                for (GLint element = 0; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+            else
+                uniformLocations[name] = location;
+        }
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,20 @@
+#include "model.h"
+
+#include <iostream>
+
+// compresses the textures of the models that the exercise loads to .texbake files (see texture_baker.h), run it from
+// the build folder
+int main()
+{
+    texbake::BakeStats stats;
+    bool ok = true;
+    for (const char *path : {"car/Paint_LOD0.obj", "car/Body_LOD0.obj", "car/Light_LOD0.obj", "car/Interior_LOD0.obj",
+                             "car/Windows_LOD0.obj", "car/Wheel_LOD0.obj", "floor/floor_no_material.obj"})
+        ok = bakeModelTextures(path, stats) && ok;
+    std::cout << stats.textures << " textures baked, " << stats.failed << " failed" << std::endl;
+    std::cout << "  texture memory " << stats.uncompressedBytes / (1024.0 * 1024.0) << " MB -> "
+              << stats.bakedBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    std::cout << "  loading " << stats.decodeSeconds * 1000.0 << " ms to decode the files -> "
+              << stats.readSeconds * 1000.0 << " ms to read the baked files (plus glGenerateMipmap, which is not needed anymore)" << std::endl;
+    return ok ? 0 : 1;
+}
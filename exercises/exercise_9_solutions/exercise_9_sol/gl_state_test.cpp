@@ -0,0 +1,179 @@
+#include "gl_state.h"
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <map>
+#include <set>
+
+// OpenGL state of a fake context for runGLStateTest, changed by the functions of mockFunctions
+struct MockContext {
+    GLuint program = 0, vertexArray = 0, activeUnit = 0;
+    std::map<GLenum, GLuint> buffers;
+    std::map<std::pair<GLuint, GLenum>, GLuint> textures; // (unit, target) -> texture
+    std::set<GLenum> enabled;
+    GLenum depthFunction = GL_LESS, blendSource = GL_ONE, blendDestination = GL_ZERO;
+    bool depthWrite = true;
+    size_t calls = 0;
+
+    bool operator==(const MockContext &other) const
+    {
+        return program == other.program && vertexArray == other.vertexArray && buffers == other.buffers &&
+               textures == other.textures && enabled == other.enabled && depthFunction == other.depthFunction &&
+               depthWrite == other.depthWrite && blendSource == other.blendSource && blendDestination == other.blendDestination;
+    }
+};
+MockContext mockContext;
+
+namespace mock {
+    void APIENTRY useProgram(GLuint program) { mockContext.calls++; mockContext.program = program; }
+    void APIENTRY bindVertexArray(GLuint array) { mockContext.calls++; mockContext.vertexArray = array; }
+    void APIENTRY bindBuffer(GLenum target, GLuint buffer) { mockContext.calls++; mockContext.buffers[target] = buffer; }
+    void APIENTRY activeTexture(GLenum texture) { mockContext.calls++; mockContext.activeUnit = texture - GL_TEXTURE0; }
+    void APIENTRY bindTexture(GLenum target, GLuint texture) { mockContext.calls++; mockContext.textures[{mockContext.activeUnit, target}] = texture; }
+    void APIENTRY enable(GLenum cap) { mockContext.calls++; mockContext.enabled.insert(cap); }
+    void APIENTRY disable(GLenum cap) { mockContext.calls++; mockContext.enabled.erase(cap); }
+    void APIENTRY depthFunc(GLenum func) { mockContext.calls++; mockContext.depthFunction = func; }
+    void APIENTRY depthMask(GLboolean flag) { mockContext.calls++; mockContext.depthWrite = flag == GL_TRUE; }
+    void APIENTRY blendFunc(GLenum source, GLenum destination)
+    {
+        mockContext.calls++;
+        mockContext.blendSource = source;
+        mockContext.blendDestination = destination;
+    }
+}
+
+GLFunctions mockFunctions()
+{
+    GLFunctions functions;
+    functions.useProgram = mock::useProgram;
+    functions.bindVertexArray = mock::bindVertexArray;
+    functions.bindBuffer = mock::bindBuffer;
+    functions.activeTexture = mock::activeTexture;
+    functions.bindTexture = mock::bindTexture;
+    functions.enable = mock::enable;
+    functions.disable = mock::disable;
+    functions.depthFunc = mock::depthFunc;
+    functions.depthMask = mock::depthMask;
+    functions.blendFunc = mock::blendFunc;
+    return functions;
+}
+
+// checks the state cache of gl_state.h against a fake context: random calls go through GLState and are applied
+// directly to a reference context, the fake context must always end up like the reference. Then counts the calls of
+// the draws of a frame like the car scene, with and without the filtering
+int main()
+{
+    std::mt19937 random(1234);
+    auto pick = [&](std::initializer_list<GLuint> values) { return *(values.begin() + random() % values.size()); };
+    bool ok = true;
+
+    mockContext = MockContext();
+    MockContext reference;
+    GLState state(mockFunctions());
+    size_t errors = 0, unitErrors = 0;
+    for (int call = 0; call < 200000; call++)
+    {
+        switch (random() % 11)
+        {
+            case 0: { GLuint v = pick({0, 1, 2, 3}); state.useProgram(v); reference.program = v; break; }
+            case 1: { GLuint v = pick({0, 1, 2, 3, 4}); state.bindVertexArray(v); reference.vertexArray = v; break; }
+            case 2: {
+                GLenum target = pick({GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_ELEMENT_ARRAY_BUFFER});
+                GLuint v = pick({0, 1, 2});
+                state.bindBuffer(target, v);
+                reference.buffers[target] = v;
+                break;
+            }
+            case 3: case 4: {
+                GLuint unit = pick({0, 1, 2, 3, 20});
+                GLenum target = pick({GL_TEXTURE_2D, GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_3D});
+                GLuint v = pick({0, 1, 2, 3});
+                state.bindTexture(unit, target, v);
+                reference.textures[{unit, target}] = v;
+                break;
+            }
+            case 5: {
+                // the active unit is only defined after an explicit activeTexture
+                GLuint unit = pick({0, 1, 2, 3});
+                state.activeTexture(unit);
+                unitErrors += mockContext.activeUnit != unit;
+                break;
+            }
+            case 6: {
+                GLenum cap = pick({GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST});
+                bool enabled = random() % 2;
+                state.setEnabled(cap, enabled);
+                if (enabled)
+                    reference.enabled.insert(cap);
+                else
+                    reference.enabled.erase(cap);
+                break;
+            }
+            case 7: { GLenum v = pick({GL_LESS, GL_LEQUAL}); state.depthFunc(v); reference.depthFunction = v; break; }
+            case 8: { bool v = random() % 2; state.depthMask(v); reference.depthWrite = v; break; }
+            case 9: {
+                GLenum source = pick({GL_ONE, GL_SRC_ALPHA}), destination = pick({GL_ZERO, GL_ONE_MINUS_SRC_ALPHA});
+                state.blendFunc(source, destination);
+                reference.blendSource = source;
+                reference.blendDestination = destination;
+                break;
+            }
+            case 10:
+                // something changes the state without the cache (an upload, the GUI), and invalidates it
+                if (random() % 50 == 0)
+                {
+                    mock::bindTexture(GL_TEXTURE_2D, 7);
+                    mock::bindVertexArray(9);
+                    mock::useProgram(8);
+                    mock::enable(GL_BLEND);
+                    reference = mockContext;
+                    state.invalidate();
+                }
+                break;
+        }
+        errors += !(mockContext == reference);
+    }
+    const GLState::Counts &counts = state.callCounts();
+    bool randomOk = errors == 0 && unitErrors == 0 && counts.issued + counts.filtered > 0;
+    ok = ok && randomOk;
+    std::cout << "random calls: " << counts.issued << " issued, " << counts.filtered << " filtered, "
+              << errors << " state errors, " << unitErrors << " active unit errors" << std::endl;
+
+    // a frame of the car scene: two programs, the floor, 4 wheels that share their mesh and textures, and the 5 parts
+    // of the body with 3 textures each, 2 of them shared between the parts. The window is blended
+    struct Part { GLuint vertexArray; GLuint textures[3]; };
+    std::vector<Part> parts = {{1, {1, 2, 3}}};
+    for (int wheel = 0; wheel < 4; wheel++)
+        parts.push_back({2, {4, 5, 6}});
+    for (GLuint body = 0; body < 5; body++)
+        parts.push_back({3 + body, {7 + body, 20, 21}});
+    for (bool filtering : {false, true})
+    {
+        mockContext = MockContext();
+        GLState frameState(mockFunctions());
+        frameState.filtering = filtering;
+        for (int frame = 0; frame < 10; frame++)
+        {
+            frameState.invalidate();
+            for (size_t i = 0; i < parts.size(); i++)
+            {
+                frameState.useProgram(i == 0 ? 1 : 2);
+                if (i == parts.size() - 1)
+                    frameState.enable(GL_BLEND);
+                for (GLuint unit = 0; unit < 3; unit++)
+                    frameState.bindTexture(unit, GL_TEXTURE_2D, parts[i].textures[unit]);
+                frameState.bindTexture(4, GL_TEXTURE_CUBE_MAP, 30);
+                frameState.bindVertexArray(parts[i].vertexArray);
+            }
+            frameState.disable(GL_BLEND);
+        }
+        std::cout << "car frame, " << (filtering ? "filtered" : "not filtered") << ": "
+                  << mockContext.calls / 10 << " GL calls per frame (" << frameState.callCounts().total() / 10
+                  << " state calls)" << std::endl;
+        ok = ok && mockContext.calls == frameState.callCounts().issued;
+    }
+
+    std::cout << (ok ? "PASSED" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -6,6 +6,8 @@
 #include <chrono>
 
 #include "shader.h"
+#include "gl_state.h"
+#include "render_queue.h"
 #include "camera.h"
 #include "model.h"
 
@@ -46,6 +48,11 @@ Model* carWheel;
 Model* floorModel;
 unsigned int floorTextureId;
 Camera camera(glm::vec3(0.0f, 1.6f, 5.0f));
+// upload the vertices of the models in the packed format (see packed_vertex.h), 20 instead of 56 bytes per vertex
+const bool usePackedVertices = true;
+meshlet::Stats cullStats; // meshlets of the car culled in the last frame (see meshlet.h)
+Shader::CallCounts uniformCalls; // uniform GL calls of the last frame
+GLState::Counts stateCalls; // binds and state changes of the last frame (see gl_state.h)
 
 // global variables used for control
 // ---------------------------------
@@ -84,6 +91,9 @@ struct Config {
     unsigned int minFilterSetting = GL_LINEAR_MIPMAP_LINEAR;
     unsigned int magFilterSetting = GL_LINEAR;
 
+    // draw only the parts of the car inside the view
+    bool meshletCulling = true;
+
 } config;
 
 
@@ -135,13 +145,35 @@ int main()
 
     carShader = new Shader("shaders/car_shader.vert", "shaders/car_shader.frag");
     floorShader = new Shader("shaders/floor_Shader.vert", "shaders/floor_Shader.frag");
-	carPaint = new Model("car/Paint_LOD0.obj");
-	carBody = new Model("car/Body_LOD0.obj");
-	carLight = new Model("car/Light_LOD0.obj");
-	carInterior = new Model("car/Interior_LOD0.obj");
-	carWindow = new Model("car/Windows_LOD0.obj");
-	carWheel = new Model("car/Wheel_LOD0.obj");
-	floorModel = new Model("floor/floor_no_material.obj");
+	// time the model loading, the first launch imports the models with assimp and writes the mesh caches (cold),
+	// later launches load the caches (warm). delete the .meshcache files next to the models to measure a cold start again
+	auto loadStart = std::chrono::high_resolution_clock::now();
+	carPaint = new Model("car/Paint_LOD0.obj", false, usePackedVertices);
+	carBody = new Model("car/Body_LOD0.obj", false, usePackedVertices);
+	carLight = new Model("car/Light_LOD0.obj", false, usePackedVertices);
+	carInterior = new Model("car/Interior_LOD0.obj", false, usePackedVertices);
+	carWindow = new Model("car/Windows_LOD0.obj", false, usePackedVertices);
+	carWheel = new Model("car/Wheel_LOD0.obj", false, usePackedVertices);
+	floorModel = new Model("floor/floor_no_material.obj", false, usePackedVertices);
+	double loadSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - loadStart).count();
+	int cachedModels = 0, totalModels = 0;
+	size_t vertexBytes = 0, unpackedVertexBytes = 0;
+	for (Model* model : {carPaint, carBody, carLight, carInterior, carWindow, carWheel, floorModel})
+	{
+	    cachedModels += model->loadedFromCache;
+	    for (const Mesh &mesh : model->meshes)
+	    {
+	        vertexBytes += mesh.vertexBufferSize();
+	        unpackedVertexBytes += mesh.vertexCount * sizeof(Vertex);
+	    }
+	    totalModels++;
+	}
+	std::cout << "models loaded in " << loadSeconds * 1000.0 << " ms (" << cachedModels << "/" << totalModels
+	          << " from the mesh cache, " << (cachedModels == totalModels ? "warm" : "cold") << " start)" << std::endl;
+	std::cout << "vertex buffers: " << vertexBytes / 1024.0 << " KB (" << unpackedVertexBytes / 1024.0 << " KB unpacked)" << std::endl;
+	TextureCache::Stats textureStats = TextureCache::instance().stats();
+	std::cout << "textures: " << textureStats.textures << " in the cache, " << textureStats.residentBytes / (1024.0 * 1024.0)
+	          << " MB resident, " << textureStats.hits << " hits, " << textureStats.decodes << " files decoded" << std::endl;
 
     // set up the z-buffer
     glDepthRange(-1,1); // make the NDC a right handed coordinate system, with the camera pointing towards -z
@@ -177,8 +209,14 @@ int main()
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 
+        // the texture uploads and the GUI change the state behind the cache
+        GLState::instance().invalidate();
         drawFloor();
         drawCar();
+        uniformCalls = Shader::callCounts();
+        Shader::callCounts() = Shader::CallCounts();
+        stateCalls = GLState::instance().callCounts();
+        GLState::instance().resetCallCounts();
 		if (isPaused) {
 			drawGui();
 		}
@@ -301,6 +339,17 @@ void drawGui(){
         ImGui::SliderFloat("uv scale", &config.uvScale, 1.0f, 100.0f);
         ImGui::Separator();
 
+        ImGui::Checkbox("meshlet culling", &config.meshletCulling);
+        ImGui::Text("meshlets culled: %.1f%% (%d of %d)", cullStats.cullRate() * 100.0f,
+                    (int) (cullStats.frustumCulled + cullStats.coneCulled), (int) cullStats.meshlets);
+        ImGui::Text("triangles submitted: %d of %d, %d draw ranges", (int) cullStats.trianglesSubmitted,
+                    (int) cullStats.triangles, (int) cullStats.drawRanges);
+        ImGui::Checkbox("uniform location cache", &Shader::cacheLocations());
+        ImGui::Text("uniform calls: %d (%d sets, %d location queries)", (int) uniformCalls.total(),
+                    (int) uniformCalls.uniformSets, (int) uniformCalls.locationQueries);
+        ImGui::Checkbox("filter redundant state changes", &GLState::instance().filtering);
+        ImGui::Text("state calls: %d issued, %d filtered", (int) stateCalls.issued, (int) stateCalls.filtered);
+
         ImGui::Separator();
 
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
@@ -339,9 +388,8 @@ void drawFloor(){
     // set projection matrix uniform
     floorShader->setMat4("projection", projection);
 
-    glActiveTexture(GL_TEXTURE0);
     floorShader->setInt("texture_diffuse1", 0);
-    glBindTexture(GL_TEXTURE_2D, floorTextureId);
+    GLState::instance().bindTexture(0, GL_TEXTURE_2D, floorTextureId);
     // draw floor,
     // notice that we overwrite the value of one of the uniform variables to set a different floor color
     floorShader->setVec3("reflectionColor", .2, .5, .2);
@@ -379,13 +427,19 @@ void drawCar(){
     // set projection matrix uniform
     carShader->setMat4("projection", projection);
 
+    // the meshlets outside of the view are not drawn. The car is drawn without GL_CULL_FACE, so the back facing ones
+    // are drawn too
+    meshlet::View cullView(viewProjection, camera.Position);
+    cullView.frustumCulling = config.meshletCulling;
+    cullView.backfaceCulling = false;
+
     // draw wheel
     glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(-.7432, .328, 1.39));
     carShader->setMat4("model", model);
     glm::mat4 invTranspose = glm::inverse(glm::transpose(view * model));
     carShader->setMat4("invTranspMV", invTranspose);
     carShader->setMat4("view", view);
-    carWheel->Draw(*carShader);
+    carWheel->Draw(*carShader, cullView, model);
 
     // draw wheel
     model = glm::translate(glm::mat4(1.0f), glm::vec3(-.7432, .328, -1.296));
@@ -393,7 +447,7 @@ void drawCar(){
     invTranspose = glm::inverse(glm::transpose(view * model));
     carShader->setMat4("invTranspMV", invTranspose);
     carShader->setMat4("view", view);
-    carWheel->Draw(*carShader);
+    carWheel->Draw(*carShader, cullView, model);
 
     // draw wheel
     model = glm::rotate(glm::mat4(1.0f), glm::pi<float>(), glm::vec3(0.0, 1.0, 0.0));
@@ -402,7 +456,7 @@ void drawCar(){
     invTranspose = glm::inverse(glm::transpose(view * model));
     carShader->setMat4("invTranspMV", invTranspose);
     carShader->setMat4("view", view);
-    carWheel->Draw(*carShader);
+    carWheel->Draw(*carShader, cullView, model);
 
     // draw wheel
     model = glm::rotate(glm::mat4(1.0f), glm::pi<float>(), glm::vec3(0.0, 1.0, 0.0));
@@ -411,7 +465,7 @@ void drawCar(){
     invTranspose = glm::inverse(glm::transpose(view * model));
     carShader->setMat4("invTranspMV", invTranspose);
     carShader->setMat4("view", view);
-    carWheel->Draw(*carShader);
+    carWheel->Draw(*carShader, cullView, model);
 
     // draw the rest of the car
     model = glm::mat4(1.0f);
@@ -419,13 +473,14 @@ void drawCar(){
     invTranspose = glm::inverse(glm::transpose(view * model));
     carShader->setMat4("invTranspMV", invTranspose);
     carShader->setMat4("view", view);
-    carBody->Draw(*carShader);
-    carInterior->Draw(*carShader);
-    carPaint->Draw(*carShader);
-    carLight->Draw(*carShader);
-    glEnable(GL_BLEND);
-    carWindow->Draw(*carShader);
-    glDisable(GL_BLEND);
+    carBody->Draw(*carShader, cullView, model);
+    carInterior->Draw(*carShader, cullView, model);
+    carPaint->Draw(*carShader, cullView, model);
+    carLight->Draw(*carShader, cullView, model);
+    GLState::instance().enable(GL_BLEND);
+    carWindow->Draw(*carShader, cullView, model);
+    GLState::instance().disable(GL_BLEND);
+    cullStats = cullView.stats;
 
 }
 
@@ -499,4 +554,4 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
-}
\ No newline at end of file
+}
@@ -0,0 +1,192 @@
+#include "mesh.h"
+#include "mesh_optimizer.h"
+#include "meshlet.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// checks the meshlets of meshlet.h on generated meshes: the limits, and that the culling never removes a triangle
+// that could be seen
+int main()
+{
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    bool ok = true;
+
+    // a closed sphere with counter clockwise (outside facing) triangles, optimized like the imported meshes
+    const unsigned int rings = 96, segments = 192;
+    std::vector<Vertex> sphere;
+    std::vector<unsigned int> sphereIndices;
+    for (unsigned int r = 0; r <= rings; r++)
+        for (unsigned int s = 0; s <= segments; s++)
+        {
+            float theta = glm::pi<float>() * r / rings, phi = 2.0f * glm::pi<float>() * s / segments;
+            Vertex v = {};
+            v.Normal = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), -std::sin(theta) * std::sin(phi));
+            v.Position = v.Normal;
+            sphere.push_back(v);
+        }
+    for (unsigned int r = 0; r < rings; r++)
+        for (unsigned int s = 0; s < segments; s++)
+        {
+            unsigned int a = r * (segments + 1) + s, b = a + segments + 1;
+            for (unsigned int i : {a, b, a + 1, a + 1, b, b + 1})
+                sphereIndices.push_back(i);
+        }
+    auto positionOf = [](const Vertex &v) { return v.Position; };
+    meshopt::optimizeMesh(sphere, sphereIndices, positionOf);
+
+    // triangles in random places, with random orientations, so that the meshlets are full and their cones are wide
+    std::vector<Vertex> soup(3000);
+    std::vector<unsigned int> soupIndices(30000);
+    for (Vertex &v : soup)
+        v.Position = glm::vec3(uniform(random), uniform(random), uniform(random)) * 2.0f;
+    for (unsigned int &i : soupIndices)
+        i = (unsigned int) (random() % soup.size());
+
+    struct TestMesh { const char *name; std::vector<Vertex> *vertices; std::vector<unsigned int> *indices; };
+    for (TestMesh mesh : {TestMesh{"sphere", &sphere, &sphereIndices}, TestMesh{"random triangles", &soup, &soupIndices}})
+    {
+        const std::vector<Vertex> &vertices = *mesh.vertices;
+        const std::vector<unsigned int> &indices = *mesh.indices;
+        auto position = [&](size_t i) { return vertices[indices[i]].Position; };
+        std::vector<meshlet::Meshlet> meshlets = meshlet::build(vertices.data(), vertices.size(), indices.data(),
+                                                                indices.size(), positionOf);
+
+        // the meshlets cover the index buffer in order, within the limits, and their spheres hold their vertices
+        size_t nextIndex = 0, limitErrors = 0, boundsErrors = 0, triangleSum = 0, vertexSum = 0;
+        for (const meshlet::Meshlet &m : meshlets)
+        {
+            std::vector<unsigned int> used(indices.begin() + m.indexOffset, indices.begin() + m.indexOffset + m.triangleCount * 3);
+            std::sort(used.begin(), used.end());
+            size_t distinct = std::unique(used.begin(), used.end()) - used.begin();
+            limitErrors += m.indexOffset != nextIndex || m.triangleCount == 0 || m.triangleCount > meshlet::MAX_TRIANGLES ||
+                           distinct != m.vertexCount || m.vertexCount > meshlet::MAX_VERTICES;
+            for (size_t i = m.indexOffset; i < m.indexOffset + m.triangleCount * 3; i++)
+                boundsErrors += glm::length(position(i) - m.center) > m.radius;
+            nextIndex = m.indexOffset + m.triangleCount * 3;
+            triangleSum += m.triangleCount;
+            vertexSum += m.vertexCount;
+        }
+        limitErrors += nextIndex != indices.size();
+
+        // random cameras around the mesh, and random model transforms (mirrored ones too). A culled meshlet must have
+        // all its triangles outside of one frustum plane, or back facing
+        size_t frustumErrors = 0, coneErrors = 0, rangeErrors = 0;
+        meshlet::Stats stats;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int test = 0; test < 500; test++)
+        {
+            glm::vec3 eye = glm::vec3(uniform(random), uniform(random), uniform(random)) * 4.0f;
+            glm::vec3 target = glm::vec3(uniform(random), uniform(random), uniform(random)) * 4.0f;
+            glm::mat4 viewProjection = glm::perspective(glm::radians(30.0f + 40.0f * (uniform(random) + 1.0f)), 16.0f / 9.0f, 0.1f, 100.0f) *
+                                       glm::lookAt(eye, target, glm::vec3(0, 1, 0));
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(uniform(random), uniform(random), uniform(random))) *
+                              glm::rotate(glm::mat4(1.0f), uniform(random) * glm::pi<float>(), glm::normalize(glm::vec3(uniform(random), 1.0f, uniform(random)))) *
+                              glm::scale(glm::mat4(1.0f), glm::vec3(test % 4 == 0 ? -1.0f : 1.0f, 1.0f, 1.0f) * (1.0f + uniform(random) * 0.5f));
+            glm::mat4 toClip = viewProjection * model;
+            meshlet::View view(viewProjection, eye);
+            meshlet::Frustum frustum(view, model);
+            bool mirrored = glm::determinant(glm::mat3(model)) < 0;
+
+            std::vector<int> counts;
+            std::vector<const void*> offsets;
+            meshlet::cull(meshlets, frustum, counts, offsets, view.stats);
+            stats.meshlets += view.stats.meshlets;
+            stats.frustumCulled += view.stats.frustumCulled;
+            stats.coneCulled += view.stats.coneCulled;
+            stats.triangles += view.stats.triangles;
+            stats.trianglesSubmitted += view.stats.trianglesSubmitted;
+            stats.drawRanges += view.stats.drawRanges;
+
+            // the ranges hold exactly the meshlets that were not culled
+            std::vector<bool> drawn(indices.size() / 3, false);
+            size_t submitted = 0;
+            for (size_t r = 0; r < counts.size(); r++)
+            {
+                size_t first = (size_t) offsets[r] / sizeof(unsigned int);
+                rangeErrors += r > 0 && first <= (size_t) offsets[r - 1] / sizeof(unsigned int) + counts[r - 1];
+                for (size_t t = first / 3; t < (first + counts[r]) / 3; t++)
+                    drawn[t] = true;
+                submitted += counts[r] / 3;
+            }
+            rangeErrors += submitted != view.stats.trianglesSubmitted;
+
+            for (const meshlet::Meshlet &m : meshlets)
+            {
+                bool outside = meshlet::frustumCulled(m, frustum);
+                bool backFacing = !mirrored && meshlet::coneCulled(m, frustum.eye);
+                rangeErrors += drawn[m.indexOffset / 3] == (outside || backFacing);
+                for (size_t t = m.indexOffset; t < m.indexOffset + m.triangleCount * 3; t += 3)
+                {
+                    glm::vec4 clip[3];
+                    for (int k = 0; k < 3; k++)
+                        clip[k] = toClip * glm::vec4(position(t + k), 1.0f);
+                    if (outside)
+                    {
+                        bool behindOnePlane = false;
+                        for (int axis = 0; axis < 3 && !behindOnePlane; axis++)
+                            for (float side : {-1.0f, 1.0f})
+                            {
+                                bool allOut = true;
+                                for (int k = 0; k < 3; k++)
+                                    allOut = allOut && clip[k].w + side * clip[k][axis] < 1e-4f * std::abs(clip[k].w);
+                                behindOnePlane = behindOnePlane || allOut;
+                            }
+                        frustumErrors += !behindOnePlane;
+                    }
+                    else if (backFacing)
+                    {
+                        glm::vec3 a = position(t), b = position(t + 1), c = position(t + 2);
+                        glm::vec3 normal = glm::cross(b - a, c - a);
+                        // the camera must not be in front of the plane of the triangle
+                        coneErrors += glm::dot(normal, frustum.eye - a) > 1e-5f * glm::length(normal);
+                    }
+                }
+            }
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        // the culling alone, from a camera in front of the mesh
+        meshlet::View front(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f) *
+                            glm::lookAt(glm::vec3(0, 0, 3), glm::vec3(0), glm::vec3(0, 1, 0)), glm::vec3(0, 0, 3));
+        std::vector<int> counts;
+        std::vector<const void*> offsets;
+        auto cullStart = std::chrono::high_resolution_clock::now();
+        for (int frame = 0; frame < 100; frame++)
+        {
+            counts.clear();
+            offsets.clear();
+            front.stats = meshlet::Stats();
+            meshlet::cull(meshlets, meshlet::Frustum(front, glm::mat4(1.0f)), counts, offsets, front.stats);
+        }
+        std::chrono::duration<double, std::micro> cullTime = std::chrono::high_resolution_clock::now() - cullStart;
+
+        bool meshOk = limitErrors == 0 && boundsErrors == 0 && frustumErrors == 0 && coneErrors == 0 && rangeErrors == 0;
+        ok = ok && meshOk;
+        std::cout << mesh.name << ": " << indices.size() / 3 << " triangles, " << meshlets.size() << " meshlets ("
+                  << (float) triangleSum / meshlets.size() << " triangles and " << (float) vertexSum / meshlets.size()
+                  << " vertices on average)" << std::endl;
+        std::cout << "  random views: " << stats.cullRate() * 100.0f << "% of the meshlets culled ("
+                  << stats.frustumCulled << " frustum, " << stats.coneCulled << " back facing), "
+                  << (float) stats.trianglesSubmitted / std::max(stats.triangles, (size_t) 1) * 100.0f << "% of the triangles submitted, "
+                  << (float) stats.drawRanges / 500 << " draw ranges per view" << std::endl;
+        std::cout << "  front view: " << front.stats.cullRate() * 100.0f << "% culled, " << front.stats.trianglesSubmitted
+                  << " of " << front.stats.triangles << " triangles in " << front.stats.drawRanges << " draw ranges, "
+                  << cullTime.count() / 100 << " us per cull (" << elapsed.count() / 500 << " us per checked view)" << std::endl;
+        std::cout << "  errors: " << limitErrors << " limits, " << boundsErrors << " bounds, " << frustumErrors
+                  << " visible triangles frustum culled, " << coneErrors << " front facing triangles cone culled, "
+                  << rangeErrors << " draw ranges" << std::endl;
+    }
+
+    std::cout << (ok ? "PASSED" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
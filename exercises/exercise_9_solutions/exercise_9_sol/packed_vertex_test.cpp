@@ -0,0 +1,85 @@
+#include "mesh.h"
+#include "packed_vertex.h"
+
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <cmath>
+
+// checks the error and memory savings of the packed vertex format of packed_vertex.h on the CPU
+int main()
+{
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    auto randomDirection = [&]() {
+        glm::vec3 d;
+        do d = glm::vec3(uniform(random), uniform(random), uniform(random)); while (glm::length(d) < 0.1f || glm::length(d) > 1.0f);
+        return glm::normalize(d);
+    };
+
+    // vertices spread over a car sized box, with random tangent frames and uvs, plus the axes (edges of the encoding)
+    const unsigned int vertexCount = 200000;
+    std::vector<Vertex> vertices(vertexCount);
+    for (unsigned int i = 0; i < vertexCount; i++)
+    {
+        Vertex &v = vertices[i];
+        v.Position = glm::vec3(2.5f, 0.8f, 4.0f) * glm::vec3(uniform(random), uniform(random) + 1.0f, uniform(random));
+        v.Normal = i < 6 ? glm::vec3(i % 3 == 0, i % 3 == 1, i % 3 == 2) * (i < 3 ? 1.0f : -1.0f) : randomDirection();
+        v.Tangent = glm::normalize(glm::cross(v.Normal, randomDirection()));
+        v.Bitangent = glm::cross(v.Normal, v.Tangent) * (i % 2 ? 1.0f : -1.0f);
+        v.TexCoords = i % 2 ? glm::vec2(uniform(random) + 1.0f, uniform(random) + 1.0f) * 0.5f
+                            : glm::vec2(uniform(random), uniform(random)) * 20.0f;
+    }
+
+    glm::vec3 boundsMin, boundsSize;
+    std::vector<PackedVertex> packed = packing::pack(vertices.data(), vertices.size(), boundsMin, boundsSize);
+
+    // angle between two unit vectors, more precise than acos(dot) for small angles
+    auto angle = [](const glm::vec3 &a, const glm::vec3 &b) {
+        return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+    };
+
+    glm::vec3 maxPositionError(0.0f);
+    float maxNormalError = 0, maxTangentError = 0, maxUVError = 0;
+    unsigned int wrongBitangents = 0;
+    for (unsigned int i = 0; i < vertexCount; i++)
+    {
+        const Vertex &v = vertices[i];
+        Vertex d = packing::unpack<Vertex>(packed[i], boundsMin, boundsSize);
+        maxPositionError = glm::max(maxPositionError, glm::abs(d.Position - v.Position));
+        maxNormalError = std::max(maxNormalError, angle(d.Normal, v.Normal));
+        maxTangentError = std::max(maxTangentError, angle(d.Tangent, v.Tangent));
+        wrongBitangents += glm::dot(d.Bitangent, v.Bitangent) <= 0;
+        for (int k = 0; k < 2; k++)
+            maxUVError = std::max(maxUVError, std::abs(d.TexCoords[k] - v.TexCoords[k]) / std::max(std::abs(v.TexCoords[k]), 1e-4f));
+    }
+
+    // every half float survives a round trip through float
+    unsigned int wrongHalfs = 0;
+    for (unsigned int h = 0; h < 65536; h++)
+    {
+        bool nan = ((h >> 10) & 0x1f) == 0x1f && (h & 0x3ff);
+        wrongHalfs += !nan && packing::floatToHalf(packing::halfToFloat((uint16_t) h)) != h;
+    }
+
+    // the bounds are the ones of the format description in packed_vertex.h, plus the rounding of the float math
+    glm::vec3 positionBound = boundsSize / 65535.0f * 0.5f + (glm::abs(boundsMin) + boundsSize) * 1e-6f;
+    bool ok = maxPositionError.x <= positionBound.x && maxPositionError.y <= positionBound.y &&
+              maxPositionError.z <= positionBound.z && maxNormalError < 0.01f && maxTangentError < 0.01f &&
+              wrongBitangents == 0 && maxUVError <= 1.0f / 2048.0f && wrongHalfs == 0;
+
+    std::cout << "packed vertex format, " << vertexCount << " vertices:" << std::endl;
+    std::cout << "  position error " << maxPositionError.x << ", " << maxPositionError.y << ", " << maxPositionError.z
+              << " (bound " << positionBound.x << ", " << positionBound.y << ", " << positionBound.z << ")" << std::endl;
+    std::cout << "  normal error " << maxNormalError << " degrees, tangent error " << maxTangentError << " degrees, "
+              << wrongBitangents << " wrong bitangent signs" << std::endl;
+    std::cout << "  uv relative error " << maxUVError << " (bound " << 1.0f / 2048.0f << "), "
+              << wrongHalfs << " half floats that do not round trip" << std::endl;
+    std::cout << "  memory " << vertexCount * sizeof(Vertex) / 1024.0 << " KB -> " << vertexCount * sizeof(PackedVertex) / 1024.0
+              << " KB (" << sizeof(Vertex) << " -> " << sizeof(PackedVertex) << " bytes per vertex, "
+              << (float) sizeof(Vertex) / sizeof(PackedVertex) << "x smaller)" << std::endl;
+    std::cout << (ok ? "PASSED" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+#include "render_queue.h"
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+// checks the sort keys of render_queue.h on random draws: the radix sort against std::sort, the order of the passes
+// and of the depths, its speed on 100k draws, and the program and material changes before and after sorting
+int main()
+{
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    const size_t drawCount = 100000;
+    const unsigned int programs = 8, materials = 200;
+
+    struct TestDraw { RenderQueue::Pass pass; unsigned int program, material; float depth; };
+    std::vector<TestDraw> draws(drawCount);
+    std::vector<uint64_t> keys(drawCount);
+    for (size_t i = 0; i < drawCount; i++)
+    {
+        TestDraw &draw = draws[i];
+        draw.pass = random() % 5 == 0 ? RenderQueue::PASS_TRANSPARENT : RenderQueue::PASS_OPAQUE;
+        draw.program = 1 + random() % programs;
+        draw.material = 1 + random() % materials;
+        draw.depth = uniform(random);
+        keys[i] = RenderQueue::makeKey(draw.pass, draw.program, draw.material, draw.depth, (uint32_t) i);
+    }
+
+    std::vector<uint64_t> expected = keys, sorted, buffer;
+    std::sort(expected.begin(), expected.end());
+    double totalMicroseconds = 0;
+    const int runs = 100;
+    for (int run = 0; run < runs; run++)
+    {
+        sorted = keys;
+        auto start = std::chrono::high_resolution_clock::now();
+        RenderQueue::sortKeys(sorted, buffer);
+        totalMicroseconds += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    bool sameOrder = sorted == expected;
+
+    // opaque before transparent, the opaque draws grouped by program and material and front to back in a group,
+    // the transparent ones back to front
+    // (the depths are compared with the precision of the keys)
+    const float depthStep = 1.0f / ((1 << RenderQueue::DEPTH_BITS) - 1);
+    size_t orderErrors = 0;
+    for (size_t i = 1; i < sorted.size(); i++)
+    {
+        const TestDraw &a = draws[sorted[i - 1] & (RenderQueue::MAX_DRAWS - 1)];
+        const TestDraw &b = draws[sorted[i] & (RenderQueue::MAX_DRAWS - 1)];
+        if (a.pass != b.pass)
+            orderErrors += a.pass > b.pass;
+        else if (a.pass == RenderQueue::PASS_TRANSPARENT)
+            orderErrors += a.depth < b.depth - depthStep;
+        else if (a.program == b.program && a.material == b.material)
+            orderErrors += a.depth > b.depth + depthStep;
+        else
+            orderErrors += a.program > b.program || (a.program == b.program && a.material > b.material);
+    }
+
+    // state changes in the order the draws were added and in the sorted order
+    auto countChanges = [&](const std::vector<uint64_t> &order, bool useKeys, size_t &programChanges, size_t &materialChanges) {
+        programChanges = materialChanges = 0;
+        const TestDraw *last = nullptr;
+        for (size_t i = 0; i < drawCount; i++)
+        {
+            const TestDraw &draw = draws[useKeys ? order[i] & (RenderQueue::MAX_DRAWS - 1) : i];
+            programChanges += !last || last->program != draw.program;
+            materialChanges += !last || last->material != draw.material;
+            last = &draw;
+        }
+    };
+    size_t programsBefore, materialsBefore, programsAfter, materialsAfter;
+    countChanges(keys, false, programsBefore, materialsBefore);
+    countChanges(sorted, true, programsAfter, materialsAfter);
+
+    double averageMicroseconds = totalMicroseconds / runs;
+    bool ok = sameOrder && orderErrors == 0 && programsAfter < programsBefore && materialsAfter < materialsBefore;
+    std::cout << drawCount << " draws (" << programs << " programs, " << materials << " materials): sorted in "
+              << averageMicroseconds << " us, " << (sameOrder ? "same" : "NOT the same") << " order as std::sort, "
+              << orderErrors << " order errors" << std::endl;
+    std::cout << "  program changes: " << programsBefore << " unsorted, " << programsAfter << " sorted" << std::endl;
+    std::cout << "  material changes: " << materialsBefore << " unsorted, " << materialsAfter << " sorted" << std::endl;
+    if (averageMicroseconds > 1000.0)
+        std::cout << "WARNING: sorting took more than a millisecond" << std::endl;
+    std::cout << (ok ? "PASSED" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
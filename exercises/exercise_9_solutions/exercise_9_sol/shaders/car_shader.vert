@@ -1,5 +1,5 @@
 #version 330 core
-layout (location = 0) in vec3 vertex;
+layout (location = 0) in vec4 vertex; // w is the sign of the bitangent for packed vertices
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 textCoord;
 layout (location = 3) in vec3 tangent;
@@ -22,11 +22,28 @@ uniform mat4 invTranspMV; // inverse of the transpose of (view * model) (used to
 uniform vec3 lightPosition;
 
 
+// packed vertices (see packed_vertex.h): the position is relative to the bounds of the mesh, and the normal and
+// tangent are octahedral encoded in the xy of their attributes
+uniform bool packedVertex;
+uniform vec3 boundsMin;
+uniform vec3 boundsSize;
+
+vec3 octDecode(vec2 e) {
+   vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+   if (n.z < 0.0)
+      n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+   return normalize(n);
+}
+
 void main() {
+   // decode the vertex attributes
+   vec3 vertexPosition = packedVertex ? boundsMin + vertex.xyz * boundsSize : vertex.xyz;
+   vec3 vertexNormal = packedVertex ? octDecode(normal.xy) : normal;
+
    // vertex in eye space (for light computation in eye space)
-   vec4 Pos_eye = view * model * vec4(vertex, 1.0);
+   vec4 Pos_eye = view * model * vec4(vertexPosition, 1.0);
    // normal in eye space (for light computation in eye space)
-   vec3 N_eye = normalize((invTranspMV * vec4(normal, 0.0)).xyz);
+   vec3 N_eye = normalize((invTranspMV * vec4(vertexNormal, 0.0)).xyz);
    // light in eye space
    vec4 Light_eye = view * vec4(lightPosition, 1.0);
 
@@ -0,0 +1,648 @@
+#ifndef TEXTURE_BAKER_H
+#define TEXTURE_BAKER_H
+
+// Offline texture compression, so that the textures don't need to be decoded, converted and mipmapped at every launch.
+//
+// bakeFile decodes a texture file, generates its mip chain on the CPU and compresses every level in 4x4 texel blocks:
+// - BC1 (DXT1): RGB, 8 bytes per block (4 bits per texel instead of 32), for the textures without alpha
+// - BC3 (DXT5): RGBA, 16 bytes per block, BC1 for the color plus a BC4 block for the alpha
+// - BC4 (RGTC1): one channel, 8 bytes per block, for the single channel textures (ambient occlusion, ...)
+// - BC5 (RGTC2): two channels, 16 bytes per block, for the normal maps. Only x and y are stored, the shader computes z
+// The result is written next to the texture, to <texture path>.texbake. When the texture is loaded (see
+// texture_cache.h) an up to date .texbake file is read instead, and its levels go straight to glCompressedTexImage2D.
+// The baked file is ignored if the size or the modification time of the texture file changed.
+//
+// File layout (numbers in the byte order of the machine, like the mesh cache):
+//   FileHeader
+//   FileLevel[levelCount]
+//   the blocks of every level, each level starts at a multiple of 16 bytes (offsets relative to the end of the levels)
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+using namespace std;
+
+// S3TC is an extension (supported by all desktop GPUs), the GL loader does not always define its enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace texbake {
+
+    enum Format : uint32_t { BC1 = 1, BC3 = 3, BC4 = 4, BC5 = 5 };
+
+    inline size_t blockBytes(Format format) { return format == BC1 || format == BC4 ? 8 : 16; }
+
+    inline GLenum glFormat(Format format)
+    {
+        switch (format)
+        {
+            case BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case BC4: return GL_COMPRESSED_RED_RGTC1;
+            default:  return GL_COMPRESSED_RG_RGTC2;
+        }
+    }
+
+    inline const char *formatName(Format format)
+    {
+        switch (format)
+        {
+            case BC1: return "BC1";
+            case BC3: return "BC3";
+            case BC4: return "BC4";
+            default:  return "BC5";
+        }
+    }
+
+    struct Level {
+        uint32_t width, height;
+        uint64_t offset, size; // bytes in BakedTexture::data
+    };
+
+    // a compressed mip chain, level 0 is the full size texture
+    struct BakedTexture {
+        Format format = BC1;
+        uint32_t width = 0, height = 0;
+        vector<Level> levels;
+        vector<unsigned char> data;
+    };
+
+    namespace detail {
+        inline uint16_t to565(const float color[3])
+        {
+            int r = (int) std::lround(std::max(0.0f, std::min(255.0f, color[0])) * 31.0f / 255.0f);
+            int g = (int) std::lround(std::max(0.0f, std::min(255.0f, color[1])) * 63.0f / 255.0f);
+            int b = (int) std::lround(std::max(0.0f, std::min(255.0f, color[2])) * 31.0f / 255.0f);
+            return (uint16_t) ((r << 11) | (g << 5) | b);
+        }
+
+        // the 4 colors of a BC1 block (4 color mode, color0 > color1), 565 expanded to 888 by bit replication
+        inline void bc1Palette(uint16_t color0, uint16_t color1, int palette[4][3])
+        {
+            for (int e = 0; e < 2; e++)
+            {
+                uint16_t c = e ? color1 : color0;
+                int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+                palette[e][0] = (r << 3) | (r >> 2);
+                palette[e][1] = (g << 2) | (g >> 4);
+                palette[e][2] = (b << 3) | (b >> 2);
+            }
+            for (int i = 0; i < 3; i++)
+            {
+                palette[2][i] = (2 * palette[0][i] + palette[1][i] + 1) / 3;
+                palette[3][i] = (palette[0][i] + 2 * palette[1][i] + 1) / 3;
+            }
+        }
+
+        // picks the closest palette color for every texel, returns the squared error
+        inline int bc1Indices(const unsigned char rgba[64], uint16_t color0, uint16_t color1, int indices[16])
+        {
+            int palette[4][3];
+            bc1Palette(color0, color1, palette);
+            int error = 0;
+            for (int t = 0; t < 16; t++)
+            {
+                int best = 1 << 30;
+                for (int p = 0; p < 4; p++)
+                {
+                    int dr = rgba[t * 4] - palette[p][0], dg = rgba[t * 4 + 1] - palette[p][1], db = rgba[t * 4 + 2] - palette[p][2];
+                    int d = dr * dr + dg * dg + db * db;
+                    if (d < best)
+                    {
+                        best = d;
+                        indices[t] = p;
+                    }
+                }
+                error += best;
+            }
+            return error;
+        }
+
+        // the 8 values of a BC4 block
+        inline void bc4Palette(int value0, int value1, int palette[8])
+        {
+            palette[0] = value0;
+            palette[1] = value1;
+            if (value0 > value1)
+                for (int i = 2; i < 8; i++)
+                    palette[i] = ((8 - i) * value0 + (i - 1) * value1 + 3) / 7;
+            else
+            {
+                for (int i = 2; i < 6; i++)
+                    palette[i] = ((6 - i) * value0 + (i - 1) * value1 + 2) / 5;
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+        }
+    }
+
+    // compresses 16 RGB texels (RGBA8, row by row, alpha ignored) into a BC1 block.
+    // the endpoints are the extremes of the colors along their principal axis, then they are refined by least squares
+    inline void encodeBC1(const unsigned char rgba[64], unsigned char out[8])
+    {
+        float mean[3] = {0, 0, 0};
+        for (int t = 0; t < 16; t++)
+            for (int i = 0; i < 3; i++)
+                mean[i] += rgba[t * 4 + i] / 16.0f;
+        float covariance[6] = {0, 0, 0, 0, 0, 0}; // rr rg rb gg gb bb
+        for (int t = 0; t < 16; t++)
+        {
+            float r = rgba[t * 4] - mean[0], g = rgba[t * 4 + 1] - mean[1], b = rgba[t * 4 + 2] - mean[2];
+            covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+            covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+        }
+        // principal axis by power iteration
+        float axis[3] = {1, 1, 1};
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+            float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+            float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+            float length = std::max(std::abs(x), std::max(std::abs(y), std::abs(z)));
+            if (length == 0)
+                break;
+            axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+        }
+        float lo = 1e30f, hi = -1e30f;
+        for (int t = 0; t < 16; t++)
+        {
+            float d = (rgba[t * 4] - mean[0]) * axis[0] + (rgba[t * 4 + 1] - mean[1]) * axis[1] + (rgba[t * 4 + 2] - mean[2]) * axis[2];
+            lo = std::min(lo, d);
+            hi = std::max(hi, d);
+        }
+        float squaredLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        float endpoints[2][3];
+        for (int i = 0; i < 3; i++)
+        {
+            endpoints[0][i] = mean[i] + axis[i] * hi / std::max(squaredLength, 1e-12f);
+            endpoints[1][i] = mean[i] + axis[i] * lo / std::max(squaredLength, 1e-12f);
+        }
+        uint16_t color0 = detail::to565(endpoints[0]), color1 = detail::to565(endpoints[1]);
+        int indices[16];
+        int error = detail::bc1Indices(rgba, color0, color1, indices);
+
+        // least squares endpoints for these indices: texel = a * endpoint0 + b * endpoint1
+        static const float weight[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+        float aa = 0, ab = 0, bb = 0, ax[3] = {0, 0, 0}, bx[3] = {0, 0, 0};
+        for (int t = 0; t < 16; t++)
+        {
+            float a = weight[indices[t]], b = 1.0f - a;
+            aa += a * a; ab += a * b; bb += b * b;
+            for (int i = 0; i < 3; i++)
+            {
+                ax[i] += a * rgba[t * 4 + i];
+                bx[i] += b * rgba[t * 4 + i];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) > 1e-6f)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                endpoints[0][i] = (ax[i] * bb - bx[i] * ab) / determinant;
+                endpoints[1][i] = (bx[i] * aa - ax[i] * ab) / determinant;
+            }
+            uint16_t refined0 = detail::to565(endpoints[0]), refined1 = detail::to565(endpoints[1]);
+            int refinedIndices[16];
+            int refinedError = detail::bc1Indices(rgba, refined0, refined1, refinedIndices);
+            if (refinedError < error)
+            {
+                color0 = refined0;
+                color1 = refined1;
+                memcpy(indices, refinedIndices, sizeof(indices));
+            }
+        }
+
+        // color0 > color1 selects the 4 color mode, swapping the endpoints swaps the indices 0/1 and 2/3
+        if (color0 < color1)
+        {
+            std::swap(color0, color1);
+            for (int t = 0; t < 16; t++)
+                indices[t] ^= 1;
+        }
+        else if (color0 == color1)
+            for (int t = 0; t < 16; t++)
+                indices[t] = 0;
+
+        out[0] = (unsigned char) (color0 & 255); out[1] = (unsigned char) (color0 >> 8);
+        out[2] = (unsigned char) (color1 & 255); out[3] = (unsigned char) (color1 >> 8);
+        for (int row = 0; row < 4; row++)
+            out[4 + row] = (unsigned char) (indices[row * 4] | (indices[row * 4 + 1] << 2) | (indices[row * 4 + 2] << 4) |
+                                            (indices[row * 4 + 3] << 6));
+    }
+
+    // compresses one channel of 16 texels (the channel of RGBA8 texels at values, stride 4 bytes) into a BC4 block,
+    // always in the 8 value mode, between the smallest and the largest value
+    inline void encodeBC4(const unsigned char *values, unsigned char out[8])
+    {
+        int lo = 255, hi = 0;
+        for (int t = 0; t < 16; t++)
+        {
+            lo = std::min(lo, (int) values[t * 4]);
+            hi = std::max(hi, (int) values[t * 4]);
+        }
+        int palette[8];
+        detail::bc4Palette(hi, lo, palette);
+        uint64_t bits = 0;
+        for (int t = 0; t < 16 && hi > lo; t++)
+        {
+            int best = 0;
+            for (int p = 1; p < 8; p++)
+                if (std::abs(values[t * 4] - palette[p]) < std::abs(values[t * 4] - palette[best]))
+                    best = p;
+            bits |= (uint64_t) best << (3 * t);
+        }
+        out[0] = (unsigned char) hi;
+        out[1] = (unsigned char) lo;
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = (unsigned char) (bits >> (8 * i));
+    }
+
+    // compresses a 4x4 block of RGBA8 texels (row by row), blockBytes(format) are written to out
+    inline void encodeBlock(Format format, const unsigned char rgba[64], unsigned char *out)
+    {
+        switch (format)
+        {
+            case BC1: encodeBC1(rgba, out); break;
+            case BC3: encodeBC4(rgba + 3, out); encodeBC1(rgba, out + 8); break;
+            case BC4: encodeBC4(rgba, out); break;
+            case BC5: encodeBC4(rgba, out); encodeBC4(rgba + 1, out + 8); break;
+        }
+    }
+
+    // decodes a block to RGBA8 texels, as the GPU does (the channels a format does not have are 0, alpha 255)
+    inline void decodeBlock(Format format, const unsigned char *in, unsigned char rgba[64])
+    {
+        memset(rgba, 0, 64);
+        for (int t = 0; t < 16; t++)
+            rgba[t * 4 + 3] = 255;
+        auto decodeBC4 = [&](const unsigned char *block, int channel) {
+            int palette[8];
+            detail::bc4Palette(block[0], block[1], palette);
+            uint64_t bits = 0;
+            for (int i = 0; i < 6; i++)
+                bits |= (uint64_t) block[2 + i] << (8 * i);
+            for (int t = 0; t < 16; t++)
+                rgba[t * 4 + channel] = (unsigned char) palette[(bits >> (3 * t)) & 7];
+        };
+        auto decodeBC1 = [&](const unsigned char *block) {
+            uint16_t color0 = (uint16_t) (block[0] | (block[1] << 8)), color1 = (uint16_t) (block[2] | (block[3] << 8));
+            int palette[4][3];
+            detail::bc1Palette(color0, color1, palette);
+            if (color0 <= color1 && format == BC1)
+            {
+                // 3 color mode: the midpoint and transparent black, never written by encodeBC1
+                for (int i = 0; i < 3; i++)
+                {
+                    palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+                    palette[3][i] = 0;
+                }
+            }
+            for (int t = 0; t < 16; t++)
+            {
+                int index = (block[4 + t / 4] >> (2 * (t % 4))) & 3;
+                for (int i = 0; i < 3; i++)
+                    rgba[t * 4 + i] = (unsigned char) palette[index][i];
+                if (color0 <= color1 && format == BC1 && index == 3)
+                    rgba[t * 4 + 3] = 0;
+            }
+        };
+        switch (format)
+        {
+            case BC1: decodeBC1(in); break;
+            case BC3: decodeBC1(in + 8); decodeBC4(in, 3); break;
+            case BC4: decodeBC4(in, 0); break;
+            case BC5: decodeBC4(in, 0); decodeBC4(in + 8, 1); break;
+        }
+    }
+
+    // the format for a texture, components are the ones of the file (stb_image)
+    inline Format chooseFormat(const unsigned char *rgba, uint32_t width, uint32_t height, int components, bool normalMap)
+    {
+        if (normalMap)
+            return BC5;
+        if (components == 1)
+            return BC4;
+        for (size_t i = 0; (components == 2 || components == 4) && i < (size_t) width * height; i++)
+            if (rgba[i * 4 + 3] != 255)
+                return BC3;
+        return BC1;
+    }
+
+    // next level of a mip chain, 2x2 box filter. The normals of normal maps are renormalized after averaging
+    inline vector<unsigned char> downsample(const vector<unsigned char> &rgba, uint32_t width, uint32_t height, bool normalMap)
+    {
+        uint32_t w = std::max(width / 2, 1u), h = std::max(height / 2, 1u);
+        vector<unsigned char> result((size_t) w * h * 4);
+        for (uint32_t y = 0; y < h; y++)
+            for (uint32_t x = 0; x < w; x++)
+            {
+                float sum[4] = {0, 0, 0, 0};
+                for (uint32_t dy = 0; dy < 2; dy++)
+                    for (uint32_t dx = 0; dx < 2; dx++)
+                    {
+                        const unsigned char *texel = &rgba[((size_t) std::min(2 * y + dy, height - 1) * width +
+                                                            std::min(2 * x + dx, width - 1)) * 4];
+                        for (int i = 0; i < 4; i++)
+                            sum[i] += normalMap && i < 3 ? texel[i] / 127.5f - 1.0f : texel[i] / 4.0f;
+                    }
+                unsigned char *texel = &result[((size_t) y * w + x) * 4];
+                if (normalMap)
+                {
+                    float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+                    for (int i = 0; i < 3; i++)
+                        sum[i] = length > 0 ? (sum[i] / length + 1.0f) * 127.5f : (i == 2 ? 255.0f : 127.5f);
+                }
+                for (int i = 0; i < 4; i++)
+                    texel[i] = (unsigned char) std::lround(std::max(0.0f, std::min(255.0f, sum[i])));
+            }
+        return result;
+    }
+
+    // compresses an image (pixels as decoded by stb_image, components channels per texel) and its mip chain
+    inline void bake(const unsigned char *pixels, uint32_t width, uint32_t height, int components, bool normalMap, BakedTexture &out)
+    {
+        // expand to RGBA8, gray becomes RGB, a missing alpha is opaque
+        vector<unsigned char> rgba((size_t) width * height * 4);
+        for (size_t i = 0; i < (size_t) width * height; i++)
+        {
+            const unsigned char *texel = pixels + i * components;
+            bool gray = components < 3;
+            rgba[i * 4 + 0] = texel[0];
+            rgba[i * 4 + 1] = gray ? texel[0] : texel[1];
+            rgba[i * 4 + 2] = gray ? texel[0] : texel[2];
+            rgba[i * 4 + 3] = components == 2 ? texel[1] : components == 4 ? texel[3] : 255;
+        }
+
+        out.format = chooseFormat(rgba.data(), width, height, components, normalMap);
+        out.width = width;
+        out.height = height;
+        out.levels.clear();
+        out.data.clear();
+        uint32_t w = width, h = height;
+        while (true)
+        {
+            Level level;
+            level.width = w;
+            level.height = h;
+            level.offset = out.data.size();
+            uint32_t blocksX = (w + 3) / 4, blocksY = (h + 3) / 4;
+            level.size = (uint64_t) blocksX * blocksY * blockBytes(out.format);
+            out.data.resize((size_t) (level.offset + level.size));
+            for (uint32_t by = 0; by < blocksY; by++)
+                for (uint32_t bx = 0; bx < blocksX; bx++)
+                {
+                    // texels outside of a level smaller than 4x4 repeat the edge
+                    unsigned char block[64];
+                    for (uint32_t t = 0; t < 16; t++)
+                    {
+                        uint32_t x = std::min(bx * 4 + t % 4, w - 1), y = std::min(by * 4 + t / 4, h - 1);
+                        memcpy(block + t * 4, &rgba[((size_t) y * w + x) * 4], 4);
+                    }
+                    encodeBlock(out.format, block, &out.data[(size_t) (level.offset + ((uint64_t) by * blocksX + bx) * blockBytes(out.format))]);
+                }
+            out.levels.push_back(level);
+            if (w == 1 && h == 1)
+                break;
+            rgba = downsample(rgba, w, h, normalMap);
+            w = std::max(w / 2, 1u);
+            h = std::max(h / 2, 1u);
+        }
+    }
+
+    // decodes a level back to RGBA8 texels (for tests and tools)
+    inline vector<unsigned char> decodeLevel(const BakedTexture &texture, size_t levelIndex)
+    {
+        const Level &level = texture.levels[levelIndex];
+        vector<unsigned char> rgba((size_t) level.width * level.height * 4);
+        uint32_t blocksX = (level.width + 3) / 4, blocksY = (level.height + 3) / 4;
+        for (uint32_t by = 0; by < blocksY; by++)
+            for (uint32_t bx = 0; bx < blocksX; bx++)
+            {
+                unsigned char block[64];
+                decodeBlock(texture.format, &texture.data[(size_t) (level.offset + ((uint64_t) by * blocksX + bx) * blockBytes(texture.format))], block);
+                for (uint32_t t = 0; t < 16; t++)
+                {
+                    uint32_t x = bx * 4 + t % 4, y = by * 4 + t / 4;
+                    if (x < level.width && y < level.height)
+                        memcpy(&rgba[((size_t) y * level.width + x) * 4], block + t * 4, 4);
+                }
+            }
+        return rgba;
+    }
+
+    /*  Baked files  */
+    // increase it when the content changes
+    const uint32_t VERSION = 1;
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+        uint32_t padding;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+    };
+
+    struct FileLevel {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    inline string bakedPath(const string &sourcePath) { return sourcePath + ".texbake"; }
+
+    inline uint64_t align(uint64_t offset) { return (offset + 15) & ~(uint64_t) 15; }
+
+    // header the baked file of sourcePath should have, fails if the source file does not exist
+    inline bool makeHeader(const string &sourcePath, FileHeader &header)
+    {
+        struct stat sourceStat;
+        if (stat(sourcePath.c_str(), &sourceStat) != 0)
+            return false;
+        memset(&header, 0, sizeof(FileHeader));
+        memcpy(header.magic, "TEXBAKE", 8);
+        header.version = VERSION;
+        header.sourceSize = (uint64_t) sourceStat.st_size;
+        header.sourceTime = (int64_t) sourceStat.st_mtime;
+        return true;
+    }
+
+    // writes the baked file of sourcePath, through a temporary file so that an interrupted write leaves no broken file
+    inline bool write(const string &sourcePath, const BakedTexture &texture)
+    {
+        FileHeader header;
+        if (!makeHeader(sourcePath, header))
+            return false;
+        header.format = texture.format;
+        header.width = texture.width;
+        header.height = texture.height;
+        header.levelCount = (uint32_t) texture.levels.size();
+
+        vector<FileLevel> levels;
+        uint64_t offset = 0;
+        for (const Level &level : texture.levels)
+        {
+            FileLevel fileLevel = {level.width, level.height, offset, level.size};
+            levels.push_back(fileLevel);
+            offset = align(offset + level.size);
+        }
+
+        string path = bakedPath(sourcePath);
+        string temporaryPath = path + ".tmp";
+        FILE *out = fopen(temporaryPath.c_str(), "wb");
+        if (!out)
+            return false;
+        static const char zeros[16] = {};
+        uint64_t start = sizeof(FileHeader) + levels.size() * sizeof(FileLevel);
+        bool ok = fwrite(&header, sizeof(FileHeader), 1, out) == 1 &&
+                  (levels.empty() || fwrite(levels.data(), sizeof(FileLevel) * levels.size(), 1, out) == 1) &&
+                  fwrite(zeros, 1, (size_t) (align(start) - start), out) == align(start) - start;
+        for (size_t i = 0; i < levels.size() && ok; i++)
+        {
+            const Level &level = texture.levels[i];
+            uint64_t padding = align(level.size) - level.size;
+            ok = fwrite(&texture.data[(size_t) level.offset], 1, (size_t) level.size, out) == level.size &&
+                 (i + 1 == levels.size() || fwrite(zeros, 1, (size_t) padding, out) == padding);
+        }
+        ok = fclose(out) == 0 && ok;
+
+        remove(path.c_str()); // rename does not replace an existing file on Windows
+        if (!ok || rename(temporaryPath.c_str(), path.c_str()) != 0)
+        {
+            remove(temporaryPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // reads the baked file of sourcePath, returns false if there is none or it is out of date
+    inline bool read(const string &sourcePath, BakedTexture &texture)
+    {
+        FileHeader expected, header;
+        if (!makeHeader(sourcePath, expected))
+            return false;
+        FILE *in = fopen(bakedPath(sourcePath).c_str(), "rb");
+        if (!in)
+            return false;
+        bool ok = fread(&header, sizeof(FileHeader), 1, in) == 1 && memcmp(header.magic, expected.magic, 8) == 0 &&
+                  header.version == expected.version && header.sourceSize == expected.sourceSize &&
+                  header.sourceTime == expected.sourceTime && header.format >= BC1 && header.format <= BC5 &&
+                  header.format != 2 && header.levelCount > 0 && header.levelCount <= 32;
+        vector<FileLevel> levels(ok ? header.levelCount : 0);
+        ok = ok && fread(levels.data(), sizeof(FileLevel) * levels.size(), 1, in) == 1;
+
+        // the blocks are read in one go, from the first level to the end of the file
+        long start = (long) align(sizeof(FileHeader) + levels.size() * sizeof(FileLevel));
+        long end = 0;
+        ok = ok && fseek(in, 0, SEEK_END) == 0 && (end = ftell(in)) >= start && fseek(in, start, SEEK_SET) == 0;
+        texture.levels.clear();
+        for (size_t i = 0; i < levels.size() && ok; i++)
+        {
+            const FileLevel &fileLevel = levels[i];
+            Level level = {fileLevel.width, fileLevel.height, fileLevel.offset, fileLevel.size};
+            uint64_t expectedSize = (uint64_t) ((fileLevel.width + 3) / 4) * ((fileLevel.height + 3) / 4) *
+                                    blockBytes((Format) header.format);
+            ok = fileLevel.size == expectedSize && fileLevel.offset <= (uint64_t) (end - start) &&
+                 fileLevel.size <= (uint64_t) (end - start) - fileLevel.offset;
+            texture.levels.push_back(level);
+        }
+        if (ok)
+        {
+            texture.data.resize((size_t) (end - start));
+            ok = texture.data.empty() || fread(texture.data.data(), texture.data.size(), 1, in) == 1;
+        }
+        fclose(in);
+        if (!ok)
+        {
+            texture.levels.clear();
+            texture.data.clear();
+            return false;
+        }
+        texture.format = (Format) header.format;
+        texture.width = header.width;
+        texture.height = header.height;
+        return true;
+    }
+
+    // true if both textures have the same levels with the same blocks. The data of a texture read from a file has
+    // the padding between the levels, so the levels are compared one by one at their offsets
+    inline bool sameLevels(const BakedTexture &a, const BakedTexture &b)
+    {
+        if (a.format != b.format || a.width != b.width || a.height != b.height || a.levels.size() != b.levels.size())
+            return false;
+        for (size_t i = 0; i < a.levels.size(); i++)
+        {
+            const Level &levelA = a.levels[i], &levelB = b.levels[i];
+            if (levelA.width != levelB.width || levelA.height != levelB.height || levelA.size != levelB.size ||
+                memcmp(&a.data[(size_t) levelA.offset], &b.data[(size_t) levelB.offset], (size_t) levelA.size) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    // what bakeFile did, summed over the files
+    struct BakeStats {
+        size_t textures = 0;
+        size_t failed = 0;
+        uint64_t uncompressedBytes = 0; // GPU memory of the textures as RGBA8 with mipmaps, as loaded without baking
+        uint64_t bakedBytes = 0;        // GPU memory of the compressed mip chains
+        double decodeSeconds = 0;       // time to decode the texture files with stb_image
+        double readSeconds = 0;         // time to read the baked files
+    };
+
+    // bakes the texture file at path, normal maps are compressed to BC5
+    inline bool bakeFile(const string &path, bool normalMap, BakeStats &stats)
+    {
+        auto start = chrono::high_resolution_clock::now();
+        int width, height, components;
+        unsigned char *pixels = stbi_load(path.c_str(), &width, &height, &components, 0);
+        stats.decodeSeconds += chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+        if (!pixels)
+        {
+            stats.failed++;
+            return false;
+        }
+        BakedTexture texture;
+        bake(pixels, (uint32_t) width, (uint32_t) height, components, normalMap, texture);
+        stbi_image_free(pixels);
+        if (!write(path, texture))
+        {
+            stats.failed++;
+            return false;
+        }
+
+        start = chrono::high_resolution_clock::now();
+        BakedTexture check;
+        bool ok = read(path, check) && sameLevels(check, texture);
+        stats.readSeconds += chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+        if (!ok)
+        {
+            stats.failed++;
+            return false;
+        }
+        stats.textures++;
+        stats.uncompressedBytes += (uint64_t) width * height * 4 * 4 / 3;
+        stats.bakedBytes += texture.data.size();
+        return true;
+    }
+}
+
+#endif
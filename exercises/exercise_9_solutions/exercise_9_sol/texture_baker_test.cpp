@@ -0,0 +1,155 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#include "texture_baker.h"
+
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// checks the block compression and the baked file format of texture_baker.h, on generated images
+int main()
+{
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<int> noise(-4, 4);
+    const uint32_t width = 256, height = 192;
+    bool ok = true;
+
+    // peak signal to noise ratio of level 0 over the given channels
+    auto psnr = [](const std::vector<unsigned char> &a, const std::vector<unsigned char> &b, int firstChannel, int channels) {
+        double squaredError = 0;
+        for (size_t i = 0; i < a.size() / 4; i++)
+            for (int c = firstChannel; c < firstChannel + channels; c++)
+                squaredError += (double) (a[i * 4 + c] - b[i * 4 + c]) * (a[i * 4 + c] - b[i * 4 + c]);
+        double mse = squaredError / (a.size() / 4 * channels);
+        return mse > 0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+    };
+
+    // 1. color (BC1), color with alpha (BC3), gray (BC4) and a normal map (BC5): smooth gradients with a bit of noise
+    for (int components : {3, 4, 1, 0})
+    {
+        bool normalMap = components == 0;
+        int fileComponents = normalMap ? 3 : components;
+        std::vector<unsigned char> pixels((size_t) width * height * fileComponents);
+        std::vector<unsigned char> rgba((size_t) width * height * 4);
+        for (uint32_t y = 0; y < height; y++)
+            for (uint32_t x = 0; x < width; x++)
+            {
+                size_t i = (size_t) y * width + x;
+                int value[4] = {(int) x, (int) (y * 255 / height), (int) ((x + y) / 2), (int) (255 - x)};
+                if (normalMap)
+                {
+                    // bumps, as in a tangent space normal map
+                    glm::vec3 n = glm::normalize(glm::vec3(0.4f * std::sin(x * 0.1f), 0.4f * std::cos(y * 0.13f), 1.0f));
+                    for (int c = 0; c < 3; c++)
+                        value[c] = (int) std::lround((n[c] + 1.0f) * 127.5f);
+                }
+                for (int c = 0; c < 4; c++)
+                    value[c] = normalMap ? value[c] : std::max(0, std::min(255, value[c] + noise(random)));
+                for (int c = 0; c < fileComponents; c++)
+                    pixels[i * fileComponents + c] = (unsigned char) value[c];
+                for (int c = 0; c < 4; c++)
+                    rgba[i * 4 + c] = (unsigned char) (c == 3 ? (components == 4 ? value[3] : 255) : value[components == 1 ? 0 : c]);
+            }
+
+        texbake::BakedTexture baked;
+        texbake::bake(pixels.data(), width, height, fileComponents, normalMap, baked);
+        texbake::Format expectedFormat = normalMap ? texbake::BC5 : components == 1 ? texbake::BC4 : components == 4 ? texbake::BC3 : texbake::BC1;
+        std::vector<unsigned char> decoded = texbake::decodeLevel(baked, 0);
+        const texbake::Level &last = baked.levels.back();
+
+        double quality;
+        std::string metric;
+        if (normalMap)
+        {
+            // largest angle between the original normals and the ones rebuilt from x and y, as the shader does
+            double maxAngle = 0;
+            for (size_t i = 0; i < decoded.size() / 4; i++)
+            {
+                glm::vec3 n = glm::normalize(glm::vec3(rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2]) / 127.5f - 1.0f);
+                glm::vec2 xy = glm::vec2(decoded[i * 4], decoded[i * 4 + 1]) / 127.5f - 1.0f;
+                glm::vec3 d = glm::normalize(glm::vec3(xy, std::sqrt(std::max(0.0f, 1.0f - glm::dot(xy, xy)))));
+                maxAngle = std::max(maxAngle, (double) glm::degrees(std::atan2(glm::length(glm::cross(n, d)), glm::dot(n, d))));
+            }
+            quality = maxAngle;
+            metric = " degrees max normal error";
+            ok = ok && maxAngle < 2.0;
+        }
+        else
+        {
+            quality = psnr(rgba, decoded, 0, components == 1 ? 1 : 3);
+            if (components == 4)
+                ok = ok && psnr(rgba, decoded, 3, 1) > 40.0;
+            metric = " dB";
+            ok = ok && quality > (components == 1 ? 40.0 : 33.0);
+        }
+
+        // full mip chain down to 1x1, 4 or 8 bits per texel
+        size_t uncompressed = (size_t) width * height * 4;
+        ok = ok && baked.format == expectedFormat && baked.levels.size() == 9 && last.width == 1 && last.height == 1 &&
+             baked.levels[0].size * 8 == (uint64_t) width * height * (texbake::blockBytes(baked.format) / 2);
+        std::cout << texbake::formatName(baked.format) << ": " << quality << metric << ", level 0 " << uncompressed / 1024.0
+                  << " KB -> " << baked.levels[0].size / 1024.0 << " KB, " << baked.levels.size() << " levels" << std::endl;
+    }
+
+    // 2. blocks of a single color that 565 can represent are exact, odd sizes repeat the edge
+    {
+        unsigned char block[64], out[16], decoded[64];
+        for (int t = 0; t < 16; t++)
+        {
+            block[t * 4] = 255; block[t * 4 + 1] = 0; block[t * 4 + 2] = 132; block[t * 4 + 3] = 255;
+        }
+        texbake::encodeBlock(texbake::BC1, block, out);
+        texbake::decodeBlock(texbake::BC1, out, decoded);
+        ok = ok && memcmp(block, decoded, 64) == 0;
+
+        unsigned char odd[5 * 3 * 3];
+        for (int i = 0; i < 5 * 3 * 3; i++)
+            odd[i] = (unsigned char) (i * 5);
+        texbake::BakedTexture baked;
+        texbake::bake(odd, 5, 3, 3, false, baked);
+        ok = ok && baked.levels.size() == 3 && baked.levels[0].size == 2 * 8 && baked.levels[1].width == 2 &&
+             baked.levels[1].height == 1 && texbake::decodeLevel(baked, 0).size() == 5 * 3 * 4;
+    }
+
+    // 3. the baked file round trips, and is ignored once the texture file changes. BC3 has 16 byte blocks, BC1 and
+    // BC4 have 8 byte blocks so their 2x2 and 1x1 levels are padded in the file
+    for (int components : {4, 3, 1})
+    {
+        const char *source = "texture_compression_test.png";
+        FILE *file = fopen(source, "wb");
+        ok = ok && file && fputs("not really a png", file) >= 0;
+        if (file)
+            fclose(file);
+        std::vector<unsigned char> pixels((size_t) width * height * components);
+        for (unsigned char &p : pixels)
+            p = (unsigned char) random();
+        texbake::BakedTexture baked, read;
+        texbake::bake(pixels.data(), width, height, components, false, baked);
+        ok = ok && texbake::write(source, baked) && texbake::read(source, read) && read.format == baked.format &&
+             read.width == width && read.height == height && read.levels.size() == baked.levels.size();
+        for (size_t i = 0; ok && i < baked.levels.size(); i++)
+            ok = read.levels[i].width == baked.levels[i].width && read.levels[i].height == baked.levels[i].height &&
+                 read.levels[i].size == baked.levels[i].size &&
+                 memcmp(&read.data[read.levels[i].offset], &baked.data[baked.levels[i].offset], baked.levels[i].size) == 0;
+        // the check bakeFile does after writing the file
+        ok = ok && texbake::sameLevels(read, baked);
+        file = fopen(source, "ab");
+        if (file)
+        {
+            fputs(", changed", file);
+            fclose(file);
+        }
+        ok = ok && !texbake::read(source, read);
+        remove(texbake::bakedPath(source).c_str());
+        remove(source);
+    }
+
+    std::cout << (ok ? "PASSED" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
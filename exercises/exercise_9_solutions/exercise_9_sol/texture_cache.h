@@ -0,0 +1,318 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+// Textures shared by all the models of the program, so that a file used by several models (the parts of the car use
+// the same texture files) is only decoded and uploaded once.
+//
+// Textures are looked up by their canonical path (see canonicalPath) in a hash map. acquire returns a reference
+// counted Handle, the models keep the handles of their textures for as long as they live.
+// Textures that are not used by any handle anymore stay on the GPU, in case they are needed again, until the resident
+// texture memory goes over the budget. Then the least recently used ones are deleted.
+//
+// acquire and decode can be called from any thread (decoding is done outside of the lock, every file is only decoded
+// once even if several threads ask for it), upload and trim must be called by the thread of the GL context.
+//
+// A texture that was baked (see texture_baker.h) is read from its .texbake file instead, already compressed and
+// mipmapped.
+
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <texture_baker.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// a texture file decoded to memory, decoding needs no GL calls so it can be done on any thread
+struct TextureData {
+    string path;
+    int width = 0, height = 0, components = 0;
+    unsigned char *pixels = nullptr; // owned by stb_image, freed by uploadTexture
+    texbake::BakedTexture baked; // the compressed mip chain instead of the pixels, if the texture was baked
+};
+
+// reads the baked texture if there is an up to date one, otherwise reads and decodes the texture file
+inline void decodeTexture(TextureData &texture, const string &filename)
+{
+    texture.path = filename;
+    if (texbake::read(filename, texture.baked))
+    {
+        texture.width = (int) texture.baked.width;
+        texture.height = (int) texture.baked.height;
+        return;
+    }
+    texture.pixels = stbi_load(filename.c_str(), &texture.width, &texture.height, &texture.components, 0);
+}
+
+// GPU memory the texture will take once uploaded, mipmaps included
+inline size_t textureBytes(const TextureData &texture)
+{
+    size_t bytes = 0;
+    for (const texbake::Level &level : texture.baked.levels)
+        bytes += (size_t) level.size;
+    // uncompressed, the driver pads the rows to 4 bytes per texel, and the mipmaps add a third
+    return texture.baked.levels.empty() && texture.pixels ? (size_t) texture.width * texture.height * 4 * 4 / 3 : bytes;
+}
+
+// creates the GL texture, the pixels are freed
+inline unsigned int uploadTexture(TextureData &texture)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    if (!texture.baked.levels.empty())
+    {
+        // the mip chain is already there, every level is uploaded as it is
+        const texbake::BakedTexture &baked = texture.baked;
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        for (size_t i = 0; i < baked.levels.size(); i++)
+        {
+            const texbake::Level &level = baked.levels[i];
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint) i, texbake::glFormat(baked.format), level.width, level.height, 0,
+                                   (GLsizei) level.size, &baked.data[(size_t) level.offset]);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) baked.levels.size() - 1);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        texture.baked = texbake::BakedTexture();
+    }
+    else if (texture.pixels)
+    {
+        GLenum format;
+        if (texture.components == 1)
+            format = GL_RED;
+        else if (texture.components == 3)
+            format = GL_RGB;
+        else if (texture.components == 4)
+            format = GL_RGBA;
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, texture.width, texture.height, 0, format, GL_UNSIGNED_BYTE, texture.pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        stbi_image_free(texture.pixels);
+        texture.pixels = nullptr;
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << texture.path << std::endl;
+    }
+
+    return textureID;
+}
+
+class TextureCache {
+    struct Entry;
+
+public:
+    // shares an entry of the cache, the texture is not evicted while there is a handle to it
+    class Handle {
+    public:
+        Handle() = default;
+        Handle(const Handle &other) : entry(other.entry) { if (entry) entry->references++; }
+        Handle(Handle &&other) noexcept : entry(other.entry) { other.entry = nullptr; }
+        Handle &operator=(Handle other) { std::swap(entry, other.entry); return *this; }
+        ~Handle() { if (entry) entry->references--; }
+
+        explicit operator bool() const { return entry != nullptr; }
+        // 0 until the texture is uploaded
+        unsigned int id() const { return entry ? entry->id : 0; }
+        const string &path() const { return entry->path; }
+
+    private:
+        friend class TextureCache;
+        explicit Handle(Entry *entry) : entry(entry) { entry->references++; }
+        Entry *entry = nullptr;
+    };
+
+    struct Stats {
+        size_t hits = 0;      // acquire found the texture in the cache
+        size_t misses = 0;    // acquire had to add it
+        size_t decodes = 0;   // files decoded
+        size_t evictions = 0; // textures deleted to stay within the budget
+        size_t textures = 0;  // textures in the cache
+        size_t residentBytes = 0; // GPU memory of the uploaded textures, mipmaps included
+    };
+
+    // the cache of the program
+    static TextureCache &instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    TextureCache(TextureCache const&) = delete;
+    void operator=(TextureCache const&) = delete;
+
+    // the GL textures are not deleted, the context is usually gone when the cache is destroyed
+    ~TextureCache()
+    {
+        for (auto &item : entries)
+            if (item.second->data.pixels)
+                stbi_image_free(item.second->data.pixels);
+    }
+
+    // path relative to directory, without "." and ".." segments and with '/' separators, so that the different
+    // spellings of a path find the same texture
+    static string canonicalPath(const string &directory, const string &path)
+    {
+        bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'));
+        string joined = absolute || directory.empty() ? path : directory + '/' + path;
+        replace(joined.begin(), joined.end(), '\\', '/');
+        bool rooted = !joined.empty() && joined[0] == '/';
+
+        vector<string> segments;
+        size_t start = 0;
+        while (start <= joined.size())
+        {
+            size_t end = min(joined.find('/', start), joined.size());
+            string segment = joined.substr(start, end - start);
+            if (segment == "..")
+            {
+                if (!segments.empty() && segments.back() != "..")
+                    segments.pop_back();
+                else if (!rooted)
+                    segments.push_back(segment); // above the working directory, keep it
+            }
+            else if (!segment.empty() && segment != ".")
+                segments.push_back(segment);
+            start = end + 1;
+        }
+
+        string canonical = rooted ? "/" : "";
+        for (size_t i = 0; i < segments.size(); i++)
+            canonical += (i ? "/" : "") + segments[i];
+        return canonical.empty() ? "." : canonical;
+    }
+
+    // the texture at path (use canonicalPath), it is added to the cache if it is not there yet
+    Handle acquire(const string &path)
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        unique_ptr<Entry> &entry = entries[path];
+        if (entry)
+            statistics.hits++;
+        else
+        {
+            entry.reset(new Entry());
+            entry->path = path;
+            statistics.misses++;
+        }
+        entry->lastUsed = ++clock;
+        return Handle(entry.get());
+    }
+
+    // decodes the file of the texture, if it was not decoded yet. Any thread
+    void decode(const Handle &handle)
+    {
+        Entry &entry = *handle.entry;
+        lock_guard<mutex> lock(entry.decodeMutex);
+        if (entry.decoded)
+            return;
+        decodeTexture(entry.data, entry.path);
+        entry.decoded = true;
+        lock_guard<mutex> cacheLock(cacheMutex);
+        statistics.decodes++;
+    }
+
+    // uploads the texture, decoding it first if needed, and returns its id. GL thread
+    unsigned int upload(const Handle &handle)
+    {
+        decode(handle);
+        Entry &entry = *handle.entry;
+        {
+            lock_guard<mutex> lock(entry.decodeMutex);
+            if (entry.id != 0)
+                return entry.id;
+            entry.bytes = textureBytes(entry.data);
+            entry.id = uploadTexture(entry.data);
+        }
+        {
+            lock_guard<mutex> lock(cacheMutex);
+            statistics.residentBytes += entry.bytes;
+        }
+        trim();
+        return entry.id;
+    }
+
+    // deletes the unused textures, least recently used first, until the resident memory is within the budget. GL thread
+    void trim()
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        if (statistics.residentBytes <= budget)
+            return;
+        vector<Entry*> unused;
+        for (auto &item : entries)
+            if (item.second->references == 0)
+                unused.push_back(item.second.get());
+        sort(unused.begin(), unused.end(), [](Entry *a, Entry *b){ return a->lastUsed < b->lastUsed; });
+        for (Entry *entry : unused)
+        {
+            if (statistics.residentBytes <= budget)
+                break;
+            if (entry->id != 0)
+                glDeleteTextures(1, &entry->id);
+            if (entry->data.pixels)
+                stbi_image_free(entry->data.pixels);
+            statistics.residentBytes -= entry->bytes;
+            statistics.evictions++;
+            entries.erase(entry->path);
+        }
+    }
+
+    // budget of resident texture memory in bytes, the textures in use are never evicted so it can be exceeded
+    void setBudget(size_t bytes)
+    {
+        {
+            lock_guard<mutex> lock(cacheMutex);
+            budget = bytes;
+        }
+        trim();
+    }
+
+    Stats stats() const
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        Stats result = statistics;
+        result.textures = entries.size();
+        return result;
+    }
+
+private:
+    struct Entry {
+        string path;
+        unsigned int id = 0;
+        size_t bytes = 0;
+        uint64_t lastUsed = 0;
+        atomic<int> references{0};
+        mutex decodeMutex; // held while decoding or uploading
+        bool decoded = false;
+        TextureData data;
+    };
+
+    TextureCache() = default;
+
+    mutable mutex cacheMutex;
+    unordered_map<string, unique_ptr<Entry>> entries;
+    Stats statistics;
+    size_t budget = 256 * 1024 * 1024;
+    uint64_t clock = 0;
+};
+
+#endif